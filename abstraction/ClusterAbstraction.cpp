@@ -26,9 +26,13 @@
 
 #include "ClusterAbstraction.h"
 #include "GenericAStar.h"
+#include "WorkerPool.h"
+#include <cstdio>
 #include <cfloat>
 #include <cmath>
 #include <limits>
+#include <algorithm>
+#include <thread>
 
 using namespace GraphAbstractionConstants;
 
@@ -60,14 +64,15 @@ public:
 		return heuristic(node1, node2);
 	}
 
+	// The corridor is kept sorted so that many searches (on different threads) can
+	// share the abstraction; labelling the corridor nodes would write to the graph.
 	void setCorridor(std::vector<node *> &corr)
 	{
 		corridor = corr;
 		if (corr.size() > 0)
 		{
 			corridorLevel = aMap->GetAbstractionLevel(corr[0]);
-			for (unsigned int x = 0; x < corridor.size(); x++)
-				corridor[x]->SetLabelL(kTemporaryLabel, x);
+			std::sort(corridor.begin(), corridor.end());
 		}
 	}
 	
@@ -78,11 +83,7 @@ public:
 		node *n = aMap->GetAbstractGraph(level)->GetNode(nodeID);
 		node *parent = aMap->GetNthParent(n, corridorLevel);
 		if (parent)
-		{
-			unsigned int loc = parent->GetLabelL(kTemporaryLabel);
-			if ((loc < corridor.size()) && (corridor[loc] == parent))
-				return true;
-		}
+			return std::binary_search(corridor.begin(), corridor.end(), parent);
 		return false;
 	}
 private:
@@ -107,9 +108,12 @@ void Cluster::AddNode(int n)
 * create a cluster abstraction for the given map. Clusters are square, 
  * with height = width = clustersize. 
  */ 
-ClusterAbstraction::ClusterAbstraction(Map *map, int _clusterSize)
-:MapAbstraction(map),clusterSize(_clusterSize)
+ClusterAbstraction::ClusterAbstraction(Map *map, int _clusterSize, const char *cacheDirectory, int _numThreads)
+:MapAbstraction(map),clusterSize(_clusterSize),cacheDir(cacheDirectory?cacheDirectory:""),
+numThreads(_numThreads),fromCache(false)
 {
+	if (numThreads <= 0)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
 	abstractions.push_back(GetMapGraph(map));
 	createClustersAndEntrances();
 	linkEntrancesAndClusters();
@@ -198,8 +202,20 @@ void ClusterAbstraction::createAbstractGraph()
 	Graph *g = abstractions[1];
 	
 	addAbsNodes(g);
-	setUpParents(g);
-	computeClusterPaths(g);
+	// GetNodeLoc() stores the location of a node in its labels the first time it is
+	// called, and insertNode() reads them. Do it for every map node before the
+	// searches, so that they (running on several threads) only read the map nodes
+	// and the labels are set when the searches come from the cache.
+	node_iterator ni = abstractions[0]->getNodeIter();
+	for (node *n = abstractions[0]->nodeIterNext(ni); n; n = abstractions[0]->nodeIterNext(ni))
+		GetNodeLoc(n);
+	// results of the searches within the clusters, from the cache or computed below
+	std::vector<std::vector<int> > cellParents, entrancePaths;
+	fromCache = loadCache(g, cellParents, entrancePaths);
+	setUpParents(g, cellParents);
+	computeClusterPaths(g, entrancePaths);
+	if (!fromCache)
+		saveCache(g, cellParents, entrancePaths);
 	
 	// 	std::cout<<"1st level of abstraction\n";
 	// 	g->Print(std::cout);
@@ -540,73 +556,34 @@ void ClusterAbstraction::addAbsNodes(Graph* g)
  * 
  * can make this more efficient?
  */
-void ClusterAbstraction::computeClusterPaths(Graph* g)
-{//int total=0;
-	Map* map = MapAbstraction::GetMap();
+void ClusterAbstraction::computeClusterPaths(Graph* g, std::vector<std::vector<int> > &entrancePaths)
+{
 	if (verbose) std::cout<<"computing cluster paths\n";
+	// the clusters are searched in parallel; the edges are added in order afterwards
+	if (entrancePaths.size() != clusters.size())
+	{
+		entrancePaths.assign(clusters.size(), std::vector<int>());
+		forEachCluster([&](unsigned int i) {
+			findEntrancePaths(g, clusters[i], entrancePaths[i]);
+		});
+	}
 	for (unsigned int i=0; i<clusters.size(); i++)
 	{
 		Cluster& c = clusters[i];
-		
-		std::vector<node*> corridor; 
-		for (int l=0; l<c.GetNumNodes(); l++)
-		{
-			corridor.push_back(g->GetNode(c.getIthNodeNum(l)));
-		}
-		for (unsigned int j=0; j < c.parents.size(); j++)
-			corridor.push_back(c.parents[j]);
-		
-		//int num = 0;
+		const std::vector<int> &result = entrancePaths[i];
+		unsigned int next = 0;
 		for (int j=0; j<c.GetNumNodes(); j++)
 		{
 			for (int k=j+1; k<c.GetNumNodes();k++)
 			{
-				
-				// find bottom level nodes
-				node* absStart = g->GetNode(c.getIthNodeNum(j));
-				node* absGoal = g->GetNode(c.getIthNodeNum(k));
-				
-				// find start/end coordinates (same in abstract and bottom level)
-				double startx = absStart->GetLabelF(kXCoordinate);	
-				double starty = absStart->GetLabelF(kYCoordinate);
-				double startz = absStart->GetLabelF(kZCoordinate);
-				
-				double goalx = absGoal->GetLabelF(kXCoordinate);
-				double goaly = absGoal->GetLabelF(kYCoordinate);
-				double goalz = absGoal->GetLabelF(kZCoordinate);
-				
-				point3d s(startx,starty,startz);
-				point3d gl(goalx,goaly,goalz);
-				
-				int px;
-				int py;
-				
-				map->GetPointFromCoordinate(s,px,py);
-				
-				node* start = GetNodeFromMap(px,py);
-				
-				map->GetPointFromCoordinate(gl,px,py);
-				
-				node* goal = GetNodeFromMap(px,py);
-				
 				int startnum = c.getIthNodeNum(j);
 				int goalnum = c.getIthNodeNum(k);
 				
-				//find path
-//				corridorAStar astar;
-//				astar.setCorridor(&corridor);
-//				path* p = astar.GetPath(static_cast<MapAbstraction*>(this), start, goal);
-
-				GenericAStar astar;
-				ClusterSearchEnvironment cse(this, GetAbstractionLevel(start));
-				cse.setCorridor(corridor);
-				std::vector<uint32_t> resultPath;
-				astar.GetPath(&cse, start->GetNum(), goal->GetNum(),
-											resultPath);
 				path *p = 0;
-				for (unsigned int x = 0; x < resultPath.size(); x++)
-					p = new path(GetAbstractGraph(start)->GetNode(resultPath[x]), p);
-
+				int length = result[next++];
+				for (int x = 0; x < length; x++)
+					p = new path(abstractions[0]->GetNode(result[next++]), p);
+				
 				if (p!=0)
 				{
 					//get its length
@@ -624,6 +601,265 @@ void ClusterAbstraction::computeClusterPaths(Graph* g)
 	}
 }
 
+/*
+ * Find the paths between each pair of entrances of cluster c. For each pair (in the
+ * order computeClusterPaths adds the edges) result gets the length of the path (0 if
+ * there is none) followed by the numbers of its map nodes.
+ *
+ * Only reads the abstraction, so different clusters can be searched at the same time.
+ */
+void ClusterAbstraction::findEntrancePaths(Graph* g, Cluster& c, std::vector<int> &result)
+{
+	Map* map = MapAbstraction::GetMap();
+	std::vector<node*> corridor; 
+	for (int l=0; l<c.GetNumNodes(); l++)
+	{
+		corridor.push_back(g->GetNode(c.getIthNodeNum(l)));
+	}
+	for (unsigned int j=0; j < c.parents.size(); j++)
+		corridor.push_back(c.parents[j]);
+	
+	for (int j=0; j<c.GetNumNodes(); j++)
+	{
+		for (int k=j+1; k<c.GetNumNodes();k++)
+		{
+			
+			// find bottom level nodes
+			node* absStart = g->GetNode(c.getIthNodeNum(j));
+			node* absGoal = g->GetNode(c.getIthNodeNum(k));
+			
+			// find start/end coordinates (same in abstract and bottom level)
+			double startx = absStart->GetLabelF(kXCoordinate);	
+			double starty = absStart->GetLabelF(kYCoordinate);
+			double startz = absStart->GetLabelF(kZCoordinate);
+			
+			double goalx = absGoal->GetLabelF(kXCoordinate);
+			double goaly = absGoal->GetLabelF(kYCoordinate);
+			double goalz = absGoal->GetLabelF(kZCoordinate);
+			
+			point3d s(startx,starty,startz);
+			point3d gl(goalx,goaly,goalz);
+			
+			int px;
+			int py;
+			
+			map->GetPointFromCoordinate(s,px,py);
+			
+			node* start = GetNodeFromMap(px,py);
+			
+			map->GetPointFromCoordinate(gl,px,py);
+			
+			node* goal = GetNodeFromMap(px,py);
+			
+			//find path
+			GenericAStar astar;
+			ClusterSearchEnvironment cse(this, GetAbstractionLevel(start));
+			cse.setCorridor(corridor);
+			std::vector<uint32_t> resultPath;
+			astar.GetPath(&cse, start->GetNum(), goal->GetNum(),
+										resultPath);
+			result.push_back(resultPath.size());
+			for (unsigned int x = 0; x < resultPath.size(); x++)
+				result.push_back(resultPath[x]);
+		}
+	}
+}
+
+/**
+* Call f on the number of every cluster, spreading the clusters over the threads.
+ */
+void ClusterAbstraction::forEachCluster(const std::function<void(unsigned int)> &f)
+{
+	if (numThreads <= 1 || clusters.size() <= 1)
+	{
+		for (unsigned int i=0; i<clusters.size(); i++)
+			f(i);
+		return;
+	}
+	WorkerPool pool(std::min(numThreads, (int)clusters.size()));
+	WorkStealingRange range(pool.NumThreads());
+	range.Reset(clusters.size());
+	pool.Run([&](int threadNum) {
+		uint64_t i;
+		while (range.Next(threadNum, i))
+			f((unsigned int)i);
+	});
+}
+
+// header of the files that cache the results of the cluster searches
+struct ClusterCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t mapHash;
+	int32_t clusterSize;
+	int32_t numClusters;
+	int32_t numEntrances;
+	int32_t pad;
+};
+static const uint32_t kClusterCacheMagic = 0x43415048; // "HPAC"
+static const uint32_t kClusterCacheVersion = 1;
+
+/**
+* 64-bit FNV-1a hash of the size and terrain of the map.
+ */
+uint64_t ClusterAbstraction::getMapHash()
+{
+	Map* map = MapAbstraction::GetMap();
+	uint64_t hash = 0xcbf29ce484222325ull;
+	auto add = [&](uint64_t value) {
+		for (int x = 0; x < 8; x++)
+		{
+			hash ^= (value>>(8*x))&0xFF;
+			hash *= 0x100000001b3ull;
+		}
+	};
+	add(map->GetMapWidth());
+	add(map->GetMapHeight());
+	for (int y = 0; y < map->GetMapHeight(); y++)
+	{
+		for (int x = 0; x < map->GetMapWidth(); x++)
+		{
+			add(map->GetTerrainType(x, y, kLeftSide));
+			add(map->GetTerrainType(x, y, kRightSide));
+			add(map->GetSplit(x, y));
+		}
+	}
+	return hash;
+}
+
+std::string ClusterAbstraction::getCacheFileName()
+{
+	char name[64];
+	sprintf(name, "/hpa-%016llx-%d.cache", (unsigned long long)getMapHash(), clusterSize);
+	return cacheDir+name;
+}
+
+/**
+* Read the results of the cluster searches from the cache file. Returns false (and
+ * leaves the results empty) if there is no cache or it doesn't match this map.
+ */
+bool ClusterAbstraction::loadCache(Graph* g, std::vector<std::vector<int> > &cellParents, std::vector<std::vector<int> > &entrancePaths)
+{
+	if (cacheDir.size() == 0)
+		return false;
+	std::string fname = getCacheFileName();
+	FILE *f = fopen(fname.c_str(), "rb");
+	if (f == 0)
+		return false;
+	Map* map = MapAbstraction::GetMap();
+	int numMapNodes = abstractions[0]->GetNumNodes();
+	int numEntrances = 0;
+	for (unsigned int i=0; i<clusters.size(); i++)
+		numEntrances += clusters[i].GetNumNodes();
+	fseek(f, 0, SEEK_END);
+	long remaining = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	ClusterCacheHeader header;
+	bool valid = (fread(&header, sizeof(header), 1, f) == 1) &&
+		header.magic == kClusterCacheMagic && header.version == kClusterCacheVersion &&
+		header.mapHash == getMapHash() && header.clusterSize == clusterSize &&
+		header.numClusters == (int)clusters.size() && header.numEntrances == numEntrances &&
+		numEntrances == g->GetNumNodes();
+	remaining -= sizeof(header);
+	cellParents.resize(clusters.size());
+	entrancePaths.resize(clusters.size());
+	for (unsigned int i=0; valid && i<clusters.size(); i++)
+	{
+		Cluster& c = clusters[i];
+		for (int which = 0; valid && which < 2; which++)
+		{
+			std::vector<int> &data = (which == 0)?cellParents[i]:entrancePaths[i];
+			uint32_t size;
+			valid = (fread(&size, sizeof(size), 1, f) == 1) && size*sizeof(int)+sizeof(size) <= (unsigned long)remaining;
+			if (!valid)
+				break;
+			remaining -= size*sizeof(int)+sizeof(size);
+			data.resize(size);
+			valid = (size == 0) || (fread(&data[0], sizeof(int), size, f) == size);
+		}
+		if (!valid)
+			break;
+		
+		// one entrance (or -1) per open cell of the cluster
+		unsigned int cells = 0;
+		for (int x=c.getHOrig(); x<c.getHOrig()+c.getWidth(); x++)
+			for (int y=c.getVOrig(); y<c.getVOrig()+c.GetHeight(); y++)
+				if (map->GetNodeNum(x,y) >= 0)
+					cells++;
+		valid = (cellParents[i].size() == cells);
+		for (unsigned int x = 0; valid && x < cells; x++)
+			valid = (cellParents[i][x] >= -1) && (cellParents[i][x] < numEntrances);
+		
+		// a path (possibly empty) of map nodes for each pair of entrances
+		const std::vector<int> &result = entrancePaths[i];
+		unsigned int next = 0;
+		for (int pair = 0; valid && pair < c.GetNumNodes()*(c.GetNumNodes()-1)/2; pair++)
+		{
+			valid = (next < result.size()) && (result[next] >= 0) && (result[next] <= (int)(result.size()-next-1));
+			if (!valid)
+				break;
+			int length = result[next++];
+			for (int x = 0; valid && x < length; x++, next++)
+				valid = (result[next] >= 0) && (result[next] < numMapNodes);
+		}
+		valid = valid && (next == result.size());
+	}
+	fclose(f);
+	if (!valid)
+	{
+		printf("Ignoring HPA* cache '%s'; it doesn't match the map\n", fname.c_str());
+		cellParents.clear();
+		entrancePaths.clear();
+	}
+	return valid;
+}
+
+/**
+* Write the results of the cluster searches to the cache file. The file is written
+ * under a temporary name and then renamed, so a reader never sees part of a file.
+ */
+void ClusterAbstraction::saveCache(Graph* g, const std::vector<std::vector<int> > &cellParents, const std::vector<std::vector<int> > &entrancePaths)
+{
+	if (cacheDir.size() == 0)
+		return;
+	std::string fname = getCacheFileName();
+	std::string tmpName = fname+".tmp";
+	FILE *f = fopen(tmpName.c_str(), "wb");
+	if (f == 0)
+	{
+		perror("Unable to write HPA* cache");
+		return;
+	}
+	ClusterCacheHeader header;
+	header.magic = kClusterCacheMagic;
+	header.version = kClusterCacheVersion;
+	header.mapHash = getMapHash();
+	header.clusterSize = clusterSize;
+	header.numClusters = clusters.size();
+	header.numEntrances = 0;
+	for (unsigned int i=0; i<clusters.size(); i++)
+		header.numEntrances += clusters[i].GetNumNodes();
+	header.pad = 0;
+	bool ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+	for (unsigned int i=0; ok && i<clusters.size(); i++)
+	{
+		for (int which = 0; ok && which < 2; which++)
+		{
+			const std::vector<int> &data = (which == 0)?cellParents[i]:entrancePaths[i];
+			uint32_t size = data.size();
+			ok = (fwrite(&size, sizeof(size), 1, f) == 1) &&
+				((size == 0) || (fwrite(&data[0], sizeof(int), size, f) == size));
+		}
+	}
+	if (fclose(f) != 0)
+		ok = false;
+	if (!ok || rename(tmpName.c_str(), fname.c_str()) != 0)
+	{
+		perror("Unable to write HPA* cache");
+		remove(tmpName.c_str());
+	}
+}
+
 /**
 * given a cluster row and column (NOT map row/column), return the cluster's ID.
  */
@@ -707,7 +943,7 @@ int ClusterAbstraction::getClusterIdFromNode(node* n)
  *
  * Connected component code borrowed from MapSectorAbstraction.cpp
  */
-void ClusterAbstraction::setUpParents(Graph* g)
+void ClusterAbstraction::setUpParents(Graph* g, std::vector<std::vector<int> > &cellParents)
 {
 	
 	
@@ -751,113 +987,34 @@ void ClusterAbstraction::setUpParents(Graph* g)
 	
 	int numNodesAfter = g->GetNumNodes();
 	
+	// Find the parents of the cells of all clusters in parallel, then build the cells
+	// into them in order. A cell keeps its dummy parent until then, which (like its
+	// entrance) is in the corridor of its own cluster, so the searches are the same
+	// as when each cell was built into its parent right after its own search.
+	if (cellParents.size() != clusters.size())
+	{
+		cellParents.assign(clusters.size(), std::vector<int>());
+		forEachCluster([&](unsigned int i) {
+			findCellParents(g, clusters[i], dummies[i], cellParents[i]);
+		});
+	}
 	for (unsigned int i=0; i<clusters.size(); i++)
 	{
-		
 		Cluster& c = clusters[i];
-		//Create the corridor
-		std::vector<node*> corridor; 
-		corridor.push_back(dummies[i]);
-		
-		for (int l=0; l<c.GetNumNodes(); l++)
-		{
-			corridor.push_back(g->GetNode(c.getIthNodeNum(l)));
-		}
-		
-//		corridorAStar astar;
-//		astar.setCorridor(&corridor);	
-		
-		// 		std::cout<<"corridor has: "<<std::endl;
-		// 		for (unsigned int bla = 0; bla<corridor.size(); bla++)
-		// 			std::cout<<corridor[bla]<<" ("<<corridor[bla]->GetLabelL(kNumAbstractedNodes)<<") ";
-		// 		std::cout<<std::endl;
-		
-		//Find parent for each node 
+		unsigned int next = 0;
 		for (int x=c.getHOrig(); x<c.getHOrig()+c.getWidth(); x++)
 		{
 			for (int y=c.getVOrig(); y<c.getVOrig()+c.GetHeight(); y++)
 			{
 				if (map->GetNodeNum(x,y) >= 0)
 				{
-					node* mnode = GetNodeFromMap(x,y);
-					
-					// reset minimum 
-					double minDist = DBL_MAX;
-					node* entrance = 0;
-					
-					//for every abstract (entrance node) in this cluster
-					for (int k=0; k<c.GetNumNodes(); k++)
-					{
-						//get the entrance
-						int nodenum = c.getIthNodeNum(k);
-						
-						node* n = g->GetNode(nodenum);						
-						node* low = getLowLevelNode(n);	
-						
-						if (low==mnode)
-						{
-							entrance = n;
-							break;
-						}
-						
-						//See if there's a path within this cluster
-//						astar.setCorridor(&corridor);
-//						path* p = astar.GetPath(static_cast<MapAbstraction*>(this),low,mnode);
-						GenericAStar astar;
-						ClusterSearchEnvironment cse(this, GetAbstractionLevel(low));
-						cse.setCorridor(corridor);
-						std::vector<uint32_t> resultPath;
-						astar.GetPath(&cse, low->GetNum(), mnode->GetNum(),
-													resultPath);
-						path *p = 0;
-						for (unsigned int t = 0; t < resultPath.size(); t++)
-							p = new path(GetAbstractGraph(low)->GetNode(resultPath[t]), p);
-						
-						if (p!=0)
-						{
-							// 								std::cout<<"corridor has: "<<std::endl;
-							// 								for (unsigned int bla = 0; bla<corridor.size(); bla++)
-							// 									std::cout<<corridor[bla]<<" ("<<corridor[bla]->GetLabelL(kNumAbstractedNodes)<<") ";
-							// 								std::cout<<std::endl;
-							// 							}
-							
-							// find distance to this point 
-							point3d s(n->GetLabelF(kXCoordinate),n->GetLabelF(kYCoordinate),-1);
-							int px;
-							int py;
-							map->GetPointFromCoordinate(s,px,py);
-							
-							// calculate the distance to this entrance
-							
-							double dist = distance(p);
-							
-							if (dist<minDist)
-							{
-								
-								minDist=dist;  
-								entrance=n;
-								
-							}
-							delete p;
-					}
+					int parent = cellParents[i][next++];
+					if (parent != -1)
+						buildNodeIntoParent(GetNodeFromMap(x,y), g->GetNode(parent));
 				}
-					
-					//std::cout<<entrance<<std::endl;
-					if (entrance)
-					{
-						
-						point3d s(entrance->GetLabelF(kXCoordinate),entrance->GetLabelF(kYCoordinate),-1);
-						int px;
-						int py;
-						map->GetPointFromCoordinate(s,px,py);
-						buildNodeIntoParent(mnode, entrance);
-					}
-					//					else
-					//std::cout<<" no parent\n";
-			}//end if (not out of bounds)
-		}    
+			}
+		}
 	}
-}
 // 	for (unsigned int i=0;i<dummies.size(); i++){
 // 		// make sure no node has a dummy for a parent
 // 		for (int j=0; j<dummies[i]->GetLabelL(kNumAbstractedNodes); j++){
@@ -920,6 +1077,83 @@ for (unsigned int i=dummies.size()-1;i>0; --i)
 }
 }
 
+/**
+* Find the closest entrance of each cell of cluster c. For every cell of the map in
+ * the cluster (in the order setUpParents visits them) result gets the number of
+ * the entrance, or -1 if no entrance can be reached inside the cluster.
+ *
+ * Only reads the abstraction, so different clusters can be searched at the same time.
+ */
+void ClusterAbstraction::findCellParents(Graph* g, Cluster& c, node* dummy, std::vector<int> &result)
+{
+	Map* map = MapAbstraction::GetMap();
+	//Create the corridor
+	std::vector<node*> corridor; 
+	corridor.push_back(dummy);
+	
+	for (int l=0; l<c.GetNumNodes(); l++)
+	{
+		corridor.push_back(g->GetNode(c.getIthNodeNum(l)));
+	}
+	
+	//Find parent for each node 
+	for (int x=c.getHOrig(); x<c.getHOrig()+c.getWidth(); x++)
+	{
+		for (int y=c.getVOrig(); y<c.getVOrig()+c.GetHeight(); y++)
+		{
+			if (map->GetNodeNum(x,y) >= 0)
+			{
+				node* mnode = GetNodeFromMap(x,y);
+				
+				// reset minimum 
+				double minDist = DBL_MAX;
+				node* entrance = 0;
+				
+				//for every abstract (entrance node) in this cluster
+				for (int k=0; k<c.GetNumNodes(); k++)
+				{
+					//get the entrance
+					int nodenum = c.getIthNodeNum(k);
+					
+					node* n = g->GetNode(nodenum);						
+					node* low = getLowLevelNode(n);	
+					
+					if (low==mnode)
+					{
+						entrance = n;
+						break;
+					}
+					
+					//See if there's a path within this cluster
+					GenericAStar astar;
+					ClusterSearchEnvironment cse(this, GetAbstractionLevel(low));
+					cse.setCorridor(corridor);
+					std::vector<uint32_t> resultPath;
+					astar.GetPath(&cse, low->GetNum(), mnode->GetNum(),
+												resultPath);
+					path *p = 0;
+					for (unsigned int t = 0; t < resultPath.size(); t++)
+						p = new path(GetAbstractGraph(low)->GetNode(resultPath[t]), p);
+					
+					if (p!=0)
+					{
+						// calculate the distance to this entrance
+						double dist = distance(p);
+						
+						if (dist<minDist)
+						{
+							minDist=dist;  
+							entrance=n;
+						}
+						delete p;
+					}
+				}
+				result.push_back(entrance?entrance->GetNum():-1);
+			}
+		}
+	}
+}
+
 /**
 * 'borrowed' from MapSectorAbstraction.cpp
  */
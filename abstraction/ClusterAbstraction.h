@@ -28,6 +28,8 @@
 #define CLUSTERABSTRACTION_H
 
 #include <vector>
+#include <string>
+#include <functional>
 #include <ext/hash_map>
 
 #include "MapAbstraction.h"
@@ -133,13 +135,20 @@ private:
 /** 
  * Cluster abstraction for HPA* algorithm as described in (Botea,Mueller,Schaeffer 2004). 
  * Source code based on HPA* code found at http://www.cs.ualberta.ca/~adib/Home/Download/hpa.tgz
+ *
+ * Building the abstraction runs a search from every entrance of a cluster to every
+ * cell of the cluster and between every pair of entrances. These searches are spread
+ * over numThreads threads (0 uses one per core). If cacheDirectory is given, their
+ * results are saved there in a file named by the hash of the map and the cluster
+ * size, and are read back instead of searching the next time the same map is
+ * abstracted.
  */
 class ClusterAbstraction : public MapAbstraction {
 public:
-  ClusterAbstraction(Map *map, int _clusterSize);
+  ClusterAbstraction(Map *map, int _clusterSize, const char *cacheDirectory = 0, int numThreads = 0);
   ~ClusterAbstraction();
 	MapAbstraction* Clone(Map* map)
-	{ return new ClusterAbstraction(map, clusterSize); }
+	{ return new ClusterAbstraction(map, clusterSize, cacheDir.size()?cacheDir.c_str():0, numThreads); }
 
 	int getClusterSize() { return clusterSize; };  
   bool Pathable(node* start, node* goal);
@@ -161,6 +170,8 @@ public:
 	void printMapCoord(node* n);
 	void printPathAsCoord(path* p);
 	virtual void OpenGLDraw() const;
+	/** true if the abstraction was built from the cache file */
+	bool loadedFromCache() const { return fromCache; }
 
 private:
   int min(int, int);
@@ -171,13 +182,17 @@ private:
   void createVertEntrances(int, int, int, int, int);
   void linkEntrancesAndClusters();
   void addAbsNodes(Graph* g);
-  void computeClusterPaths(Graph* g);
+  void computeClusterPaths(Graph* g, std::vector<std::vector<int> > &entrancePaths);
+  void findEntrancePaths(Graph* g, Cluster& c, std::vector<int> &result);
   void addEntrance(Entrance e);
   int getClusterId(int row, int col) const;
 
   Cluster& getCluster(int id);
 
   int clusterSize;
+  std::string cacheDir;
+  int numThreads;
+  bool fromCache;
   int rows; //rows of clusters
   int columns; //columns of clusters
 
@@ -187,7 +202,14 @@ private:
   clusterUtil::PathLookupTable temp;
 		std::vector<path*> newPaths;
   int nodeExists(const Cluster& c,double x,double y, Graph* g);
-  void setUpParents(Graph* g);
+  void setUpParents(Graph* g, std::vector<std::vector<int> > &cellParents);
+  void findCellParents(Graph* g, Cluster& c, node* dummy, std::vector<int> &result);
+  void forEachCluster(const std::function<void(unsigned int)> &f);
+
+  uint64_t getMapHash();
+  std::string getCacheFileName();
+  bool loadCache(Graph* g, std::vector<std::vector<int> > &cellParents, std::vector<std::vector<int> > &entrancePaths);
+  void saveCache(Graph* g, const std::vector<std::vector<int> > &cellParents, const std::vector<std::vector<int> > &entrancePaths);
 
 	void buildNodeIntoParent(node *n, node *parent);
 	void abstractionBFS(node *which, node *parent, int cluster,int numOrigNodes,int numNodesAfter);
@@ -26,10 +26,11 @@
 #include "PositionalUtils.h"
 #include <iostream>
 #include "FPUtil.h"
+#include "SafeIntervalStore.h"
 
 #include <vector>
 #include <list>
-#include <unordered_map>
+#include <deque>
 #include <algorithm>
 
 #define CN_EPSILON      1e-5
@@ -37,9 +38,6 @@
 #define CN_BT_G_MAX     1
 #define CN_BT_G_MIN     2
 
-typedef std::pair<double,double> Interval;
-typedef std::vector<Interval> Intervals;
-
 // Based on the algorithm of (Yakovlev and Andreychuk 2017)
 template <typename Map, typename State>
 class AnyAngleSipp
@@ -114,9 +112,19 @@ public:
     Intervals const& getSafeIntervals(uint16_t x,uint16_t y) const;
     void setSafeIntervals(uint16_t x,uint16_t y,Intervals const& intvls);
     void setConstraint(uint16_t x, uint16_t y, double t);
+    // Trajectories of moving obstacles (e.g. the paths of other agents, as
+    // returned by GetPath). They stay in effect for later queries until they
+    // are removed, so replanning only updates the trajectories that changed.
+    void AddTrajectory(uint32_t id, std::vector<State> const& path);
+    void RemoveTrajectory(uint32_t id);
+    // Removes all trajectories, constraints and safe intervals
+    void ClearTrajectories();
 
 private:
 
+    // owner of the constraints added with setConstraint()
+    static const uint32_t manualOwner = 0xFFFFFFFF;
+
     void addOpen(State &newState);
     State findMin(int size);
     bool stopCriterion();
@@ -127,33 +135,37 @@ private:
     void makePrimaryPath(State curState);
     void makeSecondaryPath(State curState);
     void calculateLineSegment(std::vector<State> &line, State const& start, State const& goal);
-    void addConstraints(int curAgent);
-    void addConstraints(std::vector<State> const& path);
+    void addConstraints(std::vector<State> const& path, uint32_t owner);
+    State* addClosed(State const& s, int w);
     State resetParent(State current, State Parent, Map const& map);
     bool findPath(std::vector<State>& solution, State const& s, State const& g, Map const& map);
-    std::vector<std::pair<int, int> > findConflictCells(State cur);
+    void findConflictCells(State const& cur, State const& parent, std::vector<std::pair<int, int> >& cells);
     std::vector<std::pair<double, double> > findIntervals(State curState, std::vector<double> &EAT, int w);
     //std::vector<conflict> CheckConflicts();//bruteforce checker. It splits final(already built) trajectories into sequences of points and checks distances between them
 
-    //std::vector<std::vector<std::vector<std::pair<double,double>>>> safe_intervals;
-    std::unordered_map<uint32_t,Intervals> safe_intervals;
-    uint32_t hash(uint16_t x,uint16_t y) const {return (x<<16)+y;}
-    
-    //std::vector<std::vector<std::vector<constraint>>> ctable;
-    std::unordered_map<uint32_t,std::vector<constraint>> ctable;
+    // Indexed by grid cell and kept across queries
+    SafeIntervalStore safe_intervals;
+    CellLists<constraint> ctable;
     double weight;
     bool breakingties;
     unsigned int closeSize, openSize;
-    std::list<State> *open, lppath;
-    std::unordered_multimap<int, State> close;
+    std::vector<std::list<State> > open;
+    std::list<State> lppath;
+    // Closed states of the current query. States are reused by the next
+    // query; the deque keeps the Parent pointers valid as it grows.
+    std::deque<State> closed;
+    std::vector<uint32_t> closedHead, closedNext; // newest closed state of each cell, next older one
+    unsigned numClosed, closedWidth;
+    std::vector<std::pair<int, int> > cells;
     std::vector<State> hppath;
     double gap;
     int NUMOFCUR;
     SearchResult sresult;
-    // Note: this should be static
-    Intervals defaultIntervals;
 };
 
+template <typename Map, typename State>
+const uint32_t AnyAngleSipp<Map,State>::manualOwner;
+
 inline bool sort_function(std::pair<double, double> a, std::pair<double, double> b)
 {
     return fless(a.first, b.first);
@@ -162,14 +174,15 @@ inline bool sort_function(std::pair<double, double> a, std::pair<double, double>
 
 template <typename Map, typename State>
 AnyAngleSipp<Map,State>::AnyAngleSipp(double weight, bool breakingties)
+:safe_intervals(CN_INFINITY)
 {
     this->weight = weight;
     this->breakingties = breakingties;
     closeSize = 0;
     openSize = 0;
+    numClosed = 0;
+    closedWidth = 0;
     gap = 2;//equivalent of 4r
-    // This is used everywhere that a "save" interval is not defined
-    defaultIntervals.push_back({0,CN_INFINITY});
 }
 
 template <typename Map, typename State>
@@ -196,8 +209,8 @@ void AnyAngleSipp<Map,State>::findSuccessors(State const& curState, State const&
     std::vector<std::pair<double, double>> intervals;
     double h_value;
     // Added this line
-    //close.insert({curState.x * map.GetMapWidth() + curState.y, curState});
-    auto parent = &(close.find(curState.x*map.GetMapWidth() + curState.y)->second);
+    // curState is the newest closed state of its cell
+    auto parent = &closed[closedHead[curState.y*map.GetMapWidth() + curState.x]];
     for(int i = -1; i <= +1; i++)
     {
         for(int j = -1; j <= +1; j++)
@@ -398,26 +411,55 @@ void AnyAngleSipp<Map,State>::addOpen(State &newState)
 // Get safe intervals
 template <typename Map, typename State>
 Intervals const& AnyAngleSipp<Map,State>::getSafeIntervals(uint16_t x, uint16_t y) const{
-  auto interval(safe_intervals.find(hash(x,y)));
-  // If the interval is non-extant, return an interval of [0,INFTY).
-  if(interval==safe_intervals.end()){
-    return defaultIntervals;
-  }else{
-    return interval->second;
-  }
+  // If the interval is non-extant, this is an interval of [0,INFTY).
+  return safe_intervals.GetSafeIntervals(x,y);
 }
 
-// Add an unsafe interval to the safe intervals list
+// Replace the safe intervals of a cell (trajectories are still subtracted from them)
 template <typename Map, typename State>
 void AnyAngleSipp<Map,State>::setSafeIntervals(uint16_t x, uint16_t y, Intervals const& intvls){
-  safe_intervals[hash(x,y)]=intvls;
+  safe_intervals.SetSafeIntervals(x,y,intvls);
 }
 
 // Add a constraint to the constraint table
 template <typename Map, typename State>
 void AnyAngleSipp<Map,State>::setConstraint(uint16_t x, uint16_t y, double time){
   constraint c(x,y,time);
-  ctable[hash(x,y)].push_back(c);
+  ctable.Add(x,y,manualOwner,c);
+}
+
+template <typename Map, typename State>
+void AnyAngleSipp<Map,State>::AddTrajectory(uint32_t id, std::vector<State> const& path){
+  RemoveTrajectory(id);
+  addConstraints(path,id);
+}
+
+template <typename Map, typename State>
+void AnyAngleSipp<Map,State>::RemoveTrajectory(uint32_t id){
+  ctable.RemoveOwner(id);
+  safe_intervals.RemoveOwner(id);
+}
+
+template <typename Map, typename State>
+void AnyAngleSipp<Map,State>::ClearTrajectories(){
+  ctable.Clear();
+  safe_intervals.Clear();
+}
+
+// Add s to the closed list
+template <typename Map, typename State>
+State* AnyAngleSipp<Map,State>::addClosed(State const& s, int w){
+  unsigned n(numClosed++);
+  if(n<closed.size()){
+    closed[n]=s;
+  }else{
+    closed.push_back(s);
+    closedNext.push_back(0);
+  }
+  uint32_t cell(s.y*w+s.x);
+  closedNext[n]=closedHead[cell];
+  closedHead[cell]=n;
+  return &closed[n];
 }
 
 // Initialize search
@@ -457,12 +499,11 @@ void AnyAngleSipp<Map,State>::GetPath(std::vector<State>& solution, State const&
         map.addConstraint(map.goal_i[i], map.goal_j[i]);
     }
     */
-    if(findPath(solution, start, goal, map))
-      addConstraints(0);
-    close.clear();
-    for(int i = 0; i< map.GetMapHeight(); i++)
+    safe_intervals.Reserve(map.GetMapWidth(), map.GetMapHeight());
+    ctable.Reserve(map.GetMapWidth(), map.GetMapHeight());
+    findPath(solution, start, goal, map);
+    for(int i = 0; i< open.size(); i++)
       open[i].clear();
-    delete [] open;
 /*#ifdef __linux__
     gettimeofday(&end, NULL);
     sresult.time = (end.tv_sec - begin.tv_sec) + static_cast<double>(end.tv_usec - begin.tv_usec) / 1000000;
@@ -492,10 +533,10 @@ State AnyAngleSipp<Map,State>::resetParent(State current, State Parent, Map cons
 }
 
 template <typename Map, typename State>
-std::vector<std::pair<int,int>> AnyAngleSipp<Map,State>::findConflictCells(State cur)
+void AnyAngleSipp<Map,State>::findConflictCells(State const& cur, State const& parent, std::vector<std::pair<int,int>>& cells)
 {
-    std::vector<std::pair<int,int>> cells(0);
-    int i1 = cur.x, j1 = cur.y, i2 = cur.Parent->x, j2 = cur.Parent->y;
+    cells.resize(0);
+    int i1 = cur.x, j1 = cur.y, i2 = parent.x, j2 = parent.y;
     int delta_i = std::abs(i1 - i2);
     int delta_j = std::abs(j1 - j2);
     int step_i = (i1 < i2 ? 1 : -1);
@@ -552,28 +593,23 @@ std::vector<std::pair<int,int>> AnyAngleSipp<Map,State>::findConflictCells(State
         cells.push_back({i,j});
         cells.push_back({i+step_i,j});
     }
-    return cells;
-}
-
-
-template <typename Map, typename State>
-void AnyAngleSipp<Map,State>::addConstraints(int curAgent)
-{
-  addConstraints(sresult.pathInfo[curAgent].sections);
 }
 
+// Consecutive states of path are the sections of the trajectory
 template <typename Map, typename State>
-void AnyAngleSipp<Map,State>::addConstraints(std::vector<State> const& path)
+void AnyAngleSipp<Map,State>::addConstraints(std::vector<State> const& path, uint32_t owner)
 {
-    State cur;
-    std::vector<std::pair<int,int>> cells;
+    State cur, parent;
     for(int a = 1; a < path.size(); a++)
     {
         cur = path[a];
-        cells = findConflictCells(cur);
-        int x1 = cur.x, y1 = cur.y, x0 = cur.Parent->x, y0 = cur.Parent->y;
+        parent = path[a - 1];
+        findConflictCells(cur, parent, cells);
+        // cells next to the map edge can be off the map
+        cells.erase(std::remove_if(cells.begin(), cells.end(), [](std::pair<int,int> const& c){return c.first < 0 || c.second < 0;}), cells.end());
+        int x1 = cur.x, y1 = cur.y, x0 = parent.x, y0 = parent.y;
         if(x1 != x0 || y1 != y0)
-            cur.Parent->g = cur.g - calculateDistanceFromCellToCell(x0, y0, x1, y1);
+            parent.g = cur.g - calculateDistanceFromCellToCell(x0, y0, x1, y1);
         constraint add;
         add.agent = 0;
         int dx = abs(x1 - x0);
@@ -582,18 +618,19 @@ void AnyAngleSipp<Map,State>::addConstraints(std::vector<State> const& path)
         {
             add.x = cur.x;
             add.y = cur.y;
-            uint32_t key(hash(add.x,add.y));
             add.goal = false;
-            for(double i = cur.Parent->g; i <= cur.g; i += gap)
+            for(double i = parent.g; i <= cur.g; i += gap)
             {
                 add.g = i;
-                if(ctable[key].empty() || ctable[key].back().g != add.g)
-                    ctable[key].push_back(add);
+                constraint const* last(ctable.Newest(add.x, add.y, owner));
+                if(last == nullptr || last->g != add.g)
+                    ctable.Add(add.x, add.y, owner, add);
             }
-            if(ctable[key].back().g < cur.g)
+            constraint const* last(ctable.Newest(add.x, add.y, owner));
+            if(last == nullptr || last->g < cur.g)
             {
                 add.g = cur.g;
-                ctable[key].push_back(add);
+                ctable.Add(add.x, add.y, owner, add);
             }
             continue;
         }
@@ -626,22 +663,22 @@ void AnyAngleSipp<Map,State>::addConstraints(std::vector<State> const& path)
                     con.x = x1;
                     con.y = y1;
                 }
-                con.g = cur.Parent->g + Util::distance(cur.Parent->x, cur.Parent->y, con.x, con.y);
+                con.g = parent.g + Util::distance(parent.x, parent.y, con.x, con.y);
                 if(add.x == path.back().x && add.y == path.back().y)
                     con.goal = true;
                 else
                     con.goal = false;
                 con.agent = 0;
-                uint32_t key(hash(add.x,add.y));
-                if(ctable[key].empty() || fabs(ctable[key].back().g-con.g)>CN_EPSILON)
-                    ctable[key].push_back(con);
+                constraint const* last(ctable.Newest(add.x, add.y, owner));
+                if(last == nullptr || fabs(last->g-con.g)>CN_EPSILON)
+                    ctable.Add(add.x, add.y, owner, con);
             }
             for(int i = 0; i < cells.size(); i++)
             {
                 add.x = cells[i].first;
                 add.y = cells[i].second;
                 add.agent = 0;
-                Interval ps, pg, interval;
+                TimeInterval ps, pg, interval;
                 ps = {x0, y0};
                 pg = {x1, y1};
                 double dist = fabs((ps.first - pg.first)*add.y + (pg.second - ps.second)*add.x + (ps.second*pg.first - ps.first*pg.second))
@@ -653,70 +690,23 @@ void AnyAngleSipp<Map,State>::addConstraints(std::vector<State> const& path)
                 double size = sqrt(1 - dist*dist);
                 if(da >= 1 && db >= 1)
                 {
-                    interval.first = cur.Parent->g + ha - size;
-                    interval.second = cur.Parent->g + ha + size;
+                    interval.first = parent.g + ha - size;
+                    interval.second = parent.g + ha + size;
                 }
                 else if(da < 1)
                 {
-                    interval.first = cur.Parent->g;
+                    interval.first = parent.g;
                     interval.second = cur.g - hb + size;
                 }
                 else
                 {
-                    interval.first = cur.Parent->g + ha - size;
+                    interval.first = parent.g + ha - size;
                     interval.second = cur.g;
                 }
-                uint32_t key(hash(add.x,add.y));
-                // If the safe interval does not explicitly exist, create it
-                if(safe_intervals.find(key) == safe_intervals.end()){
-                  safe_intervals[key] = defaultIntervals;
-                }
-                for(int j = 0; j < safe_intervals[key].size(); j++)
-                {
-                    if(safe_intervals[key][j].first <= interval.first && safe_intervals[key][j].second >= interval.first)
-                    {
-                        if(safe_intervals[key][j].second < interval.second)
-                        {
-                            safe_intervals[key].erase(safe_intervals[key].begin() + j);
-                            break;
-                        }
-                        else if(safe_intervals[key][j].first == interval.first)
-                        {
-                            safe_intervals[key][j].first = interval.second;
-                            break;
-                        }
-                        else if(safe_intervals[key][j].second <= interval.second)
-                        {
-                            safe_intervals[key][j].second = interval.first;
-                            break;
-                        }
-                        else
-                        {
-                            std::pair<double,double> new1, new2;
-                            new1.first = safe_intervals[key][j].first;
-                            new1.second = interval.first;
-                            new2.first = interval.second;
-                            new2.second = safe_intervals[key][j].second;
-                            safe_intervals[key].erase(safe_intervals[key].begin() + j);
-                            safe_intervals[key].insert(safe_intervals[key].begin() + j, new2);
-                            safe_intervals[key].insert(safe_intervals[key].begin() + j, new1);
-                            break;
-                        }
-                    }
-                    else if(safe_intervals[key][j].first > interval.first && safe_intervals[key][j].first < interval.second)
-                    {
-                        if(safe_intervals[key][j].second < interval.second)
-                        {
-                            safe_intervals[key].erase(safe_intervals[key].begin() + j);
-                            break;
-                        }
-                        else
-                        {
-                            safe_intervals[key][j].first = interval.second;
-                            break;
-                        }
-                    }
-                }
+                // dist can exceed 1 for cells at the corners of the section
+                if(std::isnan(interval.first) || std::isnan(interval.second))
+                    continue;
+                safe_intervals.AddUnsafeInterval(add.x, add.y, owner, interval);
             }
         }
     }
@@ -735,23 +725,39 @@ bool AnyAngleSipp<Map,State>::findPath(std::vector<State>& solution, State const
     QueryPerformanceFrequency(&freq);
 #endif
 */
-    open = new std::list<State>[map.GetMapHeight()];
+    // open lists are indexed by x
+    open.resize(map.GetMapWidth());
+    unsigned w(map.GetMapWidth());
+    if(closedWidth != w || closedHead.size() != w*map.GetMapHeight())
+    {
+        closedHead.assign(w*map.GetMapHeight(), CellLists<constraint>::none);
+        closedWidth = w;
+    }
+    else
+    {
+        for(unsigned i = 0; i < numClosed; i++)
+            closedHead[closed[i].y*w + closed[i].x] = CellLists<constraint>::none;
+    }
+    numClosed = 0;
     ResultPathInfo resultPath;
     openSize = 0;
     closeSize = 0;
+    lppath.clear();
 
     State curState(start);
     curState.F = weight * Util::distance(curState.x, curState.y, goal.x,goal.y);
+    if(getSafeIntervals(curState.x,curState.y).empty())
+        return false;
     curState.interval = getSafeIntervals(curState.x,curState.y)[0];
     bool pathFound = false;
     open[curState.x].push_back(curState);
     openSize++;
     while(!stopCriterion())
     {
-        curState = findMin(map.GetMapHeight());
+        curState = findMin(open.size());
         open[curState.x].pop_front();
         openSize--;
-        close.insert({curState.x * map.GetMapWidth() + curState.y, curState});
+        addClosed(curState, w);
         closeSize++;
         if(curState.x == goal.x && curState.y == goal.y && curState.interval.second == CN_INFINITY)
         {
@@ -772,8 +778,7 @@ bool AnyAngleSipp<Map,State>::findPath(std::vector<State>& solution, State const
             {
                 State add = hppath[i - 1];
                 add.Parent = hppath[i].Parent;
-                close.insert({add.x*map.GetMapWidth() + add.y, add});
-                hppath[i].Parent = &(close.find(add.x*map.GetMapWidth() + add.y)->second);
+                hppath[i].Parent = addClosed(add, w);
                 add.g = hppath[i].g - Util::distance(hppath[i].x, hppath[i].y, hppath[i - 1].x,hppath[i - 1].y);
                 hppath.emplace(hppath.begin() + i, add);
                 i++;
@@ -830,15 +835,14 @@ std::vector<std::pair<double,double>> AnyAngleSipp<Map,State>::findIntervals(Sta
     Intervals badIntervals(0), curStateIntervals(0);
     double ab = curState.g-curState.Parent->g;
 
-    auto range = close.equal_range(curState.x * w + curState.y);
     bool has;
     Intervals const& curSafeIntervals(getSafeIntervals(curState.x,curState.y));
     for(int i = 0; i < curSafeIntervals.size(); i++)
         if(curSafeIntervals[i].second > curState.g && curSafeIntervals[i].first <= curState.Parent->interval.second + ab)
         {
             has = false;
-            for(auto it = range.first; it != range.second; it++)
-                if(it->second.interval.first == curSafeIntervals[i].first)
+            for(uint32_t c = closedHead[curState.y * w + curState.x]; c != CellLists<constraint>::none; c = closedNext[c])
+                if(closed[c].interval.first == curSafeIntervals[i].first)
                 {
                     has = true;
                     break;
@@ -854,20 +858,18 @@ std::vector<std::pair<double,double>> AnyAngleSipp<Map,State>::findIntervals(Sta
         }
     if(curStateIntervals.empty())
         return curStateIntervals;
-    std::vector<std::pair<int,int>> cells = findConflictCells(curState);
+    findConflictCells(curState, *curState.Parent, cells);
 
     double da, db, offset, vi, vj, wi, wj, c1, c2, dist;
-    Interval add;
+    TimeInterval add;
     constraint con;
     for(int i = 0; i < cells.size(); i++)
     {
-        uint32_t key(hash(cells[i].first,cells[i].second));
-        for(int j = 0; j < ctable[key].size(); j++)
+        ctable.ForEach(cells[i].first, cells[i].second, [&](constraint const& c, uint32_t)
         {
-
-            con = ctable[key][j];
+            con = c;
             if(con.g + gap < curState.Parent->g && !con.goal)
-                continue;
+                return;
             da = (curState.x - con.x)*(curState.x - con.x) + (curState.y - con.y)*(curState.y - con.y);
             db = (curState.Parent->x - con.x)*(curState.Parent->x - con.x) + (curState.Parent->y - con.y)*(curState.Parent->y - con.y);
             vi = curState.Parent->x - curState.x;
@@ -891,7 +893,7 @@ std::vector<std::pair<double,double>> AnyAngleSipp<Map,State>::findIntervals(Sta
                     if(con.goal == true)
                         add.second = CN_INFINITY;
                     badIntervals.push_back(add);
-                    continue;
+                    return;
                 }
 
             }
@@ -908,7 +910,7 @@ std::vector<std::pair<double,double>> AnyAngleSipp<Map,State>::findIntervals(Sta
                     badIntervals.push_back(add);
                 }
             }
-        }
+        });
     }
 
     //combining and sorting bad intervals
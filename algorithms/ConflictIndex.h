@@ -0,0 +1,176 @@
+//
+//  ConflictIndex.h
+//  hog2
+//
+//  Spatio-temporal hash of agent paths used to find the pairs of agents that
+//  can possibly conflict, so that CBS only runs the exact (pairwise) check on
+//  those pairs instead of on all n^2 of them.
+//
+
+#ifndef _ConflictIndex_h__
+#define _ConflictIndex_h__
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+// Every path segment s[i]-->s[i+1] is put in the buckets of all cells of its
+// bounding box (grown by margin cells) and all time windows that [t_i,t_i+1)
+// touches (the last segment includes its end time). Two segments that collide
+// overlap in time and, for agent radii below 0.5 (or a large enough margin),
+// share a cell, so the agents share a bucket. Bucket collisions in the hash
+// only add candidates.
+//
+// The candidates of each agent are kept up to date as agents are inserted and
+// removed, so listing the candidate pairs doesn't visit the buckets. The index
+// is meant to be copied along with the paths into child CBS nodes; Sync() then
+// re-buckets only the agents whose paths changed.
+//
+// The state needs x, y and t members.
+template <typename state>
+class ConflictIndex{
+public:
+  ConflictIndex(double window=1.0, int cellMargin=0):timeWindow(window),margin(cellMargin){}
+
+  // margin needed for agents of the given radius
+  static int MarginForRadius(double radius){return std::max(0,int(std::ceil(2.0*radius))-1);}
+
+  void SetParameters(double window, int cellMargin){
+    if(window!=timeWindow || cellMargin!=margin){
+      Clear();
+      timeWindow=window;
+      margin=cellMargin;
+    }
+  }
+
+  void Clear(){
+    buckets.clear();
+    agentKeys.clear();
+    signatures.clear();
+    candidates.clear();
+  }
+
+  void Insert(unsigned agent, std::vector<state> const& path){
+    if(agentKeys.size()<=agent){
+      agentKeys.resize(agent+1);
+      signatures.resize(agent+1,0);
+      candidates.resize(agent+1);
+    }
+    Remove(agent);
+    std::vector<uint64_t>& keys(agentKeys[agent]);
+    for(unsigned i(0); i+1<path.size(); ++i)
+      AddKeys(path[i],path[i+1],i+2==path.size(),keys);
+    if(path.size()==1)
+      AddKeys(path[0],path[0],true,keys);
+    std::sort(keys.begin(),keys.end());
+    keys.erase(std::unique(keys.begin(),keys.end()),keys.end());
+    std::vector<unsigned>& mine(candidates[agent]);
+    for(auto k:keys){
+      std::vector<unsigned>& agents(buckets[k]);
+      mine.insert(mine.end(),agents.begin(),agents.end());
+      agents.push_back(agent);
+    }
+    std::sort(mine.begin(),mine.end());
+    mine.erase(std::unique(mine.begin(),mine.end()),mine.end());
+    for(auto a:mine)
+      candidates[a].insert(std::lower_bound(candidates[a].begin(),candidates[a].end(),agent),agent);
+    signatures[agent]=Signature(path);
+  }
+
+  void Remove(unsigned agent){
+    if(agent>=agentKeys.size()) return;
+    for(auto k:agentKeys[agent]){
+      auto b(buckets.find(k));
+      std::vector<unsigned>& agents(b->second);
+      *std::find(agents.begin(),agents.end(),agent)=agents.back();
+      agents.pop_back();
+      if(agents.empty())
+        buckets.erase(b);
+    }
+    agentKeys[agent].resize(0);
+    for(auto a:candidates[agent])
+      candidates[a].erase(std::lower_bound(candidates[a].begin(),candidates[a].end(),agent));
+    candidates[agent].resize(0);
+    signatures[agent]=0;
+  }
+
+  // Re-buckets the agents whose path changed since they were inserted
+  // (compared by hashing the path). Returns the number of agents updated.
+  template <typename pathContainer>
+  unsigned Sync(pathContainer const& paths){
+    unsigned updated(0);
+    for(unsigned a(0); a<paths.size(); ++a){
+      std::vector<state> const& path(Deref(paths[a]));
+      if(a>=signatures.size() || signatures[a]!=Signature(path)){
+        Insert(a,path);
+        ++updated;
+      }
+    }
+    for(unsigned a(paths.size()); a<agentKeys.size(); ++a)
+      Remove(a);
+    return updated;
+  }
+
+  // Agents (other than agent) that share a bucket with agent, sorted
+  void GetCandidates(unsigned agent, std::vector<unsigned>& out) const{
+    out.resize(0);
+    if(agent<candidates.size())
+      out=candidates[agent];
+  }
+
+  // All pairs (a<b) that share a bucket, in lexicographic order
+  void GetCandidatePairs(std::vector<std::pair<unsigned,unsigned>>& out) const{
+    out.resize(0);
+    for(unsigned a(0); a<candidates.size(); ++a){
+      auto b(std::upper_bound(candidates[a].begin(),candidates[a].end(),a));
+      for(; b!=candidates[a].end(); ++b)
+        out.emplace_back(a,*b);
+    }
+  }
+
+  size_t NumBuckets() const{return buckets.size();}
+
+private:
+  static std::vector<state> const& Deref(std::vector<state> const& p){return p;}
+  static std::vector<state> const& Deref(std::vector<state> const* p){return *p;}
+
+  static uint64_t Signature(std::vector<state> const& path){
+    // FNV-1a over the locations and times; 0 is reserved for "not inserted"
+    uint64_t h(14695981039346656037ull);
+    for(auto const& s:path){
+      float t(s.t);
+      uint32_t bits;
+      memcpy(&bits,&t,sizeof(bits));
+      h=(h^uint64_t(s.x))*1099511628211ull;
+      h=(h^uint64_t(s.y))*1099511628211ull;
+      h=(h^bits)*1099511628211ull;
+    }
+    return h|1;
+  }
+
+  void AddKeys(state const& s1, state const& s2, bool last, std::vector<uint64_t>& keys) const{
+    int64_t x0(std::min<int64_t>(s1.x,s2.x)-margin), x1(std::max<int64_t>(s1.x,s2.x)+margin);
+    int64_t y0(std::min<int64_t>(s1.y,s2.y)-margin), y1(std::max<int64_t>(s1.y,s2.y)+margin);
+    int64_t w0(std::floor(std::min<double>(s1.t,s2.t)/timeWindow));
+    int64_t w1(std::floor(std::max<double>(s1.t,s2.t)/timeWindow));
+    // the end time belongs to the next segment
+    if(!last && w1>w0 && w1*timeWindow==std::max<double>(s1.t,s2.t))
+      --w1;
+    for(int64_t w(w0); w<=w1; ++w)
+      for(int64_t x(x0); x<=x1; ++x)
+        for(int64_t y(y0); y<=y1; ++y)
+          keys.push_back((uint64_t(x)&0xFFFFF)|((uint64_t(y)&0xFFFFF)<<20)|((uint64_t(w)&0xFFFFFF)<<40));
+  }
+
+  std::unordered_map<uint64_t,std::vector<unsigned>> buckets;
+  std::vector<std::vector<uint64_t>> agentKeys;
+  std::vector<uint64_t> signatures;
+  std::vector<std::vector<unsigned>> candidates; // sorted
+  double timeWindow;
+  int margin;
+};
+
+#endif
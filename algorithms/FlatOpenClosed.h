@@ -0,0 +1,373 @@
+//
+//  FlatOpenClosed.h
+//  hog2
+//
+//  A drop-in replacement for AStarOpenClosed with a d-ary heap and a flat
+//  (open addressing) hash table.
+//
+
+#ifndef FlatOpenClosed_h
+#define FlatOpenClosed_h
+
+/**
+ * Same interface and element ids as AStarOpenClosed (ids are assigned in
+ * insertion order and stay valid until Reset), so it can be used as the
+ * open list of TemplateAStar, MM, NAMOAStar, etc.
+ *
+ * The open list is an arity-ary heap (default 4), which is shallower than a
+ * binary heap and keeps the children of a node in one cache line. Hash keys
+ * are mapped to ids either with a linear probing hash table of (key, id)
+ * pairs or, when Reset() is given a maximum hash that is small enough, with a
+ * direct-indexed array. If a key larger than the maximum hash arrives, the
+ * direct index is converted to a hash table.
+ */
+
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "OpenClosedInterface.h"
+
+template<typename state, typename CmpKey, class dataStructure = AStarOpenClosedData<state>, int arity = 4>
+class FlatOpenClosed : public OpenClosedInterface<state, dataStructure> {
+public:
+	FlatOpenClosed();
+	~FlatOpenClosed();
+	void Reset(uint64_t maxHash=0);
+	uint64_t AddOpenNode(dataStructure& val, uint64_t hash);
+	uint64_t AddClosedNode(dataStructure& val, uint64_t hash);
+	uint64_t AddOpenNode(const state &val, uint64_t hash, double g, double h, uint64_t parent=kTAStarNoNode);
+	uint64_t AddClosedNode(state &val, uint64_t hash, double g, double h, uint64_t parent=kTAStarNoNode);
+	void KeyChanged(uint64_t objKey);
+	dataLocation Lookup(uint64_t hashKey, uint64_t &objKey) const;
+	inline dataStructure &Lookup(uint64_t objKey) { return elements[objKey]; }
+	inline const dataStructure &Lookat(uint64_t objKey) const { return elements[objKey]; }
+	uint64_t Peek() const;
+	uint64_t Close();
+	void Reopen(uint64_t objKey);
+
+	uint64_t GetOpenItem(unsigned int which) { return theHeap[which]; }
+	size_t OpenSize() const { return theHeap.size(); }
+	size_t ClosedSize() const { return size()-OpenSize(); }
+	size_t size() const { return elements.size(); }
+
+	// Largest maximum hash for which a direct index is used (0 disables it)
+	void SetDirectIndexLimit(uint64_t limit) { directLimit = limit; }
+	bool UsingDirectIndex() const { return direct; }
+	bool HeapifyUp(uint64_t index);
+	void HeapifyDown(uint64_t index);
+private:
+	struct slot {
+		uint64_t key;
+		uint64_t id;
+	};
+	static const uint32_t kNoIndex = 0xFFFFFFFF;
+	inline uint64_t Bucket(uint64_t key) const
+	{ return (key*0x9E3779B97F4A7C15ull)>>shift; }
+	uint64_t Find(uint64_t hash) const;
+	void Insert(uint64_t hash, uint64_t id);
+	void InsertSlot(uint64_t hash, uint64_t id);
+	void GrowTable();
+	void ConvertToTable();
+
+	std::vector<uint64_t> theHeap;
+	std::vector<dataStructure> elements;
+	// hash key of each element, needed to clear the direct index
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> index;
+	uint64_t directSize;
+	std::vector<slot> table;
+	uint64_t mask;
+	int shift;
+	uint64_t directLimit;
+	bool direct;
+};
+
+template<typename state, typename CmpKey, class dataStructure, int arity>
+const uint32_t FlatOpenClosed<state, CmpKey, dataStructure, arity>::kNoIndex;
+
+template<typename state, typename CmpKey, class dataStructure, int arity>
+FlatOpenClosed<state, CmpKey, dataStructure, arity>::FlatOpenClosed()
+:directSize(0), directLimit(1ull<<24), direct(false)
+{
+	table.resize(1024, {0, kTAStarNoNode});
+	mask = table.size()-1;
+	shift = 64-10;
+}
+
+template<typename state, typename CmpKey, class dataStructure, int arity>
+FlatOpenClosed<state, CmpKey, dataStructure, arity>::~FlatOpenClosed()
+{
+}
+
+/**
+ * Remove all objects from queue. maxHash is the bound on the hash keys, as
+ * returned by GetMaxHash(); 0 if unknown.
+ */
+template<typename state, typename CmpKey, class dataStructure, int arity>
+void FlatOpenClosed<state, CmpKey, dataStructure, arity>::Reset(uint64_t maxHash)
+{
+	if (direct)
+	{
+		for (uint64_t k : keys)
+			index[k] = kNoIndex;
+	}
+	else {
+		for (auto &s : table)
+			s.id = kTAStarNoNode;
+	}
+	elements.resize(0);
+	keys.resize(0);
+	theHeap.resize(0);
+	direct = (maxHash > 0 && maxHash <= directLimit);
+	directSize = direct?maxHash:0;
+	if (index.size() < directSize)
+		index.resize(directSize, kNoIndex);
+}
+
+template<typename state, typename CmpKey, class dataStructure, int arity>
+uint64_t FlatOpenClosed<state, CmpKey, dataStructure, arity>::Find(uint64_t hash) const
+{
+	if (direct)
+	{
+		if (hash >= directSize || index[hash] == kNoIndex)
+			return kTAStarNoNode;
+		return index[hash];
+	}
+	for (uint64_t b = Bucket(hash); ; b = (b+1)&mask)
+	{
+		if (table[b].id == kTAStarNoNode)
+			return kTAStarNoNode;
+		if (table[b].key == hash)
+			return table[b].id;
+	}
+}
+
+template<typename state, typename CmpKey, class dataStructure, int arity>
+void FlatOpenClosed<state, CmpKey, dataStructure, arity>::Insert(uint64_t hash, uint64_t id)
+{
+	keys.push_back(hash);
+	if (direct && hash >= directSize)
+		ConvertToTable();
+	if (direct)
+	{
+		index[hash] = (uint32_t)id;
+		return;
+	}
+	// keep the load factor at most 1/2
+	if (2*(elements.size()+1) > table.size())
+		GrowTable();
+	InsertSlot(hash, id);
+}
+
+template<typename state, typename CmpKey, class dataStructure, int arity>
+void FlatOpenClosed<state, CmpKey, dataStructure, arity>::InsertSlot(uint64_t hash, uint64_t id)
+{
+	uint64_t b = Bucket(hash);
+	while (table[b].id != kTAStarNoNode)
+		b = (b+1)&mask;
+	table[b].key = hash;
+	table[b].id = id;
+}
+
+template<typename state, typename CmpKey, class dataStructure, int arity>
+void FlatOpenClosed<state, CmpKey, dataStructure, arity>::GrowTable()
+{
+	table.assign(table.size()*2, {0, kTAStarNoNode});
+	mask = table.size()-1;
+	shift--;
+	// ids are assigned in order, so keys[id] is the key of element id
+	for (uint64_t x = 0; x < elements.size(); x++)
+		InsertSlot(keys[x], x);
+}
+
+/**
+ * Called when a key is outside the range given to Reset(); moves all
+ * entries from the direct index into the hash table.
+ */
+template<typename state, typename CmpKey, class dataStructure, int arity>
+void FlatOpenClosed<state, CmpKey, dataStructure, arity>::ConvertToTable()
+{
+	for (uint64_t x = 0; x < elements.size(); x++)
+		index[keys[x]] = kNoIndex;
+	direct = false;
+	uint64_t size = table.size();
+	while (2*(elements.size()+1) > size)
+	{
+		size *= 2;
+		shift--;
+	}
+	table.assign(size, {0, kTAStarNoNode});
+	mask = size-1;
+	for (uint64_t x = 0; x < elements.size(); x++)
+		InsertSlot(keys[x], x);
+}
+
+/**
+ * Add object into open list.
+ */
+template<typename state, typename CmpKey, class dataStructure, int arity>
+uint64_t FlatOpenClosed<state, CmpKey, dataStructure, arity>::AddOpenNode(dataStructure& val, uint64_t hash)
+{
+	assert(Find(hash) == kTAStarNoNode);
+	uint64_t id = elements.size();
+	val.openLocation = theHeap.size();
+	val.where = kOpenList;
+	Insert(hash, id);
+	elements.push_back(val);
+	if (val.parentID == kTAStarNoNode)
+		elements.back().parentID = id;
+	theHeap.push_back(id);
+	HeapifyUp(theHeap.size()-1);
+	return id;
+}
+
+/**
+ * Add object into closed list.
+ */
+template<typename state, typename CmpKey, class dataStructure, int arity>
+uint64_t FlatOpenClosed<state, CmpKey, dataStructure, arity>::AddClosedNode(dataStructure& val, uint64_t hash)
+{
+	assert(Find(hash) == kTAStarNoNode);
+	uint64_t id = elements.size();
+	val.openLocation = 0;
+	val.where = kClosedList;
+	Insert(hash, id);
+	elements.push_back(val);
+	if (val.parentID == kTAStarNoNode)
+		elements.back().parentID = id;
+	return id;
+}
+
+template<typename state, typename CmpKey, class dataStructure, int arity>
+uint64_t FlatOpenClosed<state, CmpKey, dataStructure, arity>::AddOpenNode(const state &val, uint64_t hash, double g, double h, uint64_t parent)
+{
+	dataStructure data(val, g, h, parent, theHeap.size(), kOpenList);
+	return AddOpenNode(data, hash);
+}
+
+template<typename state, typename CmpKey, class dataStructure, int arity>
+uint64_t FlatOpenClosed<state, CmpKey, dataStructure, arity>::AddClosedNode(state &val, uint64_t hash, double g, double h, uint64_t parent)
+{
+	dataStructure data(val, g, h, parent, 0, kClosedList);
+	return AddClosedNode(data, hash);
+}
+
+/**
+ * Indicate that the key for a particular object has changed.
+ */
+template<typename state, typename CmpKey, class dataStructure, int arity>
+void FlatOpenClosed<state, CmpKey, dataStructure, arity>::KeyChanged(uint64_t val)
+{
+	if (!HeapifyUp(elements[val].openLocation))
+		HeapifyDown(elements[val].openLocation);
+}
+
+/**
+ * Returns location of object as well as object key.
+ */
+template<typename state, typename CmpKey, class dataStructure, int arity>
+dataLocation FlatOpenClosed<state, CmpKey, dataStructure, arity>::Lookup(uint64_t hashKey, uint64_t &objKey) const
+{
+	uint64_t id = Find(hashKey);
+	if (id == kTAStarNoNode)
+		return kNotFound;
+	objKey = id;
+	return elements[id].where;
+}
+
+/**
+ * Peek at the next item to be expanded.
+ */
+template<typename state, typename CmpKey, class dataStructure, int arity>
+uint64_t FlatOpenClosed<state, CmpKey, dataStructure, arity>::Peek() const
+{
+	assert(OpenSize() != 0);
+	return theHeap[0];
+}
+
+/**
+ * Move the best item to the closed list and return key.
+ */
+template<typename state, typename CmpKey, class dataStructure, int arity>
+uint64_t FlatOpenClosed<state, CmpKey, dataStructure, arity>::Close()
+{
+	assert(OpenSize() != 0);
+
+	uint64_t ans = theHeap[0];
+	elements[ans].where = kClosedList;
+	theHeap[0] = theHeap.back();
+	elements[theHeap[0]].openLocation = 0;
+	theHeap.pop_back();
+	HeapifyDown(0);
+	return ans;
+}
+
+/**
+ * Move item off the closed list and back onto the open list.
+ */
+template<typename state, typename CmpKey, class dataStructure, int arity>
+void FlatOpenClosed<state, CmpKey, dataStructure, arity>::Reopen(uint64_t objKey)
+{
+	assert(elements[objKey].where == kClosedList);
+	elements[objKey].reopened = true;
+	elements[objKey].where = kOpenList;
+	elements[objKey].openLocation = theHeap.size();
+	theHeap.push_back(objKey);
+	HeapifyUp(theHeap.size()-1);
+}
+
+/**
+ * Moves a node up the heap. Returns true if the node was moved, false otherwise.
+ */
+template<typename state, typename CmpKey, class dataStructure, int arity>
+bool FlatOpenClosed<state, CmpKey, dataStructure, arity>::HeapifyUp(uint64_t index)
+{
+	CmpKey compare;
+	uint64_t item = theHeap[index];
+	uint64_t start = index;
+	// move the hole up instead of swapping at each level
+	while (index > 0)
+	{
+		uint64_t parent = (index-1)/arity;
+		if (!compare(elements[theHeap[parent]], elements[item]))
+			break;
+		theHeap[index] = theHeap[parent];
+		elements[theHeap[index]].openLocation = index;
+		index = parent;
+	}
+	theHeap[index] = item;
+	elements[item].openLocation = index;
+	return index != start;
+}
+
+template<typename state, typename CmpKey, class dataStructure, int arity>
+void FlatOpenClosed<state, CmpKey, dataStructure, arity>::HeapifyDown(uint64_t index)
+{
+	CmpKey compare;
+	uint64_t count = theHeap.size();
+	if (count == 0)
+		return;
+	uint64_t item = theHeap[index];
+	while (true)
+	{
+		uint64_t first = index*arity+1;
+		if (first >= count)
+			break;
+		uint64_t last = std::min(first+arity, count);
+		// find best child
+		uint64_t which = first;
+		for (uint64_t child = first+1; child < last; child++)
+			if (compare(elements[theHeap[which]], elements[theHeap[child]]))
+				which = child;
+		if (!compare(elements[item], elements[theHeap[which]]))
+			break;
+		theHeap[index] = theHeap[which];
+		elements[theHeap[index]].openLocation = index;
+		index = which;
+	}
+	theHeap[index] = item;
+	elements[item].openLocation = index;
+}
+
+#endif /* FlatOpenClosed_h */
@@ -0,0 +1,313 @@
+//
+//  SafeIntervalStore.h
+//  hog2
+//
+//  Per-cell safe intervals (and other per-cell records) for SIPP-style
+//  planners, indexed by grid cell and kept across queries.
+//
+
+#ifndef _SafeIntervalStore_h__
+#define _SafeIntervalStore_h__
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <stdint.h>
+
+typedef std::pair<double,double> TimeInterval;
+typedef std::vector<TimeInterval> Intervals;
+
+// Lists of items attached to grid cells. Every item has an owner (e.g. the
+// obstacle trajectory that produced it) so that all of the items of one owner
+// can be removed without touching the rest of the grid.
+//
+// The items live in one arena; each cell keeps a (doubly) linked list of its
+// items and each owner a list of its items through the same nodes. Removed
+// nodes go on a free list, so once the arena has grown to the working size,
+// adding and removing trajectories doesn't allocate. The grid grows when an
+// item is added outside of it; Reserve() the map size up front to avoid that.
+template <typename item>
+class CellLists{
+public:
+  static const uint32_t none = 0xFFFFFFFF;
+
+  CellLists():width(0),height(0),freeList(none),count(0){}
+
+  void Reserve(unsigned w, unsigned h){
+    if(w>width || h>height)
+      Grow(std::max(w,width),std::max(h,height));
+  }
+  unsigned GetWidth()const{return width;}
+  unsigned GetHeight()const{return height;}
+  size_t size()const{return count;}
+
+  // Removes all items; keeps the memory
+  void Clear(){
+    nodes.resize(0);
+    std::fill(heads.begin(),heads.end(),none);
+    owners.clear();
+    freeList=none;
+    count=0;
+  }
+
+  void Add(unsigned x, unsigned y, uint32_t owner, item const& value){
+    Reserve(x+1,y+1);
+    uint32_t n(freeList);
+    if(n==none){
+      n=nodes.size();
+      nodes.resize(n+1);
+    }else{
+      freeList=nodes[n].next;
+    }
+    Node& node(nodes[n]);
+    node.value=value;
+    node.owner=owner;
+    node.cell=y*width+x;
+    // newest first in the cell and owner lists
+    node.prev=none;
+    node.next=heads[node.cell];
+    if(node.next!=none) nodes[node.next].prev=n;
+    heads[node.cell]=n;
+    auto o(owners.insert({owner,none}).first);
+    node.ownerPrev=none;
+    node.ownerNext=o->second;
+    if(node.ownerNext!=none) nodes[node.ownerNext].ownerPrev=n;
+    o->second=n;
+    ++count;
+  }
+
+  // The most recently added item of the cell if it belongs to owner, or null
+  item const* Newest(unsigned x, unsigned y, uint32_t owner)const{
+    if(x>=width || y>=height) return nullptr;
+    uint32_t n(heads[y*width+x]);
+    return (n!=none && nodes[n].owner==owner)?&nodes[n].value:nullptr;
+  }
+
+  // Calls f(value, owner) on the items of the cell, newest first
+  template <typename F>
+  void ForEach(unsigned x, unsigned y, F f)const{
+    if(x>=width || y>=height) return;
+    for(uint32_t n(heads[y*width+x]); n!=none; n=nodes[n].next)
+      f(nodes[n].value,nodes[n].owner);
+  }
+
+  // Calls f(x, y, value) on the items of owner, newest first
+  template <typename F>
+  void ForEachOfOwner(uint32_t owner, F f)const{
+    auto o(owners.find(owner));
+    if(o==owners.end()) return;
+    for(uint32_t n(o->second); n!=none; n=nodes[n].ownerNext)
+      f(nodes[n].cell%width,nodes[n].cell/width,nodes[n].value);
+  }
+
+  // Removes the items of owner; returns how many were removed
+  unsigned RemoveOwner(uint32_t owner){
+    auto o(owners.find(owner));
+    if(o==owners.end()) return 0;
+    unsigned removed(0);
+    for(uint32_t n(o->second); n!=none; ++removed){
+      uint32_t next(nodes[n].ownerNext);
+      UnlinkCell(n);
+      Free(n);
+      n=next;
+    }
+    owners.erase(o);
+    return removed;
+  }
+
+  // Removes the items of one cell (of all owners); returns how many were removed
+  unsigned RemoveCell(unsigned x, unsigned y){
+    if(x>=width || y>=height) return 0;
+    unsigned removed(0);
+    uint32_t& head(heads[y*width+x]);
+    while(head!=none){
+      uint32_t n(head);
+      head=nodes[n].next;
+      UnlinkOwner(n);
+      Free(n);
+      ++removed;
+    }
+    return removed;
+  }
+
+private:
+  struct Node{
+    item value;
+    uint32_t owner;
+    uint32_t cell;
+    uint32_t prev, next;           // cell list; next is the free list link
+    uint32_t ownerPrev, ownerNext; // owner list
+  };
+
+  void Grow(unsigned w, unsigned h){
+    std::vector<uint32_t> grown(w*h,none);
+    for(unsigned y(0); y<height; ++y)
+      for(unsigned x(0); x<width; ++x)
+        grown[y*w+x]=heads[y*width+x];
+    // free nodes get a meaningless cell, which is never read
+    if(width)
+      for(auto& n:nodes)
+        n.cell=(n.cell/width)*w+n.cell%width;
+    heads.swap(grown);
+    width=w;
+    height=h;
+  }
+
+  void UnlinkCell(uint32_t n){
+    Node& node(nodes[n]);
+    if(node.prev!=none) nodes[node.prev].next=node.next;
+    else heads[node.cell]=node.next;
+    if(node.next!=none) nodes[node.next].prev=node.prev;
+  }
+
+  void UnlinkOwner(uint32_t n){
+    Node& node(nodes[n]);
+    if(node.ownerNext!=none) nodes[node.ownerNext].ownerPrev=node.ownerPrev;
+    if(node.ownerPrev!=none){
+      nodes[node.ownerPrev].ownerNext=node.ownerNext;
+    }else{
+      auto o(owners.find(node.owner));
+      if(node.ownerNext==none) owners.erase(o);
+      else o->second=node.ownerNext;
+    }
+  }
+
+  void Free(uint32_t n){
+    nodes[n].next=freeList;
+    freeList=n;
+    --count;
+  }
+
+  unsigned width, height;
+  std::vector<Node> nodes;
+  std::vector<uint32_t> heads;                 // first node of each cell
+  std::unordered_map<uint32_t,uint32_t> owners; // first node of each owner
+  uint32_t freeList;
+  size_t count;
+};
+
+template <typename item>
+const uint32_t CellLists<item>::none;
+
+// The safe intervals of a cell are its base intervals ([0,horizon] unless
+// set with SetSafeIntervals()) minus the unsafe intervals that trajectories
+// put on it. Unsafe intervals are added and removed per trajectory (owner);
+// the safe intervals of a cell are recomputed the next time the cell is
+// looked up after a change.
+class SafeIntervalStore{
+public:
+  SafeIntervalStore(double horizon):width(0),defaultIntervals(1,TimeInterval(0,horizon)){}
+
+  void Reserve(unsigned w, unsigned h){
+    unsafe.Reserve(w,h);
+    base.Reserve(w,h);
+    Resize();
+  }
+
+  // Removes all trajectories and base intervals
+  void Clear(){
+    unsafe.Clear();
+    base.Clear();
+    std::fill(state.begin(),state.end(),kDefault);
+  }
+
+  void AddUnsafeInterval(unsigned x, unsigned y, uint32_t owner, TimeInterval const& i){
+    unsafe.Add(x,y,owner,i);
+    Resize();
+    state[y*unsafe.GetWidth()+x]=kStale;
+  }
+
+  // Removes the unsafe intervals of one trajectory
+  void RemoveOwner(uint32_t owner){
+    unsafe.ForEachOfOwner(owner,[&](unsigned x, unsigned y, TimeInterval const&){
+      state[y*unsafe.GetWidth()+x]=kStale;
+    });
+    unsafe.RemoveOwner(owner);
+  }
+
+  // Replaces the base intervals of the cell
+  void SetSafeIntervals(unsigned x, unsigned y, Intervals const& intvls){
+    base.RemoveCell(x,y);
+    // the list is newest first
+    for(auto i(intvls.rbegin()); i!=intvls.rend(); ++i)
+      base.Add(x,y,0,*i);
+    // never safe
+    if(intvls.empty())
+      base.Add(x,y,0,TimeInterval(0,0));
+    Resize();
+    state[y*unsafe.GetWidth()+x]=kStale;
+  }
+
+  Intervals const& GetSafeIntervals(unsigned x, unsigned y)const{
+    if(x>=unsafe.GetWidth() || y>=unsafe.GetHeight())
+      return defaultIntervals;
+    unsigned cell(y*unsafe.GetWidth()+x);
+    if(state[cell]==kStale)
+      Update(x,y);
+    return state[cell]==kDefault?defaultIntervals:safe[cell];
+  }
+
+  CellLists<TimeInterval> const& GetUnsafeIntervals()const{return unsafe;}
+
+private:
+  enum {kDefault, kCached, kStale};
+
+  // Both lists grow together, keep the cache the same size
+  void Resize(){
+    base.Reserve(unsafe.GetWidth(),unsafe.GetHeight());
+    unsafe.Reserve(base.GetWidth(),base.GetHeight());
+    unsigned w(unsafe.GetWidth()), h(unsafe.GetHeight());
+    if(state.size()==w*h) return;
+    std::vector<uint8_t> grownState(w*h,kDefault);
+    std::vector<Intervals> grownSafe(w*h);
+    for(unsigned i(0); i<state.size(); ++i){
+      unsigned cell((i/width)*w+i%width);
+      grownState[cell]=state[i];
+      grownSafe[cell].swap(safe[i]);
+    }
+    state.swap(grownState);
+    safe.swap(grownSafe);
+    width=w;
+  }
+
+  void Update(unsigned x, unsigned y)const{
+    unsigned cell(y*width+x);
+    blocked.resize(0);
+    unsafe.ForEach(x,y,[&](TimeInterval const& i, uint32_t){blocked.push_back(i);});
+    bool hasBase(false);
+    base.ForEach(x,y,[&](TimeInterval const&, uint32_t){hasBase=true;});
+    if(blocked.empty() && !hasBase){
+      state[cell]=kDefault;
+      return;
+    }
+    std::sort(blocked.begin(),blocked.end());
+    Intervals& out(safe[cell]);
+    out.resize(0);
+    auto subtract=[&](TimeInterval const& b, uint32_t){
+      double t(b.first);
+      for(auto const& u:blocked){
+        if(u.second<=t) continue;
+        if(u.first>=b.second) break;
+        if(u.first>t) out.emplace_back(t,u.first);
+        t=u.second;
+        if(t>=b.second) break;
+      }
+      if(t<b.second) out.emplace_back(t,b.second);
+    };
+    if(hasBase)
+      base.ForEach(x,y,subtract);
+    else
+      subtract(defaultIntervals[0],0);
+    state[cell]=kCached;
+  }
+
+  CellLists<TimeInterval> unsafe;
+  CellLists<TimeInterval> base;
+  mutable std::vector<uint8_t> state;
+  mutable std::vector<Intervals> safe;
+  mutable Intervals blocked;
+  unsigned width;
+  Intervals defaultIntervals;
+};
+
+#endif
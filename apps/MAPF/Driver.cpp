@@ -43,6 +43,7 @@ bool mouseTracking;
 unsigned killtime(3600); // Kill after some number of seconds
 unsigned killmem(2048); // 1GB
 unsigned killex(INT_MAX); // Kill after some number of expansions
+unsigned numThreads(1); // Threads for replanning CT children
 bool disappearAtGoal(false);
 int px1, py1, px2, py2;
 int absType = 0;
@@ -168,6 +169,7 @@ void InstallHandlers()
 	InstallCommandLineHandler(MyCLHandler, "-killtime", "-killtime", "Kill after this many seconds");
         InstallCommandLineHandler(MyCLHandler, "-killmem", "-killmem [value megabytes]", "Kill if a process exceeds this size in memory");
 	InstallCommandLineHandler(MyCLHandler, "-killex", "-killex", "Kill after this many expansions");
+	InstallCommandLineHandler(MyCLHandler, "-threads", "-threads <n>", "Replan the children of a CT node on n threads");
 	InstallCommandLineHandler(MyCLHandler, "-mapfile", "-mapfile", "Map file to use");
 	InstallCommandLineHandler(MyCLHandler, "-scenfile", "-scenfile", "Scenario file to use");
 	InstallCommandLineHandler(MyCLHandler, "-mergeThreshold", "-mergeThreshold", "Number of conflicts to tolerate between meta-agents before merging");
@@ -217,6 +219,7 @@ void InitHeadless(){
   group->keeprunning=gui;
   group->animate=animate;
   group->killex=killex;
+  group->numThreads=numThreads;
   //group->mergeThreshold=mergeThreshold;
   group->ECBSheuristic=ECBSheuristic;
   group->nobypass=nobypass;
@@ -601,6 +604,11 @@ int MyCLHandler(char *argument[], int maxNumArgs)
                 killex = atoi(argument[1]);
 		return 2;
 	}
+	if(strcmp(argument[0], "-threads") == 0)
+	{
+		numThreads = std::max(1, atoi(argument[1]));
+		return 2;
+	}
         if(strcmp(argument[0], "-killmem") == 0)
         {
           killmem = atoi(argument[1]);
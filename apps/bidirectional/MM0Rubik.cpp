@@ -10,6 +10,7 @@
 #include "IDAStar.h"
 #include "ParallelIDAStar.h"
 #include "Timer.h"
+#include "ExternalSort.h"
 #include <string>
 #include <unordered_set>
 #include <iomanip>
@@ -42,6 +43,11 @@ std::vector<uint64_t> gDistBackward;
 std::mutex printLock;
 std::mutex countLock;
 std::mutex openLock;
+// sorts the buckets
+WorkerPool *sortPool = 0;
+// A bucket with more states is sorted in parts of this size, merged on disk and
+// expanded a part at a time (1GB; sorting needs as much again for scratch)
+uint64_t maxBucketStates = 1ull<<27;
 
 void GetBucketAndData(const RubiksState &s, int &bucket, uint64_t &data);
 void GetState(RubiksState &s, int bucket, uint64_t data);
@@ -95,11 +101,6 @@ struct closedData {
 	uint8_t bucket;
 };
 
-struct closedList {
-	closedList() :f(0) {}
-	FILE *f;
-};
-
 static bool operator==(const closedData &a, const closedData &b)
 {
 	return (a.dir == b.dir && a.depth == b.depth && a.bucket == b.bucket);
@@ -114,7 +115,7 @@ struct closedDataHash
 };
 
 //std::vector<std::unordered_set<uint64_t>> closed(fileBuckets);
-std::unordered_map<closedData, closedList, closedDataHash> closed;
+std::unordered_map<closedData, SortedRunFile, closedDataHash> closed;
 std::unordered_map<openData, openList, openDataHash> open;
 
 std::string GetClosedName(closedData d)
@@ -298,74 +299,82 @@ bool CanTerminateSearch()
 }
 
 void CheckSolution(std::unordered_map<openData, openList, openDataHash> currentOpen, openData d,
-				   const std::unordered_set<uint64_t> &states)
+				   const std::vector<uint64_t> &states)
 {
+	SortedIndex index(states);
 	for (const auto &s : currentOpen)
 	{
 		// Opposite direction, same bucket AND could be a solution (g+g >= C)
 		if (s.first.dir != d.dir && s.first.bucket == d.bucket &&
 			d.gcost + s.first.gcost >= currentC)// && d.hcost2 == s.first.hcost)
 		{
-			const size_t bufferSize = 128;
-			uint64_t buffer[bufferSize];
 			if (s.second.f == 0)
 			{
 				std::cout << "Error opening " << s.first << "\n";
 				exit(0);
 			}
 			rewind(s.second.f);
+			PrefetchReader reader(s.second.f);
+			uint64_t *buffer;
 			size_t numRead;
-			do {
-				numRead = fread(buffer, sizeof(uint64_t), bufferSize, s.second.f);
-				for (int x = 0; x < numRead; x++)
+			while ((buffer = reader.Next(numRead)) != 0)
+			{
+				if (index.Count(buffer, numRead) != 0)
 				{
-					if (states.find(buffer[x]) != states.end())
-					{
-						printLock.lock();
-						//s.second.states.find(data) != s.second.states.end()
-						printf("\nFound solution cost %d+%d=%d\n", d.gcost, s.first.gcost, d.gcost + s.first.gcost);
-						bestSolution = std::min(d.gcost + s.first.gcost, bestSolution);
-						printf("Current best solution: %d\n", bestSolution);
-						printLock.unlock();
-						
-						if (CanTerminateSearch())
-							return;
-					}
+					printLock.lock();
+					printf("\nFound solution cost %d+%d=%d\n", d.gcost, s.first.gcost, d.gcost + s.first.gcost);
+					bestSolution = std::min(d.gcost + s.first.gcost, bestSolution);
+					printf("Current best solution: %d\n", bestSolution);
+					printLock.unlock();
+					
+					if (CanTerminateSearch())
+						return;
 				}
-			} while (numRead == bufferSize);
+			}
 		}
 	}
 }
 
-void ReadBucket(std::unordered_set<uint64_t> &states, openData d)
+// Reads a bucket into states, sorted and unique, if it has at most maxBucketStates
+// states. A larger bucket is sorted in parts that are added to runs instead (and
+// the runs file must be removed when done). Returns whether the bucket is in states.
+bool ReadBucket(std::vector<uint64_t> &states, SortedRunFile &runs, openData d)
 {
-	const size_t bufferSize = 128;
-	uint64_t buffer[bufferSize];
+	fseeko(open[d].f, 0, SEEK_END);
+	bool fits = ftello(open[d].f)/sizeof(uint64_t) <= maxBucketStates;
 	rewind(open[d].f);
-	size_t numRead;
-	do {
-		numRead = fread(buffer, sizeof(uint64_t), bufferSize, open[d].f);
-		for (int x = 0; x < numRead; x++)
-			states.insert(buffer[x]);
-	} while (numRead == bufferSize);
+	states.clear();
+	if (fits)
+	{
+		ReadValues(open[d].f, states);
+		SortAndUnique(states, sortPool);
+	}
+	else {
+		if (!runs.Open(GetOpenName(d)+".runs"))
+		{
+			printf("Error opening %s.runs; Aborting!\n", GetOpenName(d).c_str());
+			perror("Reason: ");
+			exit(0);
+		}
+		runs.AddRuns(open[d].f, states, maxBucketStates, sortPool);
+	}
 	fclose(open[d].f);
 	remove(GetOpenName(d).c_str());
 	open[d].f = 0;
+	return fits;
 }
 
-void WriteBucket(std::unordered_set<uint64_t> &states, openData d)
+void WriteBucket(std::vector<uint64_t> &states, openData d)
 {
 	assert(open[d].f == 0);
 	open[d].f = fopen(GetOpenName(d).c_str(), "w+b");
-	FILE *f = open[d].f;
-	for (const uint64_t &s : states)
-	{
-		fwrite(&s, sizeof(s), 1, f);
-	}
+	fwrite(states.data(), sizeof(uint64_t), states.size(), open[d].f);
 }
 
-void RemoveDuplicates(std::unordered_set<uint64_t> &states, openData d)
+// the closed lists that can have duplicates of the states in a bucket
+std::vector<SortedRunFile *> GetPreviousClosed(const openData &d)
 {
+	std::vector<SortedRunFile *> result;
 	for (int depth = d.gcost-2; depth < d.gcost; depth++)
 	{
 		closedData c;
@@ -373,61 +382,63 @@ void RemoveDuplicates(std::unordered_set<uint64_t> &states, openData d)
 		c.depth = depth;
 		c.dir = d.dir;
 		
-		closedList &cd = closed[c];
-		if (cd.f == 0)
-			continue;
-		rewind(cd.f);
-		
-		const size_t bufferSize = 1024;
-		uint64_t buffer[bufferSize];
-		rewind(cd.f);
-		size_t numRead;
-		do {
-			numRead = fread(buffer, sizeof(uint64_t), bufferSize, cd.f);
-			for (int x = 0; x < numRead; x++)
-			{
-				auto i = states.find(buffer[x]);
-				if (i != states.end())
-					states.erase(i);
-			}
-		} while (numRead == bufferSize);
+		auto cd = closed.find(c);
+		if (cd != closed.end() && cd->second.IsOpen())
+			result.push_back(&cd->second);
 	}
+	return result;
+}
+
+void RemoveDuplicates(std::vector<uint64_t> &states, openData d)
+{
+	for (SortedRunFile *cd : GetPreviousClosed(d))
+		cd->Subtract(states);
 }
 
-void WriteToClosed(std::unordered_set<uint64_t> &states, openData d)
+// Merges the runs of a bucket that didn't fit in memory and writes it back to
+// its open file, removing the duplicates between the runs and with the
+// previous closed lists
+void WriteBucket(SortedRunFile &runs, openData d)
+{
+	assert(open[d].f == 0);
+	open[d].f = fopen(GetOpenName(d).c_str(), "w+b");
+	runs.Merge(GetPreviousClosed(d), open[d].f);
+}
+
+SortedRunFile &GetClosed(const openData &d)
 {
 	closedData c;
 	c.bucket = d.bucket;
 	c.depth = d.gcost;
 	c.dir = d.dir;
 	
-	closedList &cd = closed[c];
-	if (cd.f == 0)
+	SortedRunFile &cd = closed[c];
+	if (!cd.IsOpen() && !cd.Open(GetClosedName(c)))
 	{
-		cd.f = fopen(GetClosedName(c).c_str(), "w+b");
-	}
-	for (const auto &i : states)
-	{
-		fwrite(&i, sizeof(uint64_t), 1, cd.f);
+		printf("Error opening %s; Aborting!\n", GetClosedName(c).c_str());
+		perror("Reason: ");
+		exit(0);
 	}
+	return cd;
+}
+
+void WriteToClosed(std::vector<uint64_t> &states, openData d)
+{
+	GetClosed(d).AddRun(states);
 }
 
-void ParallelExpandBucket(openData d, const std::unordered_set<uint64_t> &states, int myThread, int totalThreads)
+void ParallelExpandBucket(openData d, const std::vector<uint64_t> &states, int myThread, int totalThreads)
 {
 	const int cacheSize = 1024;
 	std::unordered_map<openData, std::vector<uint64_t>, openDataHash> cache;
 	RubiksState tmp;
 	uint64_t localExpanded = 0;
-	int count = 0;
-	for (const auto &values : states)
+	for (size_t next = myThread; next < states.size(); next += totalThreads)
 	{
 		if (finished)
 			break;
 		
-		count++;
-		if (myThread != (count%totalThreads))
-			continue;
-		
+		uint64_t values = states[next];
 		localExpanded++;
 		for (int x = 0; x < 18; x++) // TODO: use getactions
 		{
@@ -473,14 +484,27 @@ void ExpandNextFile()
 	Timer timer;
 	timer.StartTimer();
 	
-	std::unordered_set<uint64_t> states;
-	ReadBucket(states, d);
-	//RemoveDuplicates(states, d); // delayed duplicate detection
-	WriteToClosed(states, d); // this could run in parallel!
+	std::vector<uint64_t> states;
+	SortedRunFile runs;
+	// a bucket that didn't fit in memory is merged into a run of the closed list
+	SortedRunFile *closedRun = 0;
+	uint64_t bucketSize;
+	if (ReadBucket(states, runs, d))
+	{
+		//RemoveDuplicates(states, d); // delayed duplicate detection
+		WriteToClosed(states, d); // this could run in parallel!
+		bucketSize = states.size();
+	}
+	else {
+		closedRun = &GetClosed(d);
+		bucketSize = runs.Merge(std::vector<SortedRunFile *>(), *closedRun);
+		runs.Close();
+		remove((GetOpenName(d)+".runs").c_str());
+	}
 	timer.EndTimer();
 	
 	printLock.lock();
-	std::cout << "Next: " << d << " (" << states.size() << " entries) [" << timer.GetElapsedTime() << "s reading/dd] ";
+	std::cout << "Next: " << d << " (" << bucketSize << " entries) [" << timer.GetElapsedTime() << "s reading/dd] ";
 	printLock.unlock();
 	
 	timer.StartTimer();
@@ -489,15 +513,21 @@ void ExpandNextFile()
 	//std::thread t(CheckSolution, open, d, std::ref(states));
 	//openLock.unlock();
 	
-	// 3. expand all states in current bucket & write out successors
-	const int numThreads = std::thread::hardware_concurrency();
-	std::vector<std::thread *> threads;
-	for (int x = 0; x < numThreads; x++)
-		threads.push_back(new std::thread(ParallelExpandBucket, d, std::ref(states), x, numThreads));
-	for (int x = 0; x < threads.size(); x++)
+	// 3. expand all states in current bucket & write out successors, a part at a
+	// time if the bucket didn't fit in memory
+	for (uint64_t part = 0; part < bucketSize; part += states.size())
 	{
-		threads[x]->join();
-		delete threads[x];
+		if (closedRun && closedRun->ReadRun(closedRun->NumRuns()-1, part, states, maxBucketStates) == 0)
+			break;
+		const int numThreads = std::thread::hardware_concurrency();
+		std::vector<std::thread *> threads;
+		for (int x = 0; x < numThreads; x++)
+			threads.push_back(new std::thread(ParallelExpandBucket, d, std::ref(states), x, numThreads));
+		for (int x = 0; x < threads.size(); x++)
+		{
+			threads[x]->join();
+			delete threads[x];
+		}
 	}
 	open.erase(open.find(d));
 	timer.EndTimer();
@@ -557,6 +587,7 @@ void MM0(RubiksState &start, RubiksState &goal, const char *p1, const char *p2)
 	Timer t;
 	t.StartTimer();
 	printf("---MM*---\n");
+	sortPool = new WorkerPool(std::thread::hardware_concurrency());
 	AddStateToQueue(start, kForward, 0);
 	AddStateToQueue(goal, kBackward, 0);
 	openData last = GetBestFile();
@@ -572,11 +603,26 @@ void MM0(RubiksState &start, RubiksState &goal, const char *p1, const char *p2)
 					Timer s;
 					s.StartTimer();
 					printf("DDD/DSD on %s bucket %d g:%d", last.dir==kForward?"forward":"backward", item.first.bucket, item.first.gcost);
-					std::unordered_set<uint64_t> states;
-					ReadBucket(states, item.first);
-					RemoveDuplicates(states, item.first); // DDD
-					WriteBucket(states, item.first);
-					CheckSolution(open, item.first, std::ref(states)); // DSD
+					std::vector<uint64_t> states;
+					SortedRunFile runs;
+					if (ReadBucket(states, runs, item.first))
+					{
+						RemoveDuplicates(states, item.first); // DDD
+						WriteBucket(states, item.first);
+						CheckSolution(open, item.first, std::ref(states)); // DSD
+					}
+					else {
+						WriteBucket(runs, item.first); // DDD
+						runs.Close();
+						remove((GetOpenName(item.first)+".runs").c_str());
+						// DSD a part at a time; the bucket is now sorted
+						rewind(open[item.first].f);
+						while (ReadValues(open[item.first].f, states, maxBucketStates) != 0)
+						{
+							CheckSolution(open, item.first, std::ref(states));
+							states.clear();
+						}
+					}
 					s.EndTimer();
 					printf("[%1.2f]\n", s.GetElapsedTime());
 				}
@@ -585,6 +631,8 @@ void MM0(RubiksState &start, RubiksState &goal, const char *p1, const char *p2)
 		ExpandNextFile();
 		last = curr;
 	}
+	delete sortPool;
+	sortPool = 0;
 	t.EndTimer();
 	printf("%1.2fs elapsed\n", t.GetElapsedTime());
 }
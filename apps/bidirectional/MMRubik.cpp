@@ -14,7 +14,7 @@
 #include <unordered_set>
 #include <iomanip>
 #include "SharedQueue.h"
-#include "FixedSizeSet.h"
+#include "ExternalSort.h"
 
 NAMESPACE_OPEN(MM)
 
@@ -47,13 +47,20 @@ RubiksState startState, goalState;
 //unsigned __int128 i;
 //typedef RubiksState diskState;
 typedef uint64_t diskState;
-#define MY_SET
-
-#ifdef MY_SET
-typedef FixedSizeSet<diskState> bucketSet;
-#else
-typedef std::unordered_set<diskState> bucketSet;
-#endif
+// sorted and without duplicates once it is read
+typedef std::vector<diskState> bucketSet;
+// sorts the buckets
+WorkerPool *sortPool = 0;
+// A bucket with more states is sorted in parts of this size, merged on disk and
+// expanded a part at a time (1GB; sorting needs as much again for scratch).
+// The bucket being expanded and the one being read ahead can both be in memory.
+uint64_t maxBucketStates = 1ull<<27;
+// a bucket that didn't fit in memory: a run of its closed list
+struct bucketRun {
+	bucketRun() :file(0), run(0) {}
+	SortedRunFile *file;
+	size_t run;
+};
 
 void GetBucketAndData(const RubiksState &s, int &bucket, diskState &data);
 void GetState(RubiksState &s, int bucket, diskState data);
@@ -132,11 +139,6 @@ struct closedData {
 	uint8_t bucket;
 };
 
-struct closedList {
-	closedList() :f(0) {}
-	FILE *f;
-};
-
 static bool operator==(const closedData &a, const closedData &b)
 {
 	return (a.dir == b.dir && a.depth == b.depth && a.bucket == b.bucket);
@@ -151,7 +153,7 @@ struct closedDataHash
 };
 
 //std::vector<std::unordered_set<uint64_t>> closed(fileBuckets);
-std::unordered_map<closedData, closedList, closedDataHash> closed;
+std::unordered_map<closedData, SortedRunFile, closedDataHash> closed;
 std::unordered_map<openData, openList, openDataHash> open;
 
 std::string GetClosedName(closedData d)
@@ -353,40 +355,38 @@ bool CanTerminateSearch()
 	return false;
 }
 
-void FindSolutionThread(const openData &d, const openList &l, const bucketSet &states)
+void FindSolutionThread(const openData &d, const openList &l, const SortedIndex &states)
 {
-	const size_t bufferSize = 128;
-	diskState buffer[bufferSize];
 	if (l.f == 0)
 	{
 		std::cout << "Error opening " << d << "\n";
 		exit(0);
 	}
 	rewind(l.f);
+	PrefetchReader reader(l.f);
+	diskState *buffer;
 	size_t numRead;
-	do {
-		numRead = fread(buffer, sizeof(diskState), bufferSize, l.f);
-		for (int x = 0; x < numRead; x++)
+	while ((buffer = reader.Next(numRead)) != 0)
+	{
+		if (states.Count(buffer, numRead) != 0)
 		{
-			if (states.find(buffer[x]) != states.end())
-			{
-				printLock.lock();
-				printf("\nFound solution cost %d+%d=%d\n", d.gcost, d.gcost, d.gcost + d.gcost);
-				bestSolution = std::min(d.gcost + d.gcost, bestSolution);
-				printf("Current best solution: %d\n", bestSolution);
-				printLock.unlock();
-				
-				if (CanTerminateSearch())
-					return;
-			}
+			printLock.lock();
+			printf("\nFound solution cost %d+%d=%d\n", d.gcost, d.gcost, d.gcost + d.gcost);
+			bestSolution = std::min(d.gcost + d.gcost, bestSolution);
+			printf("Current best solution: %d\n", bestSolution);
+			printLock.unlock();
+			
+			if (CanTerminateSearch())
+				return;
 		}
-	} while (numRead == bufferSize);
+	}
 }
 
 void CheckSolution(std::unordered_map<openData, openList, openDataHash> currentOpen, openData d,
 				   const bucketSet &states)
 {
 	std::vector<std::thread *> threads;
+	SortedIndex index(states);
 	for (const auto &s : currentOpen)
 	{
 		// Opposite direction, same bucket AND could be a solution (g+g >= C)
@@ -396,7 +396,7 @@ void CheckSolution(std::unordered_map<openData, openList, openDataHash> currentO
 		{
 //			std::thread *t = new std::thread(FindSolutionThread, s.first, s.second, states);
 //			threads.push_back(t);
-			FindSolutionThread(s.first, s.second, states);
+			FindSolutionThread(s.first, s.second, index);
 		}
 	}
 //	while (threads.size() > 0)
@@ -407,27 +407,39 @@ void CheckSolution(std::unordered_map<openData, openList, openDataHash> currentO
 //	}
 }
 
-void ReadBucket(bucketSet &states, openData d)
+// Reads a bucket into states, sorted and unique, if it has at most maxBucketStates
+// states. A larger bucket is sorted in parts that are added to runs instead.
+// Returns whether the bucket is in states.
+bool ReadBucket(bucketSet &states, SortedRunFile &runs, openData d)
 {
-	const size_t bufferSize = 128;
-	diskState buffer[bufferSize];
 	rewind(open[d].f);
-#ifdef MY_SET
-	states.resize(open[d].writtenStates);
-#endif
-	size_t numRead;
-	do {
-		numRead = fread(buffer, sizeof(diskState), bufferSize, open[d].f);
-		for (int x = 0; x < numRead; x++)
-			states.insert(buffer[x]);
-	} while (numRead == bufferSize);
+	states.clear();
+	bool fits = open[d].writtenStates <= maxBucketStates;
+	if (fits)
+	{
+		states.reserve(open[d].writtenStates);
+		ReadValues(open[d].f, states);
+		SortAndUnique(states, sortPool);
+	}
+	else {
+		if (!runs.Open(GetOpenName(d)+".runs"))
+		{
+			printf("Error opening %s.runs; Aborting!\n", GetOpenName(d).c_str());
+			perror("Reason: ");
+			exit(0);
+		}
+		runs.AddRuns(open[d].f, states, maxBucketStates, sortPool);
+	}
 	fclose(open[d].f);
 	remove(GetOpenName(d).c_str());
 	open[d].f = 0;
+	return fits;
 }
 
-void RemoveDuplicates(bucketSet &states, openData d)
+// the closed lists that can have duplicates of the states in a bucket
+std::vector<SortedRunFile *> GetPreviousClosed(const openData &d)
 {
+	std::vector<SortedRunFile *> result;
 	for (int depth = d.gcost-2; depth < d.gcost; depth++)
 	{
 		closedData c;
@@ -435,65 +447,64 @@ void RemoveDuplicates(bucketSet &states, openData d)
 		c.depth = depth;
 		c.dir = d.dir;
 		
-		closedList &cd = closed[c];
-		if (cd.f == 0)
-			continue;
-		rewind(cd.f);
-		
-		const size_t bufferSize = 1024;
-		diskState buffer[bufferSize];
-		rewind(cd.f);
-		size_t numRead;
-		do {
-			numRead = fread(buffer, sizeof(diskState), bufferSize, cd.f);
-			for (int x = 0; x < numRead; x++)
-			{
-				auto i = states.find(buffer[x]);
-				if (i != states.end())
-					states.erase(i);
-			}
-		} while (numRead == bufferSize);
+		auto cd = closed.find(c);
+		if (cd != closed.end() && cd->second.IsOpen())
+			result.push_back(&cd->second);
 	}
+	return result;
 }
 
-void WriteToClosed(bucketSet &states, openData d)
+void RemoveDuplicates(bucketSet &states, openData d)
+{
+	for (SortedRunFile *cd : GetPreviousClosed(d))
+		cd->Subtract(states);
+}
+
+SortedRunFile &GetClosed(const openData &d)
 {
 	closedData c;
 	c.bucket = d.bucket;
 	c.depth = d.gcost;
 	c.dir = d.dir;
 
-	closedList &cd = closed[c];
-	if (cd.f == 0)
+	SortedRunFile &cd = closed[c];
+	if (!cd.IsOpen() && !cd.Open(GetClosedName(c)))
 	{
-		cd.f = fopen(GetClosedName(c).c_str(), "w+b");
+		printf("Error opening %s; Aborting!\n", GetClosedName(c).c_str());
+		perror("Reason: ");
+		exit(0);
 	}
-	for (const auto &i : states)
+	return cd;
+}
+
+void WriteToClosed(bucketSet &states, openData d)
+{
+	GetClosed(d).AddRun(states);
+}
+
+// Merges the runs of a bucket that didn't fit in memory into one run of the
+// closed list, removing the duplicates between the runs and with the previous
+// closed lists
+void WriteToClosed(SortedRunFile &runs, openData d, bucketRun &result)
+{
+	SortedRunFile &cd = GetClosed(d);
+	result = bucketRun();
+	if (runs.Merge(GetPreviousClosed(d), cd) != 0)
 	{
-		fwrite(&i, sizeof(diskState), 1, cd.f);
+		result.file = &cd;
+		result.run = cd.NumRuns()-1;
 	}
 }
 
-void ParallelExpandBucket(openData d, bucketSet &states, int myThread, int totalThreads)
+void ParallelExpandBucket(openData d, const bucketSet &states, int myThread, int totalThreads)
 {
 	const int cacheSize = 1024;
 	std::unordered_map<openData, std::vector<diskState>, openDataHash> cache;
 	RubiksState tmp;
 	uint64_t localExpanded = 0;
-	int count = 0;
-	for (const auto &values : states)
+	for (size_t next = myThread; next < states.size(); next += totalThreads)
 	{
-		count++;
-		if (myThread != count%totalThreads)
-			continue;
-		diskState v;
-#ifdef MY_SET
-		if (!values.valid)
-			continue;
-		v = values.item;
-#else
-		v = values;
-#endif
+		diskState v = states[next];
 		localExpanded++;
 		for (int x = 0; x < 18; x++) // TODO: use getactions
 		{
@@ -527,11 +538,77 @@ void ParallelExpandBucket(openData d, bucketSet &states, int myThread, int total
 	countLock.unlock();
 }
 
-void ReadAndDDBucket(bucketSet &states, const openData &d)
+// the bucket is in states, or in run if it is too large for memory
+void ReadAndDDBucket(bucketSet &states, bucketRun &run, const openData &d)
+{
+	SortedRunFile runs;
+	run = bucketRun();
+	if (ReadBucket(states, runs, d))
+	{
+		RemoveDuplicates(states, d); // delayed duplicate detection
+		WriteToClosed(states, d); // this could run in parallel!
+		return;
+	}
+	WriteToClosed(runs, d, run); // delayed duplicate detection on disk
+	runs.Close();
+	remove((GetOpenName(d)+".runs").c_str());
+}
+
+// Expands states (all or part of bucket d) and checks them for solutions at the same time
+void ExpandBucketPart(const openData &d, const bucketSet &states,
+					  const std::unordered_map<openData, openList, openDataHash> &currentOpen,
+					  double &expandTime, double &solutionTime)
 {
-	ReadBucket(states, d);
-	RemoveDuplicates(states, d); // delayed duplicate detection
-	WriteToClosed(states, d); // this could run in parallel!
+	Timer timer;
+	timer.StartTimer();
+	// Read in opposite buckets to check for solutions in parallel to expanding this bucket
+	std::thread t(CheckSolution, currentOpen, d, std::ref(states));
+	
+	const int numThreads = std::thread::hardware_concurrency();
+	std::vector<std::thread *> threads;
+	for (int x = 0; x < numThreads; x++)
+		threads.push_back(new std::thread(ParallelExpandBucket, d, std::ref(states), x, numThreads));
+	// Put work for states into queue and send it to threads
+//	{
+//		int count = 0;
+//		workUnit w;
+//		for (const auto &values : states)
+//		{
+//#ifdef MY_SET
+//			if (values.valid == false)
+//				continue;
+//			w.work[count] = values.item;
+//#else
+//			w.work[count] = values;
+//#endif
+//			count++;
+//			if (count == kWorkUnitSize)
+//			{
+//				w.count = count;
+//				work.WaitAdd(w);
+//				count = 0;
+//			}
+//		}
+//		if (count > 0)
+//		{
+//			w.count = count;
+//			work.WaitAdd(w);
+//		}
+//		w.count = 0;
+//		for (int x = 0; x < threads.size(); x++)
+//			work.WaitAdd(w);
+//	}
+	for (int x = 0; x < threads.size(); x++)
+	{
+		threads[x]->join();
+		delete threads[x];
+	}
+	expandTime += timer.EndTimer();
+
+	// Close thread that is doing DSD
+	timer.StartTimer();
+	t.join();
+	solutionTime += timer.EndTimer();
 }
 
 #define DO_PRELOAD
@@ -539,8 +616,10 @@ void ReadAndDDBucket(bucketSet &states, const openData &d)
 void ExpandNextFile()
 {
 	static bool preLoaded = false;
-	static bucketSet nextStates(0);
-	static bucketSet states(0);
+	static bucketSet nextStates;
+	static bucketSet states;
+	static bucketRun nextRun;
+	static bucketRun run;
 	static openData next;
 	// 1. Get next expansion target
 	openData d = GetBestFile();
@@ -555,30 +634,30 @@ void ExpandNextFile()
 	states.clear();
 	if (preLoaded == false)
 	{
-		ReadAndDDBucket(states, d);
+		ReadAndDDBucket(states, run, d);
 	}
 	else {
 		if (d == next)
 		{
 			states.swap(nextStates);
+			run = nextRun;
 			preLoaded = false;
 		}
 		else {
 			std::cout << "ERROR: pre-loading changed buckets!\n";
-			ReadAndDDBucket(states, d);
+			ReadAndDDBucket(states, run, d);
 		}
 	}
 	open.erase(open.find(d));
 	timer.EndTimer();
 	
+	uint64_t bucketSize = run.file?run.file->RunSize(run.run):states.size();
 	printLock.lock();
-	std::cout << "Next: " << d << " (" << states.size() << " entries) [" << timer.GetElapsedTime() << "s reading/dd] ";
+	std::cout << "Next: " << d << " (" << bucketSize << " entries) [" << timer.GetElapsedTime() << "s reading/dd] ";
 	printLock.unlock();
 
-	timer.StartTimer();
-	// Read in opposite buckets to check for solutions in parallel to expanding this bucket
 	openLock.lock();
-	std::thread t(CheckSolution, open, d, std::ref(states));
+	std::unordered_map<openData, openList, openDataHash> currentOpen = open;
 	openLock.unlock();
 	
 	std::thread *pre = 0;
@@ -588,62 +667,23 @@ void ExpandNextFile()
 	next = GetBestFile();
 	if (next.dir == d.dir && next.gcost == d.gcost && next.bucket != d.bucket)
 	{
-		pre = new std::thread(ReadAndDDBucket, std::ref(nextStates), std::ref(next));
+		pre = new std::thread(ReadAndDDBucket, std::ref(nextStates), std::ref(nextRun), std::ref(next));
 		preLoaded = true;
 	}
 #endif
 	
-	// 3. expand all states in current bucket & write out successors
-	const int numThreads = std::thread::hardware_concurrency();
-	std::vector<std::thread *> threads;
-	for (int x = 0; x < numThreads; x++)
-		threads.push_back(new std::thread(ParallelExpandBucket, d, std::ref(states), x, numThreads));
-	// Put work for states into queue and send it to threads
-//	{
-//		int count = 0;
-//		workUnit w;
-//		for (const auto &values : states)
-//		{
-//#ifdef MY_SET
-//			if (values.valid == false)
-//				continue;
-//			w.work[count] = values.item;
-//#else
-//			w.work[count] = values;
-//#endif
-//			count++;
-//			if (count == kWorkUnitSize)
-//			{
-//				w.count = count;
-//				work.WaitAdd(w);
-//				count = 0;
-//			}
-//		}
-//		if (count > 0)
-//		{
-//			w.count = count;
-//			work.WaitAdd(w);
-//		}
-//		w.count = 0;
-//		for (int x = 0; x < threads.size(); x++)
-//			work.WaitAdd(w);
-//	}
-	for (int x = 0; x < threads.size(); x++)
+	// 3. expand all states in current bucket & write out successors, a part at a
+	// time if the bucket didn't fit in memory
+	double expandTime = 0, solutionTime = 0;
+	for (uint64_t part = 0; part < bucketSize; part += states.size())
 	{
-		threads[x]->join();
-		delete threads[x];
+		if (run.file && run.file->ReadRun(run.run, part, states, maxBucketStates) == 0)
+			break;
+		ExpandBucketPart(d, states, currentOpen, expandTime, solutionTime);
 	}
-	timer.EndTimer();
 	printLock.lock();
-	std::cout << "[" << timer.GetElapsedTime() << "s expanding]+";
-	printLock.unlock();
-
-	// Close thread that is doing DSD
-	timer.StartTimer();
-	t.join();
-	timer.EndTimer();
-	printLock.lock();
-	std::cout << "[" << timer.GetElapsedTime() << "s] ";
+	std::cout << "[" << expandTime << "s expanding]+";
+	std::cout << "[" << solutionTime << "s] ";
 	printLock.unlock();
 	
 	// Close thread that is reading previous bucket
@@ -925,9 +965,6 @@ void MM(RubiksState &start, RubiksState &goal, const char *p1, const char *p2,
 		heuristicType h, const char *hloc)
 //void MM(RubiksState &start, RubiksState &goal, const char *p1, const char *p2, const char *hloc)
 {
-#ifdef MY_SET
-	printf("Using custom set container\n");
-#endif
 	startState = start;
 	goalState = goal;
 	prefix1 = p1;
@@ -953,12 +990,15 @@ void MM(RubiksState &start, RubiksState &goal, const char *p1, const char *p2,
 	Timer t;
 	t.StartTimer();
 	printf("---MM*---\n");
+	sortPool = new WorkerPool(std::thread::hardware_concurrency());
 	AddStateToQueue(start, kForward, 0);
 	AddStateToQueue(goal, kBackward, 0);
 	while (!open.empty() && !finished)
 	{
 		ExpandNextFile();
 	}
+	delete sortPool;
+	sortPool = 0;
 	t.EndTimer();
 	printf("%1.2fs elapsed\n", t.GetElapsedTime());
 }
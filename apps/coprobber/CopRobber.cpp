@@ -6,6 +6,7 @@
 #include <string.h>
 #include <time.h>
 #include <cstdio>
+#include <thread>
 #include "Minimax.h"
 #include "Minimax_optimized.h"
 #include "MapCliqueAbstraction.h"
@@ -47,6 +48,8 @@
 #include "dscrsimulation/OptimalUnit.h"
 #include "TwoCopsDijkstra.h"
 #include "TwoCopsDijkstra2.h"
+#include "TwoCopsRetrograde.h"
+#include "Timer.h"
 #include "TwoCopsRMAStar.h"
 #include "TwoCopsTIDAStar.h"
 #include "DSCover2.h"
@@ -193,6 +196,9 @@ int main(int argc, char* argv[])
 	else if( strcmp( argv[1], "twocopsdijkstra" ) == 0 ) {
 		compute_twocopsdijkstra( argc, argv );
 	}
+	else if( strcmp( argv[1], "twocopsretrograde" ) == 0 ) {
+		compute_twocopsretrograde( argc, argv );
+	}
 	else if( strcmp( argv[1], "testpoints" ) == 0 ) {
 		compute_testpoints( argc, argv );
 	}
@@ -1418,6 +1424,56 @@ void compute_twocopsdijkstra( int argc, char* argv[] ) {
 	delete m;
 }
 
+// same values as twocopsdijkstra, with retrograde analysis on -threads <n> threads
+void compute_twocopsretrograde( int argc, char* argv[] ) {
+	Map *m;
+	xyLoc pc, pr;
+	int max_recursion_level;
+	int num_threads = std::thread::hardware_concurrency();
+	Timer t;
+
+	parseCommandLineParameters( argc, argv, m, pc, pr, max_recursion_level );
+	for( int i = 2; i+1 < argc; i += 2 ) {
+		if( strcmp( argv[i], "-threads" ) == 0 ) num_threads = atoi( argv[i+1] );
+	}
+	printf( "map: %s\n", m->GetMapName() );
+
+	Graph *g = GraphSearchConstants::GetGraph( m );
+	GraphEnvironment *env = new GraphEnvironment( g, NULL );
+	env->SetDirected( true );
+
+	TwoCopsRetrograde *tcr = new TwoCopsRetrograde( env );
+	t.StartTimer();
+	tcr->solve( num_threads );
+	printf( "retrograde (%d threads): %1.3fs, %llu nodes expanded, %llu nodes touched\n", num_threads, t.EndTimer(),
+		(unsigned long long)tcr->nodesExpanded, (unsigned long long)tcr->nodesTouched );
+	printf( "2-cop-win: %d\n", tcr->is_two_cop_win() );
+
+	// TwoCopsDijkstra hashes positions into 32 bits
+	if( (uint64_t)g->GetNumNodes()*g->GetNumNodes()*g->GetNumNodes() <= UINT32_MAX ) {
+		TwoCopsDijkstra *tcd = new TwoCopsDijkstra( env );
+		t.StartTimer();
+		tcd->dijkstra();
+		printf( "dijkstra: %1.3fs, %u nodes expanded, %u nodes touched\n", t.EndTimer(), tcd->nodesExpanded, tcd->nodesTouched );
+		unsigned int differ = 0;
+		for( graphState r = 0; r < (graphState)g->GetNumNodes(); r++ ) {
+			for( graphState c1 = 0; c1 < (graphState)g->GetNumNodes(); c1++ ) {
+				for( graphState c2 = 0; c2 < (graphState)g->GetNumNodes(); c2++ ) {
+					if( tcd->Value( r, c1, c2 ) != tcr->Value( r, c1, c2 ) ) differ++;
+				}
+			}
+		}
+		printf( "positions with different values: %u\n", differ );
+		delete tcd;
+	}
+	tcr->WriteValuesToDisk( "retrograde_twocops.dat" );
+
+	delete tcr;
+	delete env;
+	delete g;
+	delete m;
+}
+
 
 /*------------------------------------------------------------------------------
 | Implementation of tests
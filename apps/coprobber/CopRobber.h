@@ -30,6 +30,7 @@ void compute_dsdatpdijkstra( int argc, char* argv[] );
 void compute_dsrandombeacons( int argc, char* argv[] );
 void compute_markov( int argc, char* argv[] );
 void compute_twocopsdijkstra( int argc, char* argv[] );
+void compute_twocopsretrograde( int argc, char* argv[] );
 // tests
 void compute_testpoints( int argc, char* argv[] );
 void compute_testpoints_two_cops( int argc, char* argv[] );
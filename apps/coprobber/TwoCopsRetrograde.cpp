@@ -0,0 +1,155 @@
+#include "TwoCopsRetrograde.h"
+#include <math.h>
+#include <thread>
+#include <algorithm>
+
+/*------------------------------------------------------------------------------
+| The game
+------------------------------------------------------------------------------*/
+TwoCopsRetrograde::Game::Game( GraphEnvironment *env ):
+	numnodes( env->GetGraph()->GetNumNodes() ),
+	numpairs( numnodes*(numnodes+1)/2 )
+{
+	std::vector<std::vector<uint32_t> > preds( numnodes );
+	std::vector<graphState> neighbors;
+	succStart.push_back( 0 );
+	for( uint64_t n = 0; n < numnodes; n++ ) {
+		env->GetSuccessors( n, neighbors );
+		std::sort( neighbors.begin(), neighbors.end() );
+		neighbors.erase( std::unique( neighbors.begin(), neighbors.end() ), neighbors.end() );
+		for( unsigned int i = 0; i < neighbors.size(); i++ ) {
+			if( neighbors[i] == n ) continue;
+			succ.push_back( neighbors[i] );
+			preds[neighbors[i]].push_back( n );
+		}
+		succStart.push_back( succ.size() );
+		// the robber's moves are counted in 8 bits
+		if( succStart[n+1]-succStart[n] > 254 ) {
+			fprintf( stderr, "ERROR: node %llu has more than 254 neighbors\n", (unsigned long long)n );
+			exit( 1 );
+		}
+	}
+	predStart.push_back( 0 );
+	for( uint64_t n = 0; n < numnodes; n++ ) {
+		pred.insert( pred.end(), preds[n].begin(), preds[n].end() );
+		predStart.push_back( pred.size() );
+	}
+};
+
+uint64_t TwoCopsRetrograde::Game::Rank( graphState r, graphState c1, graphState c2 ) const {
+	if( c1 > c2 ) std::swap( c1, c2 );
+	return( r * numpairs + PairRank( c1, c2 ) );
+};
+
+void TwoCopsRetrograde::Game::Unrank( uint64_t rank, graphState &r, graphState &c1, graphState &c2 ) const {
+	r = rank / numpairs;
+	uint64_t p = rank % numpairs;
+	// invert RowStart (quadratic in c1) and correct the rounding
+	double n = numnodes + 0.5;
+	uint64_t c = (uint64_t)floor( n - sqrt( n*n - 2.*p ) );
+	while( c > 0 && RowStart( c ) > p ) c--;
+	while( c+1 < numnodes && RowStart( c+1 ) <= p ) c++;
+	c1 = c;
+	c2 = p - RowStart( c ) + c;
+};
+
+bool TwoCopsRetrograde::Game::IsTerminal( uint64_t rank ) const {
+	graphState r, c1, c2;
+	Unrank( rank, r, c1, c2 );
+	return( r == c1 || r == c2 );
+};
+
+int TwoCopsRetrograde::Game::GetNumMaxMoves( uint64_t rank ) const {
+	uint64_t r = rank / numpairs;
+	// the robber can pass
+	return( succStart[r+1] - succStart[r] + 1 );
+};
+
+void TwoCopsRetrograde::Game::GetMinPredecessors( uint64_t rank, std::vector<uint64_t> &p ) const {
+	p.clear();
+	graphState r, c1, c2;
+	Unrank( rank, r, c1, c2 );
+	uint64_t base = r * numpairs;
+
+	// every cop passes or comes from a predecessor of its node, but not both
+	// pass (as in TwoCopsDijkstra::GetNeighbors)
+	for( uint32_t i = predStart[c1]; i <= predStart[c1+1]; i++ ) {
+		uint64_t from1 = (i == predStart[c1+1])?c1:pred[i];
+		for( uint32_t j = predStart[c2]; j <= predStart[c2+1]; j++ ) {
+			uint64_t from2 = (j == predStart[c2+1])?c2:pred[j];
+			if( from1 == c1 && from2 == c2 ) continue;
+			p.push_back( base + ((from1 <= from2)?PairRank( from1, from2 ):PairRank( from2, from1 )) );
+		}
+	}
+};
+
+void TwoCopsRetrograde::Game::GetMaxPredecessors( uint64_t rank, std::vector<uint64_t> &p ) const {
+	p.clear();
+	uint64_t r = rank / numpairs;
+	uint64_t cops = rank % numpairs;
+	graphState rr, c1, c2;
+	Unrank( rank, rr, c1, c2 );
+
+	// the robber passed or came from a predecessor of its node; positions
+	// where the robber was already caught are left out
+	if( r != c1 && r != c2 )
+		p.push_back( rank );
+	for( uint32_t i = predStart[r]; i < predStart[r+1]; i++ ) {
+		if( pred[i] != c1 && pred[i] != c2 )
+			p.push_back( pred[i] * numpairs + cops );
+	}
+};
+
+/*------------------------------------------------------------------------------
+| Constructor and solver
+------------------------------------------------------------------------------*/
+TwoCopsRetrograde::TwoCopsRetrograde( GraphEnvironment *env, const char *filePrefix ):
+	nodesExpanded( 0 ), nodesTouched( 0 ), game( env ), solver( game )
+{
+	solver.SetFilePrefix( filePrefix );
+};
+
+void TwoCopsRetrograde::solve( int numThreads ) {
+	solver.Solve( numThreads );
+	nodesExpanded = solver.GetNodesExpanded();
+	nodesTouched  = solver.GetNodesTouched();
+	return;
+};
+
+bool TwoCopsRetrograde::is_two_cop_win() {
+	// in case the values haven't been computed yet
+	if( !solver.IsSolved() ) solve( std::thread::hardware_concurrency() );
+
+	for( uint64_t i = 0; i < game.GetNumStates(); i++ ) {
+		if( solver.GetValue( i ) == solver.kUnsolved )
+			return false;
+	}
+	return true;
+};
+
+unsigned int TwoCopsRetrograde::Value( graphState &r, graphState &c1, graphState &c2 ) {
+	assert( solver.IsSolved() );
+	// failsafe
+	if( !solver.IsSolved() ) return 0;
+
+	return solver.GetValue( game.Rank( r, c1, c2 ) );
+};
+
+/*------------------------------------------------------------------------------
+| Output
+------------------------------------------------------------------------------*/
+void TwoCopsRetrograde::WriteValuesToDisk( const char* filename ) {
+	FILE *fhandler;
+
+	fhandler = fopen( filename, "w" );
+	for( graphState r = 0; r < game.GetNumNodes(); r++ ) {
+		for( graphState c1 = 0; c1 < game.GetNumNodes(); c1++ ) {
+			for( graphState c2 = 0; c2 < game.GetNumNodes(); c2++ ) {
+				fprintf( fhandler, "%u %u %u %u\n", (unsigned int)r, (unsigned int)c1, (unsigned int)c2,
+					solver.GetValue( game.Rank( r, c1, c2 ) ) );
+			}
+		}
+	}
+	fclose( fhandler );
+	return;
+};
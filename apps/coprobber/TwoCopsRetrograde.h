@@ -0,0 +1,71 @@
+#include <vector>
+#include "GraphEnvironment.h"
+#include "RetrogradeSolver.h"
+
+#ifndef TWOCOPSRETROGRADE_H
+#define TWOCOPSRETROGRADE_H
+
+/*
+	Retrograde analysis for one robber and two cops
+
+	note: same rules and values as TwoCopsDijkstra (cops move first,
+	  agents can pass their turns, edge costs are all 1)
+
+	note: positions are ranked in 64 bits, so graphs are not limited to
+	  the 1625 nodes that fit into the 32 bit hash of TwoCopsDijkstra.
+	  The values take 3 bytes per position, in memory or memory mapped
+	  from files with the given prefix, and the layers are solved in
+	  parallel (see RetrogradeSolver.h)
+*/
+class TwoCopsRetrograde {
+
+	public:
+
+	// the game for RetrogradeSolver, the cops are the min player
+	class Game {
+		public:
+		Game( GraphEnvironment *env );
+
+		uint64_t GetNumStates() const { return numnodes * numpairs; }
+		bool IsTerminal( uint64_t rank ) const;
+		int GetNumMaxMoves( uint64_t rank ) const;
+		void GetMinPredecessors( uint64_t rank, std::vector<uint64_t> &p ) const;
+		void GetMaxPredecessors( uint64_t rank, std::vector<uint64_t> &p ) const;
+
+		// the cops' positions don't have to be ordered
+		uint64_t Rank( graphState r, graphState c1, graphState c2 ) const;
+		void Unrank( uint64_t rank, graphState &r, graphState &c1, graphState &c2 ) const;
+		uint64_t GetNumNodes() const { return numnodes; }
+
+		protected:
+		// c1 <= c2
+		uint64_t PairRank( uint64_t c1, uint64_t c2 ) const { return c1*numnodes - c1*(c1+1)/2 + c2; }
+		uint64_t RowStart( uint64_t c1 ) const { return PairRank( c1, c1 ); }
+
+		uint64_t numnodes, numpairs;
+		// successors and predecessors of the nodes in compressed rows,
+		// without repeats and self loops
+		std::vector<uint32_t> succStart, succ, predStart, pred;
+	};
+
+	// constructor
+	TwoCopsRetrograde( GraphEnvironment *env, const char *filePrefix = 0 );
+
+	void solve( int numThreads );
+	// returns whether the graph is 2-cop-win or not
+	bool is_two_cop_win();
+
+	void WriteValuesToDisk( const char* filename );
+
+	unsigned int Value( graphState &r, graphState &c1, graphState &c2 );
+
+	uint64_t nodesExpanded, nodesTouched;
+
+	protected:
+
+	Game game;
+	RetrogradeSolver<Game> solver;
+
+};
+
+#endif
@@ -31,6 +31,7 @@
 #include <set>
 #include <numeric>
 #include <stack>
+#include <deque>
 #include <unordered_map>
 #include <sstream>
 #include <iterator>
@@ -45,6 +46,7 @@
 #include "ScenarioLoader.h"
 #include "MapPerfectHeuristic.h"
 #include "Utilities.h"
+#include "PackedKeyTable.h"
 
 #define  INF 0xffffffff
 
@@ -134,7 +136,7 @@ uint64_t largestbranch(0);
 double largestJoint(0);
 uint32_t step(INFLATION);
 int n(0);
-std::unordered_map<std::string,bool> transTable;
+PackedKeyTable<uint8_t> transTable; // keyed by the node hash of each agent
 std::unordered_map<uint64_t,bool> singleTransTable;
 unsigned seed(clock());
 
@@ -299,7 +301,8 @@ struct Node : public Hashable{
         bool optimal;
         //bool connected()const{return parents.size()+successors.size();}
 	//std::unordered_set<Node*> parents;
-	std::unordered_set<Node*> successors;
+	std::vector<Node*> successors;
+	void AddSuccessor(Node* s){if(std::find(successors.begin(),successors.end(),s)==successors.end())successors.push_back(s);}
 	virtual uint64_t Hash()const{return (env->GetStateHash(n)<<32) | depth;}
 	virtual uint32_t Depth()const{return depth; }
         virtual void Print(std::ostream& ss, int d=0) const {
@@ -460,7 +463,7 @@ bool LimitedDFS(xyLoc const& start, xyLoc const& end, DAG& dag, Node*& root, uin
       current.id=dag.size()+1;
       dag[chash]=current;
       if(verbose)std::cout << "inserting " << dag[chash] << " " << &dag[chash] << "under " << *parent << "\n";
-      parent->successors.insert(&dag[chash]);
+      parent->AddSuccessor(&dag[chash]);
       //dag[chash].parents.insert(parent);
       parent=&dag[chash];
     }
@@ -519,7 +522,7 @@ bool LimitedDFS(xyLoc const& start, xyLoc const& end, DAG& dag, Node*& root, uin
       //dag[current->Hash()].parents.insert(parent);
       //std::cout << *current << " child of " << *parent << " " << parent->Hash() << "\n";
       //std::cout << "inserting " << dag[chash] << " " << &dag[chash] << "under " << *parent << "\n";
-      dag[parent->Hash()].successors.insert(&dag[current->Hash()]);
+      dag[parent->Hash()].AddSuccessor(&dag[current->Hash()]);
       //std::cout << "at" << &dag[parent->Hash()] << "\n";
     }
   }
@@ -830,30 +833,23 @@ bool jointDFS2(MultiEdge const& r, uint32_t d, Solution solution, std::vector<So
 */
 
 // Return true if we get to the desired depth
-bool jointDFS(MultiEdge const& s, uint32_t d, Solution solution, std::vector<Solution>& solutions, std::vector<Node*>& toDelete, uint32_t& best, uint32_t& bestSeen, std::vector<std::vector<uint64_t>*>& good, std::vector<std::vector<uint64_t>>& unified, unsigned recursions=1, bool suboptimal=false, bool checkOnly=false){
+bool jointDFS(MultiEdge const& s, uint32_t d, Solution solution, std::vector<Solution>& solutions, std::deque<Node>& waits, uint32_t& best, uint32_t& bestSeen, std::vector<std::vector<uint64_t>*>& good, std::vector<std::vector<uint64_t>>& unified, unsigned recursions=1, bool suboptimal=false, bool checkOnly=false){
   jointdepth=std::max(recursions,jointdepth);
-  // Compute hash for transposition table
-  std::string hash(s.size()*sizeof(uint64_t),1);
+  // Key for the transposition table: the node hashes of all agents
+  std::vector<uint64_t> hash(s.size());
   int k(0);
   for(auto v:s){
-    uint64_t h1(v.second->Hash());
-    uint8_t c[sizeof(uint64_t)];
-    memcpy(c,&h1,sizeof(uint64_t));
-    for(unsigned j(0); j<sizeof(uint64_t); ++j){
-      hash[k*sizeof(uint64_t)+j]=((int)c[j])?c[j]:1; // Replace null-terminators in the middle of the string
-    }
-    ++k;
+    hash[k++]=v.second->Hash();
   }
 
   if(verbose)std::cout << "saw " << s << " hash ";
   if(verbose)for(unsigned int i(0); i<hash.size(); ++i){
-    std::cout << (unsigned)hash[i]<<" ";
+    std::cout << hash[i]<<" ";
   }
   if(verbose)std::cout <<"\n";
-  if(transTable.find(hash)!=transTable.end()){
+  if(uint8_t const* seen=transTable.find(&hash[0])){
     //std::cout << "AGAIN!\n";
-    return transTable[hash];
-    //if(!transTable[hash]){return false;}
+    return *seen;
   }
 
   if(!checkOnly&&d>0){
@@ -914,8 +910,8 @@ bool jointDFS(MultiEdge const& s, uint32_t d, Solution solution, std::vector<Sol
         if(!disappear){
           for(int i(0); i<solution.size(); ++i){
             if(solution[i].back()->depth<MAXTIME){
-              solution[i].emplace_back(new Node(solution[i].back()->n,MAXTIME));
-              toDelete.push_back(solution[i].back());
+              waits.emplace_back(solution[i].back()->n,MAXTIME);
+              solution[i].push_back(&waits.back());
             }
           }
         }
@@ -979,9 +975,9 @@ bool jointDFS(MultiEdge const& s, uint32_t d, Solution solution, std::vector<Sol
     }
     if(output.empty()){
       // Stay at state...
-      output.emplace_back(a.second,new Node(a.second->n,MAXTIME));
+      waits.emplace_back(a.second->n,MAXTIME);
+      output.emplace_back(a.second,&waits.back());
       //if(verbose)std::cout << "Wait " << *output.back().second << "\n";
-      toDelete.push_back(output.back().second);
       //md=min(md,a.second->depth+1.0); // Amount of time to wait
     }
     //std::cout << "successor  of " << s << "gets("<<*a<< "): " << output << "\n";
@@ -1011,11 +1007,11 @@ bool jointDFS(MultiEdge const& s, uint32_t d, Solution solution, std::vector<Sol
       set(unified[k].data(),a[k].second->id);
     }
     if(verbose)std::cout << "EVAL " << s << "-->" << a << "\n";
-    if(jointDFS(a,md,solution,solutions,toDelete,best,bestSeen,good,unified,recursions+1,suboptimal,checkOnly)){
+    if(jointDFS(a,md,solution,solutions,waits,best,bestSeen,good,unified,recursions+1,suboptimal,checkOnly)){
       maxjoint=std::max(recursions,maxjoint);
       minjoint=std::min(recursions,minjoint);
       value=true;
-      transTable[hash]=value;
+      transTable[&hash[0]]=value;
       // Return first solution... (unless this is a pairwise check with pruning)
       if(!checkOnly&&!certifyTime)certtimer.StartTimer();
       if(suboptimal&&!(epp&&checkOnly)) return true;
@@ -1023,15 +1019,14 @@ bool jointDFS(MultiEdge const& s, uint32_t d, Solution solution, std::vector<Sol
       if(!(epp&&checkOnly)&&!fulljoint&&best==bestSeen)return true;
     }
   }
-  transTable[hash]=value;
+  transTable[&hash[0]]=value;
   return value;
 }
 
-bool jointDFS(MultiState const& s, std::vector<Solution>& solutions, std::vector<Node*>& toDelete, uint32_t bestSeen, uint32_t& best, std::vector<std::vector<uint64_t>*>& good, std::vector<std::vector<uint64_t>>& unified, bool suboptimal=false, bool checkOnly=false){
+bool jointDFS(MultiState const& s, std::vector<Solution>& solutions, std::deque<Node>& waits, uint32_t bestSeen, uint32_t& best, std::vector<std::vector<uint64_t>*>& good, std::vector<std::vector<uint64_t>>& unified, bool suboptimal=false, bool checkOnly=false){
   if(verbose)std::cout << "JointDFS\n";
   MultiEdge act;
   Solution solution;
-  std::unordered_set<std::string> ttable;
   // Add null parents for the initial movements
   for(auto const& n:s){
     act.emplace_back(n,n);
@@ -1040,11 +1035,11 @@ bool jointDFS(MultiState const& s, std::vector<Solution>& solutions, std::vector
       solution.push_back({n});
     }
   }
-  transTable.clear();
+  transTable.SetWidth(s.size());
   jointdepth=0;
   jointbranchingfactor=0;
   jointgoals=0;
-  return jointDFS(act,0.0,solution,solutions,toDelete,best,bestSeen,good,unified,1,suboptimal,checkOnly);
+  return jointDFS(act,0.0,solution,solutions,waits,best,bestSeen,good,unified,1,suboptimal,checkOnly);
 }
 
 // Check that two paths have no collisions
@@ -1109,6 +1104,14 @@ void join(std::stringstream& s, std::vector<uint32_t> const& x){
   copy(x.begin(),x.end(), std::ostream_iterator<uint32_t>(s,","));
 }
 
+// Cost vectors are packed two per word for the set of ICT nodes generated
+void pack(std::vector<uint32_t> const& x, std::vector<uint64_t>& key){
+  key.assign((x.size()+1)/2,0);
+  for(unsigned i(0); i<x.size(); ++i){
+    key[i/2]|=uint64_t(x[i])<<(32*(i%2));
+  }
+}
+
 struct ICTSNode{
   ICTSNode(ICTSNode* parent,int agent, uint32_t size):instance(parent->instance),dag(parent->dag.size()),best(parent->best),dagsize(parent->dagsize),costs(parent->costs),bestSeen(0),sizes(parent->sizes),root(parent->root),ids(parent->ids),incumbent(parent->incumbent){
     count++;
@@ -1158,8 +1161,6 @@ struct ICTSNode{
     bestSeen=std::accumulate(best.begin(),best.end(),0.0f);
   }
 
-  ~ICTSNode(){for(auto d:toDelete){delete d;}}
-
   // Get unique identifier for this node
   std::string key()const{
     std::stringstream sv;
@@ -1180,7 +1181,7 @@ struct ICTSNode{
   MultiState root;
   std::vector<int> ids;
   Instance points;
-  std::vector<Node*> toDelete;
+  std::deque<Node> waits; // wait nodes added by the joint searches
   static uint64_t count;
   static bool pairwise;
   static bool suboptimal;
@@ -1214,7 +1215,6 @@ struct ICTSNode{
           MultiState tmproot(2);
           tmproot[0]=root[i];
           tmproot[1]=root[j];
-          std::vector<Node*> toDeleteTmp;
           std::vector<std::vector<uint64_t>> unified(2);
           std::vector<std::vector<uint64_t>*> tmpgood(2);
           if(epp){
@@ -1230,7 +1230,7 @@ struct ICTSNode{
           uint32_t dummy(INF);
           // This is a satisficing search, thus we only need do a sub-optimal check
           if(!quiet)std::cout<<"pairwise for " << i << ","<<j<<"\n";
-          if(!jointDFS(tmproot,answers,toDeleteTmp,INF,dummy,tmpgood,unified,true,true)){
+          if(!jointDFS(tmproot,answers,waits,INF,dummy,tmpgood,unified,true,true)){
             if(!quiet)std::cout << "Pairwise failed\n";
             cardinal.push_back(i);
             cardinal.push_back(j);
@@ -1290,7 +1290,7 @@ struct ICTSNode{
     }
     unsigned p(jointexpansions);
     unsigned q(jointnodes);
-    if(jointDFS(root,answers,toDelete,lb(),*incumbent,tmpgood,unified,suboptimal)){
+    if(jointDFS(root,answers,waits,lb(),*incumbent,tmpgood,unified,suboptimal)){
       if(!answers.size()){return false;}
       jointTime+=timer.EndTimer();
       if(verbose){
@@ -1816,7 +1816,8 @@ int main(int argc, char ** argv){
       if(g.first.size()>1){
         std::vector<uint32_t> sizes(g.first.size());
         custom_priority_queue<ICTSNode*,ICTSNodePtrComp> q;
-        std::unordered_set<std::string> deconf;
+        PackedKeyTable<uint8_t> deconf((g.first.size()+1)/2);
+        std::vector<uint64_t> key;
 
         uint32_t bestCost(INF);
         q.push(new ICTSNode(g,sizes,Gid[j],&bestCost));
@@ -1882,9 +1883,8 @@ int main(int argc, char ** argv){
                 if(weight) step=std::max(INFLATION,(weight-1.0)*parent->lb()/double(n));
                 if(!quiet)std::cout << "step " << step << "\n";
                 sz[i]+=step;
-                std::stringstream sv;
-                join(sv,sz);
-                if(deconf.find(sv.str())==deconf.end()){
+                pack(sz,key);
+                if(!deconf.find(&key[0])){
                   ICTSNode* tmp(new ICTSNode(parent,i,sz[i]));
                   if(!quiet){
                     std::cout << "push ";
@@ -1900,7 +1900,7 @@ int main(int argc, char ** argv){
                     std::cout << "  SIC: " << tmp->lb() << std::endl;
                   }
                   q.push(tmp);
-                  deconf.insert(sv.str());
+                  deconf[&key[0]]=true;
                 }
               }
             }else{
@@ -1909,9 +1909,8 @@ int main(int argc, char ** argv){
                 if(weight) step=std::max(INFLATION,(weight-1.0)*parent->lb()/double(n));
                 if(!quiet)std::cout << "step " << step << "\n";
                 sz[i]+=step;
-                std::stringstream sv;
-                join(sv,sz);
-                if(deconf.find(sv.str())==deconf.end()){
+                pack(sz,key);
+                if(!deconf.find(&key[0])){
                   ICTSNode* tmp(new ICTSNode(parent,i,sz[i]));
                   if(!quiet){
                     std::cout << "push ";
@@ -1927,7 +1926,7 @@ int main(int argc, char ** argv){
                     std::cout << "  SIC: " << tmp->lb() << std::endl;
                   }
                   q.push(tmp);
-                  deconf.insert(sv.str());
+                  deconf[&key[0]]=true;
                 }
               }
             }
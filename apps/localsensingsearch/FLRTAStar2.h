@@ -13,7 +13,7 @@
 #include "FPUtil.h"
 #include <deque>
 #include <vector>
-#include <ext/hash_map>
+#include "LearnedStateTable.h"
 #include "TemplateAStar.h"
 #include "Timer.h"
 #include <queue>
@@ -107,8 +107,8 @@ namespace FLRTA2 {
 		void OpenGLDraw(const environment *env) const;
 	private:
 		typedef std::priority_queue<borderData<state>,std::vector<borderData<state> >,compareBorderData<state> > pQueue;
-		typedef __gnu_cxx::hash_map<uint64_t, lssLearnedData<state>, Hash64 > LearnedHeuristic;
-		typedef __gnu_cxx::hash_map<uint64_t, bool, Hash64 > ClosedList;
+		typedef LearnedStateTable<lssLearnedData<state>> LearnedHeuristic;
+		typedef LearnedStateTable<bool> ClosedList;
 		
 
 		bool ExpandLSS(environment *env, const state &from, const state &to, std::vector<state> &thePath);
@@ -139,6 +139,7 @@ namespace FLRTA2 {
 	template <class state, class action, class environment>
 	void FLRTAStar2<state, action, environment>::GetPath(environment *env, const state& from, const state& to, std::vector<state> &thePath)
 	{
+		heur.UseDenseIndex(env->GetMaxHash());
 		if (goals.size() == 0)
 		{
 			goals.push_back(to);
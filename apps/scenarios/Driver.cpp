@@ -0,0 +1,308 @@
+//
+//  Driver.cpp
+//  hog2
+//
+//  Headless runner for movingai grid benchmarks. All experiments in a
+//  scenario share one read-only map and environment; each thread has its own
+//  search instance. One CSV line is written per query.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include "ScenarioLoader.h"
+#include "Map2DEnvironment.h"
+#include "CanonicalGrid.h"
+#include "TemplateAStar.h"
+#include "JPS.h"
+#include "WorkerPool.h"
+#include "Timer.h"
+
+// The GUI isn't linked; the stub glut library still needs this
+void renderScene() {}
+
+struct QueryResult {
+	uint64_t nodesExpanded;
+	uint64_t nodesTouched;
+	double time;
+	double length;
+};
+
+struct RunOptions {
+	std::string algorithm;
+	std::string mapDirectory;
+	double weight;
+	int numThreads;
+};
+
+template <class environment, class state>
+double GetPathCost(const environment &env, const std::vector<state> &path)
+{
+	double cost = 0;
+	for (size_t x = 1; x < path.size(); x++)
+		cost += env.GCost(path[x-1], path[x]);
+	return cost;
+}
+
+/*
+ * Solves every experiment with one search instance per thread. The
+ * algorithm type provides a way to make an instance and to solve one query
+ * with it; everything else is shared.
+ */
+template <class searcher>
+void RunExperiments(ScenarioLoader &scen, searcher &s, int numThreads, std::vector<QueryResult> &results)
+{
+	int count = scen.GetNumExperiments();
+	results.resize(count);
+	std::vector<Experiment> experiments;
+	for (int x = 0; x < count; x++)
+		experiments.push_back(scen.GetNthExperiment(x));
+	std::vector<typename searcher::instance> instances(numThreads);
+	for (int t = 0; t < numThreads; t++)
+		s.Init(instances[t]);
+	WorkerPool pool(numThreads);
+	WorkStealingRange work(numThreads);
+	work.Reset(count);
+	pool.Run([&](int threadNum) {
+		uint64_t which;
+		while (work.Next(threadNum, which))
+			s.Solve(instances[threadNum], experiments[which], results[which]);
+	});
+}
+
+class AStarSearcher {
+public:
+	typedef std::unique_ptr<TemplateAStar<xyLoc, tDirection, MapEnvironment>> instance;
+	AStarSearcher(MapEnvironment *e, double w) :env(e), weight(w) {}
+	void Init(instance &i)
+	{
+		i.reset(new TemplateAStar<xyLoc, tDirection, MapEnvironment>());
+		i->SetWeight(weight);
+	}
+	void Solve(instance &i, const Experiment &e, QueryResult &r)
+	{
+		xyLoc start(e.GetStartX(), e.GetStartY()), goal(e.GetGoalX(), e.GetGoalY());
+		std::vector<xyLoc> path;
+		Timer t;
+		t.StartTimer();
+		i->GetPath(env, start, goal, path);
+		r.time = t.EndTimer();
+		r.nodesExpanded = i->GetNodesExpanded();
+		r.nodesTouched = i->GetNodesTouched();
+		r.length = GetPathCost(*env, path);
+	}
+private:
+	MapEnvironment *env;
+	double weight;
+};
+
+class JPSSearcher {
+public:
+	typedef std::unique_ptr<JPS> instance;
+	JPSSearcher(Map *m, MapEnvironment *e, double w) :map(m), env(e), weight(w) {}
+	void Init(instance &i)
+	{
+		i.reset(new JPS(map));
+		i->SetWeight(weight);
+	}
+	void Solve(instance &i, const Experiment &e, QueryResult &r)
+	{
+		xyLoc start(e.GetStartX(), e.GetStartY()), goal(e.GetGoalX(), e.GetGoalY());
+		std::vector<xyLoc> path;
+		Timer t;
+		t.StartTimer();
+		i->GetPath(env, start, goal, path);
+		r.time = t.EndTimer();
+		r.nodesExpanded = i->GetNodesExpanded();
+		r.nodesTouched = i->GetNodesTouched();
+		// JPS returns jump points; the octile distance is the cost between them
+		r.length = 0;
+		for (size_t x = 1; x < path.size(); x++)
+			r.length += env->HCost(path[x-1], path[x]);
+	}
+private:
+	Map *map;
+	MapEnvironment *env;
+	double weight;
+};
+
+class CanonicalSearcher {
+public:
+	typedef std::unique_ptr<TemplateAStar<CanonicalGrid::xyLoc, CanonicalGrid::tDirection, CanonicalGrid::CanonicalGrid>> instance;
+	CanonicalSearcher(CanonicalGrid::CanonicalGrid *e, double w) :env(e), weight(w) {}
+	void Init(instance &i)
+	{
+		i.reset(new TemplateAStar<CanonicalGrid::xyLoc, CanonicalGrid::tDirection, CanonicalGrid::CanonicalGrid>());
+		i->SetWeight(weight);
+	}
+	void Solve(instance &i, const Experiment &e, QueryResult &r)
+	{
+		CanonicalGrid::xyLoc start(e.GetStartX(), e.GetStartY()), goal(e.GetGoalX(), e.GetGoalY());
+		std::vector<CanonicalGrid::xyLoc> path;
+		Timer t;
+		t.StartTimer();
+		i->GetPath(env, start, goal, path);
+		r.time = t.EndTimer();
+		r.nodesExpanded = i->GetNodesExpanded();
+		r.nodesTouched = i->GetNodesTouched();
+		r.length = GetPathCost(*env, path);
+	}
+private:
+	CanonicalGrid::CanonicalGrid *env;
+	double weight;
+};
+
+std::string GetMapPath(const char *scenario, const char *mapName, const std::string &mapDirectory)
+{
+	std::vector<std::string> candidates;
+	if (mapDirectory.size() > 0)
+		candidates.push_back(mapDirectory+"/"+mapName);
+	candidates.push_back(mapName);
+	// movingai layout: <set>/scen-even/x.scen and <set>/maps/x.map
+	std::string dir(scenario);
+	size_t slash = dir.find_last_of('/');
+	dir = (slash == std::string::npos)?".":dir.substr(0, slash);
+	candidates.push_back(dir+"/"+mapName);
+	candidates.push_back(dir+"/../maps/"+mapName);
+	for (const std::string &c : candidates)
+	{
+		FILE *f = fopen(c.c_str(), "r");
+		if (f)
+		{
+			fclose(f);
+			return c;
+		}
+	}
+	return "";
+}
+
+bool RunScenario(const char *scenario, const RunOptions &opt, FILE *out, int &mismatches)
+{
+	ScenarioLoader scen(scenario);
+	if (scen.GetNumExperiments() == 0)
+	{
+		fprintf(stderr, "No experiments in '%s'\n", scenario);
+		return false;
+	}
+	std::string mapPath = GetMapPath(scenario, scen.GetNthExperiment(0).GetMapName(), opt.mapDirectory);
+	if (mapPath.size() == 0)
+	{
+		fprintf(stderr, "Could not find map '%s' for '%s'\n", scen.GetNthExperiment(0).GetMapName(), scenario);
+		return false;
+	}
+	Map map(mapPath.c_str());
+	MapEnvironment env(&map);
+	std::vector<QueryResult> results;
+	Timer t;
+	t.StartTimer();
+	if (opt.algorithm == "astar")
+	{
+		AStarSearcher s(&env, opt.weight);
+		RunExperiments(scen, s, opt.numThreads, results);
+	}
+	else if (opt.algorithm == "jps")
+	{
+		JPSSearcher s(&map, &env, opt.weight);
+		RunExperiments(scen, s, opt.numThreads, results);
+	}
+	else if (opt.algorithm == "canonical")
+	{
+		CanonicalGrid::CanonicalGrid grid(&map);
+		CanonicalSearcher s(&grid, opt.weight);
+		RunExperiments(scen, s, opt.numThreads, results);
+	}
+	else {
+		fprintf(stderr, "Unknown algorithm '%s'\n", opt.algorithm.c_str());
+		return false;
+	}
+	double elapsed = t.EndTimer();
+
+	uint64_t totalExpanded = 0;
+	for (int x = 0; x < scen.GetNumExperiments(); x++)
+	{
+		Experiment e = scen.GetNthExperiment(x);
+		const QueryResult &r = results[x];
+		fprintf(out, "%s,%s,%d,%d,%d,%d,%d,%d,%s,%llu,%llu,%f,%f,%f\n", scenario, e.GetMapName(), x, e.GetBucket(),
+				e.GetStartX(), e.GetStartY(), e.GetGoalX(), e.GetGoalY(), opt.algorithm.c_str(),
+				(unsigned long long)r.nodesExpanded, (unsigned long long)r.nodesTouched, r.time, r.length, e.GetDistance());
+		totalExpanded += r.nodesExpanded;
+		// the scenario distances are printed with 8 digits
+		if (opt.weight == 1 && fabs(r.length-e.GetDistance()) > 1e-4)
+			mismatches++;
+	}
+	fprintf(stderr, "%s: %d queries in %1.3fs (%1.0f nodes/s)\n", scenario, scen.GetNumExperiments(),
+			elapsed, totalExpanded/elapsed);
+	return true;
+}
+
+void Usage(const char *name)
+{
+	printf("Usage: %s [options] <astar|jps|canonical> <scenario>...\n", name);
+	printf("  -threads <n>   number of search threads (default: hardware threads)\n");
+	printf("  -maps <dir>    directory containing the maps\n");
+	printf("  -w <weight>    weight on the heuristic (default 1)\n");
+	printf("  -o <file>      write the CSV to file instead of stdout\n");
+}
+
+int main(int argc, char* argv[])
+{
+	RunOptions opt;
+	opt.weight = 1;
+	opt.numThreads = std::max(1u, std::thread::hardware_concurrency());
+	const char *outFile = 0;
+	std::vector<const char *> scenarios;
+	for (int x = 1; x < argc; x++)
+	{
+		bool hasValue = (x+1 < argc);
+		if (strcmp(argv[x], "-threads") == 0 && hasValue)
+			opt.numThreads = std::max(1, atoi(argv[++x]));
+		else if (strcmp(argv[x], "-maps") == 0 && hasValue)
+			opt.mapDirectory = argv[++x];
+		else if (strcmp(argv[x], "-w") == 0 && hasValue)
+			opt.weight = atof(argv[++x]);
+		else if (strcmp(argv[x], "-o") == 0 && hasValue)
+			outFile = argv[++x];
+		else if (argv[x][0] == '-')
+		{
+			Usage(argv[0]);
+			exit(1);
+		}
+		else if (opt.algorithm.size() == 0)
+			opt.algorithm = argv[x];
+		else
+			scenarios.push_back(argv[x]);
+	}
+	if (scenarios.size() == 0)
+	{
+		Usage(argv[0]);
+		exit(1);
+	}
+
+	FILE *out = stdout;
+	if (outFile && (out = fopen(outFile, "w")) == 0)
+	{
+		perror("Could not open output file");
+		exit(1);
+	}
+	fprintf(out, "scenario,map,query,bucket,sx,sy,gx,gy,algorithm,expanded,touched,time,length,optimal\n");
+	int mismatches = 0, failures = 0;
+	Timer t;
+	t.StartTimer();
+	for (const char *s : scenarios)
+	{
+		if (!RunScenario(s, opt, out, mismatches))
+			failures++;
+	}
+	if (out != stdout)
+		fclose(out);
+	fprintf(stderr, "%d scenarios in %1.2fs with %d threads", (int)scenarios.size(), t.EndTimer(), opt.numThreads);
+	if (mismatches > 0)
+		fprintf(stderr, "; %d paths differ from the scenario distance", mismatches);
+	fprintf(stderr, "\n");
+	return (failures > 0)?1:0;
+}
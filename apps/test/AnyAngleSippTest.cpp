@@ -0,0 +1,100 @@
+//
+//  AnyAngleSippTest.cpp
+//  hog2
+//
+
+#include "AnyAngleSippTest.h"
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include "Map.h"
+#include "GridStates.h"
+#include "AnyAngleSipp.h"
+#include "Timer.h"
+
+static Map *OpenMap(int mapSize)
+{
+	char header[100];
+	sprintf(header, "type octile\nheight %d\nwidth %d\nmap\n", mapSize, mapSize);
+	std::string text(header);
+	for (int y = 0; y < mapSize; y++)
+		text += std::string(mapSize, '.')+"\n";
+	FILE *f = tmpfile();
+	fputs(text.c_str(), f);
+	rewind(f);
+	Map *m = new Map(f);
+	fclose(f);
+	return m;
+}
+
+// A few straight sections between random points, at unit speed
+static void RandomTrajectory(int mapSize, std::vector<AANode> &path)
+{
+	path.resize(0);
+	path.push_back(AANode(random()%mapSize, random()%mapSize));
+	for (int x = 0; x < 3; x++)
+	{
+		AANode next(random()%mapSize, random()%mapSize);
+		next.g = path.back().g+Util::distance(path.back().x, path.back().y, next.x, next.y);
+		path.push_back(next);
+	}
+}
+
+/*
+ * Before each query one obstacle trajectory changes. The store is either
+ * rebuilt from all of the trajectories (what a planner that can't remove
+ * constraints has to do) or updated with the changed trajectory.
+ */
+void AnyAngleSippTest(int mapSize, int numObstacles, int replans)
+{
+	Map *m = OpenMap(mapSize);
+	srandom(1234);
+	std::vector<std::vector<AANode>> obstacles(numObstacles);
+	for (auto &o : obstacles)
+		RandomTrajectory(mapSize, o);
+	std::vector<int> which(replans);
+	std::vector<std::vector<AANode>> changed(replans);
+	std::vector<AANode> starts, goals;
+	for (int r = 0; r < replans; r++)
+	{
+		which[r] = random()%numObstacles;
+		RandomTrajectory(mapSize, changed[r]);
+		starts.push_back(AANode(random()%mapSize, random()%mapSize));
+		goals.push_back(AANode(random()%mapSize, random()%mapSize));
+	}
+
+	for (int incremental = 0; incremental < 2; incremental++)
+	{
+		std::vector<std::vector<AANode>> current(obstacles);
+		AnyAngleSipp<Map, AANode> sipp(1, false);
+		for (int x = 0; x < numObstacles; x++)
+			sipp.AddTrajectory(x, current[x]);
+		Timer t;
+		double update = 0, search = 0, length = 0;
+		std::vector<AANode> path;
+		for (int r = 0; r < replans; r++)
+		{
+			current[which[r]] = changed[r];
+			t.StartTimer();
+			if (incremental)
+			{
+				sipp.AddTrajectory(which[r], current[which[r]]);
+			}
+			else {
+				sipp.ClearTrajectories();
+				for (int x = 0; x < numObstacles; x++)
+					sipp.AddTrajectory(x, current[x]);
+			}
+			update += t.EndTimer();
+			t.StartTimer();
+			path.clear();
+			sipp.GetPath(path, starts[r], goals[r], *m);
+			search += t.EndTimer();
+			if (path.size() > 0)
+				length += path.back().g;
+		}
+		printf("%s: %d obstacles, %d queries: updates %1.4fs, searches %1.4fs, total path length %1.2f\n",
+			   incremental?"incremental":"rebuilt", numObstacles, replans, update, search, length);
+	}
+	delete m;
+}
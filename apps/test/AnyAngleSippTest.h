@@ -0,0 +1,15 @@
+//
+//  AnyAngleSippTest.h
+//  hog2
+//
+//  Replans AnyAngleSipp queries among moving obstacles, updating one
+//  obstacle trajectory between queries.
+//
+
+#ifndef AnyAngleSippTest_h
+#define AnyAngleSippTest_h
+
+#include <stdio.h>
+void AnyAngleSippTest(int mapSize, int numObstacles, int replans);
+
+#endif /* AnyAngleSippTest_h */
@@ -0,0 +1,120 @@
+//
+//  BatchRankingTest.cpp
+//  hog2
+//
+
+#include "BatchRankingTest.h"
+#include "MNPuzzle.h"
+#include "PermutationPDB.h"
+#include "MR1Permutation.h"
+#include "Timer.h"
+
+static void LexBatchTest(int numStates, std::vector<int> pattern)
+{
+	MNPuzzle mnp(4, 4);
+	MNPuzzleState goal(4, 4);
+	PermutationPDB<MNPuzzleState, slideDir, MNPuzzle> pdb(&mnp, goal, pattern);
+	std::vector<uint64_t> ranks(numStates), batchRanks(numStates);
+	std::vector<MNPuzzleState> states(numStates, goal), batchStates(numStates, goal);
+	srandom(1234);
+	for (int x = 0; x < numStates; x++)
+		ranks[x] = random()%pdb.GetPDBSize();
+	Timer t;
+	double scalar, batch;
+
+	t.StartTimer();
+	for (int x = 0; x < numStates; x++)
+		pdb.GetStateFromPDBHash(ranks[x], states[x]);
+	scalar = t.EndTimer();
+	t.StartTimer();
+	pdb.GetStatesFromPDBHashes(&ranks[0], &batchStates[0], numStates);
+	batch = t.EndTimer();
+	for (int x = 0; x < numStates; x++)
+		if (!(states[x] == batchStates[x]))
+		{
+			printf("Error: unranking %llu differs\n", ranks[x]);
+			break;
+		}
+	printf("lex k=%d unrank: %1.0f/sec one at a time, %1.0f/sec batched\n", (int)pattern.size(), numStates/scalar, numStates/batch);
+
+	t.StartTimer();
+	for (int x = 0; x < numStates; x++)
+		ranks[x] = pdb.GetPDBHash(states[x]);
+	scalar = t.EndTimer();
+	t.StartTimer();
+	pdb.GetPDBHashes(&states[0], &batchRanks[0], numStates);
+	batch = t.EndTimer();
+	if (ranks != batchRanks)
+		printf("Error: batched ranks differ\n");
+	printf("lex k=%d rank:   %1.0f/sec one at a time, %1.0f/sec batched\n", (int)pattern.size(), numStates/scalar, numStates/batch);
+}
+
+static void MR1BatchTest(int numStates, int k, int N)
+{
+	MR1KPermutation mr1;
+	uint64_t maxRank = 1;
+	for (int x = N; x > N-k; x--)
+		maxRank *= x;
+	std::vector<uint64_t> ranks(numStates), batchRanks(numStates);
+	std::vector<int> items(numStates*N), duals(numStates*N);
+	std::vector<int> batchItems(numStates*N), batchDuals(numStates*N);
+	srandom(1234);
+	for (int x = 0; x < numStates; x++)
+		ranks[x] = random()%maxRank;
+	Timer t;
+	double scalar, batch;
+
+	t.StartTimer();
+	for (int x = 0; x < numStates; x++)
+		mr1.Unrank(ranks[x], &items[x*N], &duals[x*N], k, N);
+	scalar = t.EndTimer();
+	t.StartTimer();
+	mr1.UnrankBatch(&ranks[0], &batchItems[0], &batchDuals[0], k, N, numStates);
+	batch = t.EndTimer();
+	if (items != batchItems)
+		printf("Error: batched MR1 unranking differs\n");
+	printf("MR1 k=%d N=%d unrank: %1.0f/sec one at a time, %1.0f/sec batched\n", k, N, numStates/scalar, numStates/batch);
+
+	// Rank takes the items and their dual
+	for (int x = 0; x < numStates; x++)
+	{
+		for (int y = 0; y < N; y++)
+			duals[x*N+y] = -1;
+		for (int y = 0; y < N; y++)
+			if (items[x*N+y] != -1)
+				duals[x*N+items[x*N+y]] = y;
+	}
+	batchItems = items;
+	batchDuals = duals;
+	t.StartTimer();
+	for (int x = 0; x < numStates; x++)
+		ranks[x] = mr1.Rank(&items[x*N], &duals[x*N], k, N);
+	scalar = t.EndTimer();
+	t.StartTimer();
+	mr1.RankBatch(&batchItems[0], &batchDuals[0], k, N, numStates, &batchRanks[0]);
+	batch = t.EndTimer();
+	if (ranks != batchRanks)
+		printf("Error: batched MR1 ranks differ\n");
+	printf("MR1 k=%d N=%d rank:   %1.0f/sec one at a time, %1.0f/sec batched\n", k, N, numStates/scalar, numStates/batch);
+}
+
+void BatchRankingTest(int numStates)
+{
+#ifdef __AVX2__
+	printf("Batched lex ranking uses AVX2\n");
+#else
+	printf("Batched lex ranking is scalar (build with CPU=AVX2 for AVX2)\n");
+#endif
+	LexBatchTest(numStates, {0, 1, 2, 3, 4, 5, 6});
+	LexBatchTest(numStates, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+	MR1BatchTest(numStates, 7, 12);
+	MR1BatchTest(numStates, 12, 12);
+
+	MNPuzzle mnp(4, 4);
+	MNPuzzleState goal(4, 4);
+	PermutationPDB<MNPuzzleState, slideDir, MNPuzzle> pdb(&mnp, goal, {0, 1, 2, 3, 4, 5});
+	Timer t;
+	t.StartTimer();
+	pdb.BuildPDB(goal, std::thread::hardware_concurrency());
+	printf("Built 15-puzzle PDB {0, 1, 2, 3, 4, 5} in %1.2fs\n", t.EndTimer());
+}
@@ -0,0 +1,14 @@
+//
+//  BatchRankingTest.h
+//  hog2
+//
+//  Compares one-at-a-time and batched permutation ranking and unranking.
+//
+
+#ifndef BatchRankingTest_h
+#define BatchRankingTest_h
+
+#include <stdio.h>
+void BatchRankingTest(int numStates);
+
+#endif /* BatchRankingTest_h */
@@ -0,0 +1,112 @@
+//
+//  CSRGraphTest.cpp
+//  hog2
+//
+
+#include <cmath>
+#include "CSRGraphTest.h"
+#include "Graph.h"
+#include "CSRGraph.h"
+#include "GraphEnvironment.h"
+#include "CSRGraphEnvironment.h"
+#include "TemplateAStar.h"
+#include "Timer.h"
+
+// Scaled straight line distance, so both environments use the same heuristic
+class CSRGraphTestHeuristic : public GraphHeuristic {
+public:
+	CSRGraphTestHeuristic(Graph *graph, CSRGraphEnvironment *e, bool zero)
+	:g(graph), env(e), zero(zero) {}
+	Graph *GetGraph() { return g; }
+	double HCost(const graphState &state1, const graphState &state2) const
+	{ return zero?0:env->HCost(state1, state2); }
+private:
+	Graph *g;
+	CSRGraphEnvironment *env;
+	bool zero;
+};
+
+template <class environment>
+void TimeGraphSearches(const char *name, environment *env, const std::vector<std::pair<graphState, graphState>> &problems,
+					   std::vector<double> &lengths)
+{
+	TemplateAStar<graphState, graphMove, environment> astar;
+	std::vector<graphState> path;
+	Timer t;
+	uint64_t nodes = 0;
+	double total = 0;
+	for (unsigned int x = 0; x < problems.size(); x++)
+	{
+		t.StartTimer();
+		astar.GetPath(env, problems[x].first, problems[x].second, path);
+		total += t.EndTimer();
+		nodes += astar.GetNodesExpanded();
+		double length = (path.size() == 0)?-1:env->GetPathLength(path);
+		if (lengths.size() <= x)
+			lengths.push_back(length);
+		else if (fabs(lengths[x]-length) > 0.0001)
+			printf("Error: problem %d has length %f with %s but %f before\n", x, length, name, lengths[x]);
+	}
+	printf("%-20s %1.4fs %llu nodes %1.0f nodes/sec\n", name, total, nodes, nodes/total);
+}
+
+void CSRGraphTest(const char *grFile, const char *coFile, int numProblems)
+{
+	Timer t;
+	CSRGraph csr;
+	t.StartTimer();
+	if (!csr.LoadDIMACS(grFile, coFile))
+		return;
+	printf("Loaded %u nodes and %llu edges from DIMACS in %1.2fs\n", csr.GetNumNodes(), csr.GetNumEdges(), t.EndTimer());
+	printf("CSRGraph uses %1.1f MB\n", csr.GetMemoryBytes()/1024.0/1024.0);
+
+	t.StartTimer();
+	if (csr.Save("csr-test.graph"))
+	{
+		printf("Saved binary CSRGraph in %1.2fs\n", t.EndTimer());
+		CSRGraph loaded;
+		t.StartTimer();
+		if (loaded.Load("csr-test.graph"))
+			printf("Loaded binary CSRGraph in %1.2fs\n", t.EndTimer());
+		remove("csr-test.graph");
+	}
+
+	// Same node ids and edge order as the CSRGraph
+	t.StartTimer();
+	Graph *g = new Graph();
+	for (uint32_t n = 0; n < csr.GetNumNodes(); n++)
+	{
+		node *nn = new node("");
+		g->AddNode(nn);
+		if (csr.HasCoordinates())
+		{
+			nn->SetLabelF(GraphSearchConstants::kXCoordinate, csr.GetX(n));
+			nn->SetLabelF(GraphSearchConstants::kYCoordinate, csr.GetY(n));
+		}
+	}
+	for (uint32_t n = 0; n < csr.GetNumNodes(); n++)
+		for (uint64_t e = csr.EdgeBegin(n); e < csr.EdgeEnd(n); e++)
+			g->AddEdge(new edge(n, csr.GetTarget(e), csr.GetWeight(e)));
+	printf("Built Graph in %1.2fs\n", t.EndTimer());
+
+	CSRGraphEnvironment ce(&csr);
+	ce.UseCoordinateHeuristic();
+
+	srandom(1234);
+	std::vector<std::pair<graphState, graphState>> problems;
+	for (int x = 0; x < numProblems; x++)
+		problems.push_back({1+random()%(csr.GetNumNodes()-1), 1+random()%(csr.GetNumNodes()-1)});
+
+	for (int zero = 1; zero >= 0; zero--)
+	{
+		CSRGraphTestHeuristic h(g, &ce, zero);
+		GraphEnvironment ge(g, &h);
+		ge.SetDirected(true);
+		CSRGraphEnvironment cenv(&csr, &h);
+		std::vector<double> lengths;
+		printf("-- %s --\n", zero?"Dijkstra":"A*");
+		TimeGraphSearches("GraphEnvironment", &ge, problems, lengths);
+		TimeGraphSearches("CSRGraphEnvironment", &cenv, problems, lengths);
+	}
+	delete g;
+}
@@ -0,0 +1,16 @@
+//
+//  CSRGraphTest.h
+//  hog2
+//
+//  Compares A* and Dijkstra throughput on a DIMACS road map stored as a
+//  Graph and as a CSRGraph.
+//
+
+#ifndef CSRGraphTest_h
+#define CSRGraphTest_h
+
+#include <stdio.h>
+// grFile/coFile are DIMACS graph and coordinate files (as used by apps/roads)
+void CSRGraphTest(const char *grFile, const char *coFile, int numProblems);
+
+#endif /* CSRGraphTest_h */
@@ -0,0 +1,96 @@
+//
+//  ConflictIndexTest.cpp
+//  hog2
+//
+
+#include "ConflictIndexTest.h"
+#include <vector>
+#include <cstdlib>
+#include "GridStates.h"
+#include "ConflictIndex.h"
+#include "Timer.h"
+
+static void RandomPath(int mapSize, int pathLength, std::vector<xytLoc> &path)
+{
+	path.resize(0);
+	path.push_back(xytLoc(random()%mapSize, random()%mapSize, 0.0f));
+	for (int x = 0; x < pathLength; x++)
+	{
+		xytLoc s = path.back();
+		int dx = random()%3-1, dy = random()%3-1;
+		if (s.x+dx >= 0 && s.x+dx < mapSize) s.x += dx;
+		if (s.y+dy >= 0 && s.y+dy < mapSize) s.y += dy;
+		s.t += 1;
+		path.push_back(s);
+	}
+}
+
+// Same test as CBS on unit-time grid paths: do the agents share a
+// location or swap locations at some time step
+static bool Conflicts(const std::vector<xytLoc> &a, const std::vector<xytLoc> &b)
+{
+	size_t len = std::min(a.size(), b.size());
+	for (size_t x = 0; x < len; x++)
+	{
+		if (a[x].x == b[x].x && a[x].y == b[x].y)
+			return true;
+		if (x+1 < len && a[x].x == b[x+1].x && a[x].y == b[x+1].y &&
+			a[x+1].x == b[x].x && a[x+1].y == b[x].y)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * Simulates the conflict checks in a CBS search: the agents' paths are
+ * checked, then one agent is replanned and they are checked again.
+ */
+void ConflictIndexTest(int mapSize, int pathLength, int replans)
+{
+	for (int numAgents = 50; numAgents <= 400; numAgents *= 2)
+	{
+		srandom(1234);
+		std::vector<std::vector<xytLoc>> paths(numAgents);
+		for (auto &p : paths)
+			RandomPath(mapSize, pathLength, p);
+		std::vector<std::vector<xytLoc>> start(paths);
+		std::vector<int> agents(replans);
+		std::vector<std::vector<xytLoc>> newPaths(replans);
+		for (int r = 0; r < replans; r++)
+		{
+			agents[r] = random()%numAgents;
+			RandomPath(mapSize, pathLength, newPaths[r]);
+		}
+		Timer t;
+		uint64_t allConflicts = 0, pairsChecked = 0;
+		t.StartTimer();
+		for (int r = 0; r < replans; r++)
+		{
+			for (int x = 0; x < numAgents; x++)
+				for (int y = x+1; y < numAgents; y++)
+					allConflicts += Conflicts(paths[x], paths[y]);
+			paths[agents[r]] = newPaths[r];
+		}
+		double allPairs = t.EndTimer();
+
+		paths = start;
+		uint64_t indexConflicts = 0;
+		ConflictIndex<xytLoc> index;
+		std::vector<std::pair<unsigned, unsigned>> candidates;
+		t.StartTimer();
+		for (int r = 0; r < replans; r++)
+		{
+			index.Sync(paths);
+			index.GetCandidatePairs(candidates);
+			pairsChecked += candidates.size();
+			for (const auto &c : candidates)
+				indexConflicts += Conflicts(paths[c.first], paths[c.second]);
+			paths[agents[r]] = newPaths[r];
+		}
+		double indexed = t.EndTimer();
+		if (allConflicts != indexConflicts)
+			printf("Error: %llu conflicts checking all pairs, %llu with the index\n", allConflicts, indexConflicts);
+		printf("%d agents: all pairs %1.3fs, index %1.3fs (%1.1f of %d pairs checked)\n", numAgents, allPairs, indexed,
+			   (double)pairsChecked/replans, numAgents*(numAgents-1)/2);
+	}
+}
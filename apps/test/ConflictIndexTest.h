@@ -0,0 +1,15 @@
+//
+//  ConflictIndexTest.h
+//  hog2
+//
+//  Compares checking all pairs of agent paths for conflicts with checking
+//  only the candidate pairs from a ConflictIndex.
+//
+
+#ifndef ConflictIndexTest_h
+#define ConflictIndexTest_h
+
+#include <stdio.h>
+void ConflictIndexTest(int mapSize, int pathLength, int replans);
+
+#endif /* ConflictIndexTest_h */
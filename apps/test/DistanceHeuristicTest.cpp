@@ -0,0 +1,146 @@
+//
+//  DistanceHeuristicTest.cpp
+//  hog2
+//
+
+#include <cmath>
+#include "DistanceHeuristicTest.h"
+#include "Graph.h"
+#include "CSRGraph.h"
+#include "GraphEnvironment.h"
+#include "Map.h"
+#include "TemplateAStar.h"
+#include "Timer.h"
+
+// The max over the pivots one vector at a time, as GraphDistanceHeuristic did
+// before the node-major table
+class PivotMajorHeuristic : public GraphDistanceHeuristic {
+public:
+	PivotMajorHeuristic(Graph *graph) :GraphDistanceHeuristic(graph) {}
+	bool Load(const char *file)
+	{
+		if (!GraphDistanceHeuristic::Load(file))
+			return false;
+		heuristics.assign(GetNumHeuristics(), std::vector<double>(g->GetNumNodes()));
+		for (unsigned int i = 0; i < heuristics.size(); i++)
+			for (graphState n = 0; n < heuristics[i].size(); n++)
+				heuristics[i][n] = Distance(i, n);
+		return true;
+	}
+	double HCost(const graphState &state1, const graphState &state2) const
+	{
+		double val = 0;
+		for (unsigned int i = 0; i < heuristics.size(); i++)
+		{
+			double hval = fabs(heuristics[i][state1]-heuristics[i][state2]);
+			if (hval > val)
+				val = hval;
+		}
+		return val;
+	}
+private:
+	std::vector<std::vector<double> > heuristics;
+};
+
+static void TimeSearches(const char *name, Graph *g, GraphHeuristic *h,
+						 const std::vector<std::pair<graphState, graphState>> &problems, std::vector<uint64_t> &nodes)
+{
+	GraphEnvironment ge(g, h);
+	ge.SetDirected(true);
+	TemplateAStar<graphState, graphMove, GraphEnvironment> astar;
+	std::vector<graphState> path;
+	Timer t;
+	uint64_t total = 0;
+	t.StartTimer();
+	for (unsigned int x = 0; x < problems.size(); x++)
+	{
+		astar.GetPath(&ge, problems[x].first, problems[x].second, path);
+		total += astar.GetNodesExpanded();
+		if (nodes.size() <= x)
+			nodes.push_back(astar.GetNodesExpanded());
+		else if (nodes[x] != astar.GetNodesExpanded())
+			printf("Error: problem %d expands %llu nodes with %s but %llu before\n", x,
+				   (unsigned long long)astar.GetNodesExpanded(), name, (unsigned long long)nodes[x]);
+	}
+	printf("%-12s A*: %1.3fs %llu nodes\n", name, t.EndTimer(), (unsigned long long)total);
+}
+
+static void DistanceHeuristicTest(Graph *g, int numPivots, int numThreads, int numProblems)
+{
+	Timer t;
+	srandom(1234);
+	std::vector<graphState> pivots;
+	for (int x = 0; x < numPivots; x++)
+		pivots.push_back(random()%g->GetNumNodes());
+
+	GraphDistanceHeuristic serial(g);
+	t.StartTimer();
+	serial.AddHeuristics(pivots, 1);
+	printf("%d pivots, 1 thread: %1.3fs\n", numPivots, t.EndTimer());
+	GraphDistanceHeuristic h(g);
+	t.StartTimer();
+	h.AddHeuristics(pivots, numThreads);
+	printf("%d pivots, %d threads: %1.3fs\n", numPivots, numThreads, t.EndTimer());
+
+	// the saved heuristic loads into the pivot-major lookup
+	t.StartTimer();
+	if (!h.Save("dh-test.dat"))
+		return;
+	printf("Saved in %1.3fs\n", t.EndTimer());
+	PivotMajorHeuristic p(g);
+	t.StartTimer();
+	if (!p.Load("dh-test.dat"))
+		return;
+	printf("Loaded in %1.3fs\n", t.EndTimer());
+	remove("dh-test.dat");
+
+	std::vector<std::pair<graphState, graphState>> pairs;
+	for (int x = 0; x < 2000000; x++)
+		pairs.push_back({random()%g->GetNumNodes(), random()%g->GetNumNodes()});
+	double sums[3] = {0, 0, 0};
+	int differ = 0;
+	t.StartTimer();
+	for (auto &pair : pairs)
+		sums[0] += p.HCost(pair.first, pair.second);
+	printf("pivot-major  HCost: %1.3fs\n", t.EndTimer());
+	t.StartTimer();
+	for (auto &pair : pairs)
+		sums[1] += h.HCost(pair.first, pair.second);
+	printf("node-major   HCost: %1.3fs\n", t.EndTimer());
+	for (auto &pair : pairs)
+		differ += (h.HCost(pair.first, pair.second) != p.HCost(pair.first, pair.second)) ||
+			(serial.HCost(pair.first, pair.second) != p.HCost(pair.first, pair.second));
+	printf("%d of %d lookups differ (sums %1.1f and %1.1f)\n", differ, (int)pairs.size(), sums[0], sums[1]);
+
+	std::vector<std::pair<graphState, graphState>> problems(pairs.begin(), pairs.begin()+numProblems);
+	std::vector<uint64_t> nodes;
+	TimeSearches("pivot-major", g, &p, problems, nodes);
+	TimeSearches("node-major", g, &h, problems, nodes);
+}
+
+void DistanceHeuristicGridTest(const char *mapFile, int numPivots, int numThreads, int numProblems)
+{
+	Map *m = new Map(mapFile);
+	Graph *g = GraphSearchConstants::GetGraph(m);
+	printf("%s: %d nodes, %d edges\n", mapFile, g->GetNumNodes(), g->GetNumEdges());
+	DistanceHeuristicTest(g, numPivots, numThreads, numProblems);
+	delete g;
+	delete m;
+}
+
+void DistanceHeuristicRoadTest(const char *grFile, const char *coFile, int numPivots, int numThreads, int numProblems)
+{
+	CSRGraph csr;
+	if (!csr.LoadDIMACS(grFile, coFile))
+		return;
+	// Same node ids as the DIMACS file; node 0 is unused
+	Graph *g = new Graph();
+	for (uint32_t n = 0; n < csr.GetNumNodes(); n++)
+		g->AddNode(new node(""));
+	for (uint32_t n = 0; n < csr.GetNumNodes(); n++)
+		for (uint64_t e = csr.EdgeBegin(n); e < csr.EdgeEnd(n); e++)
+			g->AddEdge(new edge(n, csr.GetTarget(e), csr.GetWeight(e)));
+	printf("%s: %d nodes, %d edges\n", grFile, g->GetNumNodes(), g->GetNumEdges());
+	DistanceHeuristicTest(g, numPivots, numThreads, numProblems);
+	delete g;
+}
@@ -0,0 +1,20 @@
+//
+//  DistanceHeuristicTest.h
+//  hog2
+//
+//  Differential heuristic lookups from the node-major distance table against
+//  the max over the per-pivot distance vectors, on a grid map or a DIMACS
+//  road map.
+//
+
+#ifndef DistanceHeuristicTest_h
+#define DistanceHeuristicTest_h
+
+#include <stdio.h>
+// Builds numPivots random pivots on numThreads threads, then times HCost
+// and numProblems A* searches with both lookups
+void DistanceHeuristicGridTest(const char *mapFile, int numPivots, int numThreads, int numProblems);
+// grFile/coFile are DIMACS graph and coordinate files (as used by apps/roads)
+void DistanceHeuristicRoadTest(const char *grFile, const char *coFile, int numPivots, int numThreads, int numProblems);
+
+#endif /* DistanceHeuristicTest_h */
@@ -1,9 +1,46 @@
 #include "NBitVectorTest.h"
 #include "PDBRankingTest.h"
+#include "MapSuccessorTest.h"
+#include "OpenClosedTest.h"
+#include "CSRGraphTest.h"
+#include "IncrementalPDBTest.h"
+#include "BatchRankingTest.h"
+#include "ConflictIndexTest.h"
+#include "ParetoFrontTest.h"
+#include "AnyAngleSippTest.h"
+#include "LearningTableTest.h"
+#include "HPAPreprocessTest.h"
+#include "SuccessorBatchTest.h"
+#include "RubikMoveTest.h"
+#include "ExternalDDTest.h"
+#include "DistanceHeuristicTest.h"
+#include "VoxelTest.h"
+#include "FrontierBFSTest.h"
+#include "PackedTOHTest.h"
 
 int main(void)
 {
 	//TestNBitVector();
 
 	PDBRankingTest();
+	//MapSuccessorTest("../../benchmarks/scen-even/Berlin_1_256-even-1.scen", "../../benchmarks/maps");
+	//OpenClosedGridTest("../../benchmarks/scen-random/den520d-random-1.scen", "../../benchmarks/maps");
+	//OpenClosedSTPTest(100, 80);
+	//CSRGraphTest("USA-road-d.NY.gr", "USA-road-d.NY.co", 100);
+	//IncrementalPDBTest(100, 100);
+	//BatchRankingTest(1000000);
+	//ConflictIndexTest(64, 100, 200);
+	//ParetoFrontTest(100000, 128);
+	//AnyAngleSippTest(128, 300, 200);
+	//LearningTableTest("../../benchmarks/scen-random/den520d-random-1.scen", "../../benchmarks/maps", 10);
+	//HPAPreprocessTest("../../benchmarks/scen-random/den520d-random-1.scen", "../../benchmarks/maps", 10, 4, "/tmp", 100);
+	//SuccessorBatchGridTest("../../benchmarks/scen-even/Berlin_1_256-even-1.scen", "../../benchmarks/maps");
+	//SuccessorBatchPuzzleTest(50, 150, 7);
+	//RubikMoveTest(10000000, 5, 12);
+	//ExternalDDTest("/tmp", 6, 4);
+	//DistanceHeuristicGridTest("../../benchmarks/maps/den520d.map", 16, 4, 100);
+	//DistanceHeuristicRoadTest("USA-road-d.NY.gr", "USA-road-d.NY.co", 16, 4, 100);
+	//VoxelTest("/tmp/voxel-test.3dnav", 256, 20);
+	//FrontierBFSTest(11, 12, 4, 50000000);
+	//PackedTOHTest(5, 4);
 }
\ No newline at end of file
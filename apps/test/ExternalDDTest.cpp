@@ -0,0 +1,209 @@
+//
+//  ExternalDDTest.cpp
+//  hog2
+//
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include "ExternalDDTest.h"
+#include "ExternalSort.h"
+#include "RubiksCube.h"
+#include "Timer.h"
+
+// the states of a layer are split into 32 buckets on the low bits of the edge rank (as in MM)
+const int kBucketBits = 5;
+const int kBuckets = 1<<kBucketBits;
+
+static void GetBucketAndData(const RubiksState &s, int &bucket, uint64_t &data)
+{
+	uint64_t ehash = RubikEdgePDB::GetStateHash(s.edge);
+	bucket = (int)(ehash&(kBuckets-1));
+	data = (ehash>>kBucketBits)*RubikCornerPDB::GetStateSpaceSize()+RubikCornerPDB::GetStateHash(s.corner);
+}
+
+static void GetState(RubiksState &s, int bucket, uint64_t data)
+{
+	RubikCornerPDB::GetStateFromHash(s.corner, data%RubikCornerPDB::GetStateSpaceSize());
+	RubikEdgePDB::GetStateFromHash(s.edge, bucket|((data/RubikCornerPDB::GetStateSpaceSize())<<kBucketBits));
+}
+
+static std::string FileName(const char *directory, const char *kind, int depth, int bucket)
+{
+	return std::string(directory)+"/dd-"+kind+"-"+std::to_string(depth)+"-"+std::to_string(bucket);
+}
+
+// Writes the successors of the states of one bucket to the open files of the next layer
+template <typename container>
+static void Expand(const container &states, int bucket, std::vector<FILE *> &next)
+{
+	RubiksCube cube;
+	std::vector<std::vector<uint64_t>> cache(kBuckets);
+	RubiksState s;
+	for (uint64_t data : states)
+	{
+		for (int a = 0; a < 18; a++)
+		{
+			GetState(s, bucket, data);
+			cube.ApplyAction(s, a);
+			int b;
+			uint64_t d;
+			GetBucketAndData(s, b, d);
+			cache[b].push_back(d);
+			if (cache[b].size() == 4096)
+			{
+				fwrite(cache[b].data(), sizeof(uint64_t), cache[b].size(), next[b]);
+				cache[b].clear();
+			}
+		}
+	}
+	for (int b = 0; b < kBuckets; b++)
+		fwrite(cache[b].data(), sizeof(uint64_t), cache[b].size(), next[b]);
+}
+
+// Opens the files of one layer; all of them are removed at the end of the search
+static void OpenLayer(const char *directory, const char *kind, int depth, std::vector<FILE *> &files)
+{
+	files.resize(kBuckets);
+	for (int b = 0; b < kBuckets; b++)
+	{
+		files[b] = fopen(FileName(directory, kind, depth, b).c_str(), "w+b");
+		if (files[b] == 0)
+		{
+			printf("Error opening %s\n", FileName(directory, kind, depth, b).c_str());
+			perror("Reason: ");
+			exit(0);
+		}
+	}
+}
+
+static void RemoveLayers(const char *directory, const char *kind, int maxDepth)
+{
+	for (int depth = 0; depth <= maxDepth+1; depth++)
+		for (int b = 0; b < kBuckets; b++)
+			remove(FileName(directory, kind, depth, b).c_str());
+}
+
+// Duplicate detection with a hash set of the bucket, probed with the closed
+// lists of the two previous layers (as MM and MM0 did)
+static void HashSearch(const char *directory, int maxDepth, std::vector<uint64_t> &layers, double &ddTime, double &expandTime)
+{
+	std::vector<std::vector<FILE *>> open(maxDepth+2), closed(maxDepth+1);
+	OpenLayer(directory, "open", 0, open[0]);
+	int bucket;
+	uint64_t data;
+	GetBucketAndData(RubiksState(), bucket, data);
+	fwrite(&data, sizeof(data), 1, open[0][bucket]);
+	Timer t;
+	ddTime = expandTime = 0;
+	for (int depth = 0; depth <= maxDepth; depth++)
+	{
+		OpenLayer(directory, "closed", depth, closed[depth]);
+		if (depth < maxDepth)
+			OpenLayer(directory, "open", depth+1, open[depth+1]);
+		layers.push_back(0);
+		for (int b = 0; b < kBuckets; b++)
+		{
+			t.StartTimer();
+			std::unordered_set<uint64_t> states;
+			const size_t bufferSize = 1024;
+			uint64_t buffer[bufferSize];
+			size_t numRead;
+			rewind(open[depth][b]);
+			do {
+				numRead = fread(buffer, sizeof(uint64_t), bufferSize, open[depth][b]);
+				states.insert(buffer, buffer+numRead);
+			} while (numRead == bufferSize);
+			for (int prev = std::max(0, depth-2); prev < depth; prev++)
+			{
+				rewind(closed[prev][b]);
+				do {
+					numRead = fread(buffer, sizeof(uint64_t), bufferSize, closed[prev][b]);
+					for (size_t x = 0; x < numRead; x++)
+						states.erase(buffer[x]);
+				} while (numRead == bufferSize);
+			}
+			for (uint64_t s : states)
+				fwrite(&s, sizeof(s), 1, closed[depth][b]);
+			ddTime += t.EndTimer();
+			layers.back() += states.size();
+
+			t.StartTimer();
+			if (depth < maxDepth)
+				Expand(states, b, open[depth+1]);
+			expandTime += t.EndTimer();
+		}
+	}
+	for (auto &l : open)
+		for (FILE *f : l)
+			fclose(f);
+	for (auto &l : closed)
+		for (FILE *f : l)
+			fclose(f);
+	RemoveLayers(directory, "open", maxDepth);
+	RemoveLayers(directory, "closed", maxDepth);
+}
+
+// Duplicate detection by sorting the bucket and merging it with the sorted
+// closed runs of the two previous layers
+static void SortSearch(const char *directory, int maxDepth, int numThreads, std::vector<uint64_t> &layers, double &ddTime, double &expandTime)
+{
+	WorkerPool pool(numThreads);
+	std::vector<std::vector<FILE *>> open(maxDepth+2);
+	std::vector<std::vector<SortedRunFile>> closed(maxDepth+1);
+	OpenLayer(directory, "open", 0, open[0]);
+	int bucket;
+	uint64_t data;
+	GetBucketAndData(RubiksState(), bucket, data);
+	fwrite(&data, sizeof(data), 1, open[0][bucket]);
+	Timer t;
+	ddTime = expandTime = 0;
+	std::vector<uint64_t> states;
+	for (int depth = 0; depth <= maxDepth; depth++)
+	{
+		closed[depth] = std::vector<SortedRunFile>(kBuckets);
+		for (int b = 0; b < kBuckets; b++)
+			closed[depth][b].Open(FileName(directory, "closed", depth, b));
+		if (depth < maxDepth)
+			OpenLayer(directory, "open", depth+1, open[depth+1]);
+		layers.push_back(0);
+		for (int b = 0; b < kBuckets; b++)
+		{
+			t.StartTimer();
+			states.clear();
+			rewind(open[depth][b]);
+			ReadValues(open[depth][b], states);
+			SortAndUnique(states, &pool);
+			for (int prev = std::max(0, depth-2); prev < depth; prev++)
+				closed[prev][b].Subtract(states);
+			closed[depth][b].AddRun(states);
+			ddTime += t.EndTimer();
+			layers.back() += states.size();
+
+			t.StartTimer();
+			if (depth < maxDepth)
+				Expand(states, b, open[depth+1]);
+			expandTime += t.EndTimer();
+		}
+	}
+	for (auto &l : open)
+		for (FILE *f : l)
+			fclose(f);
+	closed.clear();
+	RemoveLayers(directory, "open", maxDepth);
+	RemoveLayers(directory, "closed", maxDepth);
+}
+
+void ExternalDDTest(const char *directory, int maxDepth, int numThreads)
+{
+	std::vector<uint64_t> hashLayers, sortLayers;
+	double hashDD, hashExpand, sortDD, sortExpand;
+	HashSearch(directory, maxDepth, hashLayers, hashDD, hashExpand);
+	SortSearch(directory, maxDepth, numThreads, sortLayers, sortDD, sortExpand);
+	for (int depth = 0; depth <= maxDepth; depth++)
+		printf("depth %d: %llu states (hash), %llu states (sort)\n", depth,
+			   (unsigned long long)hashLayers[depth], (unsigned long long)sortLayers[depth]);
+	printf("hash set: %1.3fs duplicate detection, %1.3fs expansion\n", hashDD, hashExpand);
+	printf("sort/merge (%d threads): %1.3fs duplicate detection, %1.3fs expansion\n", numThreads, sortDD, sortExpand);
+	printf("%s\n", (hashLayers == sortLayers)?"same layers":"DIFFERENT LAYERS");
+}
@@ -0,0 +1,18 @@
+//
+//  ExternalDDTest.h
+//  hog2
+//
+//  Duplicate detection for external-memory search: hash sets against sorted
+//  buckets merged with sorted closed runs, in a bucketed breadth-first search
+//  of the Rubik's cube.
+//
+
+#ifndef ExternalDDTest_h
+#define ExternalDDTest_h
+
+#include <stdio.h>
+// Searches to maxDepth twice, keeping the bucket files in directory; the
+// sorts use numThreads threads
+void ExternalDDTest(const char *directory, int maxDepth, int numThreads);
+
+#endif /* ExternalDDTest_h */
@@ -0,0 +1,54 @@
+//
+//  FrontierBFSTest.cpp
+//  hog2
+//
+
+#include "FrontierBFSTest.h"
+#include "FrontierBFS.h"
+#include "ParallelFrontierBFS.h"
+#include "PancakePuzzle.h"
+#include "TopSpin.h"
+#include "TOH.h"
+#include "Timer.h"
+
+template <class state, class action, class environment>
+static void CompareBFS(const char *name, environment *env, state &start, int numThreads, uint64_t hashLimit)
+{
+	printf("---- %s: %llu ranks ----\n", name, (unsigned long long)env->GetMaxHash());
+	Timer t;
+	ParallelFrontierBFS<state, action, environment> parallel;
+	t.StartTimer();
+	parallel.DoBFS(env, start, numThreads);
+	double parallelTime = t.EndTimer();
+
+	if (env->GetMaxHash() > hashLimit)
+	{
+		printf("%s: two-bit %1.2fs (%d threads), %llu states; hashed skipped\n", name, parallelTime, numThreads,
+			   (unsigned long long)parallel.GetNumReached());
+		return;
+	}
+	FrontierBFS<state, action> hashed;
+	std::vector<state> path;
+	// the per-layer output of the hashed search goes to stdout
+	t.StartTimer();
+	hashed.GetPath(env, start, start, path);
+	double hashedTime = t.EndTimer();
+	printf("%s: two-bit %1.2fs (%d threads), hashed %1.2fs; %llu and %llu expansions\n", name, parallelTime,
+		   numThreads, hashedTime, (unsigned long long)parallel.GetNodesExpanded(),
+		   (unsigned long long)hashed.GetNodesExpanded());
+}
+
+void FrontierBFSTest(int pancakes, int topSpinTiles, int numThreads, uint64_t hashLimit)
+{
+	PancakePuzzle pancake(pancakes);
+	PancakePuzzleState pancakeStart(pancakes);
+	CompareBFS<PancakePuzzleState, PancakePuzzleAction>("pancake", &pancake, pancakeStart, numThreads, hashLimit);
+
+	TOH<12> toh;
+	TOHState<12> tohStart;
+	CompareBFS<TOHState<12>, TOHMove>("TOH", &toh, tohStart, numThreads, hashLimit);
+
+	TopSpin topspin(topSpinTiles, 4);
+	TopSpinState topspinStart(topSpinTiles, 4);
+	CompareBFS<TopSpinState, TopSpinAction>("TopSpin", &topspin, topspinStart, numThreads, hashLimit);
+}
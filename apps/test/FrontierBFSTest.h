@@ -0,0 +1,19 @@
+//
+//  FrontierBFSTest.h
+//  hog2
+//
+//  Brute-force state space sizes with the hashed FrontierBFS and the
+//  two-bit ParallelFrontierBFS.
+//
+
+#ifndef FrontierBFSTest_h
+#define FrontierBFSTest_h
+
+#include <stdio.h>
+#include <stdint.h>
+// Enumerates the pancake puzzle with pancakes pancakes, 4-peg TOH with 12
+// disks and TopSpin with topSpinTiles tiles; the hashed search is skipped
+// on spaces larger than hashLimit states
+void FrontierBFSTest(int pancakes, int topSpinTiles, int numThreads, uint64_t hashLimit);
+
+#endif /* FrontierBFSTest_h */
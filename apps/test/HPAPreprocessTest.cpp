@@ -0,0 +1,112 @@
+//
+//  HPAPreprocessTest.cpp
+//  hog2
+//
+
+#include <string>
+#include "HPAPreprocessTest.h"
+#include "ClusterAbstraction.h"
+#include "HPAStar.h"
+#include "ScenarioLoader.h"
+#include "Timer.h"
+
+using namespace GraphAbstractionConstants;
+
+// Compares the nodes, parents, edges and cached edge paths of two abstractions
+static bool SameAbstraction(ClusterAbstraction *a, ClusterAbstraction *b)
+{
+	if (a->getNumAbstractGraphs() != b->getNumAbstractGraphs())
+		return false;
+	for (unsigned int level = 0; level < a->getNumAbstractGraphs(); level++)
+	{
+		Graph *ga = a->GetAbstractGraph(level), *gb = b->GetAbstractGraph(level);
+		if (ga->GetNumNodes() != gb->GetNumNodes() || ga->GetNumEdges() != gb->GetNumEdges())
+			return false;
+		for (int x = 0; x < ga->GetNumNodes(); x++)
+			if (ga->GetNode(x)->GetLabelL(kParent) != gb->GetNode(x)->GetLabelL(kParent))
+				return false;
+		edge_iterator ea = ga->getEdgeIter(), eb = gb->getEdgeIter();
+		for (edge *e1 = ga->edgeIterNext(ea), *e2 = gb->edgeIterNext(eb); e1 && e2;
+			 e1 = ga->edgeIterNext(ea), e2 = gb->edgeIterNext(eb))
+		{
+			if (e1->getFrom() != e2->getFrom() || e1->getTo() != e2->getTo() || e1->GetWeight() != e2->GetWeight())
+				return false;
+			if (level != 1)
+				continue;
+			path *p1 = a->getCachedPath(e1), *p2 = b->getCachedPath(e2);
+			bool same = (p1 != 0) == (p2 != 0);
+			for (path *t1 = p1, *t2 = p2; same && (t1 || t2); t1 = t1->next, t2 = t2->next)
+				same = t1 && t2 && t1->n->GetNum() == t2->n->GetNum();
+			delete p1;
+			delete p2;
+			if (!same)
+				return false;
+		}
+	}
+	return true;
+}
+
+// Solves the last numProblems problems of the scenario; returns the total path length
+static double SolveProblems(ClusterAbstraction *abs, ScenarioLoader &s, int numProblems)
+{
+	hpaStar hpa;
+	hpa.setAbstraction(abs);
+	double total = 0;
+	for (int x = std::max(0, s.GetNumExperiments()-numProblems); x < s.GetNumExperiments(); x++)
+	{
+		Experiment e = s.GetNthExperiment(x);
+		node *from = abs->GetNodeFromMap(e.GetStartX(), e.GetStartY());
+		node *to = abs->GetNodeFromMap(e.GetGoalX(), e.GetGoalY());
+		path *p = hpa.GetPath(abs, from, to);
+		total += abs->distance(p);
+		delete p;
+	}
+	return total;
+}
+
+void HPAPreprocessTest(const char *scenario, const char *mapDirectory, int clusterSize, int numThreads, const char *cacheDirectory, int numProblems)
+{
+	ScenarioLoader s(scenario);
+	if (s.GetNumExperiments() == 0)
+	{
+		printf("No experiments in '%s'\n", scenario);
+		return;
+	}
+	std::string mapName = std::string(mapDirectory)+"/"+s.GetNthExperiment(0).GetMapName();
+	Map *m = new Map(mapName.c_str());
+	printf("%s: %dx%d, clusters of %d\n", mapName.c_str(), (int)m->GetMapWidth(), (int)m->GetMapHeight(), clusterSize);
+	Timer t;
+
+	t.StartTimer();
+	ClusterAbstraction *serial = new ClusterAbstraction(m->Clone(), clusterSize, 0, 1);
+	printf("1 thread: %1.3fs, %d abstract nodes, %d abstract edges\n", t.EndTimer(),
+		   serial->GetAbstractGraph(1)->GetNumNodes(), serial->GetAbstractGraph(1)->GetNumEdges());
+
+	t.StartTimer();
+	ClusterAbstraction *parallel = new ClusterAbstraction(m->Clone(), clusterSize, 0, numThreads);
+	printf("%d threads: %1.3fs, %s\n", numThreads, t.EndTimer(), SameAbstraction(serial, parallel)?"same":"DIFFERENT");
+
+	// the first build writes the cache (unless it is there already), the second reads it
+	t.StartTimer();
+	ClusterAbstraction *saved = new ClusterAbstraction(m->Clone(), clusterSize, cacheDirectory, numThreads);
+	printf("%s cache: %1.3fs\n", saved->loadedFromCache()?"read":"wrote", t.EndTimer());
+	t.StartTimer();
+	ClusterAbstraction *cached = new ClusterAbstraction(m->Clone(), clusterSize, cacheDirectory, numThreads);
+	double cachedTime = t.EndTimer();
+	printf("from cache: %1.3fs (%s), %s\n", cachedTime, cached->loadedFromCache()?"read":"NOT READ",
+		   SameAbstraction(serial, cached)?"same":"DIFFERENT");
+
+	t.StartTimer();
+	double serialLength = SolveProblems(serial, s, numProblems);
+	double serialTime = t.EndTimer();
+	t.StartTimer();
+	double cachedLength = SolveProblems(cached, s, numProblems);
+	printf("%d problems: %1.3fs (total length %1.2f), from cache %1.3fs (total length %1.2f)\n", numProblems,
+		   serialTime, serialLength, t.EndTimer(), cachedLength);
+
+	delete serial;
+	delete parallel;
+	delete saved;
+	delete cached;
+	delete m;
+}
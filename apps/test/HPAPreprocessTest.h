@@ -0,0 +1,16 @@
+//
+//  HPAPreprocessTest.h
+//  hog2
+//
+//  Times building the HPA* cluster abstraction of a map on one thread, on
+//  several threads and from the abstraction cache, checks that the three
+//  abstractions are the same and answers scenario problems with each.
+//
+
+#ifndef HPAPreprocessTest_h
+#define HPAPreprocessTest_h
+
+#include <stdio.h>
+void HPAPreprocessTest(const char *scenario, const char *mapDirectory, int clusterSize, int numThreads, const char *cacheDirectory, int numProblems);
+
+#endif /* HPAPreprocessTest_h */
@@ -0,0 +1,115 @@
+//
+//  IncrementalPDBTest.cpp
+//  hog2
+//
+
+#include "IncrementalPDBTest.h"
+#include "MNPuzzle.h"
+#include "FixedMNPuzzle.h"
+#include "PermutationPDB.h"
+#include "IncrementalTilePDB.h"
+#include "IDAStar.h"
+#include "ParallelIDAStar.h"
+#include "Timer.h"
+
+typedef FixedMNPuzzleState<4, 4> stpState;
+typedef PermutationPDB<MNPuzzleState, slideDir, MNPuzzle> stpPDB;
+
+void IncrementalPDBTest(int numProblems, int walkLength)
+{
+	MNPuzzle mnp(4, 4);
+	FixedMNPuzzle<4, 4> fixed;
+	MNPuzzleState goal(4, 4);
+	std::vector<std::vector<int>> patterns = {{0, 1, 2, 3, 4, 5}, {0, 6, 7, 8, 9, 10}, {0, 11, 12, 13, 14, 15}};
+	std::vector<stpPDB*> pdbs;
+	Heuristic<MNPuzzleState> h;
+	IncrementalTilePDB<4, 4> inc;
+	h.lookups.push_back({kMaxNode, 1, (unsigned int)patterns.size()});
+	for (unsigned int x = 0; x < patterns.size(); x++)
+	{
+		pdbs.push_back(new stpPDB(&mnp, goal, patterns[x]));
+		pdbs.back()->BuildPDB(goal, std::thread::hardware_concurrency());
+		h.lookups.push_back({kLeafNode, x, 0});
+		h.heuristics.push_back(pdbs.back());
+		inc.AddPDB(pdbs.back());
+	}
+
+	std::vector<stpState> problems;
+	std::vector<slideDir> acts;
+	srandom(1234);
+	for (int x = 0; x < numProblems; x++)
+	{
+		stpState s;
+		for (int y = 0; y < walkLength; y++)
+		{
+			fixed.GetActions(s, acts);
+			fixed.ApplyAction(s, acts[random()%acts.size()]);
+		}
+		problems.push_back(s);
+	}
+
+	Timer t;
+	std::vector<slideDir> path;
+	std::vector<size_t> lengths;
+	uint64_t nodes;
+	double total;
+
+	IDAStar<MNPuzzleState, slideDir, MNPuzzle> ida1;
+	ida1.SetHeuristic(&h);
+	nodes = 0; total = 0;
+	for (int x = 0; x < numProblems; x++)
+	{
+		t.StartTimer();
+		ida1.GetPath(&mnp, problems[x].GetMNPuzzleState(), goal, path);
+		total += t.EndTimer();
+		nodes += ida1.GetNodesExpanded();
+		lengths.push_back(path.size());
+	}
+	printf("%-35s %1.4fs %llu nodes %1.0f nodes/sec\n", "MNPuzzle, full ranking", total, nodes, nodes/total);
+
+	IDAStar<stpState, slideDir, FixedMNPuzzle<4, 4>> ida2;
+	ida2.SetHeuristic(&inc);
+	nodes = 0; total = 0;
+	for (int x = 0; x < numProblems; x++)
+	{
+		t.StartTimer();
+		ida2.GetPath(&fixed, problems[x], stpState(), path);
+		total += t.EndTimer();
+		nodes += ida2.GetNodesExpanded();
+		if (path.size() != lengths[x])
+			printf("Error: problem %d has length %d, expected %d\n", x, (int)path.size(), (int)lengths[x]);
+	}
+	printf("%-35s %1.4fs %llu nodes %1.0f nodes/sec\n", "FixedMNPuzzle, full ranking", total, nodes, nodes/total);
+
+	IDAStar<stpState, slideDir, FixedMNPuzzle<4, 4>> ida3;
+	ida3.SetIncrementalHeuristic(&inc);
+	nodes = 0; total = 0;
+	for (int x = 0; x < numProblems; x++)
+	{
+		t.StartTimer();
+		ida3.GetPath(&fixed, problems[x], stpState(), path);
+		total += t.EndTimer();
+		nodes += ida3.GetNodesExpanded();
+		if (path.size() != lengths[x])
+			printf("Error: problem %d has length %d, expected %d\n", x, (int)path.size(), (int)lengths[x]);
+	}
+	printf("%-35s %1.4fs %llu nodes %1.0f nodes/sec\n", "FixedMNPuzzle, incremental", total, nodes, nodes/total);
+
+	ParallelIDAStar<FixedMNPuzzle<4, 4>, stpState, slideDir> ida4;
+	ida4.SetIncrementalHeuristic(&inc);
+	ida4.SetVerbose(false);
+	nodes = 0; total = 0;
+	for (int x = 0; x < numProblems; x++)
+	{
+		t.StartTimer();
+		ida4.GetPath(&fixed, problems[x], stpState(), path);
+		total += t.EndTimer();
+		nodes += ida4.GetNodesExpanded();
+		if (path.size() != lengths[x])
+			printf("Error: problem %d has length %d, expected %d\n", x, (int)path.size(), (int)lengths[x]);
+	}
+	printf("%-35s %1.4fs %llu nodes %1.0f nodes/sec\n", "ParallelIDAStar, incremental", total, nodes, nodes/total);
+
+	for (auto p : pdbs)
+		delete p;
+}
@@ -0,0 +1,15 @@
+//
+//  IncrementalPDBTest.h
+//  hog2
+//
+//  Compares IDA* node rates on the 15-puzzle with full PDB ranking and with
+//  incremental ranking on fixed-size states.
+//
+
+#ifndef IncrementalPDBTest_h
+#define IncrementalPDBTest_h
+
+#include <stdio.h>
+void IncrementalPDBTest(int numProblems, int walkLength);
+
+#endif /* IncrementalPDBTest_h */
@@ -0,0 +1,147 @@
+//
+//  LearningTableTest.cpp
+//  hog2
+//
+
+#include <string>
+#include <ext/hash_map>
+#include "LearningTableTest.h"
+#include "Map2DEnvironment.h"
+#include "ScenarioLoader.h"
+#include "LearnedStateTable.h"
+#include "LRTAStar.h"
+#include "LSSLRTAStar.h"
+#include "FLRTAStar.h"
+#include "Timer.h"
+
+/*
+ * Moves the agent from start to goal, as LearningUnit does, until it reaches
+ * the goal. Returns the number of moves.
+ */
+template <class algorithm>
+static uint64_t RunTrial(algorithm &alg, MapEnvironment &me, xyLoc start, xyLoc goal, uint64_t &nodes)
+{
+	std::vector<xyLoc> path;
+	xyLoc current = start;
+	uint64_t moves = 0;
+	// the trial is cut off if the agent is stuck
+	while (!(current == goal) && moves < 1000000)
+	{
+		if (path.size() <= 1)
+		{
+			alg.GetPath(&me, current, goal, path);
+			nodes += alg.GetNodesExpanded();
+			if (path.size() <= 1)
+				break;
+		}
+		current = path[path.size()-2];
+		path.pop_back();
+		moves++;
+	}
+	return moves;
+}
+
+/*
+ * Repeats trials on each problem until the heuristic converges (a trial
+ * learns nothing) or maxTrials is reached.
+ */
+template <class algorithm>
+static void RunTrials(const char *name, MapEnvironment &me, ScenarioLoader &s, int numProblems, int maxTrials)
+{
+	uint64_t trials = 0, moves = 0, nodes = 0;
+	Timer t;
+	t.StartTimer();
+	for (int x = 0; x < numProblems && x < s.GetNumExperiments(); x++)
+	{
+		// problems from the end of the scenario are the longest
+		Experiment e = s.GetNthExperiment(s.GetNumExperiments()-1-x);
+		xyLoc start(e.GetStartX(), e.GetStartY()), goal(e.GetGoalX(), e.GetGoalY());
+		// MapEnvironment::GCost reads the goal when the agent waits in place
+		me.setGoal(goal);
+		algorithm alg;
+		srandom(1234);
+		for (int trial = 0; trial < maxTrials; trial++)
+		{
+			double learned = alg.GetAmountLearned();
+			moves += RunTrial(alg, me, start, goal, nodes);
+			trials++;
+			if (fequal(learned, alg.GetAmountLearned()))
+				break;
+		}
+	}
+	double elapsed = t.EndTimer();
+	printf("%-20s %6llu trials %10llu moves %11llu nodes %8.3fs (%1.0f trials/s, %1.0f nodes/s)\n", name,
+		   trials, moves, nodes, elapsed, trials/elapsed, nodes/elapsed);
+}
+
+struct tableData {
+	tableData() :h(0) {}
+	double h;
+};
+
+/*
+ * The lookups of LRTA* on a grid: mostly states that are already in the
+ * table, near the last one, with new states added at the frontier.
+ */
+template <class table>
+static double TableWalk(table &t, int width, int height, int steps, double &sum)
+{
+	Timer timer;
+	srandom(1234);
+	int x = width/2, y = height/2;
+	timer.StartTimer();
+	for (int step = 0; step < steps; step++)
+	{
+		for (int dx = -1; dx <= 1; dx++)
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				if (x+dx < 0 || x+dx >= width || y+dy < 0 || y+dy >= height)
+					continue;
+				uint64_t hash = (y+dy)*width+x+dx;
+				typename table::iterator it = t.find(hash);
+				if (it != t.end())
+					sum += it->second.h;
+			}
+		t[y*width+x].h += 1;
+		x = std::min(std::max(x+(int)(random()%3)-1, 0), width-1);
+		y = std::min(std::max(y+(int)(random()%3)-1, 0), height-1);
+	}
+	return timer.EndTimer();
+}
+
+static void CompareTables(int width, int height, int steps)
+{
+	double sum1 = 0, sum2 = 0, sum3 = 0;
+	__gnu_cxx::hash_map<uint64_t, tableData, Hash64> hashMap;
+	double mapTime = TableWalk(hashMap, width, height, steps, sum1);
+	LearnedStateTable<tableData> hashed;
+	double hashedTime = TableWalk(hashed, width, height, steps, sum2);
+	LearnedStateTable<tableData> dense;
+	dense.UseDenseIndex(width*height);
+	double denseTime = TableWalk(dense, width, height, steps, sum3);
+	if (sum1 != sum2 || sum1 != sum3 || hashMap.size() != hashed.size() || hashMap.size() != dense.size())
+		printf("Error: the tables differ\n");
+	printf("%d steps, %d states: hash_map %1.4fs, LearnedStateTable %1.4fs (hashed) %1.4fs (dense)\n",
+		   steps, (int)hashed.size(), mapTime, hashedTime, denseTime);
+}
+
+void LearningTableTest(const char *scenario, const char *mapDirectory, int numProblems)
+{
+	ScenarioLoader s(scenario);
+	if (s.GetNumExperiments() == 0)
+	{
+		printf("No experiments in '%s'\n", scenario);
+		return;
+	}
+	std::string mapName = std::string(mapDirectory)+"/"+s.GetNthExperiment(0).GetMapName();
+	Map *m = new Map(mapName.c_str());
+	MapEnvironment me(m);
+	printf("%s: %d problems\n", scenario, numProblems);
+	RunTrials<LRTAStar<xyLoc, tDirection, MapEnvironment>>("LRTAStar", me, s, numProblems, 100);
+	RunTrials<LSSLRTAStar<xyLoc, tDirection, MapEnvironment>>("LSSLRTAStar(8)", me, s, numProblems, 100);
+	RunTrials<FLRTA::FLRTAStar<xyLoc, tDirection, MapEnvironment>>("FLRTAStar(8,1.5)", me, s, numProblems, 100);
+	CompareTables(m->GetMapWidth(), m->GetMapHeight(), 10000000);
+	// the walk covers a few million states
+	CompareTables(4096, 4096, 10000000);
+	delete m;
+}
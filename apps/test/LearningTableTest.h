@@ -0,0 +1,16 @@
+//
+//  LearningTableTest.h
+//  hog2
+//
+//  Runs repeated trials of the LRTA* family on scenario problems and reports
+//  trial throughput, and compares LearnedStateTable with the hash_map that
+//  the algorithms used before.
+//
+
+#ifndef LearningTableTest_h
+#define LearningTableTest_h
+
+#include <stdio.h>
+void LearningTableTest(const char *scenario, const char *mapDirectory, int numProblems);
+
+#endif /* LearningTableTest_h */
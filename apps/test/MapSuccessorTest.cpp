@@ -0,0 +1,75 @@
+//
+//  MapSuccessorTest.cpp
+//  hog2
+//
+
+#include <cmath>
+#include <string>
+#include "MapSuccessorTest.h"
+#include "Map2DEnvironment.h"
+#include "ScenarioLoader.h"
+#include "TemplateAStar.h"
+#include "JPS.h"
+#include "Timer.h"
+
+// JPS returns only the jump points, so measure each segment by octile distance
+static double JumpPathLength(MapEnvironment &me, const std::vector<xyLoc> &path)
+{
+	double length = 0;
+	for (unsigned int x = 1; x < path.size(); x++)
+		length += me.HCost(path[x-1], path[x]);
+	return length;
+}
+
+void MapSuccessorTest(const char *scenario, const char *mapDirectory)
+{
+	ScenarioLoader s(scenario);
+	if (s.GetNumExperiments() == 0)
+	{
+		printf("No experiments in '%s'\n", scenario);
+		return;
+	}
+	std::string mapName = std::string(mapDirectory)+"/"+s.GetNthExperiment(0).GetMapName();
+	Map *m = new Map(mapName.c_str());
+	MapEnvironment me(m);
+	TemplateAStar<xyLoc, tDirection, MapEnvironment> astar;
+	JPS jps(m);
+	std::vector<xyLoc> path;
+	Timer t;
+	double mapTime = 0, bitmapTime = 0, jpsTime = 0;
+	uint64_t mapNodes = 0, bitmapNodes = 0;
+	int jpsDifferent = 0;
+
+	for (int x = 0; x < s.GetNumExperiments(); x++)
+	{
+		Experiment e = s.GetNthExperiment(x);
+		xyLoc start(e.GetStartX(), e.GetStartY()), goal(e.GetGoalX(), e.GetGoalY());
+
+		me.UsePassabilityBitmap(false);
+		t.StartTimer();
+		astar.GetPath(&me, start, goal, path);
+		mapTime += t.EndTimer();
+		mapNodes += astar.GetNodesExpanded();
+		double length = me.GetPathLength(path);
+
+		me.UsePassabilityBitmap(true);
+		t.StartTimer();
+		astar.GetPath(&me, start, goal, path);
+		bitmapTime += t.EndTimer();
+		bitmapNodes += astar.GetNodesExpanded();
+		if (fabs(me.GetPathLength(path)-length) > 0.0001)
+			printf("Error: problem %d has length %f with the bitmap but %f without\n", x, me.GetPathLength(path), length);
+
+		t.StartTimer();
+		jps.GetPath(&me, start, goal, path);
+		jpsTime += t.EndTimer();
+		// JPS treats only kGround as passable, so maps with trees or water can differ
+		if (fabs(JumpPathLength(me, path)-length) > 0.0001)
+			jpsDifferent++;
+	}
+	printf("%s: %d problems\n", scenario, s.GetNumExperiments());
+	printf("A* (map):    %1.4fs %llu nodes\n", mapTime, mapNodes);
+	printf("A* (bitmap): %1.4fs %llu nodes\n", bitmapTime, bitmapNodes);
+	printf("JPS:         %1.4fs (%d paths differ from A*)\n", jpsTime, jpsDifferent);
+	delete m;
+}
@@ -0,0 +1,15 @@
+//
+//  MapSuccessorTest.h
+//  hog2
+//
+//  Compares grid search using Map lookups with the packed passability bitmap.
+//
+
+#ifndef MapSuccessorTest_h
+#define MapSuccessorTest_h
+
+#include <stdio.h>
+// mapDirectory is prepended to the map names found in the scenario file
+void MapSuccessorTest(const char *scenario, const char *mapDirectory);
+
+#endif /* MapSuccessorTest_h */
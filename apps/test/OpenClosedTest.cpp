@@ -0,0 +1,86 @@
+//
+//  OpenClosedTest.cpp
+//  hog2
+//
+
+#include <cmath>
+#include <string>
+#include "OpenClosedTest.h"
+#include "Map2DEnvironment.h"
+#include "MNPuzzle.h"
+#include "ScenarioLoader.h"
+#include "TemplateAStar.h"
+#include "FlatOpenClosed.h"
+#include "Timer.h"
+
+template <class state, class action, class environment, class openList>
+void TimeSearches(const char *name, environment *env, const std::vector<std::pair<state, state>> &problems,
+				  std::vector<double> &lengths)
+{
+	TemplateAStar<state, action, environment, openList> astar;
+	std::vector<state> path;
+	Timer t;
+	uint64_t nodes = 0;
+	double total = 0;
+	for (unsigned int x = 0; x < problems.size(); x++)
+	{
+		t.StartTimer();
+		astar.GetPath(env, problems[x].first, problems[x].second, path);
+		total += t.EndTimer();
+		nodes += astar.GetNodesExpanded();
+		double length = env->GetPathLength(path);
+		if (lengths.size() <= x)
+			lengths.push_back(length);
+		else if (fabs(lengths[x]-length) > 0.0001)
+			printf("Error: problem %d has length %f with %s but %f before\n", x, length, name, lengths[x]);
+	}
+	printf("%-20s %1.4fs %llu nodes %1.0f nodes/sec\n", name, total, nodes, nodes/total);
+}
+
+void OpenClosedGridTest(const char *scenario, const char *mapDirectory)
+{
+	ScenarioLoader s(scenario);
+	if (s.GetNumExperiments() == 0)
+	{
+		printf("No experiments in '%s'\n", scenario);
+		return;
+	}
+	std::string mapName = std::string(mapDirectory)+"/"+s.GetNthExperiment(0).GetMapName();
+	Map *m = new Map(mapName.c_str());
+	MapEnvironment me(m);
+	std::vector<std::pair<xyLoc, xyLoc>> problems;
+	for (int x = 0; x < s.GetNumExperiments(); x++)
+	{
+		Experiment e = s.GetNthExperiment(x);
+		problems.push_back({xyLoc(e.GetStartX(), e.GetStartY()), xyLoc(e.GetGoalX(), e.GetGoalY())});
+	}
+	std::vector<double> lengths;
+	printf("%s: %d problems\n", scenario, s.GetNumExperiments());
+	TimeSearches<xyLoc, tDirection, MapEnvironment, AStarOpenClosed<xyLoc, AStarCompare<xyLoc>>>("AStarOpenClosed", &me, problems, lengths);
+	TimeSearches<xyLoc, tDirection, MapEnvironment, FlatOpenClosed<xyLoc, AStarCompare<xyLoc>>>("FlatOpenClosed", &me, problems, lengths);
+	TimeSearches<xyLoc, tDirection, MapEnvironment, FlatOpenClosed<xyLoc, AStarCompare<xyLoc>, AStarOpenClosedData<xyLoc>, 2>>("FlatOpenClosed (2)", &me, problems, lengths);
+	delete m;
+}
+
+void OpenClosedSTPTest(int numProblems, int walkLength)
+{
+	MNPuzzle mnp(4, 4);
+	MNPuzzleState goal(4, 4);
+	std::vector<std::pair<MNPuzzleState, MNPuzzleState>> problems;
+	std::vector<slideDir> acts;
+	srandom(1234);
+	for (int x = 0; x < numProblems; x++)
+	{
+		MNPuzzleState s = goal;
+		for (int y = 0; y < walkLength; y++)
+		{
+			mnp.GetActions(s, acts);
+			mnp.ApplyAction(s, acts[random()%acts.size()]);
+		}
+		problems.push_back({s, goal});
+	}
+	std::vector<double> lengths;
+	printf("15-puzzle: %d problems, %d-step random walks\n", numProblems, walkLength);
+	TimeSearches<MNPuzzleState, slideDir, MNPuzzle, AStarOpenClosed<MNPuzzleState, AStarCompare<MNPuzzleState>>>("AStarOpenClosed", &mnp, problems, lengths);
+	TimeSearches<MNPuzzleState, slideDir, MNPuzzle, FlatOpenClosed<MNPuzzleState, AStarCompare<MNPuzzleState>>>("FlatOpenClosed", &mnp, problems, lengths);
+}
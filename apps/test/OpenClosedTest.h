@@ -0,0 +1,16 @@
+//
+//  OpenClosedTest.h
+//  hog2
+//
+//  Compares A* throughput with AStarOpenClosed and FlatOpenClosed.
+//
+
+#ifndef OpenClosedTest_h
+#define OpenClosedTest_h
+
+#include <stdio.h>
+// mapDirectory is prepended to the map names found in the scenario file
+void OpenClosedGridTest(const char *scenario, const char *mapDirectory);
+void OpenClosedSTPTest(int numProblems, int walkLength);
+
+#endif /* OpenClosedTest_h */
@@ -0,0 +1,105 @@
+//
+//  PackedTOHTest.cpp
+//  hog2
+//
+
+#include "PackedTOHTest.h"
+#include "PackedTOH.h"
+#include "TemplateAStar.h"
+#include "Timer.h"
+
+const int numDisks = 12;
+const int patternDisks = 8;
+
+template <class state, class environment>
+static void TimeSuccessors(const char *name, environment &env, state s)
+{
+	const int walkLength = 10000000;
+	std::vector<state> succ;
+	Timer t;
+	srandom(1234);
+	t.StartTimer();
+	for (int x = 0; x < walkLength; x++)
+	{
+		env.GetSuccessors(s, succ);
+		s = succ[random()%succ.size()];
+	}
+	t.EndTimer();
+	printf("%-10s %1.2fs for %d GetSuccessors; %1.0f per second\n", name, t.GetElapsedTime(), walkLength,
+		   walkLength/t.GetElapsedTime());
+}
+
+template <class state, class environment>
+static void TimeLookups(const char *name, environment &env, Heuristic<state> *h, state &goal)
+{
+	const int numStates = 1000000, passes = 10;
+	std::vector<state> states(numStates);
+	srandom(1234);
+	for (auto &s : states)
+		env.GetStateFromHash(((uint64_t(random())<<31)|random())%env.GetMaxHash(), s);
+	double sum = 0;
+	Timer t;
+	t.StartTimer();
+	for (int x = 0; x < passes; x++)
+		for (auto &s : states)
+			sum += h->HCost(s, goal);
+	t.EndTimer();
+	printf("%-10s %1.2fs for %d lookups (average %1.2f); %1.0f per second\n", name, t.GetElapsedTime(), numStates*passes,
+		   sum/(numStates*passes), numStates*passes/t.GetElapsedTime());
+}
+
+template <class state, class environment>
+static void TimeSearches(const char *name, environment &env, Heuristic<state> *h,
+						 const std::vector<uint64_t> &problems, state &goal)
+{
+	TemplateAStar<state, TOHMove, environment> astar;
+	astar.SetHeuristic(h);
+	std::vector<state> path;
+	uint64_t nodes = 0;
+	Timer t;
+	t.StartTimer();
+	for (uint64_t p : problems)
+	{
+		state s;
+		env.GetStateFromHash(p, s);
+		astar.GetPath(&env, s, goal, path);
+		nodes += astar.GetNodesExpanded();
+		printf("%s: %llu expanded, length %lu\n", name, (unsigned long long)astar.GetNodesExpanded(), path.size()-1);
+	}
+	t.EndTimer();
+	printf("%-10s A*: %1.2fs; %llu expanded; %1.0f nodes per second\n", name, t.GetElapsedTime(),
+		   (unsigned long long)nodes, nodes/t.GetElapsedTime());
+}
+
+void PackedTOHTest(int numProblems, int numThreads)
+{
+	TOH<numDisks> toh;
+	TOHState<numDisks> tohGoal;
+	PackedTOH<numDisks> packed;
+	PackedTOHState<numDisks> packedGoal;
+	TimeSuccessors("TOH", toh, tohGoal);
+	TimeSuccessors("PackedTOH", packed, packedGoal);
+
+	Timer t;
+	TOH<patternDisks> absToh;
+	TOHPDB<patternDisks, numDisks> pdb(&absToh);
+	pdb.SetGoal(tohGoal);
+	t.StartTimer();
+	pdb.BuildPDB(tohGoal, numThreads);
+	printf("TOHPDB of %d disks: %1.2fs\n", patternDisks, t.EndTimer());
+	PackedTOHPDB<numDisks> additive({numDisks-patternDisks, patternDisks});
+	t.StartTimer();
+	additive.BuildPDBs(packedGoal, numThreads);
+	printf("PackedTOHPDB of %d+%d disks: %1.2fs\n", numDisks-patternDisks, patternDisks, t.EndTimer());
+
+	TimeLookups("TOH", toh, &pdb, tohGoal);
+	TimeLookups("PackedTOH", packed, &additive, packedGoal);
+
+	// uniformly random states
+	std::vector<uint64_t> problems;
+	srandom(1234);
+	for (int x = 0; x < numProblems; x++)
+		problems.push_back(((uint64_t(random())<<31)|random())%packed.GetMaxHash());
+	TimeSearches("TOH", toh, &pdb, problems, tohGoal);
+	TimeSearches("PackedTOH", packed, &additive, problems, packedGoal);
+}
@@ -0,0 +1,18 @@
+//
+//  PackedTOHTest.h
+//  hog2
+//
+//  4-peg Towers of Hanoi with TOH and TOHPDB against the one-word
+//  PackedTOH and its additive PDBs.
+//
+
+#ifndef PackedTOHTest_h
+#define PackedTOHTest_h
+
+#include <stdio.h>
+// Times random walks of successor generation, builds PDBs of the 8 largest
+// of 12 disks (and of the other 4 for PackedTOH) on numThreads threads, times
+// lookups and solves numProblems uniformly random instances with A*
+void PackedTOHTest(int numProblems, int numThreads);
+
+#endif /* PackedTOHTest_h */
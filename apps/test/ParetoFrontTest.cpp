@@ -0,0 +1,208 @@
+//
+//  ParetoFrontTest.cpp
+//  hog2
+//
+
+#include "ParetoFrontTest.h"
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include "NAMOAStar.h"
+#include "ParetoFront.h"
+#include "Timer.h"
+
+/*
+ * Labels that reach one node. The objectives are anti-correlated (they trade
+ * off against each other), as for time/risk or distance/energy on a grid, so
+ * a large fraction of them are pareto-optimal.
+ */
+template <unsigned dim>
+static void RandomLabels(int count, std::vector<cost<dim>> &labels)
+{
+	labels.resize(count);
+	for (auto &c : labels)
+	{
+		double total = 0;
+		for (unsigned i = 0; i < dim; i++)
+		{
+			c.value[i] = (random()%1000)+1;
+			total += c.value[i];
+		}
+		// scale onto a band around the plane sum = 1000*dim
+		double scale = 1000*dim*(1+(random()%100)/1000.0)/total;
+		for (unsigned i = 0; i < dim; i++)
+			c.value[i] = (float)(int)(c.value[i]*scale);
+	}
+}
+
+// The open-set update that NAMOAStar did before ParetoFront
+template <unsigned dim>
+static void HashedInsert(std::unordered_map<cost<dim>, std::unordered_set<uint64_t>> &open, const cost<dim> &newg, uint64_t parent)
+{
+	for (auto theG = open.cbegin(); theG != open.cend(); )
+	{
+		if (newg < theG->first)
+			open.erase(theG++);
+		else
+			++theG;
+	}
+	for (const auto &theG : open)
+		if (theG.first < newg)
+			return;
+	open[newg].insert(parent);
+}
+
+// The same update on an unsorted list
+template <unsigned dim>
+static void LinearInsert(std::vector<std::pair<cost<dim>, std::vector<uint64_t>>> &open, const cost<dim> &newg, uint64_t parent)
+{
+	for (auto &theG : open)
+	{
+		if (ParetoFront<dim>::Equal(theG.first, newg))
+		{
+			if (std::find(theG.second.begin(), theG.second.end(), parent) == theG.second.end())
+				theG.second.push_back(parent);
+			return;
+		}
+		if (ParetoFront<dim>::Dominates(theG.first, newg))
+			return;
+	}
+	size_t next = 0;
+	for (size_t x = 0; x < open.size(); x++)
+		if (!ParetoFront<dim>::Dominates(newg, open[x].first))
+			std::swap(open[next++], open[x]);
+	open.resize(next);
+	open.push_back({newg, {parent}});
+}
+
+template <unsigned dim>
+static void CompareFronts(int numLabels)
+{
+	cost<dim>::compareType = cost<dim>::PURE;
+	for (int size = numLabels/100; size <= numLabels; size *= 10)
+	{
+		srandom(1234);
+		std::vector<cost<dim>> labels;
+		RandomLabels<dim>(size, labels);
+		Timer t;
+		std::unordered_map<cost<dim>, std::unordered_set<uint64_t>> open;
+		t.StartTimer();
+		for (int x = 0; x < size; x++)
+			HashedInsert<dim>(open, labels[x], x%8);
+		double hashed = t.EndTimer();
+
+		std::vector<std::pair<cost<dim>, std::vector<uint64_t>>> list;
+		t.StartTimer();
+		for (int x = 0; x < size; x++)
+			LinearInsert<dim>(list, labels[x], x%8);
+		double linear = t.EndTimer();
+
+		ParetoFront<dim> front;
+		t.StartTimer();
+		for (int x = 0; x < size; x++)
+			front.Insert(labels[x], x%8);
+		double sorted = t.EndTimer();
+
+		int missing = 0;
+		for (const auto &theG : list)
+		{
+			auto e = front.Find(theG.first);
+			missing += (e == 0 || e->ids.size() != theG.second.size());
+		}
+		if (missing > 0 || list.size() != front.size())
+			printf("Error: %d vectors in the list, %d in ParetoFront (%d differ)\n", (int)list.size(), (int)front.size(), missing);
+		// cost::Hash ignores the second objective and cost::operator== is true for
+		// vectors that don't dominate each other, so the hashed sets merge vectors
+		printf("%d objectives, %d labels, %d on the front: hashed %1.4fs (keeps %d), list %1.4fs, ParetoFront %1.4fs\n",
+			   dim, size, (int)front.size(), hashed, (int)open.size(), linear, sorted);
+	}
+}
+
+struct moLoc {
+	moLoc() :x(0), y(0) {}
+	moLoc(int a, int b) :x(a), y(b) {}
+	bool operator==(const moLoc &l) const { return x == l.x && y == l.y; }
+	int x, y;
+};
+
+static std::ostream &operator<<(std::ostream &out, const moLoc &l)
+{
+	return out << "(" << l.x << ", " << l.y << ")";
+}
+
+/*
+ * 8-connected grid. Objective 0 is the distance; the others are costs of
+ * entering each cell (e.g. risk, energy), drawn at random.
+ */
+template <unsigned dim>
+class RandomCostGrid {
+public:
+	RandomCostGrid(int size) :size(size), cellCost(size*size*(dim-1))
+	{
+		for (auto &c : cellCost)
+			c = (float)(1+random()%9);
+	}
+	void GetSuccessors(const moLoc &s, std::vector<moLoc> &succ) const
+	{
+		for (int dx = -1; dx <= 1; dx++)
+			for (int dy = -1; dy <= 1; dy++)
+				if ((dx != 0 || dy != 0) && s.x+dx >= 0 && s.x+dx < size && s.y+dy >= 0 && s.y+dy < size)
+					succ.push_back(moLoc(s.x+dx, s.y+dy));
+	}
+	int GetAction(const moLoc &, const moLoc &) const { return 0; }
+	std::vector<float> GCostVector(const moLoc &a, const moLoc &b) const
+	{
+		std::vector<float> c(dim);
+		c[0] = (a.x != b.x && a.y != b.y)?1.5f:1.0f;
+		for (unsigned i = 1; i < dim; i++)
+			c[i] = cellCost[(b.y*size+b.x)*(dim-1)+i-1];
+		return c;
+	}
+	std::vector<float> HCostVector(const moLoc &a, const moLoc &b) const
+	{
+		std::vector<float> h(dim);
+		int dx = abs(a.x-b.x), dy = abs(a.y-b.y);
+		h[0] = std::max(dx, dy)+0.5f*std::min(dx, dy);
+		for (unsigned i = 1; i < dim; i++)
+			h[i] = (float)std::max(dx, dy); // each step costs at least 1
+		return h;
+	}
+	uint64_t GetStateHash(const moLoc &s) const { return s.y*size+s.x; }
+	bool GoalTest(const moLoc &a, const moLoc &b) const { return a == b; }
+	void SetColor(double, double, double, double) const {}
+	void OpenGLDraw(const moLoc &) const {}
+private:
+	int size;
+	std::vector<float> cellCost;
+};
+
+template <unsigned dim>
+static void GridSearch(int gridSize)
+{
+	srandom(1234);
+	RandomCostGrid<dim> grid(gridSize);
+	NAMOAStar<moLoc, int, RandomCostGrid<dim>, dim> search;
+	search.SetLazyFiltering(true);
+	std::vector<std::vector<moLoc>> paths;
+	Timer t;
+	t.StartTimer();
+	search.GetPaths(&grid, moLoc(0, 0), moLoc(gridSize-1, gridSize-1), paths);
+	double elapsed = t.EndTimer();
+	int maxFront = 0;
+	for (int x = 0; x < search.GetNumItems(); x++)
+		maxFront = std::max(maxFront, (int)(search.GetItem(x).open.size()+search.GetItem(x).closed.size()));
+	printf("%d objectives, %dx%d grid: %1.4fs, %llu expansions, largest front %d\n", dim, gridSize, gridSize,
+		   elapsed, search.GetNodesExpanded(), maxFront);
+}
+
+void ParetoFrontTest(int numLabels, int gridSize)
+{
+	CompareFronts<2>(numLabels);
+	CompareFronts<3>(numLabels);
+	cost<2>::compareType = cost<2>::PURE;
+	GridSearch<2>(gridSize);
+	cost<3>::compareType = cost<3>::PURE;
+	GridSearch<3>(gridSize);
+}
@@ -0,0 +1,16 @@
+//
+//  ParetoFrontTest.h
+//  hog2
+//
+//  Compares the hashed cost-vector sets that NAMOAStar used for its open and
+//  closed sets with ParetoFront, and runs NAMOAStar on random bi- and
+//  tri-objective grids.
+//
+
+#ifndef ParetoFrontTest_h
+#define ParetoFrontTest_h
+
+#include <stdio.h>
+void ParetoFrontTest(int numLabels, int gridSize);
+
+#endif /* ParetoFrontTest_h */
@@ -0,0 +1,89 @@
+//
+//  RubikMoveTest.cpp
+//  hog2
+//
+
+#include "RubikMoveTest.h"
+#include "RubiksCube.h"
+#include "IDAStar.h"
+#include "Timer.h"
+
+void RubikMoveTest(int numMoves, int numProblems, int scrambleLength)
+{
+	RubiksCube cube;
+	RubiksState goal, s;
+	std::vector<int> edges1 = {0, 1, 2, 3, 4}, edges2 = {5, 6, 7, 8, 9}, corners = {0, 1, 2, 3, 4, 5}, blank;
+	RubikPDB pdb1(&cube, goal, edges1, blank);
+	RubikPDB pdb2(&cube, goal, edges2, blank);
+	RubikPDB pdb3(&cube, goal, blank, corners);
+	Timer t;
+	t.StartTimer();
+	pdb1.BuildPDB(goal, 1);
+	pdb2.BuildPDB(goal, 1);
+	pdb3.BuildPDB(goal, 1);
+	printf("PDBs built in %1.2fs\n", t.EndTimer());
+
+	srandom(1);
+	std::vector<RubiksAction> moves(numMoves);
+	for (auto &a : moves)
+		a = random()%18;
+	// the sum keeps the loops from being optimized away and checks the results
+	uint64_t sum = 0;
+	t.StartTimer();
+	for (auto a : moves)
+	{
+		cube.ApplyAction(s, a);
+		sum += s.edge.state^s.corner.state;
+	}
+	double applyTime = t.EndTimer();
+	t.StartTimer();
+	for (auto a : moves)
+	{
+		cube.UndoAction(s, a);
+		sum += cube.GetEdgeHash(s)^cube.GetCornerHash(s);
+	}
+	double hashTime = t.EndTimer();
+	t.StartTimer();
+	for (auto a : moves)
+	{
+		cube.ApplyAction(s, a);
+		sum += pdb1.GetPDBHash(s)^pdb3.GetPDBHash(s);
+	}
+	double pdbTime = t.EndTimer();
+	printf("%d moves: %1.1fM/sec; with edge+corner hash %1.1fM/sec; with two pdb hashes %1.1fM/sec (check %llx)\n",
+		   numMoves, numMoves/applyTime/1e6, numMoves/hashTime/1e6, numMoves/pdbTime/1e6, (unsigned long long)sum);
+
+	Heuristic<RubiksState> h;
+	h.lookups.push_back({kMaxNode, 1, 3});
+	h.lookups.push_back({kLeafNode, 0, 0});
+	h.lookups.push_back({kLeafNode, 1, 0});
+	h.lookups.push_back({kLeafNode, 2, 0});
+	h.heuristics.push_back(&pdb1);
+	h.heuristics.push_back(&pdb2);
+	h.heuristics.push_back(&pdb3);
+
+	RubiksCube scrambler;
+	cube.SetPruneSuccessors(true);
+	IDAStar<RubiksState, RubiksAction, RubiksCube> ida;
+	ida.SetHeuristic(&h);
+	std::vector<RubiksAction> path;
+	uint64_t nodes = 0;
+	double total = 0;
+	for (int x = 0; x < numProblems; x++)
+	{
+		RubiksState start;
+		for (int y = 0, last = -3; y < scrambleLength; y++)
+		{
+			// no two turns of the same face in a row
+			int a;
+			do { a = random()%18; } while (a/3 == last/3);
+			scrambler.ApplyAction(start, a);
+			last = a;
+		}
+		t.StartTimer();
+		ida.GetPath(&cube, start, goal, path);
+		total += t.EndTimer();
+		nodes += ida.GetNodesExpanded();
+	}
+	printf("IDA*: %d problems, %llu nodes, %1.2fs (%1.2fM nodes/sec)\n", numProblems, nodes, total, nodes/total/1e6);
+}
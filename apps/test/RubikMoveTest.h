@@ -0,0 +1,17 @@
+//
+//  RubikMoveTest.h
+//  hog2
+//
+//  Throughput of the Rubik's cube face turns, state hashes and PDB lookups,
+//  and of IDA* with edge and corner PDBs.
+//
+
+#ifndef RubikMoveTest_h
+#define RubikMoveTest_h
+
+#include <stdio.h>
+// numMoves random face turns for the loops; IDA* solves numProblems
+// scrambles of scrambleLength moves
+void RubikMoveTest(int numMoves, int numProblems, int scrambleLength);
+
+#endif /* RubikMoveTest_h */
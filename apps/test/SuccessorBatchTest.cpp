@@ -0,0 +1,171 @@
+//
+//  SuccessorBatchTest.cpp
+//  hog2
+//
+
+#include <cmath>
+#include <string>
+#include "SuccessorBatchTest.h"
+#include "Map2DEnvironment.h"
+#include "MNPuzzle.h"
+#include "PancakePuzzle.h"
+#include "RubiksCube.h"
+#include "ScenarioLoader.h"
+#include "TemplateAStar.h"
+#include "IDAStar.h"
+#include "Timer.h"
+
+// The environment without its successor batch, so the searches fall back to
+// GetSuccessors/GetActions, GCost and GetStateHash
+template <class environment>
+class WithoutBatch : public environment {
+public:
+	using environment::environment;
+	unsigned GetMaxSuccessors() const { return 0; }
+};
+
+struct SearchResult {
+	double time;
+	uint64_t nodes;
+	std::vector<double> lengths;
+};
+
+static void Report(const char *name, const SearchResult &batch, const SearchResult &plain)
+{
+	bool same = batch.nodes == plain.nodes && batch.lengths.size() == plain.lengths.size();
+	for (unsigned int x = 0; same && x < batch.lengths.size(); x++)
+		same = fabs(batch.lengths[x]-plain.lengths[x]) < 0.0001;
+	printf("%-24s %llu nodes%s: %1.4fs (%1.0f nodes/sec) without the batch, %1.4fs (%1.0f nodes/sec) with it\n",
+		   name, plain.nodes, same?"":" [RESULTS DIFFER]", plain.time, plain.nodes/plain.time,
+		   batch.time, batch.nodes/batch.time);
+}
+
+template <class state, class action, class environment>
+static SearchResult AStarSearches(environment *env, const std::vector<std::pair<state, state>> &problems)
+{
+	TemplateAStar<state, action, environment> astar;
+	std::vector<state> path;
+	SearchResult r = {0, 0};
+	Timer t;
+	for (const auto &p : problems)
+	{
+		t.StartTimer();
+		astar.GetPath(env, p.first, p.second, path);
+		r.time += t.EndTimer();
+		r.nodes += astar.GetNodesExpanded();
+		r.lengths.push_back(env->GetPathLength(path));
+	}
+	return r;
+}
+
+template <class state, class action, class environment>
+static SearchResult IDAStarSearches(environment *env, Heuristic<state> *h, const std::vector<std::pair<state, state>> &problems)
+{
+	IDAStar<state, action, environment> ida;
+	if (h)
+		ida.SetHeuristic(h);
+	std::vector<action> path;
+	SearchResult r = {0, 0};
+	Timer t;
+	for (const auto &p : problems)
+	{
+		t.StartTimer();
+		ida.GetPath(env, p.first, p.second, path);
+		r.time += t.EndTimer();
+		r.nodes += ida.GetNodesExpanded();
+		r.lengths.push_back(path.size());
+	}
+	return r;
+}
+
+void SuccessorBatchGridTest(const char *scenario, const char *mapDirectory)
+{
+	ScenarioLoader s(scenario);
+	if (s.GetNumExperiments() == 0)
+	{
+		printf("No experiments in '%s'\n", scenario);
+		return;
+	}
+	std::string mapName = std::string(mapDirectory)+"/"+s.GetNthExperiment(0).GetMapName();
+	Map *m = new Map(mapName.c_str());
+	MapEnvironment me(m);
+	WithoutBatch<MapEnvironment> plain(m);
+	std::vector<std::pair<xyLoc, xyLoc>> problems;
+	for (int x = 0; x < s.GetNumExperiments(); x++)
+	{
+		Experiment e = s.GetNthExperiment(x);
+		problems.push_back({xyLoc(e.GetStartX(), e.GetStartY()), xyLoc(e.GetGoalX(), e.GetGoalY())});
+	}
+	printf("%s: %d problems\n", scenario, s.GetNumExperiments());
+	for (int bitmap = 0; bitmap < 2; bitmap++)
+	{
+		me.UsePassabilityBitmap(bitmap);
+		plain.UsePassabilityBitmap(bitmap);
+		SearchResult r1 = AStarSearches<xyLoc, tDirection, WithoutBatch<MapEnvironment>>(&plain, problems);
+		SearchResult r2 = AStarSearches<xyLoc, tDirection, MapEnvironment>(&me, problems);
+		Report(bitmap?"A* (bitmap)":"A* (map)", r2, r1);
+	}
+	delete m;
+}
+
+template <class state, class environment>
+static void RandomWalks(environment *env, const state &goal, int numProblems, int walkLength,
+						std::vector<std::pair<state, state>> &problems)
+{
+	srandom(1234);
+	for (int x = 0; x < numProblems; x++)
+	{
+		state s = goal;
+		std::vector<state> succ;
+		for (int y = 0; y < walkLength; y++)
+		{
+			env->GetSuccessors(s, succ);
+			s = succ[random()%succ.size()];
+		}
+		problems.push_back({s, goal});
+	}
+}
+
+void SuccessorBatchPuzzleTest(int numProblems, int walkLength, int rubikDepth)
+{
+	{
+		MNPuzzle mnp(4, 4);
+		WithoutBatch<MNPuzzle> plain(4, 4);
+		MNPuzzleState goal(4, 4);
+		std::vector<std::pair<MNPuzzleState, MNPuzzleState>> problems;
+		RandomWalks(&mnp, goal, numProblems, walkLength, problems);
+		printf("15-puzzle: %d problems, %d-step random walks\n", numProblems, walkLength);
+		SearchResult r1 = AStarSearches<MNPuzzleState, slideDir, WithoutBatch<MNPuzzle>>(&plain, problems);
+		SearchResult r2 = AStarSearches<MNPuzzleState, slideDir, MNPuzzle>(&mnp, problems);
+		Report("A*", r2, r1);
+		r1 = IDAStarSearches<MNPuzzleState, slideDir, WithoutBatch<MNPuzzle>>(&plain, 0, problems);
+		r2 = IDAStarSearches<MNPuzzleState, slideDir, MNPuzzle>(&mnp, 0, problems);
+		Report("IDA*", r2, r1);
+	}
+	{
+		PancakePuzzle pancake(16);
+		WithoutBatch<PancakePuzzle> plain(16);
+		PancakePuzzleState goal(16);
+		// the gap heuristic
+		pancake.Set_Use_Dual_Lookup(false);
+		plain.Set_Use_Dual_Lookup(false);
+		std::vector<std::pair<PancakePuzzleState, PancakePuzzleState>> problems;
+		RandomWalks(&pancake, goal, numProblems, walkLength, problems);
+		printf("16 pancakes: %d problems, %d-step random walks\n", numProblems, walkLength);
+		SearchResult r1 = IDAStarSearches<PancakePuzzleState, PancakePuzzleAction, WithoutBatch<PancakePuzzle>>(&plain, 0, problems);
+		SearchResult r2 = IDAStarSearches<PancakePuzzleState, PancakePuzzleAction, PancakePuzzle>(&pancake, 0, problems);
+		Report("IDA*", r2, r1);
+	}
+	{
+		// without a pattern database the cube has no heuristic, so keep it shallow
+		RubiksCube cube;
+		WithoutBatch<RubiksCube> plain;
+		RubiksState goal;
+		std::vector<std::pair<RubiksState, RubiksState>> problems;
+		RandomWalks(&cube, goal, 1, rubikDepth, problems);
+		printf("Rubik's cube: %d-move scramble\n", rubikDepth);
+		SearchResult r1 = IDAStarSearches<RubiksState, RubiksAction, WithoutBatch<RubiksCube>>(&plain, 0, problems);
+		SearchResult r2 = IDAStarSearches<RubiksState, RubiksAction, RubiksCube>(&cube, 0, problems);
+		Report("IDA*", r2, r1);
+	}
+}
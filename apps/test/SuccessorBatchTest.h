@@ -0,0 +1,18 @@
+//
+//  SuccessorBatchTest.h
+//  hog2
+//
+//  Compares search throughput with and without the successor batch of the
+//  environments.
+//
+
+#ifndef SuccessorBatchTest_h
+#define SuccessorBatchTest_h
+
+#include <stdio.h>
+// mapDirectory is prepended to the map names found in the scenario file
+void SuccessorBatchGridTest(const char *scenario, const char *mapDirectory);
+// random walks of walkLength from the goal; the Rubik's cube uses depth
+void SuccessorBatchPuzzleTest(int numProblems, int walkLength, int rubikDepth);
+
+#endif /* SuccessorBatchTest_h */
@@ -0,0 +1,163 @@
+//
+//  VoxelTest.cpp
+//  hog2
+//
+
+#include <vector>
+#include "VoxelTest.h"
+#include "Voxels.h"
+#include "TemplateAStar.h"
+#include "Timer.h"
+
+// Looks up the 26 neighbors one at a time
+class OneAtATimeVoxels : public Voxels {
+public:
+	OneAtATimeVoxels(const char *file) :Voxels(file) {}
+	uint32_t GetLegalActions(const voxelState &s) const
+	{
+		uint32_t free = 0;
+		for (int dx = -1; dx <= 1; dx++)
+			for (int dy = -1; dy <= 1; dy++)
+				for (int dz = -1; dz <= 1; dz++)
+					if (!GetOccupancy().IsBlocked(s.x+dx, s.y+dy, s.z+dz))
+						free |= 1u<<((dx+1)*9+(dy+1)*3+(dz+1));
+		// a move needs every voxel it cuts past to be free
+		uint32_t legal = 0;
+		for (int a = 0; a < kXsYsZs; a++)
+		{
+			int d[3] = {(a/9 == 0)?1:((a/9 == 1)?-1:0), ((a/3)%3 == 0)?1:(((a/3)%3 == 1)?-1:0), (a%3 == 0)?1:((a%3 == 1)?-1:0)};
+			bool legalMove = true;
+			for (int sub = 1; sub < 8 && legalMove; sub++)
+			{
+				int dx = (sub&1)?d[0]:0, dy = (sub&2)?d[1]:0, dz = (sub&4)?d[2]:0;
+				legalMove = (free>>((dx+1)*9+(dy+1)*3+(dz+1)))&1;
+			}
+			if (legalMove)
+				legal |= 1u<<a;
+		}
+		return legal;
+	}
+	void GetSuccessors(const voxelState &nodeID, std::vector<voxelState> &neighbors) const
+	{
+		neighbors.resize(0);
+		uint32_t legal = GetLegalActions(nodeID);
+		for (int a = 0; a < kXsYsZs; a++)
+		{
+			if (((legal>>a)&1) == 0)
+				continue;
+			voxelState s = nodeID;
+			ApplyAction(s, (voxelAction)a);
+			neighbors.push_back(s);
+		}
+	}
+};
+
+static void WriteWorld(const char *file, int size)
+{
+	// blocked voxels in a dense array first
+	std::vector<bool> blocked((size_t)size*size*size, false);
+	auto voxel = [&](int x, int y, int z) { return ((size_t)x*size+y)*size+z; };
+	srandom(1234);
+	for (int b = 0; b < size/2; b++)
+	{
+		int x = random()%size, y = random()%size, z = random()%size;
+		int w = 1+random()%(size/8+1), h = 1+random()%(size/8+1), d = 1+random()%(size/8+1);
+		for (int i = x; i < std::min(size, x+w); i++)
+			for (int j = y; j < std::min(size, y+h); j++)
+				for (int k = z; k < std::min(size, z+d); k++)
+					blocked[voxel(i, j, k)] = true;
+	}
+	for (size_t x = 0; x < blocked.size()/50; x++)
+		blocked[random()%blocked.size()] = true;
+
+	std::vector<uint64_t> pairs;
+	for (int bx = 0; bx < size/4; bx++)
+		for (int by = 0; by < size/4; by++)
+			for (int bz = 0; bz < size/4; bz++)
+			{
+				uint64_t mask = 0;
+				for (int i = 0; i < 64; i++)
+				{
+					int x = i>>4, y = (i>>2)&3, z = i&3;
+					if (blocked[voxel(4*bx+x, 4*by+y, 4*bz+z)])
+						mask |= 1ull<<VoxelOctree::BrickBit(x, y, z);
+				}
+				if (mask == 0)
+					continue;
+				pairs.push_back(VoxelOctree::EncodeMorton(bx, by, bz));
+				pairs.push_back(mask);
+			}
+	FILE *f = fopen(file, "w");
+	uint32_t header = 0;
+	float voxelSize = 1;
+	uint64_t count = pairs.size()/2;
+	float minbounds[4] = {0, 0, 0, 0}, maxbounds[4] = {(float)size, (float)size, (float)size, 0};
+	fwrite(&header, sizeof(header), 1, f);
+	fwrite(&voxelSize, sizeof(voxelSize), 1, f);
+	fwrite(&count, sizeof(count), 1, f);
+	fwrite(minbounds, sizeof(float), 4, f);
+	fwrite(maxbounds, sizeof(float), 4, f);
+	fwrite(pairs.data(), sizeof(uint64_t), pairs.size(), f);
+	fclose(f);
+	printf("Wrote %llu grids of %d^3 voxels\n", (unsigned long long)count, size);
+}
+
+template <class environment>
+static void TimeSearches(const char *name, environment *env, const std::vector<std::pair<voxelState, voxelState>> &problems,
+						 std::vector<double> &lengths)
+{
+	TemplateAStar<voxelState, voxelAction, Voxels> astar;
+	std::vector<voxelState> path;
+	Timer t;
+	uint64_t nodes = 0;
+	t.StartTimer();
+	for (unsigned int x = 0; x < problems.size(); x++)
+	{
+		astar.GetPath(env, problems[x].first, problems[x].second, path);
+		nodes += astar.GetNodesExpanded();
+		double length = env->GetPathLength(path);
+		if (lengths.size() <= x)
+			lengths.push_back(length);
+		else if (fabs(lengths[x]-length) > 0.0001)
+			printf("Error: problem %d has length %f with %s but %f before\n", x, length, name, lengths[x]);
+	}
+	double elapsed = t.EndTimer();
+	printf("%-14s A*: %1.3fs %llu nodes %1.0f nodes/sec\n", name, elapsed, (unsigned long long)nodes, nodes/elapsed);
+}
+
+void VoxelTest(const char *file, int size, int numProblems)
+{
+	WriteWorld(file, size);
+	Timer t;
+	t.StartTimer();
+	Voxels *v = new Voxels(file);
+	printf("Loaded in %1.3fs\n", t.EndTimer());
+	OneAtATimeVoxels *naive = new OneAtATimeVoxels(file);
+
+	std::vector<voxelState> states;
+	while (states.size() < 1000000)
+	{
+		voxelState s = {(uint16_t)(random()%size), (uint16_t)(random()%size), (uint16_t)(random()%size)};
+		if (!v->IsBlocked(s))
+			states.push_back(s);
+	}
+	uint64_t sum[2] = {0, 0};
+	t.StartTimer();
+	for (auto &s : states)
+		sum[0] += v->GetLegalActions(s);
+	printf("Batched legal actions:    %1.3fs\n", t.EndTimer());
+	t.StartTimer();
+	for (auto &s : states)
+		sum[1] += naive->GetLegalActions(s);
+	printf("One neighbor at a time:   %1.3fs (%s)\n", t.EndTimer(), (sum[0] == sum[1])?"same":"DIFFERENT");
+
+	std::vector<std::pair<voxelState, voxelState>> problems;
+	for (int x = 0; x < numProblems; x++)
+		problems.push_back({states[2*x], states[2*x+1]});
+	std::vector<double> lengths;
+	TimeSearches("batched", v, problems, lengths);
+	TimeSearches("one at a time", naive, problems, lengths);
+	delete v;
+	delete naive;
+	remove(file);
+}
@@ -0,0 +1,17 @@
+//
+//  VoxelTest.h
+//  hog2
+//
+//  Loading and searching a voxel world: successors from one batched
+//  neighborhood lookup in the VoxelOctree against one lookup per neighbor.
+//
+
+#ifndef VoxelTest_h
+#define VoxelTest_h
+
+#include <stdio.h>
+// Writes a random world of size^3 voxels (boxes and noise) to file, loads it
+// and runs numProblems A* searches between random free voxels
+void VoxelTest(const char *file, int size, int numProblems);
+
+#endif /* VoxelTest_h */
@@ -0,0 +1,184 @@
+//
+//  CSRGraphEnvironment.cpp
+//  hog2
+//
+
+#include "CSRGraphEnvironment.h"
+#include <cmath>
+#include <cfloat>
+
+CSRGraphEnvironment::CSRGraphEnvironment(const CSRGraph *graph, GraphHeuristic *gh)
+:g(graph), h(gh), coordinateScale(0)
+{
+	minX = minY = 0;
+	drawScale = 1;
+	if (g->HasCoordinates() && g->GetNumNodes() > 0)
+	{
+		float maxX, maxY;
+		minX = maxX = g->GetX(0);
+		minY = maxY = g->GetY(0);
+		for (uint32_t n = 1; n < g->GetNumNodes(); n++)
+		{
+			minX = std::min(minX, g->GetX(n)); maxX = std::max(maxX, g->GetX(n));
+			minY = std::min(minY, g->GetY(n)); maxY = std::max(maxY, g->GetY(n));
+		}
+		drawScale = std::max(maxX-minX, maxY-minY);
+		if (drawScale == 0)
+			drawScale = 1;
+	}
+}
+
+CSRGraphEnvironment::~CSRGraphEnvironment()
+{
+}
+
+void CSRGraphEnvironment::GetSuccessors(const graphState &stateID, std::vector<graphState> &neighbors) const
+{
+	neighbors.resize(0);
+	uint32_t n = (uint32_t)stateID;
+	for (uint64_t e = g->EdgeBegin(n); e < g->EdgeEnd(n); e++)
+		neighbors.push_back(g->GetTarget(e));
+}
+
+void CSRGraphEnvironment::GetActions(const graphState &stateID, std::vector<graphMove> &actions) const
+{
+	actions.resize(0);
+	uint32_t n = (uint32_t)stateID;
+	for (uint64_t e = g->EdgeBegin(n); e < g->EdgeEnd(n); e++)
+		actions.push_back(graphMove(n, g->GetTarget(e)));
+}
+
+graphMove CSRGraphEnvironment::GetAction(const graphState &s1, const graphState &s2) const
+{
+	return graphMove(s1, s2);
+}
+
+void CSRGraphEnvironment::ApplyAction(graphState &s, graphMove a) const
+{
+	assert(s == a.from);
+	s = a.to;
+}
+
+bool CSRGraphEnvironment::InvertAction(graphMove &a) const
+{
+	uint32_t tmp = a.from;
+	a.from = a.to;
+	a.to = tmp;
+	return g->FindEdge(a.from, a.to) != g->GetNumEdges();
+}
+
+/**
+ * Computes the largest scale for which scale*(straight line distance) is
+ * admissible and consistent: the minimum over all edges of weight/length.
+ * Returns false if the graph has no coordinates.
+ */
+bool CSRGraphEnvironment::UseCoordinateHeuristic()
+{
+	if (!g->HasCoordinates())
+		return false;
+	double scale = DBL_MAX;
+	for (uint32_t n = 0; n < g->GetNumNodes(); n++)
+	{
+		for (uint64_t e = g->EdgeBegin(n); e < g->EdgeEnd(n); e++)
+		{
+			uint32_t t = g->GetTarget(e);
+			double dist = hypot(g->GetX(n)-g->GetX(t), g->GetY(n)-g->GetY(t));
+			if (dist > 0)
+				scale = std::min(scale, g->GetWeight(e)/dist);
+		}
+	}
+	coordinateScale = (scale == DBL_MAX)?0:scale;
+	return true;
+}
+
+double CSRGraphEnvironment::HCost(const graphState &state1, const graphState &state2) const
+{
+	if (h)
+		return h->HCost(state1, state2);
+	if (coordinateScale > 0)
+		return coordinateScale*hypot(g->GetX(state1)-g->GetX(state2), g->GetY(state1)-g->GetY(state2));
+	return 0;
+}
+
+double CSRGraphEnvironment::GCost(const graphState &state1, const graphState &state2) const
+{
+	uint64_t e = g->FindEdge(state1, state2);
+	assert(e != g->GetNumEdges());
+	return g->GetWeight(e);
+}
+
+double CSRGraphEnvironment::GCost(const graphState &, const graphMove &move) const
+{
+	return GCost(move.from, move.to);
+}
+
+bool CSRGraphEnvironment::GoalTest(const graphState &state, const graphState &goal) const
+{
+	return state == goal;
+}
+
+uint64_t CSRGraphEnvironment::GetActionHash(graphMove act) const
+{
+	return (((uint64_t)act.from)<<32)|act.to;
+}
+
+void CSRGraphEnvironment::GetDrawCoordinates(graphState s, GLdouble &x, GLdouble &y) const
+{
+	x = 2*(g->GetX(s)-minX)/drawScale-1;
+	y = -(2*(g->GetY(s)-minY)/drawScale-1);
+}
+
+void CSRGraphEnvironment::OpenGLDraw() const
+{
+	if (!g->HasCoordinates())
+		return;
+	GLfloat r, gr, b, t;
+	GetColor(r, gr, b, t);
+	glColor4f(r, gr, b, t);
+	glBegin(GL_LINES);
+	for (uint32_t n = 0; n < g->GetNumNodes(); n++)
+	{
+		for (uint64_t e = g->EdgeBegin(n); e < g->EdgeEnd(n); e++)
+		{
+			GLdouble x, y;
+			GetDrawCoordinates(n, x, y);
+			glVertex3f(x, y, 0);
+			GetDrawCoordinates(g->GetTarget(e), x, y);
+			glVertex3f(x, y, 0);
+		}
+	}
+	glEnd();
+}
+
+void CSRGraphEnvironment::OpenGLDraw(const graphState &s) const
+{
+	if (!g->HasCoordinates())
+		return;
+	GLfloat r, gr, b, t;
+	GetColor(r, gr, b, t);
+	glColor4f(r, gr, b, t);
+	GLdouble x, y;
+	GetDrawCoordinates(s, x, y);
+	DrawSphere(x, y, 0, 0.01);
+}
+
+void CSRGraphEnvironment::OpenGLDraw(const graphState &s, const graphMove &gm) const
+{
+	GLDrawLine(gm.from, gm.to);
+}
+
+void CSRGraphEnvironment::GLDrawLine(const graphState &a, const graphState &b) const
+{
+	if (!g->HasCoordinates())
+		return;
+	GLfloat r, gr, bl, t;
+	GetColor(r, gr, bl, t);
+	glColor4f(r, gr, bl, t);
+	GLdouble x, y;
+	glBegin(GL_LINES);
+	GetDrawCoordinates(a, x, y);
+	glVertex3f(x, y, 0);
+	GetDrawCoordinates(b, x, y);
+	glVertex3f(x, y, 0);
+	glEnd();
+}
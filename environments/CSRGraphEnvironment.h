@@ -0,0 +1,66 @@
+//
+//  CSRGraphEnvironment.h
+//  hog2
+//
+//  Search on an immutable CSRGraph.
+//
+
+#ifndef CSRGRAPHENVIRONMENT_H
+#define CSRGRAPHENVIRONMENT_H
+
+#include "GraphEnvironment.h"
+#include "CSRGraph.h"
+
+/**
+ * A GraphEnvironment for CSRGraph: the same states (node ids) and actions,
+ * but successors are read from contiguous arrays instead of node and edge
+ * objects. Edges are directed; build the CSRGraph undirected to search an
+ * undirected graph.
+ *
+ * Without a GraphHeuristic the heuristic is 0 (Dijkstra) unless
+ * UseCoordinateHeuristic() is called, which scales straight line distance
+ * by the smallest weight/length ratio of any edge so it stays admissible.
+ */
+class CSRGraphEnvironment : public SearchEnvironment<graphState, graphMove> {
+public:
+	CSRGraphEnvironment(const CSRGraph *g, GraphHeuristic *gh = 0);
+	virtual ~CSRGraphEnvironment();
+	virtual void GetSuccessors(const graphState &stateID, std::vector<graphState> &neighbors) const;
+	virtual void GetActions(const graphState &stateID, std::vector<graphMove> &actions) const;
+	virtual graphMove GetAction(const graphState &s1, const graphState &s2) const;
+	virtual void ApplyAction(graphState &s, graphMove a) const;
+	virtual bool InvertAction(graphMove &a) const;
+
+	virtual double HCost(const graphState &state1, const graphState &state2) const;
+	virtual double GCost(const graphState &state1, const graphState &state2) const;
+	virtual double GCost(const graphState &state1, const graphMove &move) const;
+	virtual bool GoalTest(const graphState &state, const graphState &goal) const;
+	virtual uint64_t GetMaxHash() const { return g->GetNumNodes(); }
+	virtual uint64_t GetStateHash(const graphState &state) const { return state; }
+	virtual void GetStateFromHash(uint64_t hash, graphState &s) const { s = hash; }
+	virtual uint64_t GetActionHash(graphMove act) const;
+	virtual void OpenGLDraw() const;
+	virtual void OpenGLDraw(const graphState &s) const;
+	virtual void OpenGLDraw(const graphState &s, const graphMove &gm) const;
+	virtual void GLDrawLine(const graphState &x, const graphState &y) const;
+
+	virtual double HCost(const graphState &) const {
+		fprintf(stderr, "ERROR: Single State HCost not implemented for CSRGraphEnvironment\n");
+		exit(1); return -1.0;}
+	virtual bool GoalTest(const graphState &) const {
+		fprintf(stderr, "ERROR: Single State Goal Test not implemented for CSRGraphEnvironment\n");
+		exit(1); return false;
+	}
+
+	const CSRGraph *GetGraph() const { return g; }
+	bool UseCoordinateHeuristic();
+	double GetCoordinateScale() const { return coordinateScale; }
+private:
+	void GetDrawCoordinates(graphState s, GLdouble &x, GLdouble &y) const;
+	const CSRGraph *g;
+	GraphHeuristic *h;
+	double coordinateScale;
+	float minX, minY, drawScale;
+};
+
+#endif
@@ -0,0 +1,233 @@
+//
+//  FixedMNPuzzle.h
+//  hog2
+//
+//  A sliding-tile puzzle whose size is fixed at compile time.
+//
+
+#ifndef FIXEDMNPUZZLE_H
+#define FIXEDMNPUZZLE_H
+
+#include <array>
+#include <stdint.h>
+#include <stdlib.h>
+#include "SearchEnvironment.h"
+#include "MNPuzzle.h"
+
+/**
+ * Tiles are stored by location in a std::array<uint8_t>, so states can be
+ * copied and compared without allocating. The actions (slideDir) and the
+ * meaning of the locations are the same as in MNPuzzleState.
+ */
+template <int width, int height>
+class FixedMNPuzzleState {
+public:
+	FixedMNPuzzleState() { Reset(); }
+	FixedMNPuzzleState(const MNPuzzleState &s)
+	{
+		assert(s.width == width && s.height == height);
+		for (int x = 0; x < width*height; x++)
+			puzzle[x] = s.puzzle[x];
+		blank = s.blank;
+	}
+	void Reset()
+	{
+		for (int x = 0; x < width*height; x++)
+			puzzle[x] = x;
+		blank = 0;
+	}
+	MNPuzzleState GetMNPuzzleState() const
+	{
+		MNPuzzleState s(width, height);
+		for (int x = 0; x < width*height; x++)
+			s.puzzle[x] = puzzle[x];
+		s.blank = blank;
+		return s;
+	}
+	static constexpr int size() { return width*height; }
+
+	std::array<uint8_t, width*height> puzzle;
+	uint8_t blank;
+};
+
+template <int width, int height>
+static bool operator==(const FixedMNPuzzleState<width, height> &l1, const FixedMNPuzzleState<width, height> &l2)
+{
+	return l1.blank == l2.blank && l1.puzzle == l2.puzzle;
+}
+
+template <int width, int height>
+static bool operator!=(const FixedMNPuzzleState<width, height> &l1, const FixedMNPuzzleState<width, height> &l2)
+{
+	return !(l1 == l2);
+}
+
+template <int width, int height>
+static std::ostream& operator <<(std::ostream & out, const FixedMNPuzzleState<width, height> &loc)
+{
+	out << "(" << width << "x" << height << ")";
+	for (int x = 0; x < width*height; x++)
+		out << (int)loc.puzzle[x] << " ";
+	return out;
+}
+
+template <int width, int height>
+class FixedMNPuzzle : public SearchEnvironment<FixedMNPuzzleState<width, height>, slideDir> {
+public:
+	typedef FixedMNPuzzleState<width, height> puzzleState;
+	FixedMNPuzzle();
+	FixedMNPuzzle(const std::vector<slideDir> &op_order);
+
+	void GetSuccessors(const puzzleState &s, std::vector<puzzleState> &neighbors) const;
+	void GetActions(const puzzleState &s, std::vector<slideDir> &actions) const;
+	slideDir GetAction(const puzzleState &s1, const puzzleState &s2) const;
+	inline void ApplyAction(puzzleState &s, slideDir a) const;
+	void UndoAction(puzzleState &s, slideDir a) const
+	{ InvertAction(a); ApplyAction(s, a); }
+	bool InvertAction(slideDir &a) const;
+	// The change in the blank location when applying a
+	static int GetBlankOffset(slideDir a);
+
+	double HCost(const puzzleState &s1, const puzzleState &s2) const;
+	double GCost(const puzzleState &, const puzzleState &) const { return 1; }
+	double GCost(const puzzleState &, const slideDir &) const { return 1; }
+	bool GoalTest(const puzzleState &s, const puzzleState &goal) const { return s == goal; }
+
+	uint64_t GetStateHash(const puzzleState &s) const;
+	uint64_t GetActionHash(slideDir act) const { return act; }
+
+	void OpenGLDraw() const {}
+	void OpenGLDraw(const puzzleState &) const {}
+	void OpenGLDraw(const puzzleState &, const slideDir &) const {}
+private:
+	// applicable operators at each blank location
+	std::array<std::array<slideDir, 4>, width*height> operators;
+	std::array<uint8_t, width*height> numOperators;
+};
+
+template <int width, int height>
+FixedMNPuzzle<width, height>::FixedMNPuzzle()
+:FixedMNPuzzle(MNPuzzle::Get_Op_Order_From_Hash(15)) // same default order as MNPuzzle
+{
+}
+
+template <int width, int height>
+FixedMNPuzzle<width, height>::FixedMNPuzzle(const std::vector<slideDir> &op_order)
+{
+	assert(op_order.size() == 4);
+	for (int blank = 0; blank < width*height; blank++)
+	{
+		numOperators[blank] = 0;
+		for (slideDir op : op_order)
+		{
+			if ((op == kUp && blank >= width) ||
+				(op == kLeft && blank%width > 0) ||
+				(op == kRight && blank%width < width-1) ||
+				(op == kDown && blank < width*height-width))
+				operators[blank][numOperators[blank]++] = op;
+		}
+	}
+}
+
+template <int width, int height>
+void FixedMNPuzzle<width, height>::GetSuccessors(const puzzleState &s, std::vector<puzzleState> &neighbors) const
+{
+	neighbors.resize(numOperators[s.blank]);
+	for (int x = 0; x < numOperators[s.blank]; x++)
+	{
+		neighbors[x] = s;
+		ApplyAction(neighbors[x], operators[s.blank][x]);
+	}
+}
+
+template <int width, int height>
+void FixedMNPuzzle<width, height>::GetActions(const puzzleState &s, std::vector<slideDir> &actions) const
+{
+	actions.assign(operators[s.blank].begin(), operators[s.blank].begin()+numOperators[s.blank]);
+}
+
+template <int width, int height>
+slideDir FixedMNPuzzle<width, height>::GetAction(const puzzleState &s1, const puzzleState &s2) const
+{
+	switch (s2.blank-s1.blank)
+	{
+		case -width: return kUp;
+		case width: return kDown;
+		case -1: return kLeft;
+		default: return kRight;
+	}
+}
+
+template <int width, int height>
+int FixedMNPuzzle<width, height>::GetBlankOffset(slideDir a)
+{
+	switch (a)
+	{
+		case kUp: return -width;
+		case kDown: return width;
+		case kLeft: return -1;
+		default: return 1;
+	}
+}
+
+template <int width, int height>
+void FixedMNPuzzle<width, height>::ApplyAction(puzzleState &s, slideDir a) const
+{
+	int next = s.blank+GetBlankOffset(a);
+	assert(next >= 0 && next < width*height);
+	s.puzzle[s.blank] = s.puzzle[next];
+	s.puzzle[next] = 0;
+	s.blank = next;
+}
+
+template <int width, int height>
+bool FixedMNPuzzle<width, height>::InvertAction(slideDir &a) const
+{
+	switch (a)
+	{
+		case kLeft: a = kRight; break;
+		case kUp: a = kDown; break;
+		case kDown: a = kUp; break;
+		case kRight: a = kLeft; break;
+	}
+	return true;
+}
+
+/** Manhattan distance */
+template <int width, int height>
+double FixedMNPuzzle<width, height>::HCost(const puzzleState &s1, const puzzleState &s2) const
+{
+	std::array<uint8_t, width*height> goalLoc;
+	for (int x = 0; x < width*height; x++)
+		goalLoc[s2.puzzle[x]] = x;
+	int dist = 0;
+	for (int x = 0; x < width*height; x++)
+	{
+		if (s1.puzzle[x] == 0)
+			continue;
+		int g = goalLoc[s1.puzzle[x]];
+		dist += abs(g%width-x%width)+abs(g/width-x/width);
+	}
+	return dist;
+}
+
+/**
+ * Perfect for up to 16 tiles (4 bits per tile). Larger puzzles have more
+ * states than fit in 64 bits, so the hash is not unique.
+ */
+template <int width, int height>
+uint64_t FixedMNPuzzle<width, height>::GetStateHash(const puzzleState &s) const
+{
+	uint64_t hash = 0;
+	if (width*height <= 16)
+	{
+		for (int x = 0; x < width*height; x++)
+			hash = (hash<<4)|s.puzzle[x];
+		return hash;
+	}
+	for (int x = 0; x < width*height; x++)
+		hash = (hash^s.puzzle[x])*1099511628211ull;
+	return hash;
+}
+
+#endif
@@ -11,6 +11,13 @@
 #include "GLUtil.h"
 #include "Heap.h"
 #include "FloydWarshall.h"
+#include "WorkerPool.h"
+#include <string.h>
+#include <float.h>
+#include <queue>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using namespace GraphSearchConstants;
 
@@ -788,11 +795,11 @@ double GraphMapInconsistentHeuristic::HCost(const graphState &state1, const grap
 	//for (unsigned int x = 0; x < heuristics.size(); x++)
 	if (hmode == kRandom)
 	{
-		int x = (x1+x2+y1+y2)%heuristics.size();
+		int x = (x1+x2+y1+y2)%locations.size();
 		for (int y = 0; y < numHeuristics; y++)
 		{
-			int offset = heuristics.size()/numHeuristics;
-			double hval = heuristics[(x+y*offset)%heuristics.size()][state1]-heuristics[(x+y*offset)%heuristics.size()][state2];
+			int offset = locations.size()/numHeuristics;
+			double hval = Distance((x+y*offset)%locations.size(), state1)-Distance((x+y*offset)%locations.size(), state2);
 			if (hval < 0) hval = -hval;
 			if (fgreater(hval, val))
 				val = hval;
@@ -800,9 +807,9 @@ double GraphMapInconsistentHeuristic::HCost(const graphState &state1, const grap
 	}
 	else if (hmode == kMax) // hmode == 2, taking the max
 	{
-		for (unsigned int i = 0; i < heuristics.size() && i < (unsigned int)numHeuristics; i++)
+		for (unsigned int i = 0; i < locations.size() && i < (unsigned int)numHeuristics; i++)
 		{
-			double hval = heuristics[i][state1]-heuristics[i][state2];
+			double hval = Distance(i, state1)-Distance(i, state2);
 			if (hval < 0)
 				hval = -hval;
 			if (fgreater(hval,val))
@@ -813,9 +820,9 @@ double GraphMapInconsistentHeuristic::HCost(const graphState &state1, const grap
 	{
 		if ( (x1+x2) % 4 == 0 && (y1+y2) % 4 == 0)
 		{
-			for (unsigned int i=0;i<heuristics.size();i++)
+			for (unsigned int i=0;i<locations.size();i++)
 			{
-				double hval = heuristics[i][state1]-heuristics[i][state2];
+				double hval = Distance(i, state1)-Distance(i, state2);
 				if (hval < 0)
 					hval = -hval;
 				if (fgreater(hval,val))
@@ -840,9 +847,9 @@ double GraphMapInconsistentHeuristic::HCost(const graphState &state1, const grap
 		
 		if (compressed)
 		{
-			for (unsigned int x = 0; x < heuristics.size(); x++)
+			for (unsigned int x = 0; x < locations.size(); x++)
 			{
-				double hval = vals[x*numHeuristics+state1%numHeuristics]-heuristics[x][state1];
+				double hval = vals[x*numHeuristics+state1%numHeuristics]-Distance(x, state1);
 				if (hval < 0)
 					hval = -hval;
 				hval -= errors[x*numHeuristics+state1%numHeuristics];
@@ -851,9 +858,9 @@ double GraphMapInconsistentHeuristic::HCost(const graphState &state1, const grap
 			}
 		}
 		else {
-			for (unsigned int x = (state1%numHeuristics); x < heuristics.size(); x+=numHeuristics)
+			for (unsigned int x = (state1%numHeuristics); x < locations.size(); x+=numHeuristics)
 			{
-				double hval = vals[x]-heuristics[x][state1];
+				double hval = vals[x]-Distance(x, state1);
 				if (hval < 0)
 					hval = -hval;
 				hval -= errors[x];
@@ -872,15 +879,20 @@ void GraphMapInconsistentHeuristic::Compress()
 	hmode = kCompressed;
 	compressed = true;
 
-	for (unsigned int state1 = 0; state1 < heuristics[0].size(); state1++)
+	for (int state1 = 0; state1 < g->GetNumNodes(); state1++)
 	{
-		for (unsigned int x = (state1%numHeuristics), y = 0; x < heuristics.size(); x+=numHeuristics, y++)
+		for (unsigned int x = (state1%numHeuristics), y = 0; x < locations.size(); x+=numHeuristics, y++)
 		{
-			heuristics[y][state1] = heuristics[x][state1];
+			SetDistance(y, state1, Distance(x, state1));
 		}
 	}
-	assert((heuristics.size()%numHeuristics) == 0);
-	heuristics.resize(heuristics.size()/numHeuristics);
+	assert((locations.size()%numHeuristics) == 0);
+	// the columns past the last pivot must be 0 for GraphDistanceHeuristic::HCost
+	unsigned int count = locations.size()/numHeuristics;
+	for (int state1 = 0; state1 < g->GetNumNodes(); state1++)
+		for (unsigned int x = count; x < locations.size(); x++)
+			SetDistance(x, state1, 0);
+	locations.resize(count);
 }
 
 void GraphMapInconsistentHeuristic::FillInCache(std::vector<double> &vals,
@@ -897,12 +909,12 @@ void GraphMapInconsistentHeuristic::FillInCache(std::vector<double> &vals,
 	}
 	if (!compressed)
 	{
-		unused = heuristics.size(); // set these values to the uncompressed size
-		vals.resize(heuristics.size());
-		errors.resize(heuristics.size());
+		unused = locations.size(); // set these values to the uncompressed size
+		vals.resize(locations.size());
+		errors.resize(locations.size());
 	}
 	else {
-		unused = numHeuristics*heuristics.size();
+		unused = numHeuristics*locations.size();
 		vals.resize(unused);
 		errors.resize(unused);
 	}
@@ -917,17 +929,17 @@ void GraphMapInconsistentHeuristic::FillInCache(std::vector<double> &vals,
 
 	if (!compressed)
 	{
-		for (unsigned int x = (state2%numHeuristics); x < heuristics.size(); x+=numHeuristics)
+		for (unsigned int x = (state2%numHeuristics); x < locations.size(); x+=numHeuristics)
 		{
-			vals[x] = heuristics[x][state2];
+			vals[x] = Distance(x, state2);
 			errors[x] = 0;
 			unused--;
 		}
 	}
 	else {
-		for (unsigned int x = 0; x < heuristics.size(); x++)
+		for (unsigned int x = 0; x < locations.size(); x++)
 		{
-			vals[x*numHeuristics+state2%numHeuristics] = heuristics[x][state2];
+			vals[x*numHeuristics+state2%numHeuristics] = Distance(x, state2);
 			errors[x*numHeuristics+state2%numHeuristics] = 0;
 			unused--;
 		}
@@ -945,23 +957,23 @@ void GraphMapInconsistentHeuristic::FillInCache(std::vector<double> &vals,
 
 			if (compressed)
 			{
-				for (unsigned int x = 0; x < heuristics.size(); x++)
+				for (unsigned int x = 0; x < locations.size(); x++)
 				{
 					if (vals[x*numHeuristics+tmp%numHeuristics] == -1)
 					{
 						unused--;
-						vals[x*numHeuristics+tmp%numHeuristics] = heuristics[x][tmp];
+						vals[x*numHeuristics+tmp%numHeuristics] = Distance(x, tmp);
 						errors[x*numHeuristics+tmp%numHeuristics] = cost+edgeCost;
 					}
 				}
 			}
 			else {
-				for (unsigned int x = (tmp%numHeuristics); x < heuristics.size(); x+=numHeuristics)
+				for (unsigned int x = (tmp%numHeuristics); x < locations.size(); x+=numHeuristics)
 				{
 					if (vals[x] == -1)
 					{
 						unused--;
-						vals[x] = heuristics[x][tmp];
+						vals[x] = Distance(x, tmp);
 						errors[x] = cost+edgeCost;
 					}
 				}
@@ -989,7 +1001,7 @@ void GraphMapInconsistentHeuristic::OpenGLDraw() const
 {
 	//static int counter = 50;
 	//counter = (counter+1);
-	if (heuristics.size() == 0)
+	if (locations.size() == 0)
 	{
 		printf("No heuristics\n");
 		return;
@@ -1003,31 +1015,31 @@ void GraphMapInconsistentHeuristic::OpenGLDraw() const
 	GraphEnvironment ge(m, g, 0);
 
 	double max = 0;
-	for (unsigned int a = 0; a < heuristics.back().size(); a++)
+	for (unsigned int a = 0; a < g->GetNumNodes(); a++)
 	{
-		if (heuristics.back()[a] > max)
-			max = heuristics.back()[a];
+		if (Distance(locations.size()-1, a) > max)
+			max = Distance(locations.size()-1, a);
 	}
 	
-	for (unsigned int a = 0; a < heuristics.back().size(); a++)
+	for (unsigned int a = 0; a < g->GetNumNodes(); a++)
 	{
 //		GLdouble x, y, z;
 		if ((hmode == kCompressed) &&
-			((a%heuristics.size() != displayHeuristic) || (heuristics.size() == displayHeuristic)))
+			((a%locations.size() != displayHeuristic) || (locations.size() == displayHeuristic)))
 			continue;
 		node *n = g->GetNode(a);
 		
 		if (n)
 		{
-			if (heuristics.size() == displayHeuristic)
+			if (locations.size() == displayHeuristic)
 			{
-				ge.SetColor(heuristics[a%heuristics.size()][a]/max, 0, 1-heuristics[a%heuristics.size()][a]/max, 1);
+				ge.SetColor(Distance(a%locations.size(), a)/max, 0, 1-Distance(a%locations.size(), a)/max, 1);
 				ge.OpenGLDraw(a);
 			}
 			else {
-				if (heuristics[displayHeuristic][a] != 0)
+				if (Distance(displayHeuristic, a) != 0)
 				{
-					ge.SetColor(heuristics[displayHeuristic][a]/max, 0, 1-heuristics[displayHeuristic][a]/max, 1);
+					ge.SetColor(Distance(displayHeuristic, a)/max, 0, 1-Distance(displayHeuristic, a)/max, 1);
 					ge.OpenGLDraw(a);
 				}
 				else {
@@ -1052,7 +1064,7 @@ void GraphDistanceHeuristic::OpenGLDraw() const
 {
 	//static int counter = 50;
 	//counter = (counter+1);
-	if (heuristics.size() == 0)
+	if (locations.size() == 0)
 		return;
 
 	double approxSize = 2.0/sqrt(g->GetNumNodes());
@@ -1097,34 +1109,61 @@ void GraphDistanceHeuristic::OpenGLDraw() const
 	}
 }
 
-double GraphDistanceHeuristic::HCost(const graphState &state1, const graphState &state2) const
-{
-	double val = 0;
-	for (unsigned int i = 0; i < heuristics.size(); i++)
+namespace {
+	/** The largest |a[x]-b[x]|; count is a multiple of 2 */
+	inline double MaxDifference(const double *a, const double *b, unsigned int count)
 	{
-		double hval = heuristics[i][state1]-heuristics[i][state2];
-		if (hval < 0)
-			hval = -hval;
-		if (fgreater(hval,val))
-			val = hval;
+#ifdef __SSE2__
+		const __m128d sign = _mm_set1_pd(-0.0);
+		__m128d best = _mm_setzero_pd();
+		for (unsigned int x = 0; x < count; x += 2)
+		{
+			__m128d diff = _mm_sub_pd(_mm_loadu_pd(a+x), _mm_loadu_pd(b+x));
+			best = _mm_max_pd(best, _mm_andnot_pd(sign, diff));
+		}
+		best = _mm_max_sd(best, _mm_unpackhi_pd(best, best));
+		return _mm_cvtsd_f64(best);
+#else
+		double best = 0;
+		for (unsigned int x = 0; x < count; x++)
+			best = std::max(best, fabs(a[x]-b[x]));
+		return best;
+#endif
 	}
-	return val;
+
+	const char dhFileMagic[8] = "HOG2DH";
+	const uint32_t dhFileVersion = 1;
+
+	struct DHFileHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t numHeuristics;
+		uint64_t numNodes;
+	};
+}
+
+double GraphDistanceHeuristic::HCost(const graphState &state1, const graphState &state2) const
+{
+	if (locations.size() == 0)
+		return 0;
+	// the padding after the last pivot is 0 for every node
+	return MaxDifference(&distances[state1*stride], &distances[state2*stride], (locations.size()+1)&~1);
 }
 
 void GraphDistanceHeuristic::ChooseStartGoal(graphState &start, graphState &goal)
 {
-	if (heuristics.size() == 0)
+	if (locations.size() == 0)
 		return;
 	double minStart=-1, minGoal=-1;
 
-	minStart = heuristics[0][start];
-	minGoal = heuristics[0][goal];
-	for (unsigned int x = 1; x < heuristics.size(); x++)
+	minStart = Distance(0, start);
+	minGoal = Distance(0, goal);
+	for (unsigned int x = 1; x < locations.size(); x++)
 	{
-		if (heuristics[x][start] < minStart)
-			minStart = heuristics[x][start];
-		if (heuristics[x][goal] < minGoal)
-			minGoal = heuristics[x][goal];
+		if (Distance(x, start) < minStart)
+			minStart = Distance(x, start);
+		if (Distance(x, goal) < minGoal)
+			minGoal = Distance(x, goal);
 	}
 	if (minStart < minGoal)
 	{
@@ -1152,55 +1191,166 @@ void GraphDistanceHeuristic::AddHeuristic(node *n)
 
 void GraphDistanceHeuristic::AddHeuristic(std::vector<double> &values, graphState location)
 {
-	heuristics.push_back(values);
+	// grow by doubling, so adding pivots one at a time copies the table
+	// O(log pivots) times
+	if (locations.size() == stride)
+		ReserveHeuristics(std::max(2u, 2*stride));
 	locations.push_back(location);
+	for (graphState n = 0; n < values.size(); n++)
+		SetDistance(locations.size()-1, n, values[n]);
 }
 
+void GraphDistanceHeuristic::AddHeuristics(const std::vector<graphState> &pivots, int numThreads)
+{
+	size_t first = locations.size();
+	ReserveHeuristics(first+pivots.size());
+	locations.insert(locations.end(), pivots.begin(), pivots.end());
+	WorkerPool pool(numThreads);
+	WorkStealingRange work(pool.NumThreads());
+	work.Reset(pivots.size());
+	pool.Run([&](int t) {
+		std::vector<double> values;
+		uint64_t next;
+		while (work.Next(t, next))
+		{
+			GetOptimalDistances(pivots[next], values);
+			for (graphState n = 0; n < values.size(); n++)
+				SetDistance(first+next, n, values[n]);
+		}
+	});
+}
 
+void GraphDistanceHeuristic::ReserveHeuristics(unsigned int count)
+{
+	if (count <= stride)
+		return;
+	// an even stride, so HCost can take two pivots at a time; the unused
+	// columns are 0
+	unsigned int newStride = (count+1)&~1;
+	const uint64_t numNodes = g->GetNumNodes();
+	std::vector<double> table(numNodes*newStride, 0.0);
+	for (uint64_t n = 0; n < numNodes; n++)
+		for (unsigned int i = 0; i < locations.size(); i++)
+			table[n*newStride+i] = distances[n*stride+i];
+	distances.swap(table);
+	stride = newStride;
+}
 
-void GraphDistanceHeuristic::GetOptimalDistances(node *n, std::vector<double> &values)
+bool GraphDistanceHeuristic::Save(const char *file) const
 {
-	values.resize(g->GetNumNodes());
-	for (unsigned int x = 0; x < values.size(); x++)
-		values[x] = -1.0;
-	n->SetLabelF(kTemporaryLabel, 0.0);
-	n->SetKeyLabel(kTemporaryLabel);
-	Heap h;
-	h.Add(n);
-	while (!h.Empty())
+	FILE *f = fopen(file, "w+b");
+	if (f == 0)
 	{
-		node *next = (node*)h.Remove();
-//		printf("Heap size %d, working on node %d cost %f\n", h.size(), next->GetNum(),
-//			   next->GetLabelF(kTemporaryLabel));
-		double cost = next->GetLabelF(kTemporaryLabel);
-		values[next->GetNum()] = next->GetLabelF(kTemporaryLabel);
-		neighbor_iterator ni = next->getNeighborIter();
-		for (long tmp = next->nodeNeighborNext(ni); tmp != -1; tmp = next->nodeNeighborNext(ni))
+		perror("Opening differential heuristic");
+		return false;
+	}
+	DHFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, dhFileMagic, sizeof(header.magic));
+	header.version = dhFileVersion;
+	header.numHeuristics = locations.size();
+	header.numNodes = g->GetNumNodes();
+	bool result = (fwrite(&header, sizeof(header), 1, f) == 1);
+	// the file has the distances of one pivot after another
+	std::vector<double> values(header.numNodes);
+	for (unsigned int i = 0; result && i < locations.size(); i++)
+	{
+		uint64_t location = locations[i];
+		for (graphState n = 0; n < values.size(); n++)
+			values[n] = Distance(i, n);
+		result = (fwrite(&location, sizeof(location), 1, f) == 1) &&
+			(fwrite(values.data(), sizeof(double), values.size(), f) == values.size());
+	}
+	fclose(f);
+	return result;
+}
+
+bool GraphDistanceHeuristic::Load(const char *file)
+{
+	FILE *f = fopen(file, "rb");
+	if (f == 0)
+	{
+		perror("Opening differential heuristic");
+		return false;
+	}
+	DHFileHeader header;
+	if (fread(&header, sizeof(header), 1, f) != 1 ||
+		memcmp(header.magic, dhFileMagic, sizeof(header.magic)) != 0)
+	{
+		printf("Error: '%s' is not a differential heuristic file\n", file);
+		fclose(f);
+		return false;
+	}
+	if (header.version != dhFileVersion || header.numNodes != (uint64_t)g->GetNumNodes())
+	{
+		printf("Error: differential heuristic file version %u for %llu nodes; expected %u for %d nodes\n",
+			   header.version, (unsigned long long)header.numNodes, dhFileVersion, g->GetNumNodes());
+		fclose(f);
+		return false;
+	}
+	// read into a new heuristic, so that a truncated file leaves this one alone
+	GraphDistanceHeuristic loaded(g);
+	loaded.ReserveHeuristics(header.numHeuristics);
+	std::vector<double> values(header.numNodes);
+	bool result = true;
+	for (unsigned int i = 0; result && i < header.numHeuristics; i++)
+	{
+		uint64_t location;
+		result = (fread(&location, sizeof(location), 1, f) == 1) &&
+			(fread(values.data(), sizeof(double), header.numNodes, f) == header.numNodes);
+		if (result)
+			loaded.AddHeuristic(values, location);
+	}
+	fclose(f);
+	if (!result)
+	{
+		printf("Error: '%s' is truncated\n", file);
+		return false;
+	}
+	locations.swap(loaded.locations);
+	distances.swap(loaded.distances);
+	stride = loaded.stride;
+	return true;
+}
+
+void GraphDistanceHeuristic::GetOptimalDistances(graphState from, std::vector<double> &values) const
+{
+	// Dijkstra that only reads the graph (no node labels or Heap), so several
+	// pivots can be done at once
+	typedef std::pair<double, graphState> entry;
+	std::priority_queue<entry, std::vector<entry>, std::greater<entry> > open;
+	std::vector<double> best(g->GetNumNodes(), DBL_MAX);
+	values.assign(g->GetNumNodes(), -1.0);
+	best[from] = 0;
+	open.push(entry(0, from));
+	while (!open.empty())
+	{
+		entry next = open.top();
+		open.pop();
+		if (values[next.second] != -1)
+			continue;
+		values[next.second] = next.first;
+		const node *n = g->GetNode(next.second);
+		edge_iterator ei = n->getEdgeIter();
+		for (edge *e = n->edgeIterNext(ei); e; e = n->edgeIterNext(ei))
 		{
-			if (values[tmp] == -1)
+			// edges are followed in both directions
+			graphState to = (e->getFrom() == next.second)?e->getTo():e->getFrom();
+			double cost = next.first+e->GetWeight();
+			if (values[to] == -1 && cost < best[to])
 			{
-				node *nb = g->GetNode(tmp);
-				if (h.IsIn(nb))
-				{
-					if (fgreater(nb->GetLabelF(kTemporaryLabel),
-								 cost + g->FindEdge(next->GetNum(), tmp)->GetWeight()))
-					{
-						nb->SetLabelF(kTemporaryLabel,
-									  cost+g->FindEdge(next->GetNum(), tmp)->GetWeight());
-						h.DecreaseKey(nb);
-					}
-				}
-				else {
-					nb->SetKeyLabel(kTemporaryLabel);
-					nb->SetLabelF(kTemporaryLabel,
-								  cost+g->FindEdge(next->GetNum(), tmp)->GetWeight());
-					h.Add(nb);
-				}
+				best[to] = cost;
+				open.push(entry(cost, to));
 			}
 		}
 	}
 }
 
+void GraphDistanceHeuristic::GetOptimalDistances(node *n, std::vector<double> &values)
+{
+	GetOptimalDistances(n->GetNum(), values);
+}
+
 node *GraphDistanceHeuristic::FindAvoidNode(node *n)
 {
 	if (locations.size() == 0)
@@ -1211,18 +1361,18 @@ node *GraphDistanceHeuristic::FindAvoidNode(node *n)
 	{
 		int bestSum = MAXINT;
 		int bestId = 0;
-		for (unsigned int x = 0; x < heuristics[0].size(); x+=1)
+		for (int x = 0; x < g->GetNumNodes(); x+=1)
 		//for (unsigned int x = 0; x < 5; x++)
 		{
-			if (heuristics[0][x] == -1)
+			if (Distance(0, x) == -1)
 				continue;
 			int sum = 0;
-			for (unsigned int y = 0; y < heuristics.size(); y++)
-				sum += heuristics[y][x];
+			for (unsigned int y = 0; y < locations.size(); y++)
+				sum += Distance(y, x);
 			int diff = 0;
-			sum /= heuristics.size();
-			for (unsigned int y = 0; y < heuristics.size(); y++)
-				diff = max(diff, fabs(sum-heuristics[y][x]));
+			sum /= locations.size();
+			for (unsigned int y = 0; y < locations.size(); y++)
+				diff = max(diff, fabs(sum-Distance(y, x)));
 			if (diff < bestSum)
 			{
 				bestId = x;
@@ -223,22 +223,22 @@ class TieBreaking3D {
     }
     return (fgreater(ci1.g+ci1.h, ci2.g+ci2.h));
   }
-    static OpenClosedInterface<state,AStarOpenClosedData<state>>* openList;
-    static ConstrainedEnvironment<state,action>* currentEnv;
-    static uint8_t currentAgent;
+    static thread_local OpenClosedInterface<state,AStarOpenClosedData<state>>* openList;
+    static thread_local ConstrainedEnvironment<state,action>* currentEnv;
+    static thread_local uint8_t currentAgent;
     static unsigned collchecks;
     static bool randomalg;
     static bool useCAT;
-    static NonUnitTimeCAT<state,action>* CAT; // Conflict Avoidance Table
+    static thread_local NonUnitTimeCAT<state,action>* CAT; // Conflict Avoidance Table
     static double agentRadius;
 };
 
 template <typename state, typename action>
-OpenClosedInterface<state,AStarOpenClosedData<state>>* TieBreaking3D<state,action>::openList=0;
+thread_local OpenClosedInterface<state,AStarOpenClosedData<state>>* TieBreaking3D<state,action>::openList=0;
 template <typename state, typename action>
-ConstrainedEnvironment<state,action>* TieBreaking3D<state,action>::currentEnv=0;
+thread_local ConstrainedEnvironment<state,action>* TieBreaking3D<state,action>::currentEnv=0;
 template <typename state, typename action>
-uint8_t TieBreaking3D<state,action>::currentAgent=0;
+thread_local uint8_t TieBreaking3D<state,action>::currentAgent=0;
 template <typename state, typename action>
 unsigned TieBreaking3D<state,action>::collchecks=0;
 template <typename state, typename action>
@@ -248,7 +248,7 @@ bool TieBreaking3D<state,action>::useCAT=false;
 template <typename state, typename action>
 double TieBreaking3D<state,action>::agentRadius=0.25;
 template <typename state, typename action>
-NonUnitTimeCAT<state,action>* TieBreaking3D<state,action>::CAT=0;
+thread_local NonUnitTimeCAT<state,action>* TieBreaking3D<state,action>::CAT=0;
 
 template <typename state, typename action>
 class UnitTieBreaking3D {
@@ -321,22 +321,22 @@ class UnitTieBreaking3D {
       }
       return (fgreater(ci1.g+ci1.h, ci2.g+ci2.h));
     }
-    static OpenClosedInterface<state,AStarOpenClosedData<state>>* openList;
-    static ConstrainedEnvironment<state,action>* currentEnv;
-    static uint8_t currentAgent;
+    static thread_local OpenClosedInterface<state,AStarOpenClosedData<state>>* openList;
+    static thread_local ConstrainedEnvironment<state,action>* currentEnv;
+    static thread_local uint8_t currentAgent;
     static unsigned collchecks;
     static bool randomalg;
     static bool useCAT;
     static double agentRadius;
-    static UnitTimeCAT<state,action>* CAT; // Conflict Avoidance Table
+    static thread_local UnitTimeCAT<state,action>* CAT; // Conflict Avoidance Table
 };
 
 template <typename state, typename action>
-OpenClosedInterface<state,AStarOpenClosedData<state>>* UnitTieBreaking3D<state,action>::openList=0;
+thread_local OpenClosedInterface<state,AStarOpenClosedData<state>>* UnitTieBreaking3D<state,action>::openList=0;
 template <typename state, typename action>
-ConstrainedEnvironment<state,action>* UnitTieBreaking3D<state,action>::currentEnv=0;
+thread_local ConstrainedEnvironment<state,action>* UnitTieBreaking3D<state,action>::currentEnv=0;
 template <typename state, typename action>
-uint8_t UnitTieBreaking3D<state,action>::currentAgent=0;
+thread_local uint8_t UnitTieBreaking3D<state,action>::currentAgent=0;
 template <typename state, typename action>
 unsigned UnitTieBreaking3D<state,action>::collchecks=0;
 template <typename state, typename action>
@@ -346,6 +346,6 @@ bool UnitTieBreaking3D<state,action>::useCAT=false;
 template <typename state, typename action>
 double UnitTieBreaking3D<state,action>::agentRadius=0.25;
 template <typename state, typename action>
-UnitTimeCAT<state,action>* UnitTieBreaking3D<state,action>::CAT=0;
+thread_local UnitTimeCAT<state,action>* UnitTieBreaking3D<state,action>::CAT=0;
 
 #endif /* defined(__hog2_glut__Grid3DConstrainedEnvironment__) */
@@ -83,12 +83,12 @@ struct xyLocHash
 };
 
 struct xytLoc : xyLoc, tLoc {
-  xytLoc(xyLoc loc, float time):xyLoc(loc),tLoc(time), h(0){}
-  xytLoc(xyLoc loc, uint16_t _h, float time):xyLoc(loc),tLoc(time), h(_h){}
-  xytLoc(uint16_t _x, uint16_t _y):xyLoc(_x,_y),tLoc(), h(0){}
-  xytLoc(uint16_t _x, uint16_t _y, float time):xyLoc(_x,_y),tLoc(time), h(0){}
-  xytLoc(uint16_t _x, uint16_t _y, uint16_t _h, float time):xyLoc(_x,_y),tLoc(time), h(_h){}
-  xytLoc():xyLoc(),tLoc(),h(0){}
+  xytLoc(xyLoc loc, float time):xyLoc(loc),tLoc(time), h(0),nc(-1){}
+  xytLoc(xyLoc loc, uint16_t _h, float time):xyLoc(loc),tLoc(time), h(_h),nc(-1){}
+  xytLoc(uint16_t _x, uint16_t _y):xyLoc(_x,_y),tLoc(), h(0),nc(-1){}
+  xytLoc(uint16_t _x, uint16_t _y, float time):xyLoc(_x,_y),tLoc(time), h(0),nc(-1){}
+  xytLoc(uint16_t _x, uint16_t _y, uint16_t _h, float time):xyLoc(_x,_y),tLoc(time), h(_h),nc(-1){}
+  xytLoc():xyLoc(),tLoc(),h(0),nc(-1){}
   operator TemporalVector3D()const{return TemporalVector3D(x,y,0,t);}
   operator Vector2D()const{return Vector2D(x,y);}
   //operator Point_2()const{return Point_2(x,y);}
@@ -289,6 +289,21 @@ void MNPuzzle::GetSuccessors(const MNPuzzleState &stateID,
 	}
 }
 
+unsigned MNPuzzle::GetSuccessorBatch(const MNPuzzleState &stateID, Successor<MNPuzzleState, slideDir> *succ, bool withHash) const
+{
+	const std::vector<slideDir> &ops = operators[stateID.blank];
+	for (unsigned int i = 0; i < ops.size(); i++)
+	{
+		succ[i].s = stateID;
+		MNPuzzle::ApplyAction(succ[i].s, ops[i]);
+		succ[i].a = ops[i];
+		succ[i].cost = MNPuzzle::GCost(stateID, ops[i]);
+		if (withHash)
+			succ[i].hash = MNPuzzle::GetStateHash(succ[i].s);
+	}
+	return (unsigned)ops.size();
+}
+
 void MNPuzzle::GetActions(const MNPuzzleState &stateID, std::vector<slideDir> &actions) const
 {
 	actions.resize(0);
@@ -741,9 +756,9 @@ double GraphPuzzleDistanceHeuristic::HCost(const graphState &state1, const graph
 	puzzle.GetStateFromHash(b, state2);
 	double val = puzzle.HCost(a, b);
 	
-	for (unsigned int i=0; i < heuristics.size(); i++)
+	for (unsigned int i=0; i < locations.size(); i++)
 	{
-		double hval = heuristics[i][state1]-heuristics[i][state2];
+		double hval = Distance(i, state1)-Distance(i, state2);
 		if (hval < 0)
 			hval = -hval;
 		if (fgreater(hval,val))
@@ -844,8 +859,17 @@ void MNPuzzle::GetStateFromHash(MNPuzzleState &s, uint64_t hash) const
 
 uint64_t MNPuzzle::GetStateHash(const MNPuzzleState &s) const
 {
-	std::vector<int> locs(s.puzzle.size()-2); // We only rank n-2 of n items; last two are fixed by the parity
-	std::vector<int> dual(s.puzzle.size());
+	// on the stack unless the puzzle is large
+	int localLocs[64], localDual[64];
+	std::vector<int> largeLocs, largeDual;
+	int *locs = localLocs, *dual = localDual; // We only rank n-2 of n items; last two are fixed by the parity
+	if (s.puzzle.size() > 64)
+	{
+		largeLocs.resize(s.puzzle.size()-2);
+		largeDual.resize(s.puzzle.size());
+		locs = &largeLocs[0];
+		dual = &largeDual[0];
+	}
 	
 	// build the representation containing the item locations
 	for (unsigned int x = 0; x < s.puzzle.size(); x++)
@@ -108,6 +108,8 @@ public:
 	void SetWeighted(bool w) { weighted = w; }
 	bool GetWeighted() const { return weighted; }
 	void GetSuccessors(const MNPuzzleState &stateID, std::vector<MNPuzzleState> &neighbors) const;
+	unsigned GetMaxSuccessors() const { return 4; }
+	unsigned GetSuccessorBatch(const MNPuzzleState &stateID, Successor<MNPuzzleState, slideDir> *succ, bool withHash) const;
 	void GetActions(const MNPuzzleState &stateID, std::vector<slideDir> &actions) const;
 	slideDir GetAction(const MNPuzzleState &s1, const MNPuzzleState &s2) const;
 	void ApplyAction(MNPuzzleState &s, slideDir a) const;
@@ -190,8 +192,10 @@ public:
 	static MNPuzzleState Generate_Random_Puzzle(unsigned num_cols, unsigned num_rows);
 
 	virtual void GetStateFromHash(MNPuzzleState &s, uint64_t hash) const;
+	void GetStateFromHash(uint64_t hash, MNPuzzleState &s) const { GetStateFromHash(s, hash); }
 	uint64_t GetStateHash(const MNPuzzleState &s) const;
 	uint64_t GetMaxStateHash() const;
+	uint64_t GetMaxHash() const { return GetMaxStateHash(); }
 	
 	bool State_Check(const MNPuzzleState &to_check);
 
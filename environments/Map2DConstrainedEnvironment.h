@@ -117,7 +117,7 @@ class TieBreaking {
             state n;
             currentEnv->GetStateFromHash(m.hash2,n);
             //n.t=m.stop;
-            nc1+=checkForConflict(parent1,&i1.data,&p,&n);
+            nc1+=checkForConflict(parent1,&i1.data,&p,&n,agentRadius);
             //if(!nc1){std::cout << "NO ";}
             //std::cout << "conflict(1): " << i1.data << " " << n << "\n";
           }
@@ -142,7 +142,7 @@ class TieBreaking {
             state n;
             currentEnv->GetStateFromHash(m.hash2,n);
             //n.t=m.stop;
-            nc2+=checkForConflict(parent2,&i2.data,&p,&n);
+            nc2+=checkForConflict(parent2,&i2.data,&p,&n,agentRadius);
             //if(!nc2){std::cout << "NO ";}
             //std::cout << "conflict(2): " << i2.data << " " << n << "\n";
           }
@@ -165,25 +165,25 @@ class TieBreaking {
     }
     return (fgreater(ci1.g+ci1.h, ci2.g+ci2.h));
   }
-    static OpenClosedInterface<state,AStarOpenClosedData<state>>* openList;
-    static ConstrainedEnvironment<state,action>* currentEnv;
-    static uint8_t currentAgent;
+    static thread_local OpenClosedInterface<state,AStarOpenClosedData<state>>* openList;
+    static thread_local ConstrainedEnvironment<state,action>* currentEnv;
+    static thread_local uint8_t currentAgent;
     static bool randomalg;
     static bool useCAT;
-    static NonUnitTimeCAT<state,action>* CAT; // Conflict Avoidance Table
+    static thread_local NonUnitTimeCAT<state,action>* CAT; // Conflict Avoidance Table
 };
 
 template <typename state, typename action>
-OpenClosedInterface<state,AStarOpenClosedData<state>>* TieBreaking<state,action>::openList=0;
+thread_local OpenClosedInterface<state,AStarOpenClosedData<state>>* TieBreaking<state,action>::openList=0;
 template <typename state, typename action>
-ConstrainedEnvironment<state,action>* TieBreaking<state,action>::currentEnv=0;
+thread_local ConstrainedEnvironment<state,action>* TieBreaking<state,action>::currentEnv=0;
 template <typename state, typename action>
-uint8_t TieBreaking<state,action>::currentAgent=0;
+thread_local uint8_t TieBreaking<state,action>::currentAgent=0;
 template <typename state, typename action>
 bool TieBreaking<state,action>::randomalg=false;
 template <typename state, typename action>
 bool TieBreaking<state,action>::useCAT=false;
 template <typename state, typename action>
-NonUnitTimeCAT<state,action>* TieBreaking<state,action>::CAT=0;
+thread_local NonUnitTimeCAT<state,action>* TieBreaking<state,action>::CAT=0;
 
 #endif /* defined(__hog2_glut__Map2DConstrainedEnvironment__) */
@@ -19,7 +19,7 @@
 
 using namespace Graphics2D;
 
-MapEnvironment::MapEnvironment(Map *_m, bool useOccupancy):start(nullptr),h(nullptr),map(_m),oi(useOccupancy?new BaseMapOccupancyInterface(map):nullptr),DIAGONAL_COST(sqrt(2)),connectedness(8),fullBranching(false){
+MapEnvironment::MapEnvironment(Map *_m, bool useOccupancy):start(nullptr),h(nullptr),map(_m),oi(useOccupancy?new BaseMapOccupancyInterface(map):nullptr),DIAGONAL_COST(sqrt(2)),connectedness(8),fullBranching(false),bitmap(0){
 }
 
 MapEnvironment::MapEnvironment(MapEnvironment *me)
@@ -32,12 +32,23 @@ MapEnvironment::MapEnvironment(MapEnvironment *me)
 	DIAGONAL_COST = me->DIAGONAL_COST;
 	connectedness = me->connectedness;
 	fullBranching = me->fullBranching;
+	bitmap = 0;
+	UsePassabilityBitmap(me->bitmap != 0);
 }
 
 MapEnvironment::~MapEnvironment()
 {
 //	delete map;
 	delete oi;
+	delete bitmap;
+}
+
+void MapEnvironment::UsePassabilityBitmap(bool use)
+{
+	delete bitmap;
+	bitmap = 0;
+	if (use && map->GetMapType() == kOctile)
+		bitmap = new PassabilityBitmap(map);
 }
 
 GraphHeuristic *MapEnvironment::GetGraphHeuristic()
@@ -52,74 +63,79 @@ void MapEnvironment::SetGraphHeuristic(GraphHeuristic *gh)
 
 void MapEnvironment::GetSuccessors(const xyLoc &loc, std::vector<xyLoc> &neighbors) const
 {
+	if (bitmap && connectedness <= 9)
+	{
+		GetMaskSuccessors(loc, neighbors);
+		return;
+	}
         neighbors.reserve(connectedness);
 	//neighbors.resize(0);
 	bool u=false, d=false, /*l=false, r=false,*/ u2=false, d2=false, l2=false, r2=false, /*ur=false, ul=false, dr=false, dl=false,*/ u2l=false, d2l=false, u2r=false, d2r=false, ul2=false, ur2=false, dl2=false, dr2=false, u2r2=false, u2l2=false, d2r2=false, d2l2=false;
 	// 
-	if ((map->CanStep(loc.x, loc.y, loc.x, loc.y+1)))
+	if ((CanStep(loc.x, loc.y, loc.x, loc.y+1)))
 	{
 		d = true;
 		neighbors.emplace_back(loc.x, loc.y+1);
-                if(connectedness>9 && map->IsTraversable(loc.x, loc.y+2)){
+                if(connectedness>9 && Traversable(loc.x, loc.y+2)){
                   d2=true;
                   if(fullBranching)neighbors.emplace_back(loc.x, loc.y+2);
                 }
 	}
-	if ((map->CanStep(loc.x, loc.y, loc.x, loc.y-1)))
+	if ((CanStep(loc.x, loc.y, loc.x, loc.y-1)))
 	{
 		u = true;
 		neighbors.emplace_back(loc.x, loc.y-1);
-                if(connectedness>9 && map->IsTraversable(loc.x, loc.y-2)){
+                if(connectedness>9 && Traversable(loc.x, loc.y-2)){
                   u2=true;
                   if(fullBranching)neighbors.emplace_back(loc.x, loc.y-2);
                 }
 	}
-	if ((map->CanStep(loc.x, loc.y, loc.x-1, loc.y)))
+	if ((CanStep(loc.x, loc.y, loc.x-1, loc.y)))
         {
           //l=true;
           neighbors.emplace_back(loc.x-1, loc.y);
           if (connectedness>5){
             // Left is open ...
-            if(connectedness>9 && map->IsTraversable(loc.x-2, loc.y)){ // left 2
+            if(connectedness>9 && Traversable(loc.x-2, loc.y)){ // left 2
               l2=true;
               if(fullBranching)neighbors.emplace_back(loc.x-2, loc.y);
             }
-            if(u && (map->CanStep(loc.x, loc.y, loc.x-1, loc.y-1))){
+            if(u && (CanStep(loc.x, loc.y, loc.x-1, loc.y-1))){
               //ul=true;
               neighbors.emplace_back(loc.x-1, loc.y-1);
               if(connectedness>9){
                 // Left, Up, Left2 and UpLeft are open...
-                if(l2 && map->IsTraversable(loc.x-2, loc.y-1)){
+                if(l2 && Traversable(loc.x-2, loc.y-1)){
                   ul2=true;
                   neighbors.emplace_back(loc.x-2, loc.y-1);
                 }
                 // Left, Up2, Up and UpLeft are open...
-                if(u2 && map->IsTraversable(loc.x-1, loc.y-2)){
+                if(u2 && Traversable(loc.x-1, loc.y-2)){
                   u2l=true;
                   neighbors.emplace_back(loc.x-1, loc.y-2);
                 }
-                if(ul2 && u2l && map->IsTraversable(loc.x-2, loc.y-2)){
+                if(ul2 && u2l && Traversable(loc.x-2, loc.y-2)){
                   u2l2=true;
                   if(fullBranching)neighbors.emplace_back(loc.x-2, loc.y-2);
                 }
               }
             }
 
-            if (d && (map->CanStep(loc.x, loc.y, loc.x-1, loc.y+1))){
+            if (d && (CanStep(loc.x, loc.y, loc.x-1, loc.y+1))){
               neighbors.emplace_back(loc.x-1, loc.y+1);
               //dl=true;
               if(connectedness>9){
                 // Left, Down, Left2 and UpLeft are open...
-                if(l2 && map->IsTraversable(loc.x-2, loc.y+1)){
+                if(l2 && Traversable(loc.x-2, loc.y+1)){
                   dl2=true;
                   neighbors.emplace_back(loc.x-2, loc.y+1);
                 }
                 // Left, Up2, Up and UpLeft are open...
-                if(d2 && map->IsTraversable(loc.x-1, loc.y+2)){
+                if(d2 && Traversable(loc.x-1, loc.y+2)){
                   d2l=true;
                   neighbors.emplace_back(loc.x-1, loc.y+2);
                 }
-                if(dl2 && d2l && map->IsTraversable(loc.x-2, loc.y+2)){
+                if(dl2 && d2l && Traversable(loc.x-2, loc.y+2)){
                   d2l2=true;
                   if(fullBranching)neighbors.emplace_back(loc.x-2, loc.y+2);
                 }
@@ -128,52 +144,52 @@ void MapEnvironment::GetSuccessors(const xyLoc &loc, std::vector<xyLoc> &neighbo
           } // connectedness>5
         } // left
 
-	if ((map->CanStep(loc.x, loc.y, loc.x+1, loc.y)))
+	if ((CanStep(loc.x, loc.y, loc.x+1, loc.y)))
         {
           //r=true;
           neighbors.emplace_back(loc.x+1, loc.y);
           if (connectedness>5){
             // Right is open ...
-            if(connectedness>9 && map->IsTraversable(loc.x+2, loc.y)){ // right 2
+            if(connectedness>9 && Traversable(loc.x+2, loc.y)){ // right 2
               r2=true;
               if(fullBranching)neighbors.emplace_back(loc.x+2, loc.y);
             }
-            if(u && (map->CanStep(loc.x, loc.y, loc.x+1, loc.y-1))){
+            if(u && (CanStep(loc.x, loc.y, loc.x+1, loc.y-1))){
               //ur=true;
               neighbors.emplace_back(loc.x+1, loc.y-1);
               if(connectedness>9){
                 // Right, Up, Right2 and UpRight are open...
-                if(r2 && map->IsTraversable(loc.x+2, loc.y-1)){
+                if(r2 && Traversable(loc.x+2, loc.y-1)){
                   ur2=true;
                   neighbors.emplace_back(loc.x+2, loc.y-1);
                 }
                 // Right, Up2, Up and UpRight are open...
-                if(u2 && map->IsTraversable(loc.x+1, loc.y-2)){
+                if(u2 && Traversable(loc.x+1, loc.y-2)){
                   u2r=true;
                   neighbors.emplace_back(loc.x+1, loc.y-2);
                 }
-                if(ur2 && u2r && map->IsTraversable(loc.x+2, loc.y-2)){
+                if(ur2 && u2r && Traversable(loc.x+2, loc.y-2)){
                   u2r2=true;
                   if(fullBranching)neighbors.emplace_back(loc.x+2, loc.y-2);
                 }
               }
             }
 
-            if (d && (map->CanStep(loc.x, loc.y, loc.x+1, loc.y+1))){
+            if (d && (CanStep(loc.x, loc.y, loc.x+1, loc.y+1))){
               //dr=true;
               neighbors.emplace_back(loc.x+1, loc.y+1);
               if(connectedness>9){
                 // Right, Down, Right2 and UpRight are open...
-                if(r2 && map->IsTraversable(loc.x+2, loc.y+1)){
+                if(r2 && Traversable(loc.x+2, loc.y+1)){
                   dr2=true;
                   neighbors.emplace_back(loc.x+2, loc.y+1);
                 }
                 // Right, Up2, Up and UpRight are open...
-                if(d2 && map->IsTraversable(loc.x+1, loc.y+2)){
+                if(d2 && Traversable(loc.x+1, loc.y+2)){
                   d2r=true;
                   neighbors.emplace_back(loc.x+1, loc.y+2);
                 }
-                if(dr2 && d2r && map->IsTraversable(loc.x+2, loc.y+2)){
+                if(dr2 && d2r && Traversable(loc.x+2, loc.y+2)){
                   d2r2=true;
                   if(fullBranching)neighbors.emplace_back(loc.x+2, loc.y+2);
                 }
@@ -184,88 +200,88 @@ void MapEnvironment::GetSuccessors(const xyLoc &loc, std::vector<xyLoc> &neighbo
 
         if(connectedness>25){
           if(fullBranching){
-            if(d2 && map->IsTraversable(loc.x, loc.y+3))
+            if(d2 && Traversable(loc.x, loc.y+3))
               neighbors.emplace_back(loc.x, loc.y+3);
-            if(u2 && map->IsTraversable(loc.x, loc.y-3))
+            if(u2 && Traversable(loc.x, loc.y-3))
               neighbors.emplace_back(loc.x, loc.y-3);
-            if(r2 && map->IsTraversable(loc.x+3, loc.y))
+            if(r2 && Traversable(loc.x+3, loc.y))
               neighbors.emplace_back(loc.x+3, loc.y);
-            if(l2 && map->IsTraversable(loc.x-3, loc.y))
+            if(l2 && Traversable(loc.x-3, loc.y))
               neighbors.emplace_back(loc.x-3, loc.y);
           }
 
           // ul3
           //if(l2 && map->IsTraversable(loc.x-2, loc.y-1) && map->IsTraversable(loc.x-3, loc.y-1))
-          if(l2 && ul2 && map->IsTraversable(loc.x-3, loc.y-1))
+          if(l2 && ul2 && Traversable(loc.x-3, loc.y-1))
             neighbors.emplace_back(loc.x-3, loc.y-1);
           // dl3
           //if(l2 && map->IsTraversable(loc.x-2, loc.y+1) && map->IsTraversable(loc.x-3, loc.y+1))
-          if(l2 && dl2  && map->IsTraversable(loc.x-3, loc.y+1))
+          if(l2 && dl2  && Traversable(loc.x-3, loc.y+1))
             neighbors.emplace_back(loc.x-3, loc.y+1);
           // ur3
           //if(r2 && map->IsTraversable(loc.x+2, loc.y-1) && map->IsTraversable(loc.x+3, loc.y-1))
-          if(r2 && ur2 && map->IsTraversable(loc.x+3, loc.y-1))
+          if(r2 && ur2 && Traversable(loc.x+3, loc.y-1))
             neighbors.emplace_back(loc.x+3, loc.y-1);
           // dr3
           //if(r2 && map->IsTraversable(loc.x+2, loc.y+1) && map->IsTraversable(loc.x+3, loc.y+1))
-          if(r2 && dr2 && map->IsTraversable(loc.x+3, loc.y+1))
+          if(r2 && dr2 && Traversable(loc.x+3, loc.y+1))
             neighbors.emplace_back(loc.x+3, loc.y+1);
             
           // u3l
           //if(u2 && map->IsTraversable(loc.x-1, loc.y-2) && map->IsTraversable(loc.x-1, loc.y-3))
-          if(u2 && u2l && map->IsTraversable(loc.x-1, loc.y-3))
+          if(u2 && u2l && Traversable(loc.x-1, loc.y-3))
             neighbors.emplace_back(loc.x-1, loc.y-3);
           // d3l
           //if(d2 && map->IsTraversable(loc.x-1, loc.y+2) && map->IsTraversable(loc.x-1, loc.y+3))
-          if(d2 && d2l && map->IsTraversable(loc.x-1, loc.y+3))
+          if(d2 && d2l && Traversable(loc.x-1, loc.y+3))
             neighbors.emplace_back(loc.x-1, loc.y+3);
           // u3r
           //if(u2 && map->IsTraversable(loc.x+1, loc.y-2) && map->IsTraversable(loc.x+1, loc.y-3))
-          if(u2 && u2r && map->IsTraversable(loc.x+1, loc.y-3))
+          if(u2 && u2r && Traversable(loc.x+1, loc.y-3))
             neighbors.emplace_back(loc.x+1, loc.y-3);
           // d3r
           //if(d2 && map->IsTraversable(loc.x+1, loc.y+2) && map->IsTraversable(loc.x+1, loc.y+3))
-          if(d2 && d2r && map->IsTraversable(loc.x+1, loc.y+3))
+          if(d2 && d2r && Traversable(loc.x+1, loc.y+3))
             neighbors.emplace_back(loc.x+1, loc.y+3);
             
           // u2l3
-          if(u2l2 && map->IsTraversable(loc.x-3,loc.y-1) && map->IsTraversable(loc.x-3, loc.y-2))
+          if(u2l2 && Traversable(loc.x-3,loc.y-1) && Traversable(loc.x-3, loc.y-2))
             neighbors.emplace_back(loc.x-3, loc.y-2);
           // d2l3
-          if(d2l2 && map->IsTraversable(loc.x-3,loc.y+1) && map->IsTraversable(loc.x-3, loc.y+2))
+          if(d2l2 && Traversable(loc.x-3,loc.y+1) && Traversable(loc.x-3, loc.y+2))
             neighbors.emplace_back(loc.x-3, loc.y+2);
           // u2r3
-          if(u2r2 && map->IsTraversable(loc.x+3,loc.y-1) && map->IsTraversable(loc.x+3, loc.y-2))
+          if(u2r2 && Traversable(loc.x+3,loc.y-1) && Traversable(loc.x+3, loc.y-2))
             neighbors.emplace_back(loc.x+3, loc.y-2);
           // d2r3
-          if(d2r2 && map->IsTraversable(loc.x+3,loc.y+1) && map->IsTraversable(loc.x+3, loc.y+2))
+          if(d2r2 && Traversable(loc.x+3,loc.y+1) && Traversable(loc.x+3, loc.y+2))
             neighbors.emplace_back(loc.x+3, loc.y+2);
             
           // u3l2
-          if(u2l2 && map->IsTraversable(loc.x-1,loc.y-3) && map->IsTraversable(loc.x-2, loc.y-3))
+          if(u2l2 && Traversable(loc.x-1,loc.y-3) && Traversable(loc.x-2, loc.y-3))
             neighbors.emplace_back(loc.x-2, loc.y-3);
           // d3l2
-          if(d2l2 && map->IsTraversable(loc.x-1,loc.y+3) && map->IsTraversable(loc.x-2, loc.y+3))
+          if(d2l2 && Traversable(loc.x-1,loc.y+3) && Traversable(loc.x-2, loc.y+3))
             neighbors.emplace_back(loc.x-2, loc.y+3);
           // u3r2
-          if(u2r2 && map->IsTraversable(loc.x+1,loc.y-3) && map->IsTraversable(loc.x+2, loc.y-3))
+          if(u2r2 && Traversable(loc.x+1,loc.y-3) && Traversable(loc.x+2, loc.y-3))
             neighbors.emplace_back(loc.x+2, loc.y-3);
           // d3r2
-          if(d2r2 && map->IsTraversable(loc.x+1,loc.y+3) && map->IsTraversable(loc.x+2, loc.y+3))
+          if(d2r2 && Traversable(loc.x+1,loc.y+3) && Traversable(loc.x+2, loc.y+3))
             neighbors.emplace_back(loc.x+2, loc.y+3);
             
           if(fullBranching){
             // u3l3
-            if(u2l2 && map->IsTraversable(loc.x-2,loc.y-3) && map->IsTraversable(loc.x-3,loc.y-2) && map->IsTraversable(loc.x-3, loc.y-3))
+            if(u2l2 && Traversable(loc.x-2,loc.y-3) && Traversable(loc.x-3,loc.y-2) && Traversable(loc.x-3, loc.y-3))
               neighbors.emplace_back(loc.x-3, loc.y-3);
             // d3l3
-            if(d2l2 && map->IsTraversable(loc.x-2,loc.y+3) && map->IsTraversable(loc.x-3,loc.y+2) && map->IsTraversable(loc.x-3, loc.y+3))
+            if(d2l2 && Traversable(loc.x-2,loc.y+3) && Traversable(loc.x-3,loc.y+2) && Traversable(loc.x-3, loc.y+3))
               neighbors.emplace_back(loc.x-3, loc.y+3);
             // u3r3
-            if(u2r2 && map->IsTraversable(loc.x+2,loc.y-3) && map->IsTraversable(loc.x+3,loc.y-2) && map->IsTraversable(loc.x+3, loc.y-3))
+            if(u2r2 && Traversable(loc.x+2,loc.y-3) && Traversable(loc.x+3,loc.y-2) && Traversable(loc.x+3, loc.y-3))
               neighbors.emplace_back(loc.x+3, loc.y-3);
             // d3r3
-            if(d2r2 && map->IsTraversable(loc.x+2,loc.y+3) && map->IsTraversable(loc.x+3,loc.y+2) && map->IsTraversable(loc.x+3, loc.y+3))
+            if(d2r2 && Traversable(loc.x+2,loc.y+3) && Traversable(loc.x+3,loc.y+2) && Traversable(loc.x+3, loc.y+3))
               neighbors.emplace_back(loc.x+3, loc.y+3);
           }
         }
@@ -395,7 +411,7 @@ bool MapEnvironment::GetNext4Successor(const xyLoc &currOpenNode, const xyLoc &g
 			currHCost += hIncrease[theEntry][special];
 			ApplyAction(next, order[selector][theEntry][special]);
 			special++;
-			if (map->CanStep(currOpenNode.x, currOpenNode.y, next.x, next.y))
+			if (CanStep(currOpenNode.x, currOpenNode.y, next.x, next.y))
 			{
 				//std::cout << "Next successor of " << currOpenNode << " is " << next << std::endl;
 				validMove = true;
@@ -406,7 +422,7 @@ bool MapEnvironment::GetNext4Successor(const xyLoc &currOpenNode, const xyLoc &g
 			currHCost += hIncrease[theEntry][special];
 			ApplyAction(next, order[selector][theEntry][special]);
 			special++;
-			if (map->CanStep(currOpenNode.x, currOpenNode.y, next.x, next.y))
+			if (CanStep(currOpenNode.x, currOpenNode.y, next.x, next.y))
 			{
 				//std::cout << "Next successor of " << currOpenNode << " is " << next << std::endl;
 				validMove = true;
@@ -418,7 +434,7 @@ bool MapEnvironment::GetNext4Successor(const xyLoc &currOpenNode, const xyLoc &g
 			currHCost += hIncrease[theEntry][special];
 			ApplyAction(next, order[selector][theEntry][special]);
 			special++;
-			if (map->CanStep(currOpenNode.x, currOpenNode.y, next.x, next.y))
+			if (CanStep(currOpenNode.x, currOpenNode.y, next.x, next.y))
 			{
 				//std::cout << "Next successor of " << currOpenNode << " is " << next << std::endl;
 				validMove = true;
@@ -429,7 +445,7 @@ bool MapEnvironment::GetNext4Successor(const xyLoc &currOpenNode, const xyLoc &g
 			currHCost += hIncrease[theEntry][special];
 			ApplyAction(next, order[selector][theEntry][special]);
 			special++;
-			if (map->CanStep(currOpenNode.x, currOpenNode.y, next.x, next.y))
+			if (CanStep(currOpenNode.x, currOpenNode.y, next.x, next.y))
 			{
 				//std::cout << "Next successor of " << currOpenNode << " is " << next << std::endl;
 				validMove = true;
@@ -578,37 +594,145 @@ bool MapEnvironment::GetNext8Successor(const xyLoc &currOpenNode, const xyLoc &g
 //	return false;
 }
 
+/*
+ * Same successors, in the same order, as GetSuccessors for 4/5/8/9
+ * connected maps, but generated from the precomputed neighbor mask of the
+ * passability bitmap.
+ */
+void MapEnvironment::GetMaskSuccessors(const xyLoc &loc, std::vector<xyLoc> &neighbors) const
+{
+	uint8_t mask = bitmap->GetNeighborMask(loc.x, loc.y);
+	if (connectedness <= 5)
+		mask &= (PassabilityBitmap::kNorth|PassabilityBitmap::kSouth|PassabilityBitmap::kEast|PassabilityBitmap::kWest);
+	if (mask & PassabilityBitmap::kSouth)
+		neighbors.emplace_back(loc.x, loc.y+1);
+	if (mask & PassabilityBitmap::kNorth)
+		neighbors.emplace_back(loc.x, loc.y-1);
+	if (mask & PassabilityBitmap::kWest)
+	{
+		neighbors.emplace_back(loc.x-1, loc.y);
+		if (mask & PassabilityBitmap::kNorthWest)
+			neighbors.emplace_back(loc.x-1, loc.y-1);
+		if (mask & PassabilityBitmap::kSouthWest)
+			neighbors.emplace_back(loc.x-1, loc.y+1);
+	}
+	if (mask & PassabilityBitmap::kEast)
+	{
+		neighbors.emplace_back(loc.x+1, loc.y);
+		if (mask & PassabilityBitmap::kNorthEast)
+			neighbors.emplace_back(loc.x+1, loc.y-1);
+		if (mask & PassabilityBitmap::kSouthEast)
+			neighbors.emplace_back(loc.x+1, loc.y+1);
+	}
+	if (connectedness%2)
+		neighbors.push_back(loc);
+}
+
+/*
+ * The successors of GetSuccessors for 4/5/8/9 connected maps, with their
+ * actions, costs and hashes.
+ */
+unsigned MapEnvironment::GetSuccessorBatch(const xyLoc &loc, Successor<xyLoc, tDirection> *succ, bool withHash) const
+{
+	if (connectedness > 9)
+		return 0;
+	uint8_t mask = 0;
+	if (bitmap)
+	{
+		mask = bitmap->GetNeighborMask(loc.x, loc.y);
+	}
+	else {
+		if (CanStep(loc.x, loc.y, loc.x, loc.y+1))
+			mask |= PassabilityBitmap::kSouth;
+		if (CanStep(loc.x, loc.y, loc.x, loc.y-1))
+			mask |= PassabilityBitmap::kNorth;
+		if (CanStep(loc.x, loc.y, loc.x-1, loc.y))
+		{
+			mask |= PassabilityBitmap::kWest;
+			if ((mask & PassabilityBitmap::kNorth) && CanStep(loc.x, loc.y, loc.x-1, loc.y-1))
+				mask |= PassabilityBitmap::kNorthWest;
+			if ((mask & PassabilityBitmap::kSouth) && CanStep(loc.x, loc.y, loc.x-1, loc.y+1))
+				mask |= PassabilityBitmap::kSouthWest;
+		}
+		if (CanStep(loc.x, loc.y, loc.x+1, loc.y))
+		{
+			mask |= PassabilityBitmap::kEast;
+			if ((mask & PassabilityBitmap::kNorth) && CanStep(loc.x, loc.y, loc.x+1, loc.y-1))
+				mask |= PassabilityBitmap::kNorthEast;
+			if ((mask & PassabilityBitmap::kSouth) && CanStep(loc.x, loc.y, loc.x+1, loc.y+1))
+				mask |= PassabilityBitmap::kSouthEast;
+		}
+	}
+	if (connectedness <= 5)
+		mask &= (PassabilityBitmap::kNorth|PassabilityBitmap::kSouth|PassabilityBitmap::kEast|PassabilityBitmap::kWest);
+
+	// same order as GetMaskSuccessors; GCost is Util::distance for moves
+	static const double diagonal = sqrt(2.0);
+	static const struct { uint8_t bit; int dx, dy; tDirection dir; double cost; } moves[8] = {
+		{PassabilityBitmap::kSouth, 0, 1, kS, 1.0},
+		{PassabilityBitmap::kNorth, 0, -1, kN, 1.0},
+		{PassabilityBitmap::kWest, -1, 0, kW, 1.0},
+		{PassabilityBitmap::kNorthWest, -1, -1, kNW, diagonal},
+		{PassabilityBitmap::kSouthWest, -1, 1, kSW, diagonal},
+		{PassabilityBitmap::kEast, 1, 0, kE, 1.0},
+		{PassabilityBitmap::kNorthEast, 1, -1, kNE, diagonal},
+		{PassabilityBitmap::kSouthEast, 1, 1, kSE, diagonal},
+	};
+	unsigned count = 0;
+	for (int x = 0; x < 8; x++)
+	{
+		if (!(mask & moves[x].bit))
+			continue;
+		Successor<xyLoc, tDirection> &next = succ[count++];
+		next.s = xyLoc(loc.x+moves[x].dx, loc.y+moves[x].dy);
+		next.a = moves[x].dir;
+		next.cost = moves[x].cost;
+		if (withHash)
+			next.hash = MapEnvironment::GetStateHash(next.s);
+	}
+	if (connectedness%2)
+	{
+		Successor<xyLoc, tDirection> &next = succ[count++];
+		next.s = loc;
+		next.a = kStay;
+		next.cost = GCost(loc, loc);
+		if (withHash)
+			next.hash = MapEnvironment::GetStateHash(loc);
+	}
+	return count;
+}
+
 void MapEnvironment::GetActions(const xyLoc &loc, std::vector<tDirection> &actions) const
 {
 	bool up=false, down=false;
-	if ((map->CanStep(loc.x, loc.y, loc.x, loc.y+1)))
+	if ((CanStep(loc.x, loc.y, loc.x, loc.y+1)))
 	{
 		down = true;
 		actions.push_back(kS);
 	}
-	if ((map->CanStep(loc.x, loc.y, loc.x, loc.y-1)))
+	if ((CanStep(loc.x, loc.y, loc.x, loc.y-1)))
 	{
 		up = true;
 		actions.push_back(kN);
 	}
-	if ((map->CanStep(loc.x, loc.y, loc.x-1, loc.y)))
+	if ((CanStep(loc.x, loc.y, loc.x-1, loc.y)))
 	{
 		if (connectedness>5)
 		{
-			if ((up && (map->CanStep(loc.x, loc.y, loc.x-1, loc.y-1))))
+			if ((up && (CanStep(loc.x, loc.y, loc.x-1, loc.y-1))))
 				actions.push_back(kNW);
-			if ((down && (map->CanStep(loc.x, loc.y, loc.x-1, loc.y+1))))
+			if ((down && (CanStep(loc.x, loc.y, loc.x-1, loc.y+1))))
 				actions.push_back(kSW);
 		}
 		actions.push_back(kW);
 	}
-	if ((map->CanStep(loc.x, loc.y, loc.x+1, loc.y)))
+	if ((CanStep(loc.x, loc.y, loc.x+1, loc.y)))
 	{
 		if (connectedness>5)
 		{
-			if ((up && (map->CanStep(loc.x, loc.y, loc.x+1, loc.y-1))))
+			if ((up && (CanStep(loc.x, loc.y, loc.x+1, loc.y-1))))
 				actions.push_back(kNE);
-			if ((down && (map->CanStep(loc.x, loc.y, loc.x+1, loc.y+1))))
+			if ((down && (CanStep(loc.x, loc.y, loc.x+1, loc.y+1))))
 				actions.push_back(kSE);
 		}
 		actions.push_back(kE);
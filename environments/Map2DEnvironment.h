@@ -25,6 +25,7 @@
 #include "BitVector.h"
 #include "GraphEnvironment.h"
 #include "GridStates.h"
+#include "PassabilityBitmap.h"
 
 #include <cassert>
 
@@ -49,6 +50,9 @@ public:
         virtual std::string name()const{std::stringstream ss; ss<<"Map2DEnvironment("<<(int)connectedness<<"-connected)"; return ss.str();}
 	virtual void GetSuccessors(const xyLoc &nodeID, std::vector<xyLoc> &neighbors) const;
 	virtual void GetReverseSuccessors(const xyLoc &nodeID, std::vector<xyLoc> &neighbors) const{GetSuccessors(nodeID,neighbors);}
+	// batches are only generated for 4/5/8/9 connected maps
+	virtual unsigned GetMaxSuccessors() const { return (connectedness <= 9)?9:0; }
+	virtual unsigned GetSuccessorBatch(const xyLoc &nodeID, Successor<xyLoc, tDirection> *succ, bool withHash) const;
 	bool GetNextSuccessor(const xyLoc &currOpenNode, const xyLoc &goal, xyLoc &next, double &currHCost, uint64_t &special, bool &validMove);
 	bool GetNext4Successor(const xyLoc &currOpenNode, const xyLoc &goal, xyLoc &next, double &currHCost, uint64_t &special, bool &validMove);
 	bool GetNext5Successor(const xyLoc &currOpenNode, const xyLoc &goal, xyLoc &next, double &currHCost, uint64_t &special, bool &validMove);
@@ -130,6 +134,10 @@ public:
         void SetConnectedness(int c){ connectedness=c; }
         uint8_t GetConnectedness()const{ return connectedness; }
         void SetFullBranching(bool v){fullBranching=v;}
+	// Keep a packed copy of the map passability for successor generation;
+	// only used for octile maps. Call again after the map is edited.
+	void UsePassabilityBitmap(bool use);
+	bool UsingPassabilityBitmap() const { return bitmap != 0; }
 	//virtual BaseMapOccupancyInterface* GetOccupancyInterface(){std::cout<<"Mapenv\n";return oi;}
 	//virtual xyLoc GetNextState(xyLoc &s, tDirection dir);
 	double GetPathLength(std::vector<xyLoc> &neighbors);
@@ -207,9 +215,20 @@ public:
           bitarray[idx / WORD_BITS] |= (1 << (idx % WORD_BITS));
         }
 
+	inline bool Traversable(long x, long y) const
+	{ return bitmap?bitmap->Passable(x, y):map->IsTraversable(x, y); }
+	inline bool CanStep(long x1, long y1, long x2, long y2) const
+	{
+		if (!bitmap)
+			return map->CanStep(x1, y1, x2, y2);
+		return (abs(x1-x2) <= 1) && (abs(y1-y2) <= 1) && bitmap->Passable(x1, y1) && bitmap->Passable(x2, y2);
+	}
+	void GetMaskSuccessors(const xyLoc &loc, std::vector<xyLoc> &neighbors) const;
+
         GraphHeuristic *h;
         xyLoc const* start;
 	Map *map;
+	PassabilityBitmap *bitmap;
 	BaseMapOccupancyInterface *oi;
 	double DIAGONAL_COST;
 	uint8_t connectedness;
@@ -0,0 +1,324 @@
+//
+//  PackedTOH.h
+//  hog2
+//
+//  4-peg Towers of Hanoi with the whole state in one word, and additive
+//  PDBs indexed by the state itself.
+//
+
+#ifndef PackedTOH_h
+#define PackedTOH_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include "SearchEnvironment.h"
+#include "Heuristic.h"
+#include "WorkerPool.h"
+#include "Timer.h"
+#include "TOH.h"
+
+/**
+ * The peg of disk d (1 is the smallest) is in bits 2(d-1) and 2(d-1)+1.
+ * This is the rank of TOH<disks>::GetStateHash, so states convert with
+ * TOH<disks>::GetStateFromHash(pegs, s) and GetStateHash(s).
+ */
+template <int disks>
+struct PackedTOHState {
+	static_assert(disks > 0 && disks < 32, "PackedTOH supports 1 to 31 disks");
+	// all disks on peg 3, as TOHState
+	PackedTOHState() { Reset(); }
+	void Reset() { pegs = (1ull<<(2*disks))-1; }
+	void StandardStart() { pegs = 0; }
+	int GetPeg(int disk) const { return (pegs>>(2*(disk-1)))&3; }
+	uint64_t pegs;
+};
+
+template <int D>
+static std::ostream &operator<<(std::ostream &out, const PackedTOHState<D> &s)
+{
+	TOHState<D> unpacked;
+	TOH<D>().GetStateFromHash(s.pegs, unpacked);
+	out << unpacked;
+	return out;
+}
+
+template <int D>
+static bool operator==(const PackedTOHState<D> &l1, const PackedTOHState<D> &l2)
+{
+	return l1.pegs == l2.pegs;
+}
+
+/**
+ * Moves are found from the low bit of each disk on a peg: the disks on peg
+ * p are the fields equal to p, and the top disk is the lowest of them. A
+ * move flips the peg bits of that one disk. Actions are in the order of
+ * TOH<disks>::GetActions.
+ */
+template <int disks>
+class PackedTOH : public SearchEnvironment<PackedTOHState<disks>, TOHMove> {
+public:
+	void GetSuccessors(const PackedTOHState<disks> &nodeID, std::vector<PackedTOHState<disks>> &neighbors) const;
+	unsigned GetMaxSuccessors() const { return 6; }
+	unsigned GetSuccessorBatch(const PackedTOHState<disks> &nodeID, Successor<PackedTOHState<disks>, TOHMove> *succ, bool withHash) const;
+	void GetActions(const PackedTOHState<disks> &nodeID, std::vector<TOHMove> &actions) const;
+	void ApplyAction(PackedTOHState<disks> &s, TOHMove a) const
+	{ s.pegs ^= uint64_t(a.source^a.dest)<<__builtin_ctzll(GetDisksOnPeg(s.pegs, a.source, kLowBits)); }
+	bool InvertAction(TOHMove &a) const { std::swap(a.source, a.dest); return true; }
+
+	/** Disks that are not on their goal peg **/
+	double HCost(const PackedTOHState<disks> &node1, const PackedTOHState<disks> &node2) const
+	{ return GetNumDifferent(node1.pegs, node2.pegs); }
+	double GCost(const PackedTOHState<disks> &node1, const PackedTOHState<disks> &node2) const { return 1; }
+	double GCost(const PackedTOHState<disks> &node, const TOHMove &act) const { return 1; }
+	bool GoalTest(const PackedTOHState<disks> &node, const PackedTOHState<disks> &goal) const
+	{ return node.pegs == goal.pegs; }
+
+	uint64_t GetStateHash(const PackedTOHState<disks> &node) const { return node.pegs; }
+	void GetStateFromHash(uint64_t hash, PackedTOHState<disks> &s) const { s.pegs = hash; }
+	uint64_t GetMaxHash() const { return 1ull<<(2*disks); }
+	uint64_t GetActionHash(TOHMove act) const { return (act.source<<8)|act.dest; }
+
+	void OpenGLDraw() const { TOH<disks>().OpenGLDraw(); }
+	void OpenGLDraw(const PackedTOHState<disks> &s) const { TOH<disks>().OpenGLDraw(Unpack(s)); }
+	void OpenGLDraw(const PackedTOHState<disks> &s1, const PackedTOHState<disks> &s2, float v) const
+	{ TOH<disks>().OpenGLDraw(Unpack(s1), Unpack(s2), v); }
+	void OpenGLDraw(const PackedTOHState<disks> &, const TOHMove &) const {}
+
+	/** The low bit of every disk on peg p, of the disks in lowBits */
+	static uint64_t GetDisksOnPeg(uint64_t pegs, int p, uint64_t lowBits)
+	{
+		uint64_t diff = pegs^(lowBits*p);
+		return ~(diff|(diff>>1))&lowBits;
+	}
+	/**
+	 * Writes the moves of the disks in lowBits (the low bit of each disk);
+	 * returns the number of moves, at most 6.
+	 */
+	static int GetMoves(uint64_t pegs, uint64_t lowBits, TOHMove *moves);
+	static int GetNumDifferent(uint64_t pegs1, uint64_t pegs2)
+	{
+		uint64_t diff = pegs1^pegs2;
+		return __builtin_popcountll((diff|(diff>>1))&kLowBits);
+	}
+	static TOHState<disks> Unpack(const PackedTOHState<disks> &s)
+	{ TOHState<disks> t; TOH<disks>().GetStateFromHash(s.pegs, t); return t; }
+	static const uint64_t kLowBits = 0x5555555555555555ull>>(64-2*disks);
+};
+
+template <int disks>
+const uint64_t PackedTOH<disks>::kLowBits;
+
+template <int disks>
+int PackedTOH<disks>::GetMoves(uint64_t pegs, uint64_t lowBits, TOHMove *moves)
+{
+	// the bit of the top disk on each peg, or 64 if it is empty
+	int top[4];
+	for (int p = 0; p < 4; p++)
+	{
+		uint64_t onPeg = GetDisksOnPeg(pegs, p, lowBits);
+		top[p] = (onPeg == 0)?64:__builtin_ctzll(onPeg);
+	}
+	int count = 0;
+	for (int a = 0; a < 3; a++)
+	{
+		for (int b = a+1; b < 4; b++)
+		{
+			if (top[a] < top[b])
+				moves[count++] = TOHMove(a, b);
+			else if (top[b] < top[a])
+				moves[count++] = TOHMove(b, a);
+		}
+	}
+	return count;
+}
+
+template <int disks>
+void PackedTOH<disks>::GetActions(const PackedTOHState<disks> &nodeID, std::vector<TOHMove> &actions) const
+{
+	TOHMove moves[6];
+	int count = GetMoves(nodeID.pegs, kLowBits, moves);
+	actions.assign(moves, moves+count);
+}
+
+template <int disks>
+void PackedTOH<disks>::GetSuccessors(const PackedTOHState<disks> &nodeID, std::vector<PackedTOHState<disks>> &neighbors) const
+{
+	TOHMove moves[6];
+	int count = GetMoves(nodeID.pegs, kLowBits, moves);
+	neighbors.resize(count);
+	for (int x = 0; x < count; x++)
+	{
+		neighbors[x] = nodeID;
+		ApplyAction(neighbors[x], moves[x]);
+	}
+}
+
+template <int disks>
+unsigned PackedTOH<disks>::GetSuccessorBatch(const PackedTOHState<disks> &nodeID,
+											  Successor<PackedTOHState<disks>, TOHMove> *succ, bool withHash) const
+{
+	TOHMove moves[6];
+	int count = GetMoves(nodeID.pegs, kLowBits, moves);
+	for (int x = 0; x < count; x++)
+	{
+		succ[x].s = nodeID;
+		ApplyAction(succ[x].s, moves[x]);
+		succ[x].a = moves[x];
+		succ[x].cost = 1;
+		succ[x].hash = succ[x].s.pegs;
+	}
+	return count;
+}
+
+/**
+ * Disjoint additive PDBs: the disks are split into groups of consecutive
+ * disks, and the entry of a group is the distance to its goal pegs of its
+ * disks alone (the other disks are ignored). Each move moves one disk, so
+ * the sum over the groups is admissible. A group's entry is indexed by its
+ * bits of the state, so no ranking is needed; groups of the same size with
+ * the same goal share a table.
+ *
+ * The tables are built with a layered BFS from the goal over the ranks of
+ * each group (TOH moves are reversible), expanding each layer on numThreads
+ * threads. Entries are one byte, and groups have at most 16 disks.
+ */
+template <int disks>
+class PackedTOHPDB : public Heuristic<PackedTOHState<disks>> {
+public:
+	/** The sizes of the groups from the smallest disk up, e.g. {6, 14} for 20 disks */
+	PackedTOHPDB(const std::vector<int> &groupSizes);
+	void BuildPDBs(const PackedTOHState<disks> &goal, int numThreads);
+	/** The heuristic to the goal the PDBs were built for; b is not used */
+	double HCost(const PackedTOHState<disks> &a, const PackedTOHState<disks> &b) const
+	{
+		int h = 0;
+		for (const group &g : groups)
+			h += tables[g.table][(a.pegs>>g.shift)&g.mask];
+		return h;
+	}
+	uint64_t GetMemoryBytes() const;
+private:
+	struct group {
+		int shift, size, table;
+		uint64_t mask, goal;
+	};
+	static const uint8_t kUnset = 0xFF;
+	void BuildTable(std::vector<uint8_t> &table, int size, uint64_t goal, WorkerPool &pool);
+
+	std::vector<group> groups;
+	std::vector<std::vector<uint8_t>> tables;
+};
+
+template <int disks>
+const uint8_t PackedTOHPDB<disks>::kUnset;
+
+template <int disks>
+PackedTOHPDB<disks>::PackedTOHPDB(const std::vector<int> &groupSizes)
+{
+	int shift = 0;
+	for (int size : groupSizes)
+	{
+		if (size < 1 || size > 16)
+		{
+			printf("Error: PackedTOHPDB groups have 1 to 16 disks, not %d\n", size);
+			exit(1);
+		}
+		group g = {shift, size, -1, (1ull<<(2*size))-1, 0};
+		groups.push_back(g);
+		shift += 2*size;
+	}
+	if (shift != 2*disks)
+	{
+		printf("Error: PackedTOHPDB groups have %d disks, not %d\n", shift/2, disks);
+		exit(1);
+	}
+}
+
+template <int disks>
+void PackedTOHPDB<disks>::BuildPDBs(const PackedTOHState<disks> &goal, int numThreads)
+{
+	WorkerPool pool(numThreads);
+	tables.clear();
+	for (group &g : groups)
+		g.table = -1;
+	for (group &g : groups)
+	{
+		g.goal = (goal.pegs>>g.shift)&g.mask;
+		for (const group &other : groups)
+			if (&other != &g && other.table != -1 && other.size == g.size && other.goal == g.goal)
+				g.table = other.table;
+		if (g.table != -1)
+			continue;
+		g.table = (int)tables.size();
+		tables.resize(tables.size()+1);
+		BuildTable(tables.back(), g.size, g.goal, pool);
+	}
+}
+
+template <int disks>
+void PackedTOHPDB<disks>::BuildTable(std::vector<uint8_t> &table, int size, uint64_t goal, WorkerPool &pool)
+{
+	const uint64_t lowBits = 0x5555555555555555ull>>(64-2*size);
+	const uint64_t chunkSize = 1024;
+	int numThreads = pool.NumThreads();
+	Timer t;
+	t.StartTimer();
+	table.assign(1ull<<(2*size), kUnset);
+	table[goal] = 0;
+	// ranks fit in 32 bits with at most 16 disks
+	std::vector<uint32_t> layer(1, (uint32_t)goal);
+	std::vector<std::vector<uint32_t>> next(numThreads);
+	WorkStealingRange work(numThreads);
+	int depth;
+	for (depth = 0; layer.size() > 0; depth++)
+	{
+		if (depth+1 == kUnset)
+		{
+			printf("Error: PDB distances don't fit in a byte\n");
+			exit(1);
+		}
+		work.Reset((layer.size()+chunkSize-1)/chunkSize);
+		pool.Run([&](int threadNum) {
+			uint64_t chunk;
+			TOHMove moves[6];
+			while (work.Next(threadNum, chunk))
+			{
+				for (uint64_t x = chunk*chunkSize; x < std::min((uint64_t)layer.size(), (chunk+1)*chunkSize); x++)
+				{
+					uint64_t pegs = layer[x];
+					int count = PackedTOH<disks>::GetMoves(pegs, lowBits, moves);
+					for (int m = 0; m < count; m++)
+					{
+						int disk = __builtin_ctzll(PackedTOH<disks>::GetDisksOnPeg(pegs, moves[m].source, lowBits));
+						uint64_t child = pegs^(uint64_t(moves[m].source^moves[m].dest)<<disk);
+						uint8_t unset = kUnset;
+						if (__atomic_load_n(&table[child], __ATOMIC_RELAXED) == kUnset &&
+							__atomic_compare_exchange_n(&table[child], &unset, (uint8_t)(depth+1), false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+							next[threadNum].push_back((uint32_t)child);
+					}
+				}
+			}
+		});
+		layer.clear();
+		for (auto &n : next)
+		{
+			layer.insert(layer.end(), n.begin(), n.end());
+			n.clear();
+		}
+	}
+	printf("Built %d-disk PDB: %llu entries, max distance %d; %1.2fs elapsed\n", size,
+		   (unsigned long long)table.size(), depth-1, t.EndTimer());
+}
+
+template <int disks>
+uint64_t PackedTOHPDB<disks>::GetMemoryBytes() const
+{
+	uint64_t total = 0;
+	for (const auto &t : tables)
+		total += t.size();
+	return total;
+}
+
+#endif /* PackedTOH_h */
@@ -77,6 +77,21 @@ void PancakePuzzle::GetSuccessors(const PancakePuzzleState &parent,
 	}
 }
 
+unsigned PancakePuzzle::GetSuccessorBatch(const PancakePuzzleState &parent,
+                                          Successor<PancakePuzzleState, PancakePuzzleAction> *succ, bool withHash) const
+{
+	for (unsigned i = 0; i < operators.size(); i++)
+	{
+		succ[i].s = parent;
+		PancakePuzzle::ApplyAction(succ[i].s, operators[i]);
+		succ[i].a = operators[i];
+		succ[i].cost = 1.0;
+		if (withHash)
+			succ[i].hash = PancakePuzzle::GetStateHash(succ[i].s);
+	}
+	return (unsigned)operators.size();
+}
+
 void PancakePuzzle::GetActions(const PancakePuzzleState &, std::vector<PancakePuzzleAction> &actions) const
 {
 	actions.resize(0);
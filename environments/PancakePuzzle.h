@@ -50,6 +50,8 @@ public:
 
 	~PancakePuzzle();
 	void GetSuccessors(const PancakePuzzleState &state, std::vector<PancakePuzzleState> &neighbors) const;
+	unsigned GetMaxSuccessors() const { return (unsigned)operators.size(); }
+	unsigned GetSuccessorBatch(const PancakePuzzleState &state, Successor<PancakePuzzleState, PancakePuzzleAction> *succ, bool withHash) const;
 	void GetActions(const PancakePuzzleState &state, std::vector<unsigned> &actions) const;
 	PancakePuzzleAction GetAction(const PancakePuzzleState &s1, const PancakePuzzleState &s2) const;
 	void ApplyAction(PancakePuzzleState &s, PancakePuzzleAction a) const;
@@ -68,6 +70,7 @@ public:
 	bool GoalTest(const PancakePuzzleState &s) const;
 
 	uint64_t GetActionHash(PancakePuzzleAction act) const;
+	uint64_t GetMaxHash() const { return Factorial(size); }
 	void StoreGoal(PancakePuzzleState &); // stores the locations for the given goal state
 
 	virtual const std::string GetName();
@@ -7,6 +7,7 @@
 #include <cstdio>
 #include <thread>
 #include <deque>
+#include <algorithm>
 #include "SearchEnvironment.h"
 #include "Timer.h"
 #include "SharedQueue.h"
@@ -95,6 +96,8 @@ namespace PermutationPuzzle {
 								 const std::vector<int> &pattern,
 								 std::vector<int> &dual);
 		void GetStateFromHash(state &s, uint64_t hash) const;
+		/** s must already have the size of the puzzle */
+		void GetStateFromHash(uint64_t hash, state &s) const { GetStateFromHash(s, hash); }
 		uint64_t GetStateHash(const state &s) const;
 		void PrintPDBHistogram(int which) const;
 		void GetPDBHistogram(int which, std::vector<uint64_t> &values) const;
@@ -1280,7 +1283,8 @@ namespace PermutationPuzzle {
 	template <class state, class action>
 	void PermutationPuzzleEnvironment<state, action>::GetStateFromHash(state &s, uint64_t hash) const
 	{
-		std::vector<int> puzzle = s.puzzle;
+		// each entry is written before it is read, so this works in place
+		std::vector<int> &puzzle = s.puzzle;
 		uint64_t hashVal = hash;
 		
 		int numEntriesLeft = 1;
@@ -1295,21 +1299,28 @@ namespace PermutationPuzzle {
 					puzzle[y]++;
 			}
 		}
-		
-		s.puzzle = puzzle;
 	}
 	
 	template <class state, class action>
 	uint64_t PermutationPuzzleEnvironment<state, action>::GetStateHash(const state &s) const
 	{
-		std::vector<int> puzzle = s.puzzle;
+		// rank a copy of the permutation, on the stack unless it is large
+		int localPuzzle[64];
+		std::vector<int> largePuzzle;
+		int *puzzle = localPuzzle;
+		if (s.puzzle.size() > 64)
+		{
+			largePuzzle.resize(s.puzzle.size());
+			puzzle = &largePuzzle[0];
+		}
+		std::copy(s.puzzle.begin(), s.puzzle.end(), puzzle);
 		uint64_t hashVal = 0;
 		int numEntriesLeft = s.puzzle.size();
 		for (unsigned int x = 0; x < s.puzzle.size(); x++)
 		{
 			hashVal += puzzle[x]*Factorial(numEntriesLeft-1);
 			numEntriesLeft--;
-			for (unsigned y = x; y < puzzle.size(); y++)
+			for (unsigned y = x; y < s.puzzle.size(); y++)
 			{
 				if (puzzle[y] > puzzle[x])
 					puzzle[y]--;
@@ -0,0 +1,105 @@
+//
+//  RubikFaceTurn.h
+//  hog2
+//
+//  A face turn of the Rubik's cube in table form, for the corner and edge
+//  states, which keep their pieces in 4-bit fields of a 64-bit word.
+//
+
+#ifndef RubikFaceTurn_h
+#define RubikFaceTurn_h
+
+#include <stdint.h>
+#include <cassert>
+// The shuffle is built on any x86-64 GCC/clang build (with the ssse3 target
+// attribute), so that it can be tested against the scalar copy; Permute only
+// uses it when the build targets SSSE3.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define RUBIK_FACE_TURN_SHUFFLE
+#include <tmmintrin.h>
+#endif
+
+/*
+ * A face turn moves four pieces and changes the orientation of some of them.
+ * from[loc] is the location of the piece that the turn moves to loc and
+ * changes[loc] is the change of its orientation (0 for none).
+ *
+ * With SSSE3 (build with CPU=SSSE3 or CPU=AVX2) Permute spreads the fields
+ * over the bytes of a register and moves them with one shuffle; otherwise it
+ * copies the four fields that move. The pieces whose orientation changes are
+ * listed first, so that the caller only updates NumChanged() of them.
+ */
+class RubikFaceTurn {
+public:
+	RubikFaceTurn(const int *from, const int *changes, int pieces, int firstBit)
+	:firstBit(firstBit), keep(~0ull), changed(0)
+	{
+		for (int x = 0; x < 16; x++)
+			shuffle[x] = x;
+		int moved = 0;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			for (int loc = 0; loc < pieces; loc++)
+			{
+				if (from[loc] == loc || (changes[loc] != 0) != (pass == 0))
+					continue;
+				shuffle[loc] = from[loc];
+				fromBit[moved] = firstBit+4*from[loc];
+				toBit[moved] = firstBit+4*loc;
+				change[moved] = changes[loc];
+				keep &= ~(0xFull<<toBit[moved]);
+				moved++;
+				changed += (pass == 0);
+			}
+		}
+		assert(moved == 4);
+	}
+
+	/** Moves the pieces of state; the orientations don't change */
+	uint64_t Permute(uint64_t state) const
+	{
+#ifdef __SSSE3__
+		return PermuteShuffle(state);
+#else
+		return PermuteScalar(state);
+#endif
+	}
+
+	uint64_t PermuteScalar(uint64_t state) const
+	{
+		uint64_t result = state&keep;
+		for (int x = 0; x < 4; x++)
+			result |= ((state>>fromBit[x])&0xF)<<toBit[x];
+		return result;
+	}
+
+#ifdef RUBIK_FACE_TURN_SHUFFLE
+	/** Only call this if the CPU has SSSE3 */
+	__attribute__((target("ssse3")))
+	uint64_t PermuteShuffle(uint64_t state) const
+	{
+		const __m128i low = _mm_set1_epi8(0x0F);
+		__m128i v = _mm_cvtsi64_si128((long long)(state>>firstBit));
+		__m128i fields = _mm_unpacklo_epi8(_mm_and_si128(v, low), _mm_and_si128(_mm_srli_epi16(v, 4), low));
+		fields = _mm_shuffle_epi8(fields, _mm_loadu_si128((const __m128i *)shuffle));
+		// pairs of bytes back into one byte: low+16*high
+		__m128i pairs = _mm_maddubs_epi16(fields, _mm_set1_epi16(0x1001));
+		uint64_t pieces = (uint64_t)_mm_cvtsi128_si64(_mm_packus_epi16(pairs, pairs));
+		return (state&((1ull<<firstBit)-1))|(pieces<<firstBit);
+	}
+#endif
+
+	/** The number of moved pieces whose orientation changes */
+	int NumChanged() const { return changed; }
+	/** The xth piece whose orientation changes, after Permute */
+	int ChangedPiece(uint64_t state, int x) const { return (state>>toBit[x])&0xF; }
+	int Change(int x) const { return change[x]; }
+private:
+	uint8_t shuffle[16];
+	uint8_t fromBit[4], toBit[4], change[4];
+	int firstBit;
+	uint64_t keep;
+	int changed;
+};
+
+#endif /* RubikFaceTurn_h */
@@ -21,6 +21,23 @@ void RubiksCube::GetSuccessors(const RubiksState &nodeID, std::vector<RubiksStat
 	}
 }
 
+unsigned RubiksCube::GetSuccessorBatch(const RubiksState &nodeID, Successor<RubiksState, RubiksAction> *succ, bool withHash) const
+{
+	if (pruneSuccessors)
+		return 0;
+	for (int x = 0; x < 18; x++)
+	{
+		succ[x].s = nodeID;
+		c.ApplyAction(succ[x].s.corner, x);
+		e.ApplyAction(succ[x].s.edge, x);
+		succ[x].a = x;
+		succ[x].cost = 1.0;
+		if (withHash)
+			succ[x].hash = RubiksCube::GetStateHash(succ[x].s);
+	}
+	return 18;
+}
+
 void RubiksCube::GetPrunedActions(const RubiksState &nodeID, RubiksAction lastAction, std::vector<RubiksAction> &actions) const
 {
 	actions.resize(0);
@@ -846,7 +863,13 @@ uint64_t RubikPDB::GetPDBSize() const
 
 uint64_t RubikPDB::GetPDBHash(const RubiksState &s, int threadID) const
 {
-	return ePDB.GetPDBHash(s.edge, threadID)*cPDB.GetPDBSize()+cPDB.GetPDBHash(s.corner, threadID);
+	// usually either the edges or the corners are empty; their hash is 0
+	uint64_t hash = 0;
+	if (edges.size() > 0)
+		hash = ePDB.GetPDBHash(s.edge, threadID)*cPDB.GetPDBSize();
+	if (corners.size() > 0)
+		hash += cPDB.GetPDBHash(s.corner, threadID);
+	return hash;
 }
 
 void RubikPDB::GetStateFromPDBHash(uint64_t hash, RubiksState &s, int threadID) const
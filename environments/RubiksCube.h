@@ -127,6 +127,9 @@ public:
 	~RubiksCube() { /*delete depth8; delete depth9;*/ }
 	void SetPruneSuccessors(bool val) { pruneSuccessors = val; history.resize(0); }
 	virtual void GetSuccessors(const RubiksState &nodeID, std::vector<RubiksState> &neighbors) const;
+	// pruned successors depend on the history kept by ApplyAction
+	virtual unsigned GetMaxSuccessors() const { return pruneSuccessors?0:18; }
+	virtual unsigned GetSuccessorBatch(const RubiksState &nodeID, Successor<RubiksState, RubiksAction> *succ, bool withHash) const;
 	virtual void GetActions(const RubiksState &nodeID, std::vector<RubiksAction> &actions) const;
 	virtual void GetPrunedActions(const RubiksState &nodeID, RubiksAction lastAction, std::vector<RubiksAction> &actions) const;
 	virtual RubiksAction GetAction(const RubiksState &s1, const RubiksState &s2) const;
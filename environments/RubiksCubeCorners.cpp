@@ -8,6 +8,7 @@
 
 #include "RubiksCubeCorners.h"
 #include "GLUtil.h"
+#include "RubikFaceTurn.h"
 #include <assert.h>
 
 #define LINEAR_RANK 1
@@ -197,149 +198,58 @@ RubiksCornersAction RubiksCorner::GetAction(const RubiksCornerState &s1, const R
 	return a;
 }
 
+// The face turns as tables: action a moves the cube in location
+// cornerFrom[a][loc] to loc and adds cornerTwist[a][loc] to its orientation.
+// Faces are turned in the order 0, 5, 2, 4, 1, 3; +90, -90 and 180 degrees.
+static const int cornerFrom[18][8] = {
+	{3, 0, 1, 2, 4, 5, 6, 7}, {1, 2, 3, 0, 4, 5, 6, 7}, {2, 3, 0, 1, 4, 5, 6, 7},
+	{0, 1, 2, 3, 7, 4, 5, 6}, {0, 1, 2, 3, 5, 6, 7, 4}, {0, 1, 2, 3, 6, 7, 4, 5},
+	{4, 0, 2, 3, 5, 1, 6, 7}, {1, 5, 2, 3, 0, 4, 6, 7}, {5, 4, 2, 3, 1, 0, 6, 7},
+	{0, 1, 6, 2, 4, 5, 7, 3}, {0, 1, 3, 7, 4, 5, 2, 6}, {0, 1, 7, 6, 4, 5, 3, 2},
+	{3, 1, 2, 7, 0, 5, 6, 4}, {4, 1, 2, 0, 7, 5, 6, 3}, {7, 1, 2, 4, 3, 5, 6, 0},
+	{0, 5, 1, 3, 4, 6, 2, 7}, {0, 2, 6, 3, 4, 1, 5, 7}, {0, 6, 5, 3, 4, 2, 1, 7}
+};
+static const int cornerTwist[18][8] = {
+	{0, 0, 0, 0, 0, 0, 0, 0}, {0, 0, 0, 0, 0, 0, 0, 0}, {0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0}, {0, 0, 0, 0, 0, 0, 0, 0}, {0, 0, 0, 0, 0, 0, 0, 0},
+	{1, 2, 0, 0, 2, 1, 0, 0}, {1, 2, 0, 0, 2, 1, 0, 0}, {0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 1, 2, 0, 0, 2, 1}, {0, 0, 1, 2, 0, 0, 2, 1}, {0, 0, 0, 0, 0, 0, 0, 0},
+	{2, 0, 0, 1, 1, 0, 0, 2}, {2, 0, 0, 1, 1, 0, 0, 2}, {0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 1, 2, 0, 0, 2, 1, 0}, {0, 1, 2, 0, 0, 2, 1, 0}, {0, 0, 0, 0, 0, 0, 0, 0}
+};
+
+static std::vector<RubikFaceTurn> MakeCornerTurns()
+{
+	std::vector<RubikFaceTurn> turns;
+	for (int a = 0; a < 18; a++)
+		turns.push_back(RubikFaceTurn(cornerFrom[a], cornerTwist[a], 8, 16));
+	return turns;
+}
+
+static const std::vector<RubikFaceTurn> cornerTurns = MakeCornerTurns();
+
+const RubikFaceTurn &RubiksCorner::FaceTurn(RubiksCornersAction a)
+{
+	return cornerTurns[a];
+}
+
 void RubiksCorner::ApplyAction(RubiksCornerState &s, RubiksCornersAction a) const
 {
-	switch (a)
+	if (a < 0 || a >= 18)
+		return;
+	const RubikFaceTurn &turn = cornerTurns[a];
+	uint64_t state = turn.Permute(s.state);
+	for (int x = 0; x < turn.NumChanged(); x++)
 	{
-		case 0: // face 0
-		{
-			s.Rotate(0, 1, 2, 3);
-		}
-			break;
-		case 1:
-		{
-			s.Rotate(3, 2, 1, 0);
-		}
-			break;
-		case 2:
-		{
-			s.Swap(0, 2, 1, 3);
-		}
-			break;
-		case 3: // face 5
-		{
-			s.Rotate(4, 5, 6, 7);
-		}
-			break;
-		case 4:
-		{
-			s.Rotate(7, 6, 5, 4);
-		}
-			break;
-		case 5:
-		{
-			s.Swap(4, 6, 5, 7);
-		}
-			break;
-			
-		case 6: // face 2
-		{
-			s.Rotate(0, 1, 5, 4);
-			s.SetCubeOrientation(s.GetCubeInLoc(1), (s.GetCubeOrientation(s.GetCubeInLoc(1))+2)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(5), (s.GetCubeOrientation(s.GetCubeInLoc(5))+1)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(4), (s.GetCubeOrientation(s.GetCubeInLoc(4))+2)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(0), (s.GetCubeOrientation(s.GetCubeInLoc(0))+1)%3);
-		}
-			break;
-		case 7:
-		{
-			s.Rotate(4, 5, 1, 0);
-			s.SetCubeOrientation(s.GetCubeInLoc(1), (s.GetCubeOrientation(s.GetCubeInLoc(1))+2)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(5), (s.GetCubeOrientation(s.GetCubeInLoc(5))+1)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(4), (s.GetCubeOrientation(s.GetCubeInLoc(4))+2)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(0), (s.GetCubeOrientation(s.GetCubeInLoc(0))+1)%3);
-		}
-			break;
-		case 8:
-		{
-			s.Swap(0, 5, 1, 4);
-		}
-			break;
-			
-		case 9: // face 4
-		{
-			s.Rotate(2, 3, 7, 6);
-			//std::cout << "^" << s << "\n";
-			s.SetCubeOrientation(s.GetCubeInLoc(3), (s.GetCubeOrientation(s.GetCubeInLoc(3))+2)%3);
-			//std::cout << "^" << s << "\n";
-			s.SetCubeOrientation(s.GetCubeInLoc(2), (s.GetCubeOrientation(s.GetCubeInLoc(2))+1)%3);
-			//std::cout << "^" << s << "\n";
-			s.SetCubeOrientation(s.GetCubeInLoc(6), (s.GetCubeOrientation(s.GetCubeInLoc(6))+2)%3);
-			//std::cout << "^" << s << "\n";
-			s.SetCubeOrientation(s.GetCubeInLoc(7), (s.GetCubeOrientation(s.GetCubeInLoc(7))+1)%3);
-			//std::cout << "^" << s << "\n";
-		}
-			break;
-		case 10:
-		{
-			s.Rotate(6, 7, 3, 2);
-			//std::cout << "*" << s << "\n";
-			s.SetCubeOrientation(s.GetCubeInLoc(3), (s.GetCubeOrientation(s.GetCubeInLoc(3))+2)%3);
-			//std::cout << "*" << s << "\n";
-			s.SetCubeOrientation(s.GetCubeInLoc(2), (s.GetCubeOrientation(s.GetCubeInLoc(2))+1)%3);
-			//std::cout << "*" << s << "\n";
-			s.SetCubeOrientation(s.GetCubeInLoc(6), (s.GetCubeOrientation(s.GetCubeInLoc(6))+2)%3);
-			//std::cout << "*" << s << "\n";
-			s.SetCubeOrientation(s.GetCubeInLoc(7), (s.GetCubeOrientation(s.GetCubeInLoc(7))+1)%3);
-			//std::cout << "*" << s << "\n";
-		}
-			break;
-		case 11:
-		{
-			s.Swap(6, 3, 2, 7);
-		}
-			break;
-			
-		case 12: // face 1
-		{
-			s.Rotate(0, 4, 7, 3);
-			s.SetCubeOrientation(s.GetCubeInLoc(0), (s.GetCubeOrientation(s.GetCubeInLoc(0))+2)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(4), (s.GetCubeOrientation(s.GetCubeInLoc(4))+1)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(7), (s.GetCubeOrientation(s.GetCubeInLoc(7))+2)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(3), (s.GetCubeOrientation(s.GetCubeInLoc(3))+1)%3);
-		}
-			break;
-		case 13:
-		{
-			s.Rotate(3, 7, 4, 0);
-			s.SetCubeOrientation(s.GetCubeInLoc(0), (s.GetCubeOrientation(s.GetCubeInLoc(0))+2)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(4), (s.GetCubeOrientation(s.GetCubeInLoc(4))+1)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(7), (s.GetCubeOrientation(s.GetCubeInLoc(7))+2)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(3), (s.GetCubeOrientation(s.GetCubeInLoc(3))+1)%3);
-		}
-			break;
-		case 14:
-		{
-			s.Swap(0, 7, 4, 3);
-		}
-			break;
-		case 15: // face 3
-		{
-			s.Rotate(1, 2, 6, 5);
-			s.SetCubeOrientation(s.GetCubeInLoc(2), (s.GetCubeOrientation(s.GetCubeInLoc(2))+2)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(6), (s.GetCubeOrientation(s.GetCubeInLoc(6))+1)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(5), (s.GetCubeOrientation(s.GetCubeInLoc(5))+2)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(1), (s.GetCubeOrientation(s.GetCubeInLoc(1))+1)%3);
-		}
-			break;
-		case 16:
-		{
-			s.Rotate(5, 6, 2, 1);
-			s.SetCubeOrientation(s.GetCubeInLoc(2), (s.GetCubeOrientation(s.GetCubeInLoc(2))+2)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(6), (s.GetCubeOrientation(s.GetCubeInLoc(6))+1)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(5), (s.GetCubeOrientation(s.GetCubeInLoc(5))+2)%3);
-			s.SetCubeOrientation(s.GetCubeInLoc(1), (s.GetCubeOrientation(s.GetCubeInLoc(1))+1)%3);
-		}
-			break;
-		case 17:
-		{
-			s.Swap(1, 6, 2, 5);
-		}
-			break;
-		default:
-			break;
+		int cube = turn.ChangedPiece(state, x);
+		if (cube > 7) // no cube in the location (pdb states)
+			continue;
+		uint64_t orientation = ((state>>(2*cube))&0x3)+turn.Change(x);
+		if (orientation >= 3)
+			orientation -= 3;
+		state = (state&~(0x3ull<<(2*cube)))|(orientation<<(2*cube));
 	}
-	
+	s.state = state;
 }
 
 void RubiksCorner::GetNextState(const RubiksCornerState &s0, RubiksCornersAction a, RubiksCornerState &s1) const
@@ -493,12 +403,12 @@ uint64_t RubiksCorner::GetStateHash(const RubiksCornerState &node)
 	//	return hashVal;
 #endif
 #if LINEAR_RANK == 1
-	uint64_t perm = 0, dual = 0;
-	for (int x = 0; x < 8; x++)
+	int perm[8], dual[16];
+	uint64_t pieces = node.state>>16;
+	for (int x = 0; x < 8; x++, pieces >>= 4)
 	{
-		int val = node.GetCubeInLoc(x);
-		set(perm, x, val);
-		set(dual, val, x);
+		perm[x] = pieces&0xF;
+		dual[perm[x]] = x;
 	}
 	
 	uint64_t hashVal = 0;
@@ -506,7 +416,6 @@ uint64_t RubiksCorner::GetStateHash(const RubiksCornerState &node)
 	{
 		hashVal = hashVal*3+node.GetCubeOrientation(x);
 	}
-	//	return (MRRank(12, perm, dual)<<11)|hashVal;
 	hashVal = hashVal*Factorial[8]+MRRank(8, perm, dual);
 	return hashVal;
 #endif
@@ -540,6 +449,24 @@ uint64_t RubiksCorner::MRRank(int n, uint64_t perm, uint64_t dual)
 	return result;
 }
 
+// The same rank from arrays, which are changed. Only the entries below i-1
+// are read after step i, so each swap only writes the entry that is read again.
+uint64_t RubiksCorner::MRRank(int n, int *perm, int *dual)
+{
+	uint64_t result = 0;
+	uint64_t multiplier = 1;
+	for (int i = n; i > 1; i--)
+	{
+		int s = perm[i-1];
+		int d = dual[i-1];
+		result += s*multiplier;
+		multiplier *= i;
+		perm[d] = s;
+		dual[s] = d;
+	}
+	return result;
+}
+
 
 /////
 
@@ -1084,7 +1011,7 @@ uint64_t RubikCornerPDB::GetPDBSize() const
 //	uint64_t power3[] = {1, 3, 9, 27, 81, 243, 729, 2187, 2187}; // last tile is symmetric
 //	int elts = (int)corners.size();
 //	return FactorialUpperK(8, 8-elts)*power3[elts];
-	uint64_t answer[] = {1, 24, 504, 9072, 136080, 1632960, 14696640, 88179840, 88179840};
+	static const uint64_t answer[] = {1, 24, 504, 9072, 136080, 1632960, 14696640, 88179840, 88179840};
 	return answer[corners.size()];
 }
 #define MR
@@ -1243,14 +1170,14 @@ bool RubikCornerPDB::Load(const char *prefix)
 		perror("Opening RubiksCornerPDB file");
 		return false;
 	}
-	Save(f);
+	bool result = Load(f);
 	fclose(f);
-	return true;
+	return result;
 }
 
 void RubikCornerPDB::Save(const char *prefix)
 {
-	FILE *f = fopen(GetFileName(prefix).c_str(), "w+");
+	FILE *f = fopen(GetFileName(prefix).c_str(), "w+b");
 	if (f == 0)
 	{
 		perror("Opening RubiksCornerPDB file");
@@ -1329,7 +1256,7 @@ uint64_t RubikCornerPDB::Factorial(int val) const
 
 uint64_t RubikCornerPDB::FactorialUpperK(int n, int k) const
 {
-	const uint64_t result[9][9] = {
+	static const uint64_t result[9][9] = {
 		{1}, // n = 0
 		{1, 1}, // n = 1
 		{2, 2, 1}, // n = 2
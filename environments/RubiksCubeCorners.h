@@ -91,6 +91,8 @@ public:
 	int length() { if (next == 0) return 1; return 1+next->length(); }
 };
 
+class RubikFaceTurn;
+
 class RubiksCorner
 {
 public:
@@ -109,6 +111,8 @@ public:
 	virtual void GetActions(const RubiksCornerState &nodeID, std::vector<RubiksCornersAction> &actions) const;
 	virtual RubiksCornersAction GetAction(const RubiksCornerState &s1, const RubiksCornerState &s2) const;
 	virtual void ApplyAction(RubiksCornerState &s, RubiksCornersAction a) const;
+	/** The table form of face turn a (0-17) */
+	static const RubikFaceTurn &FaceTurn(RubiksCornersAction a);
 	
 	void ApplyMove(RubiksCornerState &s, RubikCornerMove *a);
 	void UndoMove(RubiksCornerState &s, RubikCornerMove *a);
@@ -165,6 +169,7 @@ private:
 	void SetFaceColor(int face, const RubiksCornerState&) const;
 	//	void SetFaceColor(int face, const RubiksCornerState&) const;
 	static uint64_t MRRank(int n, uint64_t perm, uint64_t dual);
+	static uint64_t MRRank(int n, int *perm, int *dual);
 	static void MRUnrank2(int n, uint64_t r, uint64_t &perm);
 	RubikCornerMove moves[18];
 };
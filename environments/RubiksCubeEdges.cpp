@@ -8,6 +8,7 @@
 
 #include "RubiksCubeEdges.h"
 #include "GLUtil.h"
+#include "RubikFaceTurn.h"
 #include <cassert>
 #include <string>
 #include <thread>
@@ -108,261 +109,54 @@ void RubikEdge::UndoAction(RubikEdgeState &s, RubikEdgeAction a) const
 	ApplyAction(s, todo);
 }
 
+// The face turns as tables: action a moves the cube in location
+// edgeFrom[a][loc] to loc and flips it if edgeFlip[a][loc] is set.
+// Faces are turned in the order 0, 5, 2, 4, 1, 3; +90, -90 and 180 degrees.
+static const int edgeFrom[18][12] = {
+	{6, 1, 0, 3, 2, 5, 4, 7, 8, 9, 10, 11}, {2, 1, 4, 3, 6, 5, 0, 7, 8, 9, 10, 11}, {4, 1, 6, 3, 0, 5, 2, 7, 8, 9, 10, 11},
+	{0, 1, 2, 3, 4, 5, 6, 7, 11, 8, 9, 10}, {0, 1, 2, 3, 4, 5, 6, 7, 9, 10, 11, 8}, {0, 1, 2, 3, 4, 5, 6, 7, 10, 11, 8, 9},
+	{0, 9, 1, 2, 4, 5, 6, 7, 8, 3, 10, 11}, {0, 2, 3, 9, 4, 5, 6, 7, 8, 1, 10, 11}, {0, 3, 9, 1, 4, 5, 6, 7, 8, 2, 10, 11},
+	{0, 1, 2, 3, 4, 11, 5, 6, 8, 9, 10, 7}, {0, 1, 2, 3, 4, 6, 7, 11, 8, 9, 10, 5}, {0, 1, 2, 3, 4, 7, 11, 5, 8, 9, 10, 6},
+	{7, 0, 2, 3, 4, 5, 6, 8, 1, 9, 10, 11}, {1, 8, 2, 3, 4, 5, 6, 0, 7, 9, 10, 11}, {8, 7, 2, 3, 4, 5, 6, 1, 0, 9, 10, 11},
+	{0, 1, 2, 10, 3, 4, 6, 7, 8, 9, 5, 11}, {0, 1, 2, 4, 5, 10, 6, 7, 8, 9, 3, 11}, {0, 1, 2, 5, 10, 3, 6, 7, 8, 9, 4, 11}
+};
+static const int edgeFlip[18][12] = {
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+	{0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0}, {0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0}, {0, 1, 1, 1, 0, 0, 0, 0, 0, 1, 0, 0},
+	{0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1}, {0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 1}, {0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1},
+	{1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, {1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0}, {1, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0},
+	{0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0}, {0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 1, 0}, {0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 1, 0}
+};
+
+static std::vector<RubikFaceTurn> MakeEdgeTurns()
+{
+	std::vector<RubikFaceTurn> turns;
+	for (int a = 0; a < 18; a++)
+		turns.push_back(RubikFaceTurn(edgeFrom[a], edgeFlip[a], 12, 12));
+	return turns;
+}
+
+static const std::vector<RubikFaceTurn> edgeTurns = MakeEdgeTurns();
+
+const RubikFaceTurn &RubikEdge::FaceTurn(RubikEdgeAction a)
+{
+	return edgeTurns[a];
+}
+
 void RubikEdge::ApplyAction(RubikEdgeState &s, RubikEdgeAction a) const
 {
-	switch (a)
+	if (a < 0 || a >= 18)
+		return;
+	const RubikFaceTurn &turn = edgeTurns[a];
+	uint64_t state = turn.Permute(s.state);
+	for (int x = 0; x < turn.NumChanged(); x++)
 	{
-		case 0: // face 0
-		{
-			int a = s.GetCubeInLoc(1-1);
-			int b = s.GetCubeInLoc(3-1);
-			int c = s.GetCubeInLoc(5-1);
-			int d = s.GetCubeInLoc(7-1);
-			s.SetCubeInLoc(1-1, d);
-			s.SetCubeInLoc(3-1, a);
-			s.SetCubeInLoc(5-1, b);
-			s.SetCubeInLoc(7-1, c);
-		}
-			break;
-		case 1:
-		{
-			int a = s.GetCubeInLoc(1-1);
-			int b = s.GetCubeInLoc(3-1);
-			int c = s.GetCubeInLoc(5-1);
-			int d = s.GetCubeInLoc(7-1);
-			s.SetCubeInLoc(1-1, b);
-			s.SetCubeInLoc(3-1, c);
-			s.SetCubeInLoc(5-1, d);
-			s.SetCubeInLoc(7-1, a);
-		}
-			break;
-		case 2:
-		{
-			int a = s.GetCubeInLoc(1-1);
-			int b = s.GetCubeInLoc(3-1);
-			int c = s.GetCubeInLoc(5-1);
-			int d = s.GetCubeInLoc(7-1);
-			s.SetCubeInLoc(1-1, c);
-			s.SetCubeInLoc(3-1, d);
-			s.SetCubeInLoc(5-1, a);
-			s.SetCubeInLoc(7-1, b);
-		}
-			break;
-		case 3: // face 5
-		{
-			int a = s.GetCubeInLoc(9-1);
-			int b = s.GetCubeInLoc(10-1);
-			int c = s.GetCubeInLoc(11-1);
-			int d = s.GetCubeInLoc(12-1);
-			s.SetCubeInLoc(9-1, d);
-			s.SetCubeInLoc(10-1, a);
-			s.SetCubeInLoc(11-1, b);
-			s.SetCubeInLoc(12-1, c);
-		}
-			break;
-		case 4:
-		{
-			int a = s.GetCubeInLoc(9-1);
-			int b = s.GetCubeInLoc(10-1);
-			int c = s.GetCubeInLoc(11-1);
-			int d = s.GetCubeInLoc(12-1);
-			s.SetCubeInLoc(9-1, b);
-			s.SetCubeInLoc(10-1, c);
-			s.SetCubeInLoc(11-1, d);
-			s.SetCubeInLoc(12-1, a);
-		}
-			break;
-		case 5:
-		{
-			int a = s.GetCubeInLoc(9-1);
-			int b = s.GetCubeInLoc(10-1);
-			int c = s.GetCubeInLoc(11-1);
-			int d = s.GetCubeInLoc(12-1);
-			s.SetCubeInLoc(9-1, c);
-			s.SetCubeInLoc(10-1, d);
-			s.SetCubeInLoc(11-1, a);
-			s.SetCubeInLoc(12-1, b);
-		}
-			break;
-			
-		case 6: // face 2
-		{
-			int a = s.GetCubeInLoc(2-1);
-			int b = s.GetCubeInLoc(3-1);
-			int c = s.GetCubeInLoc(4-1);
-			int d = s.GetCubeInLoc(10-1);
-			s.SetCubeInLoc(2-1, d);
-			s.SetCubeInLoc(3-1, a);
-			s.SetCubeInLoc(4-1, b);
-			s.SetCubeInLoc(10-1, c);
-			s.FlipCubeOrientation(b);
-			s.FlipCubeOrientation(d);
-		}
-			break;
-		case 7:
-		{
-			int a = s.GetCubeInLoc(2-1);
-			int b = s.GetCubeInLoc(3-1);
-			int c = s.GetCubeInLoc(4-1);
-			int d = s.GetCubeInLoc(10-1);
-			s.SetCubeInLoc(2-1, b);
-			s.SetCubeInLoc(3-1, c);
-			s.SetCubeInLoc(4-1, d);
-			s.SetCubeInLoc(10-1, a);
-			s.FlipCubeOrientation(a);
-			s.FlipCubeOrientation(c);
-		}
-			break;
-		case 8:
-		{
-			int a = s.GetCubeInLoc(2-1);
-			int b = s.GetCubeInLoc(3-1);
-			int c = s.GetCubeInLoc(4-1);
-			int d = s.GetCubeInLoc(10-1);
-			s.SetCubeInLoc(2-1, c);
-			s.SetCubeInLoc(3-1, d);
-			s.SetCubeInLoc(4-1, a);
-			s.SetCubeInLoc(10-1, b);
-			s.FlipCubeOrientation(a);
-			s.FlipCubeOrientation(b);
-			s.FlipCubeOrientation(c);
-			s.FlipCubeOrientation(d);
-		}
-			break;
-			
-		case 9: // face 4
-		{
-			int a = s.GetCubeInLoc(6-1);
-			int b = s.GetCubeInLoc(7-1);
-			int c = s.GetCubeInLoc(8-1);
-			int d = s.GetCubeInLoc(12-1);
-			s.SetCubeInLoc(6-1, d);
-			s.SetCubeInLoc(7-1, a);
-			s.SetCubeInLoc(8-1, b);
-			s.SetCubeInLoc(12-1, c);
-			s.FlipCubeOrientation(c);
-			s.FlipCubeOrientation(d);
-		}
-			break;
-		case 10:
-		{
-			int a = s.GetCubeInLoc(6-1);
-			int b = s.GetCubeInLoc(7-1);
-			int c = s.GetCubeInLoc(8-1);
-			int d = s.GetCubeInLoc(12-1);
-			s.SetCubeInLoc(6-1, b);
-			s.SetCubeInLoc(7-1, c);
-			s.SetCubeInLoc(8-1, d);
-			s.SetCubeInLoc(12-1, a);
-			s.FlipCubeOrientation(a);
-			s.FlipCubeOrientation(d);
-		}
-			break;
-		case 11:
-		{
-			int a = s.GetCubeInLoc(6-1);
-			int b = s.GetCubeInLoc(7-1);
-			int c = s.GetCubeInLoc(8-1);
-			int d = s.GetCubeInLoc(12-1);
-			s.SetCubeInLoc(6-1, c);
-			s.SetCubeInLoc(7-1, d);
-			s.SetCubeInLoc(8-1, a);
-			s.SetCubeInLoc(12-1, b);
-			s.FlipCubeOrientation(b);
-			s.FlipCubeOrientation(d);
-		}
-			break;
-			
-		case 12: // face 1
-		{
-			int a = s.GetCubeInLoc(1-1);
-			int b = s.GetCubeInLoc(2-1);
-			int c = s.GetCubeInLoc(9-1);
-			int d = s.GetCubeInLoc(8-1);
-			s.SetCubeInLoc(1-1, d);
-			s.SetCubeInLoc(2-1, a);
-			s.SetCubeInLoc(9-1, b);
-			s.SetCubeInLoc(8-1, c);
-			s.FlipCubeOrientation(a);
-			s.FlipCubeOrientation(d);
-		}
-			break;
-		case 13:
-		{
-			int a = s.GetCubeInLoc(1-1);
-			int b = s.GetCubeInLoc(2-1);
-			int c = s.GetCubeInLoc(9-1);
-			int d = s.GetCubeInLoc(8-1);
-			s.SetCubeInLoc(1-1, b);
-			s.SetCubeInLoc(2-1, c);
-			s.SetCubeInLoc(9-1, d);
-			s.SetCubeInLoc(8-1, a);
-			s.FlipCubeOrientation(a);
-			s.FlipCubeOrientation(b);
-		}
-			break;
-		case 14:
-		{
-			int a = s.GetCubeInLoc(1-1);
-			int b = s.GetCubeInLoc(2-1);
-			int c = s.GetCubeInLoc(9-1);
-			int d = s.GetCubeInLoc(8-1);
-			s.SetCubeInLoc(1-1, c);
-			s.SetCubeInLoc(2-1, d);
-			s.SetCubeInLoc(9-1, a);
-			s.SetCubeInLoc(8-1, b);
-			s.FlipCubeOrientation(a);
-			s.FlipCubeOrientation(c);
-		}
-			break;
-		case 15: // face 3
-		{
-			int a = s.GetCubeInLoc(4-1);
-			int b = s.GetCubeInLoc(5-1);
-			int c = s.GetCubeInLoc(6-1);
-			int d = s.GetCubeInLoc(11-1);
-			s.SetCubeInLoc(4-1, d);
-			s.SetCubeInLoc(5-1, a);
-			s.SetCubeInLoc(6-1, b);
-			s.SetCubeInLoc(11-1, c);
-			s.FlipCubeOrientation(b);
-			s.FlipCubeOrientation(d);
-		}
-			break;
-		case 16:
-		{
-			int a = s.GetCubeInLoc(4-1);
-			int b = s.GetCubeInLoc(5-1);
-			int c = s.GetCubeInLoc(6-1);
-			int d = s.GetCubeInLoc(11-1);
-			s.SetCubeInLoc(4-1, b);
-			s.SetCubeInLoc(5-1, c);
-			s.SetCubeInLoc(6-1, d);
-			s.SetCubeInLoc(11-1, a);
-			s.FlipCubeOrientation(a);
-			s.FlipCubeOrientation(c);
-		}
-			break;
-		case 17:
-		{
-			int a = s.GetCubeInLoc(4-1);
-			int b = s.GetCubeInLoc(5-1);
-			int c = s.GetCubeInLoc(6-1);
-			int d = s.GetCubeInLoc(11-1);
-			s.SetCubeInLoc(4-1, c);
-			s.SetCubeInLoc(5-1, d);
-			s.SetCubeInLoc(6-1, a);
-			s.SetCubeInLoc(11-1, b);
-			s.FlipCubeOrientation(a);
-			s.FlipCubeOrientation(b);
-			s.FlipCubeOrientation(c);
-			s.FlipCubeOrientation(d);
-		}
-			break;
-		default:
-			break;
+		int cube = turn.ChangedPiece(state, x);
+		if (cube < 12) // else no cube in the location (pdb states)
+			state ^= 1ull<<cube;
 	}
-	
+	s.state = state;
 }
 
 void RubikEdge::GetNextState(const RubikEdgeState &s0, RubikEdgeAction a, RubikEdgeState &s1) const
@@ -476,20 +270,16 @@ void RubikEdge::rankPlayerRemaining(const RubikEdgeState &node, int, int64_t &ra
 
 uint64_t RubikEdge::GetStateHash(const RubikEdgeState &node) const
 {
-	uint64_t perm = 0, dual = 0;
-	for (int x = 0; x < 12; x++)
+	int perm[12], dual[16];
+	uint64_t pieces = node.state>>12;
+	for (int x = 0; x < 12; x++, pieces >>= 4)
 	{
-		int val = node.GetCubeInLoc(x);
-		set(perm, x, val);
-		set(dual, val, x);
+		perm[x] = pieces&0xF;
+		dual[perm[x]] = x;
 	}
 	
-	uint64_t hashVal = 0;
-	for (int x = 0; x < 11; x++)
-	{
-		hashVal = (hashVal<<1)+node.GetCubeOrientation(11-x);
-	}
-	//	return (MRRank(12, perm, dual)<<11)|hashVal;
+	// the flips of cubes 11...1, with cube 11 in the high bit
+	uint64_t hashVal = (node.state>>1)&0x7FF;
 	hashVal = hashVal*Factorial(12)+MRRank(12, perm, dual);
 	return hashVal;
 }
@@ -531,6 +321,24 @@ uint64_t RubikEdge::MRRank(int n, uint64_t perm, uint64_t dual)
 	//	return s+n*MRRank(n-1, perm, dual);
 }
 
+// The same rank from arrays, which are changed. Only the entries below i-1
+// are read after step i, so each swap only writes the entry that is read again.
+uint64_t RubikEdge::MRRank(int n, int *perm, int *dual)
+{
+	uint64_t result = 0;
+	uint64_t multiplier = 1;
+	for (int i = n; i > 1; i--)
+	{
+		int s = perm[i-1];
+		int d = dual[i-1];
+		result += s*multiplier;
+		multiplier *= i;
+		perm[d] = s;
+		dual[s] = d;
+	}
+	return result;
+}
+
 // 53.5% time
 uint64_t RubikEdge::MRRank2(int n, uint64_t perm, uint64_t dual)
 {
@@ -1151,7 +959,7 @@ void RubikEdgePDB::GetStateFromHash(RubikEdgeState &s, uint64_t hash)
 uint64_t RubikEdgePDB::GetPDBSize() const
 {
 	// last tile is symmetric
-	uint64_t power2[] = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 2048};
+	static const uint64_t power2[] = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 2048};
 	int elts = (int)edges.size();
 	return FactorialUpperK(12, 12-elts)*power2[elts];
 //	return mr1.GetMaxRank()*power2[elts];
@@ -1233,30 +1041,7 @@ void RubikEdgePDB::GetStateFromPDBHash(uint64_t hash, RubikEdgeState &s, int thr
 	hashVal = hashVal%FactorialUpperK(12, lastPiece); // for pieces
 	
 	mr1.Unrank(hashVal, puzzle, dual, edgeSize, 12);
-	for (int x = 0; x < 12; x++)
-	{
-		s.SetCubeInLoc(x, 0xF);
-		s.SetCubeOrientation(x, 0);
-	}
-	
-	for (int x = 0; x < edgeSize; x++)
-	{
-		s.SetCubeInLoc(dual[x], edges[x]);
-	}
-	
-	int cnt = 0;
-	int limit = std::min((int)edgeSize, 11);
-	for (int x = limit-1; x >= 0; x--)
-	{
-		s.SetCubeOrientation(edges[x], hash%2);
-		cnt += hash%2;
-		hash/=2;
-	}
-	if (edges.size() == 12)
-	{
-		assert(!"Be sure to test this code");
-		s.SetCubeOrientation(edges[11], cnt%2);
-	}
+	SetStateFromMR1(dual, hash, s);
 	
 #else
 	
@@ -1305,6 +1090,101 @@ void RubikEdgePDB::GetStateFromPDBHash(uint64_t hash, RubikEdgeState &s, int thr
 #endif
 }
 
+/*
+ * Sets the edges at the locations in dual and the orientations from the high
+ * part of the hash.
+ */
+void RubikEdgePDB::SetStateFromMR1(const int *dual, uint64_t orientations, RubikEdgeState &s) const
+{
+	int edgeSize = (int)edges.size();
+	for (int x = 0; x < 12; x++)
+	{
+		s.SetCubeInLoc(x, 0xF);
+		s.SetCubeOrientation(x, 0);
+	}
+	
+	for (int x = 0; x < edgeSize; x++)
+	{
+		s.SetCubeInLoc(dual[x], edges[x]);
+	}
+	
+	int cnt = 0;
+	int limit = std::min((int)edgeSize, 11);
+	for (int x = limit-1; x >= 0; x--)
+	{
+		s.SetCubeOrientation(edges[x], orientations%2);
+		cnt += orientations%2;
+		orientations/=2;
+	}
+	if (edges.size() == 12)
+	{
+		assert(!"Be sure to test this code");
+		s.SetCubeOrientation(edges[11], cnt%2);
+	}
+}
+
+static const int edgeBatchStates = 64;
+
+void RubikEdgePDB::GetPDBHashes(const RubikEdgeState *s, uint64_t *hashes, int count, int threadID) const
+{
+#ifdef MR
+	int puzzle[edgeBatchStates*12];
+	int newdual[edgeBatchStates*12];
+	uint64_t ranks[edgeBatchStates];
+	int edgeSize = (int)edges.size();
+	uint64_t pieceRanks = FactorialUpperK(12, 12-edgeSize);
+	int limit = std::min(edgeSize, 11);
+	for (int base = 0; base < count; base += edgeBatchStates)
+	{
+		int num = std::min(edgeBatchStates, count-base);
+		memset(puzzle, 0xFF, num*12*sizeof(puzzle[0]));
+		for (int b = 0; b < num; b++)
+		{
+			int dual[16]; // seamlessly handle 0xF entries (no cube)
+			for (int x = 0; x < 12; x++)
+				dual[s[base+b].GetCubeInLoc(x)] = x;
+			for (int x = 0; x < edgeSize; x++)
+			{
+				newdual[b*12+x] = dual[edges[x]];
+				puzzle[b*12+dual[edges[x]]] = x;
+			}
+		}
+		mr1.RankBatch(puzzle, newdual, edgeSize, 12, num, ranks);
+		for (int b = 0; b < num; b++)
+		{
+			uint64_t part2 = 0;
+			for (int x = 0; x < limit; x++)
+				part2 = part2*2+(s[base+b].GetCubeOrientation(edges[x]));
+			hashes[base+b] = part2*pieceRanks+ranks[b];
+		}
+	}
+#else
+	PDBHeuristic::GetPDBHashes(s, hashes, count, threadID);
+#endif
+}
+
+void RubikEdgePDB::GetStatesFromPDBHashes(const uint64_t *hashes, RubikEdgeState *s, int count, int threadID) const
+{
+#ifdef MR
+	int puzzle[edgeBatchStates*12];
+	int dual[edgeBatchStates*12];
+	uint64_t ranks[edgeBatchStates];
+	int edgeSize = (int)edges.size();
+	uint64_t pieceRanks = FactorialUpperK(12, 12-edgeSize);
+	for (int base = 0; base < count; base += edgeBatchStates)
+	{
+		int num = std::min(edgeBatchStates, count-base);
+		for (int b = 0; b < num; b++)
+			ranks[b] = hashes[base+b]%pieceRanks;
+		mr1.UnrankBatch(ranks, puzzle, dual, edgeSize, 12, num);
+		for (int b = 0; b < num; b++)
+			SetStateFromMR1(&dual[b*12], hashes[base+b]/pieceRanks, s[base+b]);
+	}
+#else
+	PDBHeuristic::GetStatesFromPDBHashes(hashes, s, count, threadID);
+#endif
+}
+
 bool RubikEdgePDB::Load(const char *prefix)
 {
 	FILE *f = fopen(GetFileName(prefix).c_str(), "rb");
@@ -1313,14 +1193,14 @@ bool RubikEdgePDB::Load(const char *prefix)
 		perror("Opening RubiksEdgePDB file");
 		return false;
 	}
-	Save(f);
+	bool result = Load(f);
 	fclose(f);
-	return true;
+	return result;
 }
 
 void RubikEdgePDB::Save(const char *prefix)
 {
-	FILE *f = fopen(GetFileName(prefix).c_str(), "w+");
+	FILE *f = fopen(GetFileName(prefix).c_str(), "w+b");
 	if (f == 0)
 	{
 		perror("Opening RubiksEdgePDB file");
@@ -1401,7 +1281,7 @@ uint64_t RubikEdgePDB::Factorial(int val)
 
 uint64_t RubikEdgePDB::FactorialUpperK(int n, int k)
 {
-	const uint64_t result[13][13] = {
+	static const uint64_t result[13][13] = {
 		{1}, // n = 0
 		{1, 1}, // n = 1
 		{2, 2, 1}, // n = 2
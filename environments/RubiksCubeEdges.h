@@ -102,6 +102,8 @@ public:
 	int length() { if (next == 0) return 1; return 1+next->length(); }
 };
 
+class RubikFaceTurn;
+
 class RubikEdge  : public SearchEnvironment<RubikEdgeState, RubikEdgeAction>
 {
 public:
@@ -120,6 +122,8 @@ public:
 	virtual void GetActions(const RubikEdgeState &nodeID, std::vector<RubikEdgeAction> &actions) const;
 	virtual RubikEdgeAction GetAction(const RubikEdgeState &s1, const RubikEdgeState &s2) const;
 	virtual void ApplyAction(RubikEdgeState &s, RubikEdgeAction a) const;
+	/** The table form of face turn a (0-17) */
+	static const RubikFaceTurn &FaceTurn(RubikEdgeAction a);
 	virtual void UndoAction(RubikEdgeState &s, RubikEdgeAction a) const;
 
 	
@@ -166,6 +170,7 @@ public:
 	static void MRUnrank(int n, uint64_t r, uint64_t &perm);
 	static void MRUnrank2(int n, uint64_t r, uint64_t &perm);
 	static uint64_t MRRank(int n, uint64_t perm, uint64_t dual);
+	static uint64_t MRRank(int n, int *perm, int *dual);
 	static uint64_t MRRank2(int n, uint64_t perm, uint64_t dual);
 
 private:
@@ -185,6 +190,8 @@ public:
 	uint64_t GetPDBHash(const RubikEdgeState &s, int threadID = 0) const;
 	virtual uint64_t GetAbstractHash(const RubikEdgeState &s, int threadID = 0) const { return GetPDBHash(s); }
 	void GetStateFromPDBHash(uint64_t hash, RubikEdgeState &s, int threadID = 0) const;
+	void GetPDBHashes(const RubikEdgeState *s, uint64_t *hashes, int count, int threadID = 0) const;
+	void GetStatesFromPDBHashes(const uint64_t *hashes, RubikEdgeState *s, int count, int threadID = 0) const;
 	RubikEdgeState GetStateFromAbstractState(RubikEdgeState &s) const { return s; }
 
 	bool Load(const char *prefix);
@@ -195,6 +202,7 @@ public:
 private:
 	static uint64_t Factorial(int val);
 	static uint64_t FactorialUpperK(int n, int k);
+	void SetStateFromMR1(const int *dual, uint64_t orientations, RubikEdgeState &s) const;
 	std::vector<int> edges;
 	size_t puzzleSize;
 	uint64_t pdbSize;
@@ -141,6 +141,7 @@ public:
 	uint64_t GetStateHash(const TOHState<disks> &node) const;
 	void GetStateFromHash(uint64_t parent, TOHState<disks> &s) const;
 	uint64_t GetNumStates(TOHState<disks> &s) const;
+	uint64_t GetMaxHash() const { return 1ull<<(2*disks); }
 	uint64_t GetActionHash(TOHMove act) const;
 
 
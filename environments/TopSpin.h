@@ -88,6 +88,7 @@ public:
 	//void LoadPDB(char *fname, const std::vector<int> &tiles, bool additive);
 
 	uint64_t GetActionHash(TopSpinAction act) const;
+	uint64_t GetMaxHash() const { return Factorial(numTiles); }
 	void OpenGLDraw() const;
 	void OpenGLDraw(const TopSpinState &s) const;
 	void OpenGLDraw(const TopSpinState &l1, const TopSpinState &l2, float v) const;
@@ -7,8 +7,13 @@
 //
 
 #include <stdio.h>
+#include <math.h>
+#include <algorithm>
 #include "Voxels.h"
 
+static const double kRootTwo = sqrt(2.0);
+static const double kRootThree = sqrt(3.0);
+
 // id at each layer of octree
 struct octTreeLink {
 	int layer : 3;
@@ -33,6 +38,12 @@ bool operator==(const voxelState &v1, const voxelState &v2)
 	return v1.x == v2.x && v1.y == v2.y && v1.z == v2.z;
 }
 
+std::ostream &operator<<(std::ostream &out, const voxelState &s)
+{
+	out << "(" << s.x << ", " << s.y << ", " << s.z << ")";
+	return out;
+}
+
 
 Voxels::Voxels(const char *filename)
 {
@@ -46,11 +57,11 @@ Voxels::Voxels(const char *filename)
 	}
 	//voxelWorld w;
 	fread(&w.header, sizeof(w.header), 1, f);
-	printf("Header is 0x%lX\n", w.header);
+	printf("Header is 0x%X\n", w.header);
 	fread(&w.voxelSize, sizeof(w.voxelSize), 1, f);
 	printf("Voxel size is %f\n", w.voxelSize);
 	fread(&w.numVoxelsGrids, sizeof(w.numVoxelsGrids), 1, f);
-	printf("%llu voxel grids to follow\n", w.numVoxelsGrids);
+	printf("%llu voxel grids to follow\n", (unsigned long long)w.numVoxelsGrids);
 	fread(w.minbounds, sizeof(w.minbounds[0]), 4, f);
 	fread(w.maxbounds, sizeof(w.maxbounds[0]), 4, f);
 	printf("Min bounds: ");
@@ -65,74 +76,121 @@ Voxels::Voxels(const char *filename)
 		printf("%f ", w.maxbounds[x]);
 	}
 	printf("\n");
+	// (morton, grid) pairs, read at once
+	std::vector<uint64_t> pairs(2*w.numVoxelsGrids);
+	if (fread(pairs.data(), sizeof(uint64_t), pairs.size(), f) != pairs.size())
+	{
+		printf("Error: file is truncated\n");
+		exit(0);
+	}
+	fclose(f);
 	w.morton = new uint64_t[w.numVoxelsGrids];
 	w.grid = new uint64_t[w.numVoxelsGrids];
-	for (int x = 0; x < w.numVoxelsGrids; x++)
+	// the world covers the bounds and every grid in the file
+	uint32_t size[3];
+	for (int x = 0; x < 3; x++)
+		size[x] = (uint32_t)std::max(0.0f, ceilf((w.maxbounds[x]-w.minbounds[x])/w.voxelSize));
+	for (uint64_t x = 0; x < w.numVoxelsGrids; x++)
 	{
-		
-		assert(fread(&w.morton[x], sizeof(w.morton[x]), 1, f) == 1);
-		assert(fread(&w.grid[x], sizeof(w.grid[x]), 1, f) == 1);
-		printf("0x%llX\n", w.morton[x]);
-		point3d p = GetVoxelCoordinate(w.morton[x], w.voxelSize, w.minbounds);
-		printf("(%f, %f, %f)\n", p.x, p.y, p.z);
-		printf("0x%llX\n", w.grid[x]);
-		for (int i = 0; i < 64; i++)
+		w.morton[x] = pairs[2*x];
+		w.grid[x] = pairs[2*x+1];
+		uint32_t brick[3];
+		VoxelOctree::DecodeMorton(w.morton[x], brick[0], brick[1], brick[2]);
+		for (int y = 0; y < 3; y++)
+			size[y] = std::max(size[y], 4*brick[y]+4);
+	}
+	tree.Build(w.morton, w.grid, w.numVoxelsGrids, size[0], size[1], size[2]);
+	printf("%u x %u x %u voxels, %llu bytes of occupancy\n", size[0], size[1], size[2],
+		   (unsigned long long)tree.GetMemoryBytes());
+
+	// a diagonal move passes the voxels of every subset of its moved axes
+	for (int a = 0; a < kXsYsZs; a++)
+	{
+		int delta[3] = {0, 0, 0};
+		for (int axis = 0, code = a; axis < 3; axis++, code /= 3)
+			delta[2-axis] = (code%3 == 0)?1:((code%3 == 1)?-1:0);
+		needed[a] = 0;
+		for (int sub = 1; sub < 8; sub++)
 		{
-			size_t a, b, c;
-			GetCoordsForIndex(i, a, b, c);
-			if ((w.grid[x]>>i)&1) // blocked
-			{
-				//printf("{%f, %f, %f} ", (p.x+a*w.voxelSize)/8, (p.y+b*w.voxelSize)/8, (p.z+c*w.voxelSize)/8);
-			}
+			int d[3];
+			for (int axis = 0; axis < 3; axis++)
+				d[axis] = ((sub>>axis)&1)?delta[axis]:0;
+			needed[a] |= 1u<<((d[0]+1)*9+(d[1]+1)*3+(d[2]+1));
 		}
-		printf("\n");
+		needed[a] &= ~(1u<<13); // the voxel itself
 	}
-	
-	printf("\n");
-	
-	fclose(f);
 }
 
 Voxels::~Voxels()
 {
-	
+	delete [] w.morton;
+	delete [] w.grid;
+}
+
+uint32_t Voxels::GetLegalActions(const voxelState &s) const
+{
+	uint32_t free = tree.GetFreeNeighborhood(s.x, s.y, s.z);
+	uint32_t legal = 0;
+	for (int a = 0; a < kXsYsZs; a++)
+		if ((free&needed[a]) == needed[a])
+			legal |= 1u<<a;
+	return legal;
 }
 
 void Voxels::GetSuccessors(const voxelState &nodeID, std::vector<voxelState> &neighbors) const
 {
-	
+	neighbors.resize(0);
+	for (uint32_t legal = GetLegalActions(nodeID); legal; legal &= legal-1)
+	{
+		voxelState s = nodeID;
+		ApplyAction(s, (voxelAction)__builtin_ctz(legal));
+		neighbors.push_back(s);
+	}
 }
 
 void Voxels::GetActions(const voxelState &nodeID, std::vector<voxelAction> &actions) const
 {
-	
+	actions.resize(0);
+	for (uint32_t legal = GetLegalActions(nodeID); legal; legal &= legal-1)
+		actions.push_back((voxelAction)__builtin_ctz(legal));
 }
 
 void Voxels::ApplyAction(voxelState &s, voxelAction a) const
 {
-	
+	// the actions are X, Y, Z each in {p, m, s}
+	const int delta[3] = {1, -1, 0};
+	s.x += delta[a/9];
+	s.y += delta[(a/3)%3];
+	s.z += delta[a%3];
 }
 
 bool Voxels::InvertAction(voxelAction &a) const
 {
-	return false;
+	const int invert[3] = {1, 0, 2};
+	a = (voxelAction)(invert[a/9]*9+invert[(a/3)%3]*3+invert[a%3]);
+	return true;
 }
 
 
 /** Heuristic value between two arbitrary nodes. **/
 double Voxels::HCost(const voxelState &node1, const voxelState &node2) const
 {
-	return 0;
+	// diagonal moves in 3, then 2 dimensions, then straight moves
+	int d[3] = {abs(node1.x-node2.x), abs(node1.y-node2.y), abs(node1.z-node2.z)};
+	std::sort(d, d+3);
+	return d[0]*kRootThree+(d[1]-d[0])*kRootTwo+(d[2]-d[1]);
 }
 
 double Voxels::GCost(const voxelState &node1, const voxelState &node2) const
 {
-	return 1;
+	int axes = (node1.x != node2.x)+(node1.y != node2.y)+(node1.z != node2.z);
+	return (axes == 3)?kRootThree:((axes == 2)?kRootTwo:1);
 }
 
 double Voxels::GCost(const voxelState &node, const voxelAction &act) const
 {
-	return 1;
+	int axes = (act/9 != 2)+((act/3)%3 != 2)+(act%3 != 2);
+	return (axes == 3)?kRootThree:((axes == 2)?kRootTwo:1);
 }
 
 bool Voxels::GoalTest(const voxelState &node, const voxelState &goal) const
@@ -143,10 +201,10 @@ bool Voxels::GoalTest(const voxelState &node, const voxelState &goal) const
 
 uint64_t Voxels::GetStateHash(const voxelState &node) const
 {
-	return (node.x<<32)|(node.y<<16)|(node.z);
+	return ((uint64_t)node.x<<32)|((uint64_t)node.y<<16)|(node.z);
 }
 
-void Voxels::GetStateFromHash(uint64_t parent, voxelState &s)
+void Voxels::GetStateFromHash(uint64_t parent, voxelState &s) const
 {
 	s.z = parent&0xFFFF;
 	s.y = (parent>>16)&0xFFFF;
@@ -10,6 +10,7 @@
 #define Voxels_h
 
 #include "SearchEnvironment.h"
+#include "VoxelOctree.h"
 
 struct voxelWorld {
 	uint32_t header;
@@ -27,6 +28,7 @@ struct voxelState {
 };
 
 bool operator==(const voxelState &v1, const voxelState &v2);
+std::ostream &operator<<(std::ostream &out, const voxelState &s);
 
 
 enum voxelAction {
@@ -59,6 +61,11 @@ enum voxelAction {
 	kXsYsZs
 };
 
+/**
+ * 3D grid search on a .3dnav voxel world: 26-connected moves of cost 1,
+ * sqrt(2) or sqrt(3), where a diagonal move needs every voxel it passes
+ * (the voxels of the moved axes) to be free. The occupancy is a VoxelOctree.
+ */
 class Voxels : public SearchEnvironment<voxelState, voxelAction> {
 public:
 	Voxels(const char *filename);
@@ -67,6 +74,10 @@ public:
 	void GetActions(const voxelState &nodeID, std::vector<voxelAction> &actions) const;
 	void ApplyAction(voxelState &s, voxelAction a) const;
 	bool InvertAction(voxelAction &a) const;
+	/** Bit a is set if action a is legal (kXsYsZs never is) */
+	uint32_t GetLegalActions(const voxelState &s) const;
+	bool IsBlocked(const voxelState &s) const { return tree.IsBlocked(s.x, s.y, s.z); }
+	const VoxelOctree &GetOccupancy() const { return tree; }
 	
 	
 	/** Heuristic value between two arbitrary nodes. **/
@@ -76,7 +87,7 @@ public:
 	bool GoalTest(const voxelState &node, const voxelState &goal) const;
 	
 	uint64_t GetStateHash(const voxelState &node) const;
-	void GetStateFromHash(uint64_t parent, voxelState &s);
+	void GetStateFromHash(uint64_t parent, voxelState &s) const;
 	
 	uint64_t GetActionHash(voxelAction act) const;
 	
@@ -88,6 +99,9 @@ public:
 	void GLDrawLine(const voxelState &x, const voxelState &y) const;
 private:
 	voxelWorld w;
+	VoxelOctree tree;
+	// the free voxels of VoxelOctree::GetFreeNeighborhood that each action needs
+	uint32_t needed[kXsYsZs];
 	point3d GetVoxelCoordinate(uint64_t morton, float voxelSize, const float minbounds[4]) const;
 
 	// "Insert" two 0 bits after each of the 10 low bits of x
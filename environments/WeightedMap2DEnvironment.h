@@ -76,6 +76,8 @@ public:
 	void ApplyAction(xyLoc &s, tDirection dir) const;
 	virtual double GCost(const xyLoc &node1, const xyLoc &node2) const;
 	virtual double GCost(const xyLoc &node1, const tDirection &act) const { return AbsMapEnvironment::GCost(node1, act); }
+	// the batch has the unweighted costs
+	virtual unsigned GetMaxSuccessors() const { return 0; }
 	//virtual BaseMapOccupancyInterface* GetOccupancyInterface(){std::cout<<"Returning "<<oi<<std::endl;return oi;}
 	virtual BaseMapOccupancyInterface* GetOccupancyInfo(){return oi;}
 	void OpenGLDraw() const;
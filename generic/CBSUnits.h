@@ -33,6 +33,8 @@
 #include "TemporalAStar.h"
 #include "Heuristic.h"
 #include "Timer.h"
+#include "ConflictIndex.h"
+#include "WorkerPool.h"
 #include <string.h>
 
 #define NO_CONFLICT    0
@@ -44,6 +46,7 @@
 float collisionTimeTotal(0);
 float planTime(0);
 float replanTime(0);
+std::mutex replanTimeLock; // children may be replanned concurrently
 float bypassplanTime(0);
 template <class state>
 struct CompareLowGCost;
@@ -138,7 +141,10 @@ unsigned ReplanLeg(CBSUnit<state,action,comparison,conflicttable,searchalgo>* c,
   Timer tmr;
   tmr.StartTimer();
   astar.GetPath(env, start, goal, path, minTime);
-  replanTime+=tmr.EndTimer();
+  {
+    std::lock_guard<std::mutex> l(replanTimeLock);
+    replanTime+=tmr.EndTimer();
+  }
   //std::cout << "Replan took: " << tmr.EndTimer() << std::endl;
   //std::cout << "New leg " << path.size() << "\n";
   //for(auto &p: path){std::cout << p << "\n";}
@@ -289,7 +295,7 @@ template<typename state>
 struct Conflict {
   Conflict<state>():c(nullptr),unit1(9999999),prevWpt(0){}
   Conflict<state>(Conflict<state>const& from):c(from.c.release()),unit1(from.unit1),prevWpt(from.prevWpt){}
-  Conflict<state>& operator=(Conflict<state>const& from){c.reset(from.c.release());unit1=from.unit1;prevWpt=from.prevWpt;}
+  Conflict<state>& operator=(Conflict<state>const& from){c.reset(from.c.release());unit1=from.unit1;prevWpt=from.prevWpt;return *this;}
   mutable std::unique_ptr<Constraint<state>> c;
   unsigned unit1;
   unsigned prevWpt;
@@ -298,8 +304,8 @@ struct Conflict {
 template<typename state, typename conflicttable, class searchalgo>
 struct CBSTreeNode {
 	CBSTreeNode():parent(0),satisfiable(true),cat(){}
-	CBSTreeNode(CBSTreeNode<state,conflicttable,searchalgo> const& from):wpts(from.wpts),paths(from.paths),con(from.con),parent(from.parent),satisfiable(from.satisfiable),cat(from.cat){}
-        CBSTreeNode(CBSTreeNode<state,conflicttable,searchalgo> const& node, Conflict<state> const& c, unsigned p, bool s):wpts(node.wpts),paths(node.paths),con(c),parent(p),satisfiable(s),cat(node.cat){}
+	CBSTreeNode(CBSTreeNode<state,conflicttable,searchalgo> const& from):wpts(from.wpts),paths(from.paths),con(from.con),parent(from.parent),satisfiable(from.satisfiable),cat(from.cat),index(from.index){}
+        CBSTreeNode(CBSTreeNode<state,conflicttable,searchalgo> const& node, Conflict<state> const& c, unsigned p, bool s):wpts(node.wpts),paths(node.paths),con(c),parent(p),satisfiable(s),cat(node.cat),index(node.index){}
         CBSTreeNode& operator=(CBSTreeNode<state,conflicttable,searchalgo> const& from){
           wpts=from.wpts;
           paths=from.paths;
@@ -307,6 +313,8 @@ struct CBSTreeNode {
           parent=from.parent;
           satisfiable=from.satisfiable;
           cat=from.cat;
+          index=from.index;
+          return *this;
         }
 	std::vector< std::vector<int> > wpts;
 	Solution<state> paths;
@@ -315,6 +323,9 @@ struct CBSTreeNode {
 	bool satisfiable;
         //IntervalTree cat; // Conflict avoidance table
         conflicttable cat; // Conflict avoidance table
+        // Spatio-temporal buckets of the paths. Children start from a copy of
+        // their parent's, so only the replanned paths are re-bucketed.
+        mutable ConflictIndex<state> index;
 };
 
 template<typename state, typename conflicttable, class searchalgo>
@@ -359,6 +370,11 @@ class CBSGroup : public UnitGroup<state, action, ConstrainedEnvironment<state,ac
     unsigned LoadConstraintsForNode(int location, int agent=-1);
     bool Bypass(int best, std::pair<unsigned,unsigned> const& numConflicts, Conflict<state> const& c1, unsigned otherunit, double minTime);
     void Replan(int location);
+    void Replan(int location, searchalgo& search);
+    void ReplanChildren(std::vector<unsigned> const& children);
+    void ExpandBatch(Conflict<state> const& c1, Conflict<state> const& c2, unsigned nc);
+    void AddChildToOpen(unsigned last, unsigned nc1);
+    void CheckExpansionLimit();
     void HasConflict(std::vector<state> const& a, std::vector<int> const& wa, std::vector<state> const& b, std::vector<int> const& wb, int x, int y, Conflict<state> &c1, Conflict<state> &c2, std::pair<unsigned,unsigned>& conflict);
     std::pair<unsigned,unsigned> FindHiPriConflict(CBSTreeNode<state,conflicttable,searchalgo>  const& location, Conflict<state> &c1, Conflict<state> &c2);
     unsigned FindFirstConflict(CBSTreeNode<state,conflicttable,searchalgo>  const& location, Conflict<state> &c1, Conflict<state> &c2);
@@ -370,6 +386,7 @@ class CBSGroup : public UnitGroup<state, action, ConstrainedEnvironment<state,ac
     std::vector<EnvironmentContainer<state,action>*> currentEnvironment;
 
     void SetEnvironment(unsigned conflicts,unsigned agent);
+    void SetEnvironment(unsigned conflicts,unsigned agent,searchalgo& search);
     void ClearEnvironmentConstraints(unsigned agent);
     void AddEnvironmentConstraint(Constraint<state>* c, unsigned agent);
 
@@ -403,6 +420,12 @@ class CBSGroup : public UnitGroup<state, action, ConstrainedEnvironment<state,ac
 
     uint TOTAL_EXPANSIONS = 0;
 
+    // Low-level search instances (and their expansion counts) for replanning
+    // children on the worker threads; thread 0 uses astar.
+    std::vector<std::unique_ptr<searchalgo>> workerSearch;
+    std::vector<uint> workerExpansions;
+    std::unique_ptr<WorkerPool> pool;
+
     //std::vector<SearchEnvironment<state,action>*> agentEnvs;
 public:
     // Algorithm parameters
@@ -418,6 +441,13 @@ public:
     bool verbose=false;
     bool quiet=false;
     bool disappearAtGoal=true;
+    // Number of threads used to replan the children of CT nodes. The
+    // comparison's per-search state (CAT, currentEnv, ...) must be
+    // thread_local and each agent needs its own environment objects.
+    unsigned numThreads=1;
+    // Number of open CT nodes expanded together; their children are
+    // replanned at the same time. The CT doesn't depend on numThreads.
+    unsigned ctBatch=1;
 };
 
 template<typename state, typename action, typename comparison, typename conflicttable, class searchalgo>
@@ -509,6 +539,8 @@ CBSGroup<state,action,comparison,conflicttable,searchalgo>::CBSGroup(std::vector
 
   // Sort the environment container by the number of conflicts
   unsigned agent(0);
+  // Sized once here; replans on the worker threads only set their own agent's entry
+  currentEnvironment.resize(environvec.size());
   for(auto& environs: environvec){
     std::sort(environs.begin(), environs.end(), 
         [](const EnvironmentContainer<state,action>& a, const EnvironmentContainer<state,action>& b) -> bool 
@@ -526,6 +558,27 @@ CBSGroup<state,action,comparison,conflicttable,searchalgo>::CBSGroup(std::vector
 }
 
 
+/** Add a replanned CT node to the open list */
+template<typename state, typename action, typename comparison, typename conflicttable, class searchalgo>
+void CBSGroup<state,action,comparison,conflicttable,searchalgo>::AddChildToOpen(unsigned last, unsigned nc1)
+{
+  double cost = 0;
+  for (int y = 0; y < tree[last].paths.size(); y++){
+    if(verbose){
+      std::cout << "Agent " << y <<":\n";
+      for(auto const& ff:tree[last].paths[y]){
+        std::cout << ff << "\n";
+      }
+      std::cout << "cost: " << currentEnvironment[y]->environment->GetPathLength(tree[last].paths[y]) << "\n";
+    }
+    cost += currentEnvironment[y]->environment->GetPathLength(tree[last].paths[y]);
+  }
+  if(verbose){
+    std::cout << "New CT NODE: " << last << " replanned: " << tree[last].con.unit1 << " cost: " << cost << " " << nc1 << "\n";
+  }
+  openList.emplace(last, cost, nc1);
+}
+
 /** Expand a single CBS node */
 // Return true while processing
 template<typename state, typename action, typename comparison, typename conflicttable, class searchalgo>
@@ -571,57 +624,36 @@ bool CBSGroup<state,action,comparison,conflicttable,searchalgo>::ExpandOneCBSNod
       usleep(animate*1000);
     }
 
-    double minTime(0.0);
-    // If this is the last waypoint, the plan needs to extend so that the agent sits at the final goal
-    if(bestNode==0 || tree[bestNode].con.prevWpt+1==tree[bestNode].wpts[c1.unit1].size()-1){
-      minTime=GetMaxTime(bestNode,c1.unit1)-1.0; // Take off a 1-second wait action, otherwise paths will grow over and over.
-    }
-    if((numConflicts.second&LEFT_CARDINAL) || !Bypass(bestNode,numConflicts,c1,c2.unit1,minTime)){
-      last = tree.size();
-      tree.resize(last+1);
-      tree[last] = CBSTreeNode<state,conflicttable,searchalgo>(tree[bestNode],c1,bestNode,true);
-      Replan(last);
-      unsigned nc1(numConflicts.first);
-      double cost = 0;
-      for (int y = 0; y < tree[last].paths.size(); y++){
-        if(verbose){
-          std::cout << "Agent " << y <<":\n";
-          for(auto const& ff:tree[last].paths[y]){
-            std::cout << ff << "\n";
-          }
-          std::cout << "cost: " << currentEnvironment[y]->environment->GetPathLength(tree[last].paths[y]) << "\n";
-        }
-        cost += currentEnvironment[y]->environment->GetPathLength(tree[last].paths[y]);
+    // When neither side tries a bypass, the two children are independent and
+    // can be replanned concurrently. They are added to the open list in the
+    // same order as in the sequential version.
+    bool direct1((numConflicts.second&LEFT_CARDINAL) || nobypass);
+    bool direct2((numConflicts.second&RIGHT_CARDINAL) || nobypass);
+    if((numThreads>1 || ctBatch>1) && direct1 && direct2){
+      ExpandBatch(c1,c2,numConflicts.first);
+    }else{
+      double minTime(0.0);
+      // If this is the last waypoint, the plan needs to extend so that the agent sits at the final goal
+      if(bestNode==0 || tree[bestNode].con.prevWpt+1==tree[bestNode].wpts[c1.unit1].size()-1){
+        minTime=std::max(0.0,GetMaxTime(bestNode,c1.unit1)-1.0); // Take off a 1-second wait action, otherwise paths will grow over and over.
       }
-      if(verbose){
-        std::cout << "New CT NODE: " << last << " replanned: " << c1.unit1 << " cost: " << cost << " " << nc1 << "\n";
+      if(direct1 || !Bypass(bestNode,numConflicts,c1,c2.unit1,minTime)){
+        last = tree.size();
+        tree.resize(last+1);
+        tree[last] = CBSTreeNode<state,conflicttable,searchalgo>(tree[bestNode],c1,bestNode,true);
+        Replan(last);
+        AddChildToOpen(last,numConflicts.first);
       }
-      openList.emplace(last, cost, nc1);
-    }
-    if(bestNode==0 || tree[bestNode].con.prevWpt+1==tree[bestNode].wpts[c2.unit1].size()-1){
-      minTime=GetMaxTime(bestNode,c2.unit1)-1.0; // Take off a 1-second wait action, otherwise paths will grow over and over.
-    }
-    if((numConflicts.second&RIGHT_CARDINAL) || !Bypass(bestNode,numConflicts,c2,c1.unit1,minTime)){
-      last = tree.size();
-      tree.resize(last+1);
-      tree[last] = CBSTreeNode<state,conflicttable,searchalgo>(tree[bestNode],c2,bestNode,true);
-      Replan(last);
-      unsigned nc1(numConflicts.first);
-      double cost = 0;
-      for (int y = 0; y < tree[last].paths.size(); y++){
-        if(verbose){
-          std::cout << "Agent " << y <<":\n";
-          for(auto const& ff:tree[last].paths[y]){
-            std::cout << ff << "\n";
-          }
-          std::cout << "cost: " << currentEnvironment[y]->environment->GetPathLength(tree[last].paths[y]) << "\n";
-        }
-        cost += currentEnvironment[y]->environment->GetPathLength(tree[last].paths[y]);
+      if(bestNode==0 || tree[bestNode].con.prevWpt+1==tree[bestNode].wpts[c2.unit1].size()-1){
+        minTime=std::max(0.0,GetMaxTime(bestNode,c2.unit1)-1.0); // Take off a 1-second wait action, otherwise paths will grow over and over.
       }
-      if(verbose){
-        std::cout << "New CT NODE: " << last << " replanned: " << c2.unit1 << " cost: " << cost << " " << nc1 << "\n";
+      if(direct2 || !Bypass(bestNode,numConflicts,c2,c1.unit1,minTime)){
+        last = tree.size();
+        tree.resize(last+1);
+        tree[last] = CBSTreeNode<state,conflicttable,searchalgo>(tree[bestNode],c2,bestNode,true);
+        Replan(last);
+        AddChildToOpen(last,numConflicts.first);
       }
-      openList.emplace(last, cost, nc1);
     }
 
     // Get the best node from the top of the open list, and remove it from the list
@@ -660,6 +692,50 @@ bool CBSGroup<state,action,comparison,conflicttable,searchalgo>::ExpandOneCBSNod
   return true;
 }
 
+/** Expand bestNode, whose conflict needs no bypass, together with up to
+ * ctBatch-1 more nodes from the top of the open list. The extra nodes are
+ * taken in order until one has no conflict or would try a bypass; that node
+ * goes back on the open list, so a solution is still only accepted as the
+ * best open node. All children are replanned at once, then added to the open
+ * list in the order they were made. */
+template<typename state, typename action, typename comparison, typename conflicttable, class searchalgo>
+void CBSGroup<state,action,comparison,conflicttable,searchalgo>::ExpandBatch(Conflict<state> const& c1, Conflict<state> const& c2, unsigned nc)
+{
+  std::vector<unsigned> children;
+  std::vector<unsigned> conflicts;
+  unsigned last(tree.size());
+  tree.resize(last+2);
+  tree[last] = CBSTreeNode<state,conflicttable,searchalgo>(tree[bestNode],c1,bestNode,true);
+  tree[last+1] = CBSTreeNode<state,conflicttable,searchalgo>(tree[bestNode],c2,bestNode,true);
+  children.push_back(last);
+  children.push_back(last+1);
+  conflicts.resize(2,nc);
+  while(children.size()/2<ctBatch && !openList.empty()){
+    OpenListNode next(openList.top());
+    if(!tree[next.location].satisfiable){
+      openList.pop();
+      continue;
+    }
+    Conflict<state> d1, d2;
+    auto numConflicts(FindHiPriConflict(tree[next.location],d1,d2));
+    if(numConflicts.first==0 ||
+       !(((numConflicts.second&LEFT_CARDINAL) || nobypass) && ((numConflicts.second&RIGHT_CARDINAL) || nobypass)))
+      break; // leave it for a later expansion
+    openList.pop();
+    if(!quiet)std::cout << "TREE " << next.location <<"("<<tree[next.location].parent << ") expanded with " << bestNode << "; conflict between unit " << d1.unit1 << " and unit " << d2.unit1 << " NC " << numConflicts.first << "\n";
+    last = tree.size();
+    tree.resize(last+2);
+    tree[last] = CBSTreeNode<state,conflicttable,searchalgo>(tree[next.location],d1,next.location,true);
+    tree[last+1] = CBSTreeNode<state,conflicttable,searchalgo>(tree[next.location],d2,next.location,true);
+    children.push_back(last);
+    children.push_back(last+1);
+    conflicts.resize(children.size(),numConflicts.first);
+  }
+  ReplanChildren(children);
+  for(unsigned i(0); i<children.size(); ++i)
+    AddChildToOpen(children[i],conflicts[i]);
+}
+
 template<typename state, typename action, typename comparison, typename conflicttable, class searchalgo>
 bool CBSUnit<state,action,comparison,conflicttable,searchalgo>::MakeMove(ConstrainedEnvironment<state,action> *ae, OccupancyInterface<state,action> *,
 							 SimulationInfo<state,action,ConstrainedEnvironment<state,action>> * si, action& a)
@@ -808,11 +884,9 @@ void CBSGroup<state,action,comparison,conflicttable,searchalgo>::UpdateLocation(
 }
 
 template<typename state, typename action, typename comparison, typename conflicttable, class searchalgo>
-void CBSGroup<state,action,comparison,conflicttable,searchalgo>::SetEnvironment(unsigned numConflicts, unsigned agent){
+void CBSGroup<state,action,comparison,conflicttable,searchalgo>::SetEnvironment(unsigned numConflicts, unsigned agent, searchalgo& search){
   bool set(false);
-  if(currentEnvironment.size()<agent+1){
-    currentEnvironment.resize(agent+1); // We make the assumption that agents are continuously numbered
-  }
+  assert(agent<currentEnvironment.size() && "Each agent needs an environment set");
   for (int i = 0; i < this->environments[agent].size(); i++) {
     if (numConflicts >= environments[agent][i].threshold) {
       if(verbose)std::cout << "Setting to env# " << i << " b/c " << numConflicts << " >= " << environments[agent][i].threshold<<environments[agent][i].environment->name()<<std::endl;
@@ -825,8 +899,13 @@ void CBSGroup<state,action,comparison,conflicttable,searchalgo>::SetEnvironment(
   }
   if(!set)assert(false&&"No env was set - you need -cutoffs of zero...");
 
-  astar.SetHeuristic(currentEnvironment[agent]->heuristic);
-  astar.SetWeight(currentEnvironment[agent]->astar_weight);
+  search.SetHeuristic(currentEnvironment[agent]->heuristic.get());
+  search.SetWeight(currentEnvironment[agent]->astar_weight);
+}
+
+template<typename state, typename action, typename comparison, typename conflicttable, class searchalgo>
+void CBSGroup<state,action,comparison,conflicttable,searchalgo>::SetEnvironment(unsigned numConflicts, unsigned agent){
+  SetEnvironment(numConflicts,agent,astar);
 }
 
 /** Add a new unit with a new start and goal state to the CBS group */
@@ -860,7 +939,7 @@ void CBSGroup<state,action,comparison,conflicttable,searchalgo>::AddUnit(Unit<st
   //agentEnvs[c->getUnitNumber()]=currentEnvironment[this->GetNumMembers()-1]->environment;
   comparison::CAT = &(tree[0].cat);
   comparison::CAT->set(&tree[0].paths);
-  GetFullPath<state,action,comparison,conflicttable,searchalgo>(c, astar, currentEnvironment[this->GetNumMembers()-1]->environment, tree[0].paths.back(),tree[0].wpts.back(),this->GetNumMembers()-1);
+  GetFullPath<state,action,comparison,conflicttable,searchalgo>(c, astar, currentEnvironment[this->GetNumMembers()-1]->environment.get(), tree[0].paths.back(),tree[0].wpts.back(),this->GetNumMembers()-1);
   if(killex != INT_MAX && TOTAL_EXPANSIONS>killex)
       processSolution(-timer->EndTimer());
   //std::cout << "AddUnit agent: " << (this->GetNumMembers()-1) << " expansions: " << astar.GetNodesExpanded() << "\n";
@@ -869,7 +948,7 @@ void CBSGroup<state,action,comparison,conflicttable,searchalgo>::AddUnit(Unit<st
   if(this->GetNumMembers()<2) tree[0].cat=conflicttable();
   // We add the optimal path to the root of the tree
   if(comparison::useCAT){
-    tree[0].cat.insert(tree[0].paths.back(),currentEnvironment[this->GetNumMembers()-1]->environment,tree[0].paths.size()-1);
+    tree[0].cat.insert(tree[0].paths.back(),currentEnvironment[this->GetNumMembers()-1]->environment.get(),tree[0].paths.size()-1);
   }
   StayAtGoal(0); // Do this every time a unit is added because these updates are taken into consideration by the CAT
 
@@ -989,7 +1068,7 @@ bool CBSGroup<state,action,comparison,conflicttable,searchalgo>::Bypass(int best
   Timer tmr;
   tmr.StartTimer();
   SetEnvironment(numConflicts.first,c1.unit1);
-  astar.GetPath(currentEnvironment[c1.unit1]->environment,start,goal,path,minTime); // Get the path with the new constraint
+  astar.GetPath(currentEnvironment[c1.unit1]->environment.get(),start,goal,path,minTime); // Get the path with the new constraint
   bypassplanTime+=tmr.EndTimer();
   MergeLeg<state,action,comparison,conflicttable,searchalgo>(path,newPath,newWpts,c1.prevWpt, c1.prevWpt+1,minTime);
   if(fleq(currentEnvironment[c1.unit1]->environment->GetPathLength(newPath),cost)){
@@ -1017,7 +1096,7 @@ bool CBSGroup<state,action,comparison,conflicttable,searchalgo>::Bypass(int best
         processSolution(timer->EndTimer());
         break;
       }
-    }while(fleq(astar.GetNextPath(currentEnvironment[c1.unit1]->environment,start,goal,path,minTime),cost));
+    }while(fleq(astar.GetNextPath(currentEnvironment[c1.unit1]->environment.get(),start,goal,path,minTime),cost));
   }
   TOTAL_EXPANSIONS+=astar.GetNodesExpanded();
   if(killex != INT_MAX && TOTAL_EXPANSIONS>killex)
@@ -1056,9 +1135,76 @@ bool CBSGroup<state,action,comparison,conflicttable,searchalgo>::Bypass(int best
 }
 
 
-/** Replan a node given a constraint */
+template<typename state, typename action, typename comparison, typename conflicttable, class searchalgo>
+void CBSGroup<state,action,comparison,conflicttable,searchalgo>::CheckExpansionLimit()
+{
+  if(killex != INT_MAX && TOTAL_EXPANSIONS>killex)
+    processSolution(-timer->EndTimer());
+}
+
 template<typename state, typename action, typename comparison, typename conflicttable, class searchalgo>
 void CBSGroup<state,action,comparison,conflicttable,searchalgo>::Replan(int location)
+{
+  Replan(location,astar);
+  CheckExpansionLimit();
+}
+
+/** Replan the new CT nodes, at most numThreads at a time.
+ * The children of one agent use that agent's environments, so they are
+ * replanned in order by the same thread; children of different agents only
+ * share read-only data. The results don't depend on which thread replanned
+ * them. */
+template<typename state, typename action, typename comparison, typename conflicttable, class searchalgo>
+void CBSGroup<state,action,comparison,conflicttable,searchalgo>::ReplanChildren(std::vector<unsigned> const& children)
+{
+  std::vector<std::vector<unsigned>> groups;
+  std::vector<int> groupOf(this->GetNumMembers(),-1);
+  for(auto child:children){
+    unsigned agent(tree[child].con.unit1);
+    if(groupOf[agent]<0){
+      groupOf[agent]=groups.size();
+      groups.resize(groups.size()+1);
+    }
+    groups[groupOf[agent]].push_back(child);
+  }
+  if(numThreads<2 || groups.size()<2){
+    for(auto child:children)
+      Replan(child);
+    return;
+  }
+  if(!pool || pool->NumThreads()!=numThreads){
+    pool.reset(new WorkerPool(numThreads));
+    workerSearch.resize(numThreads);
+    workerExpansions.resize(numThreads);
+    for(unsigned t(1); t<numThreads; ++t){
+      if(!workerSearch[t]){
+        workerSearch[t].reset(new searchalgo());
+        workerSearch[t]->SetVerbose(verbose);
+      }
+      // resizing may have moved the counters
+      workerSearch[t]->SetExternalExpansionsPtr(&workerExpansions[t]);
+    }
+  }
+  unsigned threads(numThreads);
+  for(unsigned t(1); t<threads; ++t){
+    workerExpansions[t]=TOTAL_EXPANSIONS;
+    workerSearch[t]->SetExternalExpansionLimit(killex);
+  }
+  unsigned before(TOTAL_EXPANSIONS);
+  pool->Run([&](int t){
+    // group i is replanned by thread i%threads; thread 0 uses astar
+    for(unsigned i(t); i<groups.size(); i+=threads)
+      for(auto child:groups[i])
+        Replan(child,t?*workerSearch[t]:astar);
+  });
+  for(unsigned t(1); t<threads; ++t)
+    TOTAL_EXPANSIONS+=workerExpansions[t]-before;
+  CheckExpansionLimit();
+}
+
+/** Replan a node given a constraint */
+template<typename state, typename action, typename comparison, typename conflicttable, class searchalgo>
+void CBSGroup<state,action,comparison,conflicttable,searchalgo>::Replan(int location, searchalgo& search)
 {
   // Select the unit from the tree with the new constraint
   int theUnit = tree[location].con.unit1;
@@ -1066,7 +1212,7 @@ void CBSGroup<state,action,comparison,conflicttable,searchalgo>::Replan(int loca
   unsigned numConflicts(LoadConstraintsForNode(location));
 
   // Set the environment based on the number of conflicts
-  SetEnvironment(numConflicts,theUnit);
+  SetEnvironment(numConflicts,theUnit,search);
 
   // Select the air unit from the group
   CBSUnit<state,action,comparison,conflicttable,searchalgo> *c = (CBSUnit<state,action,comparison,conflicttable,searchalgo>*)this->GetMember(theUnit);
@@ -1083,31 +1229,28 @@ void CBSGroup<state,action,comparison,conflicttable,searchalgo>::Replan(int loca
   //agentEnvs[c->getUnitNumber()]=currentEnvironment[theUnit]->environment;
   //astar.GetPath(currentEnvironment[theUnit]->environment, start, goal, thePath);
   //std::vector<state> thePath(tree[location].paths[theUnit]);
-  comparison::openList=astar.GetOpenList();
-  comparison::currentEnv=(ConstrainedEnvironment<state,action>*)currentEnvironment[theUnit]->environment;
+  comparison::openList=search.GetOpenList();
+  comparison::currentEnv=(ConstrainedEnvironment<state,action>*)currentEnvironment[theUnit]->environment.get();
   comparison::currentAgent=theUnit;
   comparison::CAT=&(tree[location].cat);
   comparison::CAT->set(&tree[location].paths);
   
   if(comparison::useCAT){
-    comparison::CAT->remove(tree[location].paths[theUnit],currentEnvironment[theUnit]->environment,theUnit);
+    comparison::CAT->remove(tree[location].paths[theUnit],currentEnvironment[theUnit]->environment.get(),theUnit);
   }
 
   double minTime(0.0);
   // If this is the last waypoint, the plan needs to extend so that the agent sits at the final goal
   if(location==0 || tree[location].con.prevWpt+1==tree[location].wpts[theUnit].size()-1){
-    minTime=GetMaxTime(location,theUnit)-1.0; // Take off a 1-second wait action, otherwise paths will grow over and over.
+    minTime=std::max(0.0,GetMaxTime(location,theUnit)-1.0); // Take off a 1-second wait action, otherwise paths will grow over and over.
   }
 
 
   //std::cout << "Replan agent " << theUnit << "\n";
-  ReplanLeg<state,action,comparison,conflicttable,searchalgo>(c, astar, currentEnvironment[theUnit]->environment, tree[location].paths[theUnit], tree[location].wpts[theUnit], tree[location].con.prevWpt, tree[location].con.prevWpt+1,minTime);
+  ReplanLeg<state,action,comparison,conflicttable,searchalgo>(c, search, currentEnvironment[theUnit]->environment.get(), tree[location].paths[theUnit], tree[location].wpts[theUnit], tree[location].con.prevWpt, tree[location].con.prevWpt+1,minTime);
   //for(int i(0); i<tree[location].paths.size(); ++i)
   //std::cout << "Replanned agent "<<i<<" path " << tree[location].paths[i].size() << "\n";
 
-  if(killex != INT_MAX && TOTAL_EXPANSIONS>killex)
-    processSolution(-timer->EndTimer());
-
   //DoHAStar(start, goal, thePath);
   //TOTAL_EXPANSIONS += astar.GetNodesExpanded();
   //std::cout << "Replan agent: " << location << " expansions: " << astar.GetNodesExpanded() << "\n";
@@ -1120,7 +1263,7 @@ void CBSGroup<state,action,comparison,conflicttable,searchalgo>::Replan(int loca
   // Add the path back to the tree (new constraint included)
   //tree[location].paths[theUnit].resize(0);
   if(comparison::useCAT)
-    comparison::CAT->insert(tree[location].paths[theUnit],currentEnvironment[theUnit]->environment,theUnit);
+    comparison::CAT->insert(tree[location].paths[theUnit],currentEnvironment[theUnit]->environment.get(),theUnit);
 
   /*for(int i(0); i<thePath.size(); ++i) {
     tree[location].paths[theUnit].push_back(thePath[i]);
@@ -1229,8 +1372,8 @@ void CBSGroup<state,action,comparison,conflicttable,searchalgo>::HasConflict(std
           if(NO_CONFLICT==conflict.second || ((conflict.second<=NON_CARDINAL)&&conf) || BOTH_CARDINAL==conf){
             conflict.second=conf+1;
 
-            c1.c.reset((Constraint<state>*)new Collision<state>(a[xTime], a[xNextTime]));
-            c2.c.reset((Constraint<state>*)new Collision<state>(b[yTime], b[yNextTime]));
+            c1.c.reset((Constraint<state>*)new Collision<state>(a[xTime], a[xNextTime], agentRadius));
+            c2.c.reset((Constraint<state>*)new Collision<state>(b[yTime], b[yNextTime], agentRadius));
 
             c1.unit1 = x;
             c2.unit1 = y;
@@ -1288,15 +1431,18 @@ std::pair<unsigned,unsigned> CBSGroup<state,action,comparison,conflicttable,sear
   // For each pair of units in the group
   Timer tmr;
   tmr.StartTimer();
-  for(int x = 0; x < this->GetNumMembers(); x++)
+  // Only pairs that share a spatio-temporal bucket can collide. The pairs
+  // come out in the same (x,y) order as a loop over all pairs.
+  location.index.SetParameters(1.0,ConflictIndex<state>::MarginForRadius(agentRadius));
+  location.index.Sync(location.paths);
+  std::vector<std::pair<unsigned,unsigned>> candidates;
+  location.index.GetCandidatePairs(candidates);
+  for(auto const& p:candidates)
   {
-    for(int y = x+1; y < this->GetNumMembers(); y++)
-    {
-      // This call will update "best" with the number of conflicts and
-      // with the *most* cardinal conflicts
-      HasConflict(location.paths[x],location.wpts[x],location.paths[y],location.wpts[y],x,y,best.second.first,best.second.second,best.first);
-      //if((best.first.second&BOTH_CARDINAL)==BOTH_CARDINAL)break;
-    }
+    int x(p.first), y(p.second);
+    // This call will update "best" with the number of conflicts and
+    // with the *most* cardinal conflicts
+    HasConflict(location.paths[x],location.wpts[x],location.paths[y],location.wpts[y],x,y,best.second.first,best.second.second,best.first);
     //if((best.first.second&BOTH_CARDINAL)==BOTH_CARDINAL)break;
   }
   collisionTimeTotal+=tmr.EndTimer();
@@ -11,6 +11,7 @@
 #define FRONTIERBFS_H
 
 #include <iostream>
+#include <deque>
 #include "SearchEnvironment.h"
 #include <ext/hash_map>
 #include "FPUtil.h"
@@ -162,8 +163,7 @@ void FrontierBFS<state, action>::ExpandLevel(SearchEnvironment<state, action> *e
 											 std::deque<state> &nextOpenList,
 											 FrontierBFSClosedList &lastClosedList)
 {
-	static std::vector<state> neighbors;
-	neighbors.resize(0);
+	std::vector<state> neighbors;
 	while (currentOpenList.size() > 0)
 	{
 		state s = currentOpenList.front();
@@ -174,11 +174,11 @@ void FrontierBFS<state, action>::ExpandLevel(SearchEnvironment<state, action> *e
 //			printf("Needed to check against current\n");
 			continue;
 		}
-//		if (lastClosedList.find(env->GetStateHash(s)) != lastClosedList.end())
-//		{
-//			printf("Needed to check against last\n");
-//			continue;
-//		}
+		// states of the last level that were generated before they were expanded
+		if (lastClosedList.find(env->GetStateHash(s)) != lastClosedList.end())
+		{
+			continue;
+		}
 		
 		currentClosedList[env->GetStateHash(s)] = true;
 		
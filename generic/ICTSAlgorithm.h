@@ -31,6 +31,7 @@
 #include <set>
 #include <numeric>
 #include <unordered_map>
+#include <deque>
 #include <sstream>
 #include <iterator>
 #include <algorithm>
@@ -40,6 +41,7 @@
 #include "Heuristic.h"
 #include "MultiAgentStructures.h"
 #include "Utilities.h"
+#include "PackedKeyTable.h"
 
 extern double agentRadius;
 
@@ -88,7 +90,7 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
     uint64_t jointnodes;
     uint32_t step;
     //int n;
-    std::unordered_map<std::string,bool> transTable;
+    PackedKeyTable<uint8_t> transTable; // keyed by the node hash of each agent
     std::unordered_map<uint64_t,bool> singleTransTable;
 
     std::vector<SearchEnvironment<state,action>*> envs;
@@ -114,7 +116,8 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
       bool optimal;
       //bool connected()const{return parents.size()+successors.size();}
       //std::unordered_set<Node*> parents;
-      std::unordered_set<Node*> successors;
+      std::vector<Node*> successors;
+      void AddSuccessor(Node* s){if(std::find(successors.begin(),successors.end(),s)==successors.end())successors.push_back(s);}
       virtual uint64_t Hash()const{return hash;}//(env->GetStateHash(n)<<32) | ((uint32_t)(depth*state::TIME_RESOLUTION_U));
       virtual uint32_t Depth()const{return n.t;}
       virtual void Print(std::ostream& ss, int d=0) const {
@@ -131,7 +134,43 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
 
     typedef std::vector<Node*> MultiState; // rank=agent num
     typedef std::vector<std::pair<Node*,Node*>> MultiEdge; // rank=agent num
-    typedef std::unordered_map<uint64_t,Node> DAG;
+    // The MDD nodes live in a per-DAG arena (a deque, so the successor
+    // pointers stay valid as it grows); the hash table only indexes them.
+    // Erased nodes go on a free list and are reused by the next insert.
+    class DAG{
+    public:
+      typedef typename std::unordered_map<uint64_t,Node*>::iterator iterator;
+      DAG(){}
+      DAG(DAG const&)=delete;
+      DAG& operator=(DAG const&)=delete;
+      Node& operator[](uint64_t hash){
+        Node*& n(index[hash]);
+        if(!n){
+          if(freeList.empty()){
+            arena.emplace_back();
+            n=&arena.back();
+          }else{
+            n=freeList.back();
+            freeList.pop_back();
+            *n=Node();
+          }
+        }
+        return *n;
+      }
+      iterator find(uint64_t hash){return index.find(hash);}
+      iterator end(){return index.end();}
+      void erase(uint64_t hash){
+        auto n(index.find(hash));
+        if(n==index.end())return;
+        freeList.push_back(n->second);
+        index.erase(n);
+      }
+      size_t size()const{return index.size();}
+    private:
+      std::deque<Node> arena;
+      std::vector<Node*> freeList;
+      std::unordered_map<uint64_t,Node*> index;
+    };
     std::unordered_map<uint64_t,Node*> mddcache;
     std::unordered_map<uint64_t,uint32_t> lbcache;
     std::unordered_map<uint64_t,uint32_t> mscache;
@@ -227,7 +266,7 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
           current.id=dag.size();
           dag[chash]=current;
           if(verbose)std::cout << "inserting " << dag[chash] << " " << &dag[chash] << "under " << *parent << "\n";
-          parent->successors.insert(&dag[chash]);
+          parent->AddSuccessor(&dag[chash]);
           //dag[chash].parents.insert(parent);
           parent=&dag[chash];
         }
@@ -285,7 +324,7 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
           //dag[current->Hash()].parents.insert(parent);
           //std::cout << *current << " child of " << *parent << " " << parent->Hash() << "\n";
           //std::cout << "inserting " << dag[chash] << " " << &dag[chash] << "under " << *parent << "\n";
-          dag[parent->Hash()].successors.insert(&dag[current->Hash()]);
+          dag[parent->Hash()].AddSuccessor(&dag[current->Hash()]);
           //std::cout << "at" << &dag[parent->Hash()] << "\n";
         }
       }
@@ -370,32 +409,25 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
 
     // Return true if we get to the desired depth
     bool jointDFS(MultiEdge const &s, uint32_t d, MDDSolution solution,
-                  std::vector<MDDSolution> &solutions, std::vector<Node *> &toDelete,
+                  std::vector<MDDSolution> &solutions, std::deque<Node> &waits,
                   uint64_t bestSeen, uint64_t &best, std::vector<uint32_t> &bestCosts,
                   std::vector<uint32_t> const& minimum,
                   bool suboptimal = false, bool checkOnly = false)
     {
-      // Compute hash for transposition table
-      std::string hash(s.size()*sizeof(uint64_t),1);
+      // Key for the transposition table: the node hashes of all agents
+      std::vector<uint64_t> hash(s.size());
       int k(0);
       for(auto v:s){
-        uint64_t h1(v.second->Hash());
-        uint8_t c[sizeof(uint64_t)];
-        memcpy(c,&h1,sizeof(uint64_t));
-        for(unsigned j(0); j<sizeof(uint64_t); ++j){
-          hash[k*sizeof(uint64_t)+j]=((int)c[j])?c[j]:1; // Replace null-terminators in the middle of the string
-        }
-        ++k;
+        hash[k++]=v.second->Hash();
       }
       if(verbose)std::cout << "saw " << s << " hash ";
       if(verbose)for(unsigned int i(0); i<hash.size(); ++i){
-        std::cout << (unsigned)hash[i]<<" ";
+        std::cout << hash[i]<<" ";
       }
       if(verbose)std::cout <<"\n";
-      if(transTable.find(hash)!=transTable.end()){
+      if(uint8_t const* seen=transTable.find(&hash[0])){
         //std::cout << "AGAIN!\n";
-        return transTable[hash];
-        //if(!transTable[hash]){return false;}
+        return *seen;
       }
 
       if(!checkOnly&&d>0){
@@ -464,8 +496,8 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
               if (solution[i].back()->Depth() < MAXTIME)
               {
                 state tmp(solution[i].back()->n, MAXTIME);
-                solution[i].emplace_back(new Node(tmp, GetHash(tmp, i)));
-                toDelete.push_back(solution[i].back());
+                waits.emplace_back(tmp, GetHash(tmp, i));
+                solution[i].push_back(&waits.back());
               }
             }
             solutions.clear();
@@ -505,9 +537,9 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
           // Stay at state...
           // Only set time MAX if it is above the minimum cost (this is used to indicate a goal state)
           state tmp(a.second->n,(a.second->Depth()>minimum[k]?MAXTIME:a.second->Depth()+state::TIME_RESOLUTION));
-          output.emplace_back(a.second,new Node(tmp,GetHash(tmp,successors.size())));
+          waits.emplace_back(tmp,GetHash(tmp,successors.size()));
+          output.emplace_back(a.second,&waits.back());
           //if(verbose)std::cout << "Wait " << *output.back().second << "\n";
-          toDelete.push_back(output.back().second);
           //md=min(md,a.second->Depth()+1.0); // Amount of time to wait
         }
         //std::cout << "successor  of " << s << "gets("<<*a<< "): " << output << "\n";
@@ -529,28 +561,27 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
       bool value(false);
       for(auto& a: crossProduct){
         if(verbose)std::cout << "EVAL " << s << "-->" << a << "\n";
-        if(jointDFS(a,md,solution,solutions,toDelete,bestSeen,best,bestCosts,minimum,suboptimal,checkOnly)){
+        if(jointDFS(a,md,solution,solutions,waits,bestSeen,best,bestCosts,minimum,suboptimal,checkOnly)){
           value=true;
-          transTable[hash]=value;
+          transTable[&hash[0]]=value;
           // Return first solution... (unless this is a pairwise check with pruning)
           if(suboptimal&&!(checkOnly)) return true;
           // Return if solution is as good as any MDD
           if((!(checkOnly))&&best==bestSeen)return true;
         }
       }
-      transTable[hash]=value;
+      transTable[&hash[0]]=value;
       return value;
     }
 
     bool jointDFS(MultiState const &s, std::vector<MDDSolution> &solutions,
-                  std::vector<Node *> &toDelete, uint64_t bestSeen, uint64_t &best,
+                  std::deque<Node> &waits, uint64_t bestSeen, uint64_t &best,
                   std::vector<uint32_t> &bestCosts, std::vector<uint32_t> const& minimum,
                   bool suboptimal = false, bool checkOnly = false)
     {
       if(verbose)std::cout << "JointDFS\n";
       MultiEdge act;
       MDDSolution solution;
-      std::unordered_set<std::string> ttable;
       // Add null parents for the initial movements
       for(auto const& n:s){
         act.emplace_back(nullptr,n);
@@ -561,8 +592,8 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
       }
       best=0xffffffffffffffff;
 
-      transTable.clear();
-      return jointDFS(act,0.0,solution,solutions,toDelete,bestSeen,best,bestCosts,minimum,suboptimal,checkOnly);
+      transTable.SetWidth(s.size());
+      return jointDFS(act,0.0,solution,solutions,waits,bestSeen,best,bestCosts,minimum,suboptimal,checkOnly);
     }
 
     // Check that two paths have no conflicts
@@ -618,6 +649,30 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
       copy(x.begin(),x.end(), std::ostream_iterator<uint32_t>(s,","));
       return s.str().substr(0,s.str().size()-1);
     }
+    // Cost vectors are packed two per word for the set of ICT nodes generated
+    static void pack(std::vector<uint32_t> const& x, std::vector<uint64_t>& key){
+      key.assign((x.size()+1)/2,0);
+      for(unsigned i(0); i<x.size(); ++i){
+        key[i/2]|=uint64_t(x[i])<<(32*(i%2));
+      }
+    }
+    static void unpack(uint64_t const* key, std::vector<uint32_t>& x){
+      for(unsigned i(0); i<x.size(); ++i){
+        x[i]=uint32_t(key[i/2]>>(32*(i%2)));
+      }
+    }
+    // Hint format for the generated ICT nodes (other than the answer)
+    static void appendGenerated(PackedKeyTable<uint8_t> const& generated, unsigned n, std::string const& answerkey, std::string& hint){
+      std::vector<uint32_t> x(n);
+      for(size_t d(0); d<generated.size(); ++d){
+        unpack(generated.GetKey(d),x);
+        std::string sv(join(x));
+        if(sv!=answerkey){
+          hint.append(";");
+          hint.append(sv);
+        }
+      }
+    }
 
     uint32_t HCost(state const& a, state const& b, unsigned agent)const{
       return heuristics[agent]?round(heuristics[agent]->HCost(a,b)*state::TIME_RESOLUTION_D):round(envs[agent]->HCost(a,b)*state::TIME_RESOLUTION_D);
@@ -689,7 +744,6 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
         bestSeen=std::accumulate(best.begin(),best.end(),0);
       }
 
-      virtual ~ICTSNode(){for(auto d:toDelete){delete d;}}
 
       // Get unique identifier for this node
       std::string key()const{
@@ -707,7 +761,7 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
       uint64_t bestSeen;
       MultiState root;
       Instance points;
-      std::vector<Node*> toDelete;
+      std::deque<Node> waits; // wait nodes added by the joint searches
       static uint64_t count;
       std::vector<int> replanned; // Set of nodes that was just re-planned
       bool ok; // Indicates whether all MDDs are valid
@@ -738,11 +792,10 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
               tmpBest[1] = bestCosts[j];
               tmproot[1]=root[j];
               ms[1]=minimum[j];
-              std::vector<Node*> toDeleteTmp;
 
               // This is a satisficing search, thus we only need do a sub-optimal check
               if(ictsalg->verbose)std::cout<<"pairwise for " << i << ","<<j<<"\n";
-              if(!ictsalg->jointDFS(tmproot,answers,toDeleteTmp,INFTY,bestJoint,tmpBest,ms,true,true)){
+              if(!ictsalg->jointDFS(tmproot,answers,waits,INFTY,bestJoint,tmpBest,ms,true,true)){
                 if(ictsalg->verbose)std::cout << "Pairwise failed\n";
                 return false;
               }else{
@@ -758,7 +811,7 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
         Timer timer;
         timer.StartTimer();
         bestJoint=0xffffffffffffffff;
-        if(ictsalg->jointDFS(root,answers,toDelete,lb(),bestJoint,bestCosts,minimum,ictsalg->suboptimal,costonly)){
+        if(ictsalg->jointDFS(root,answers,waits,lb(),bestJoint,bestCosts,minimum,ictsalg->suboptimal,costonly)){
           ictsalg->jointTime+=timer.EndTimer();
           if(ictsalg->verbose){
             std::cout << "Answer:\n";
@@ -827,7 +880,8 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
       }
 
       custom_priority_queue<std::unique_ptr<ICTSNode>,ICTSNodePtrComp> q;
-      std::unordered_set<std::string> deconf;
+      PackedKeyTable<uint8_t> deconf((start.size()+1)/2);
+      std::vector<uint64_t> key;
       std::vector<std::set<Node*,NodePtrComp>> answer;
       std::vector<std::unique_ptr<ICTSNode>> toDelete;
       uint64_t bestCost(0xffffffffffffffff);
@@ -901,8 +955,8 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
           for(int i(0); i<parent->sizes.size(); ++i){
             std::vector<uint32_t> sz(parent->sizes);
             sz[i]+=step;
-            std::string sv(join(sz));
-            if(deconf.find(sv)==deconf.end()){
+            pack(sz,key);
+            if(!deconf.find(&key[0])){
               ICTSNode* tmp(new ICTSNode(this,parent,i,sz[i]));
               if(verbose){
                 std::cout << "push ";
@@ -917,7 +971,7 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
                 std::cout << "\n";
                 std::cout << "  SIC: " << tmp->lb() << std::endl;
               }
-              deconf.insert(sv);
+              deconf[&key[0]]=true;
               if(!tmp->ok &&
               this->HCost(inst.first[i],inst.second[i],i)/2>tmp->sizes[i]){
               continue;
@@ -943,7 +997,8 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
       }
 
       custom_priority_queue<std::unique_ptr<ICTSNode>,ICTSNodePtrComp> q;
-      std::unordered_set<std::string> deconf;
+      PackedKeyTable<uint8_t> deconf((start.size()+1)/2);
+      std::vector<uint64_t> key;
       std::vector<std::set<Node*,NodePtrComp>> answer;
       std::vector<std::unique_ptr<ICTSNode>> toDelete;
       uint64_t bestCost(0xffffffffffffffff);
@@ -992,17 +1047,19 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
               for(int i(0); i<node->sizes.size(); ++i){
                 std::vector<uint32_t> sz(node->sizes);
                 sz[i]+=step;
-                std::string sv(join(sz));
-                if(deconf.find(sv)==deconf.end()){
+                pack(sz,key);
+                if(!deconf.find(&key[0])){
                   q.emplace(new ICTSNode(this,node,i,sz[i]));
-                  deconf.insert(sv);
+                  deconf[&key[0]]=true;
                 }
               }
             }
           }
         }
         for(auto h:Util::split(stuff[2],';')){
-          deconf.insert(h);
+          parse(h,sizes);
+          pack(sizes,key);
+          deconf[&key[0]]=true;
         }
       }else{
         q.emplace(new ICTSNode(this,inst,sizes));
@@ -1025,12 +1082,7 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
           }
           hint.append(":");
           hint.append(answerkey);
-          for(auto const& d:deconf){
-            if(d!=answerkey){
-              hint.append(";");
-              hint.append(d);
-            }
-          }
+          appendGenerated(deconf,start.size(),answerkey,hint);
           break;
         }
         // This node could contain a solution since its lb is <=
@@ -1082,12 +1134,7 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
               }
               hint.append(":");
               hint.append(answerkey);
-              for(auto const& d:deconf){
-                if(d!=answerkey){
-                  hint.append(";");
-                  hint.append(d);
-                }
-              }
+              appendGenerated(deconf,start.size(),answerkey,hint);
               break;
             }
           }
@@ -1096,8 +1143,8 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
           for(int i(0); i<parent->sizes.size(); ++i){
             std::vector<uint32_t> sz(parent->sizes);
             sz[i]+=step;
-            std::string sv(join(sz));
-            if(deconf.find(sv)==deconf.end()){
+            pack(sz,key);
+            if(!deconf.find(&key[0])){
               ICTSNode* tmp(new ICTSNode(this,parent,i,sz[i]));
               if(verbose){
                 std::cout << "push ";
@@ -1113,7 +1160,7 @@ class ICTSAlgorithm: public MAPFAlgorithm<state,action>{
                 std::cout << "  SIC: " << tmp->lb() << std::endl;
               }
               q.emplace(tmp);
-              deconf.insert(sv);
+              deconf[&key[0]]=true;
             }
           }
         }
@@ -13,15 +13,18 @@
 #include <iostream>
 #include <functional>
 #include <unordered_map>
+#include <map>
 #include "FPUtil.h"
 #include "vectorCache.h"
+#include "Heuristic.h"
+#include "SearchEnvironment.h"
 
 //#define DO_LOGGING
 
 template <class state, class action, class environment>
 class IDAStar {
 public:
-	IDAStar():incumbentcost(9999999999.9){ useHashTable = usePathMax = false; storedHeuristic = false;}
+	IDAStar():incumbentcost(9999999999.9){ useHashTable = usePathMax = false; storedHeuristic = false; incremental = 0; maxSuccessors = 0;}
 	virtual ~IDAStar() {}
 	void GetPath(environment *env, state const& from, state const& to, std::vector<state> &thePath);
 	void GetPath(environment *env, state from, state to, std::vector<action> &thePath);
@@ -31,6 +34,8 @@ public:
 	void ResetNodeCount() { nodesExpanded = nodesTouched = 0; }
 	void SetUseBDPathMax(bool val) { usePathMax = val; }
 	void SetHeuristic(Heuristic<state> *heur) { heuristic = heur; if (heur != 0) storedHeuristic = true;}
+	// Used instead of the heuristic by the action-based GetPath
+	void SetIncrementalHeuristic(IncrementalHeuristic<state, action> *heur) { incremental = heur; }
 private:
         std::vector<state> incumbent;
         double best;
@@ -45,6 +50,10 @@ private:
 					   action forbiddenAction, state &currState,
 					   std::vector<action> &thePath, double bound, double g,
 					   double maxH, double parentH);
+	double DoBatchIteration(environment *env,
+							action forbiddenAction, const state &currState,
+							std::vector<action> &thePath, double bound, double g,
+							double maxH, double parentH, double h);
 	void PrintGHistogram()
 	{
 //		uint64_t early = 0, late = 0;
@@ -69,6 +78,10 @@ private:
 	vectorCache<action> actCache;
 	bool storedHeuristic;
 	Heuristic<state> *heuristic;
+	IncrementalHeuristic<state, action> *incremental;
+	std::vector<uint64_t> hCache; // incremental heuristic data for each depth
+	unsigned maxSuccessors; // of the successor batch of the environment; 0 if there is none
+	std::vector<std::vector<Successor<state, action>>> successorCache; // batch for each depth
 	std::vector<uint64_t> gCostHistogram;
 	std::map<uint32_t,uint64_t> fCostHistogram;
         std::unordered_map<std::string,bool> transTable;
@@ -139,9 +152,17 @@ void IDAStar<state, action, environment>::GetPath(environment *env,
 	if (env->GoalTest(from, to))
 		return;
 
-	double rootH = heuristic->HCost(from, to);
+	double rootH;
+	if (incremental)
+	{
+		hCache.resize(incremental->GetCacheSize());
+		rootH = incremental->InitialHCost(from, &hCache[0]);
+	}
+	else
+		rootH = heuristic->HCost(from, to);
 	UpdateNextBound(0, rootH);
 	goal = to;
+	maxSuccessors = SuccessorBatch<environment, state, action>::GetMaxSuccessors(env);
 	std::vector<action> act;
 	env->GetActions(from, act);
 	while (thePath.size() == 0)
@@ -256,7 +277,20 @@ double IDAStar<state, action, environment>::DoIteration(environment *env,
 										   std::vector<action> &thePath, double bound, double g,
 										   double maxH, double parentH)
 {
-	double h = heuristic->HCost(currState, goal);//, parentH); // TODO: restore code that uses parent h-cost
+	double h;
+	int depth = (int)thePath.size();
+	if (incremental)
+	{
+		size_t cacheSize = incremental->GetCacheSize();
+		if (hCache.size() < (depth+1)*cacheSize)
+			hCache.resize((depth+1)*cacheSize);
+		if (depth == 0)
+			h = incremental->InitialHCost(currState, &hCache[0]);
+		else
+			h = incremental->IncrementalHCost(currState, thePath.back(), &hCache[(depth-1)*cacheSize], &hCache[depth*cacheSize]);
+	}
+	else
+		h = heuristic->HCost(currState, goal);//, parentH); // TODO: restore code that uses parent h-cost
 	parentH = h;
 	// path max
 	if (usePathMax && fless(h, maxH))
@@ -270,13 +304,14 @@ double IDAStar<state, action, environment>::DoIteration(environment *env,
 	// must do this after we check the f-cost bound
 	if (env->GoalTest(currState, goal))
 		return -1; // found goal
+	if (maxSuccessors > 0)
+		return DoBatchIteration(env, forbiddenAction, currState, thePath, bound, g, maxH, parentH, h);
 	
 	std::vector<action> &actions = *actCache.getItem();
 	env->GetActions(currState, actions);
 	nodesTouched += actions.size();
 	nodesExpanded++;
 	gCostHistogram[g]++;
-	int depth = (int)thePath.size();
 #ifdef t
 	func(currState, depth);
 #endif
@@ -321,6 +356,58 @@ double IDAStar<state, action, environment>::DoIteration(environment *env,
 }
 
 
+// The loop over the children of DoIteration with the successor batch of the
+// environment: the children are generated into a buffer for this depth
+// instead of applying and undoing each action.
+template <class state, class action, class environment>
+double IDAStar<state, action, environment>::DoBatchIteration(environment *env,
+												action forbiddenAction, const state &currState,
+												std::vector<action> &thePath, double bound, double g,
+												double maxH, double parentH, double h)
+{
+	int depth = (int)thePath.size();
+	if ((int)successorCache.size() <= depth)
+		successorCache.resize(depth+1);
+	if (successorCache[depth].size() < maxSuccessors)
+		successorCache[depth].resize(maxSuccessors);
+	// deeper calls can grow successorCache, which moves the vectors but not their contents
+	Successor<state, action> *succ = &successorCache[depth][0];
+	unsigned count = SuccessorBatch<environment, state, action>::GetSuccessors(env, currState, succ, false);
+	nodesTouched += count;
+	nodesExpanded++;
+	gCostHistogram[g]++;
+	
+	for (unsigned int x = 0; x < count; x++)
+	{
+		if ((depth != 0) && (succ[x].a == forbiddenAction))
+			continue;
+
+		thePath.push_back(succ[x].a);
+		double edgeCost = succ[x].cost;
+		action a = succ[x].a;
+		env->InvertAction(a);
+
+		double childH = DoIteration(env, a, succ[x].s, thePath, bound,
+									g+edgeCost, maxH - edgeCost, parentH);
+		if (fequal(childH, -1)) // found goal
+			return -1;
+
+		thePath.pop_back();
+
+		// pathmax
+		if (usePathMax && fgreater(childH-edgeCost, h))
+		{
+			h = childH-edgeCost;
+			if (fgreater(g+h, bound))
+			{
+				UpdateNextBound(bound, g+h);
+				return h;
+			}
+		}
+	}
+	return h;
+}
+
 template <class state, class action, class environment>
 void IDAStar<state, action, environment>::UpdateNextBound(double currBound, double fCost)
 {
@@ -33,6 +33,7 @@
 #endif
 
 #include <strings.h>
+#include <climits>
 #include "FPUtil.h"
 //#include <ext/hash_map>
 #include "AStarOpenClosed.h"
@@ -47,6 +48,7 @@
 
 #include "GenericSearchAlgorithm.h"
 #include "MultiObjective.h"
+#include "ParetoFront.h"
 
 template <unsigned dim>
 static std::ostream& operator<<(std::ostream& ss, cost<dim> const& v){
@@ -70,9 +72,9 @@ public:
         cost<dim> g;
         cost<dim> h;
         uint64_t parentID; // For compatibility and "scalarized" multi-objective search; this is not used for lexicographic or regular dominance search
-        // sets of parents and their non-dominated cost vectors reaching this node
-	std::unordered_map<cost<dim>,std::unordered_set<uint64_t>> open;
-	std::unordered_map<uint64_t,std::unordered_set<cost<dim>>> closed; // Note: this map is equivalient to COSTS (in the literature) for any goal node
+        // non-dominated cost vectors reaching this node and the parents they come from
+	ParetoFront<dim> open;
+	ParetoFront<dim> closed; // Note: this set is equivalient to COSTS (in the literature) for any goal node
         uint64_t openLocation;
         bool reopened;
         bool visited;
@@ -114,7 +116,7 @@ struct NAMOAStarCompare {
 template <class state, class action, class environment, unsigned dim, class openList = AStarOpenClosed<state, NAMOAStarCompare<state,dim>, NAMOAOpenClosedData<state,dim>>>
 class NAMOAStar : public GenericSearchAlgorithm<state,action,environment> {
 public:
-	NAMOAStar():totalExternalNodesExpanded(nullptr),externalExpansionLimit(INT_MAX),verbose(false),noncritical(false),env(nullptr),stopAfterGoal(true),weight(1),reopenNodes(false),SuccessorFunc(&environment::GetSuccessors),ActionFunc(&environment::GetAction),GCostFunc(&environment::GCostVector),HCostFunc(&environment::HCostVector){ResetNodeCount();}
+	NAMOAStar():totalExternalNodesExpanded(nullptr),externalExpansionLimit(INT_MAX),verbose(false),noncritical(false),env(nullptr),stopAfterGoal(true),fullSet(false),lazyFiltering(false),weight(1),reopenNodes(false),SuccessorFunc(&environment::GetSuccessors),ActionFunc(&environment::GetAction),GCostFunc(&environment::GCostVector),HCostFunc(&environment::HCostVector){ResetNodeCount();}
 	virtual ~NAMOAStar() {}
 	void GetPath(environment *env, const state& from, const state& to, std::vector<state> &thePath);
 	void GetPaths(environment *env, const state& from, const state& to, std::vector<std::vector<state>>& paths);
@@ -254,6 +256,7 @@ void NAMOAStar<state,action,environment,dim,openList>::GetPaths(environment *_en
 {
   fullSet=true;
   //discardcount=0;
+  paths.resize(0);
   if (!InitializeSearch(_env, from, to, paths))
   {	
     uint64_t id;
@@ -263,11 +266,28 @@ void NAMOAStar<state,action,environment,dim,openList>::GetPaths(environment *_en
   std::vector<state> dummy;
   while (!DoSingleSearchStep(dummy)) {}
 
+  // The goal is expanded once, so the cost vectors that reached it are in
+  // its closed set (the one it was expanded with) and its open set (those
+  // that arrived before it was expanded). Each comes with the parents that
+  // reach the goal at that cost; a parent is expanded once, at its g-cost,
+  // so its path plus the goal has exactly that cost. Return one path per
+  // non-dominated vector.
   uint64_t id;
-  if(kNotFound!=openClosedList.Lookup(env->GetStateHash(to),id)){
-    return &openClosedList.Lookup(id);
-  }else{
-    return nullptr;
+  if(kClosedList==openClosedList.Lookup(env->GetStateHash(to),id)){
+    ParetoFront<dim> goalFront;
+    for(auto const& e:openClosedList.Lookup(id).closed)
+      goalFront.Insert(e.c,e.ids.front());
+    for(auto const& e:openClosedList.Lookup(id).open)
+      goalFront.Insert(e.c,e.ids.front());
+    for(auto const& e:goalFront){
+      uint64_t parent(e.ids.front());
+      paths.push_back(std::vector<state>(1,openClosedList.Lookup(id).data));
+      if(openClosedList.Lookup(parent).parentID==parent) // the start
+        paths.back().push_back(openClosedList.Lookup(parent).data);
+      else
+        ExtractPathToStartFromID(parent, paths.back());
+      reverse(paths.back().begin(), paths.back().end());
+    }
   }
 }
 
@@ -311,7 +331,7 @@ bool NAMOAStar<state,action,environment,dim,openList>::InitializeSearch(environm
         // Set the start state to be its own parent
         uint64_t id;
 	openClosedList.Lookup(env->GetStateHash(start),id);
-        //openClosedList.Lookup(id).parentID=id;
+        openClosedList.Lookup(id).parentID=id;
 	//openClosedList.Print();
 	
 	return true;
@@ -323,12 +343,13 @@ bool NAMOAStar<state,action,environment,dim,openList>::InitializeSearch(environm
   env = _env;
   openClosedList.Reset();
   ResetNodeCount();
+  costs.clear();
   start = from;
   goal = to;
 
   NAMOAOpenClosedData<state,dim> data(start,cost<dim>(),(env->*HCostFunc)(start, goal),kTAStarNoNode,0,kOpenList);
   uint64_t id(openClosedList.AddOpenNode(data, env->GetStateHash(start)));
-  data.open[data.g].insert(id);
+  openClosedList.Lookup(id).parentID=id;
 
   if (env->GoalTest(from, to) && (stopAfterGoal)) //assumes that from and to are valid states
   {
@@ -388,10 +409,13 @@ bool NAMOAStar<state,action,environment,dim,openList>::DoSingleSearchStep(std::v
   // PATH SELECTION
   if(fullSet){
     // Move from Gopen to Gclosed
-    for(auto const& v:openClosedList.Lookup(nodeid).open[gcost]){
-      openClosedList.Lookup(nodeid).closed[v].insert(gcost);
+    auto& node(openClosedList.Lookup(nodeid));
+    if(auto const* e=node.open.Find(gcost)){
+      for(auto const& v:e->ids){
+        node.closed.Insert(gcost,v);
+      }
+      node.open.Erase(gcost);
     }
-    openClosedList.Lookup(nodeid).open.erase(gcost);
   }
 
   // Lazy filtering is not good if you want to grab solutions of cost greater than C*,
@@ -400,12 +424,7 @@ bool NAMOAStar<state,action,environment,dim,openList>::DoSingleSearchStep(std::v
     // Check if any goal node has a dominating vector
     // There is no good way around this for pure dominance objectives :(
     for(uint64_t id: costs){
-      auto const& gnode(openClosedList.Lookup(id));
-      for(auto const& p:gnode.closed){
-        for(auto const& cstar:p.second){
-          if(cstar<gcost) return false;
-        }
-      }
+      if(openClosedList.Lookup(id).closed.Dominates(gcost)) return false;
     }
   }
 
@@ -423,7 +442,7 @@ bool NAMOAStar<state,action,environment,dim,openList>::DoSingleSearchStep(std::v
   if(stopAfterGoal && env->GoalTest(openClosedList.Lookup(nodeid).data, goal)){
     // SOLUTION RECORDING
     if(fullSet){
-      openClosedList.Lookup(nodeid).closed[openClosedList.Lookup(nodeid).parentID].insert(gcost);
+      openClosedList.Lookup(nodeid).closed.Insert(gcost,openClosedList.Lookup(nodeid).parentID);
       costs.insert(nodeid);
       return false;
     }else{
@@ -475,14 +494,7 @@ bool NAMOAStar<state,action,environment,dim,openList>::DoSingleSearchStep(std::v
           // If so, erase it from Gopen
           bool dominates(newg<openClosedList.Lookup(theID).g);
           if(fullSet&&!dominates){
-            for(auto theG(openClosedList.Lookup(theID).open.cbegin()); theG!=openClosedList.Lookup(theID).open.cend(); /* no increment*/){
-              if(newg<theG->first){
-                dominates=true;
-                openClosedList.Lookup(theID).open.erase(theG++);
-              }else{
-                ++theG;
-              }
-            }
+            dominates=openClosedList.Lookup(theID).open.RemoveDominated(newg)>0;
           }
           if(dominates){
             if(verbose)std::cout << "Update node ("<<std::hex<<env->GetStateHash(succ[x])<<std::dec
@@ -494,19 +506,10 @@ bool NAMOAStar<state,action,environment,dim,openList>::DoSingleSearchStep(std::v
             openClosedList.Lookup(theID).data = succ[x];
             openClosedList.KeyChanged(theID);
             if(fullSet)
-              openClosedList.Lookup(theID).open[newg].insert(nodeid);
-          }else if(fullSet){ // Does anything dominate this vector?
-            bool dominated(false);
-            for(auto const& theG:openClosedList.Lookup(theID).open){
-              if(theG.first<newg){
-                dominated=true;
-                break;
-              }
-            }
-            if(!dominated){
-              // Neither dominates... This is a valid pareto-optimal path
-              openClosedList.Lookup(theID).open[newg].insert(nodeid);
-            }
+              openClosedList.Lookup(theID).open.Insert(newg,nodeid);
+          }else if(fullSet){
+            // Added unless something dominates this vector (then it's not a pareto-optimal path)
+            openClosedList.Lookup(theID).open.Insert(newg,nodeid);
           }
         }
         break;
@@ -521,7 +524,7 @@ bool NAMOAStar<state,action,environment,dim,openList>::DoSingleSearchStep(std::v
           NAMOAOpenClosedData<state,dim> data(succ[x],
               newg,hcost,nodeid,0,kOpenList);
           if(fullSet)
-            data.open[newg].insert(nodeid);
+            data.open.Insert(newg,nodeid);
 
           openClosedList.AddOpenNode(data, env->GetStateHash(succ[x]));
         }
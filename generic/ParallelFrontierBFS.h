@@ -0,0 +1,238 @@
+//
+//  ParallelFrontierBFS.h
+//  hog2
+//
+//  Breadth-first enumeration of explicit state spaces with two bits per
+//  state and multi-threaded layer expansion.
+//
+
+#ifndef ParallelFrontierBFS_h
+#define ParallelFrontierBFS_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include "MMapUtil.h"
+#include "WorkerPool.h"
+#include "Timer.h"
+
+/**
+ * Layered BFS over the ranks of an environment whose GetStateHash is a
+ * bijection onto [0, GetMaxHash()), with GetStateFromHash(uint64_t, state&)
+ * as its inverse. Unranking is done into a copy of the start state, so
+ * states whose rank depends on their size (permutations) work as well.
+ *
+ * Each rank has two bits: unseen, open in one of two alternating layers,
+ * or closed. A layer is expanded by scanning for its open code, closing
+ * those states and marking unseen children with the other open code with
+ * an atomic compare-and-swap, so the threads need no locks. Regions of the
+ * bitmap without open states are skipped. The bitmap is in (anonymous)
+ * memory or in a memory-mapped file.
+ *
+ * The threads share the environment; GetActions, GetNextState, GetStateHash
+ * and GetStateFromHash must not modify it (e.g. no TopSpin move pruning).
+ */
+template <class state, class action, class environment>
+class ParallelFrontierBFS {
+public:
+	ParallelFrontierBFS() :bits(0), bitsFD(-1), numStates(0), nodesExpanded(0), nodesTouched(0) {}
+	~ParallelFrontierBFS() { Free(); }
+	ParallelFrontierBFS(const ParallelFrontierBFS &) = delete;
+	ParallelFrontierBFS &operator=(const ParallelFrontierBFS &) = delete;
+
+	/** Keep the bitmap in a file with this name instead of in memory */
+	void SetFileName(const char *name) { fileName = name?name:""; }
+	void DoBFS(environment *env, const state &from, int numThreads)
+	{ DoBFS(env, std::vector<state>(1, from), numThreads); }
+	void DoBFS(environment *env, const std::vector<state> &from, int numThreads);
+
+	/** The number of states first reached at each depth */
+	const std::vector<uint64_t> &GetLayerCounts() const { return layerCounts; }
+	uint64_t GetNumReached() const;
+	/** Whether the state with this rank was reached by the last search */
+	bool Reached(uint64_t rank) const { return GetCode(rank) != kUnseen; }
+	uint64_t GetNodesExpanded() const { return nodesExpanded; }
+	uint64_t GetNodesTouched() const { return nodesTouched; }
+private:
+	enum { kUnseen = 0, kClosed = 3 };
+	// 32 states per word, 32k states per region
+	static const uint64_t kWordsPerRegion = 1024;
+	static const uint64_t kLowBits = 0x5555555555555555ull;
+
+	int GetCode(uint64_t rank) const { return (bits[rank>>5]>>(2*(rank&31)))&3; }
+	bool Mark(uint64_t rank, uint64_t code);
+	uint64_t ExpandRegion(environment *env, uint64_t region, uint64_t open, uint64_t next,
+						  state &s, state &child, std::vector<action> &acts, uint64_t &touched);
+	void Free();
+
+	std::string fileName;
+	uint64_t *bits;
+	int bitsFD;
+	uint64_t numStates, numWords;
+	// regions with open states in the current and next layer
+	std::vector<uint8_t> currRegions, nextRegions;
+	std::vector<uint64_t> layerCounts;
+	uint64_t nodesExpanded, nodesTouched;
+};
+
+template <class state, class action, class environment>
+const uint64_t ParallelFrontierBFS<state, action, environment>::kWordsPerRegion;
+template <class state, class action, class environment>
+const uint64_t ParallelFrontierBFS<state, action, environment>::kLowBits;
+
+template <class state, class action, class environment>
+void ParallelFrontierBFS<state, action, environment>::Free()
+{
+	if (bits == 0)
+		return;
+	// anonymous maps have no file to close
+	if (bitsFD == -1)
+		munmap(bits, numWords*sizeof(uint64_t));
+	else
+		CloseMMap((uint8_t*)bits, numWords*sizeof(uint64_t), bitsFD);
+	bits = 0;
+	bitsFD = -1;
+}
+
+/*
+ * Sets an unseen state to code; returns whether this thread set it.
+ */
+template <class state, class action, class environment>
+bool ParallelFrontierBFS<state, action, environment>::Mark(uint64_t rank, uint64_t code)
+{
+	uint64_t *word = &bits[rank>>5];
+	int shift = 2*(rank&31);
+	uint64_t old = __atomic_load_n(word, __ATOMIC_RELAXED);
+	while (((old>>shift)&3) == kUnseen)
+	{
+		if (__atomic_compare_exchange_n(word, &old, old|(code<<shift), true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		{
+			uint64_t region = (rank>>5)/kWordsPerRegion;
+			if (__atomic_load_n(&nextRegions[region], __ATOMIC_RELAXED) == 0)
+				__atomic_store_n(&nextRegions[region], 1, __ATOMIC_RELAXED);
+			return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Expands the states with code open in a region, marking their children
+ * with code next. Returns the number of new states.
+ */
+template <class state, class action, class environment>
+uint64_t ParallelFrontierBFS<state, action, environment>::ExpandRegion(environment *env, uint64_t region,
+																	  uint64_t open, uint64_t next,
+																	  state &s, state &child,
+																	  std::vector<action> &acts, uint64_t &touched)
+{
+	uint64_t count = 0, expanded = 0;
+	uint64_t last = std::min(numWords, (region+1)*kWordsPerRegion);
+	for (uint64_t w = region*kWordsPerRegion; w < last; w++)
+	{
+		uint64_t word = __atomic_load_n(&bits[w], __ATOMIC_RELAXED);
+		// the low bit of each state whose code is open
+		uint64_t states = (open == 1)?(word&~(word>>1)&kLowBits):((word>>1)&~word&kLowBits);
+		if (states == 0)
+			continue;
+		// other threads only write unseen states, so these can be closed first
+		__atomic_fetch_or(&bits[w], states*3, __ATOMIC_RELAXED);
+		while (states != 0)
+		{
+			uint64_t rank = w*32+__builtin_ctzll(states)/2;
+			states &= states-1;
+			expanded++;
+			env->GetStateFromHash(rank, s);
+			env->GetActions(s, acts);
+			for (unsigned int x = 0; x < acts.size(); x++)
+			{
+				env->GetNextState(s, acts[x], child);
+				touched++;
+				if (Mark(env->GetStateHash(child), next))
+					count++;
+			}
+		}
+	}
+	__atomic_fetch_add(&nodesExpanded, expanded, __ATOMIC_RELAXED);
+	return count;
+}
+
+template <class state, class action, class environment>
+void ParallelFrontierBFS<state, action, environment>::DoBFS(environment *env, const std::vector<state> &from,
+														   int numThreads)
+{
+	Free();
+	layerCounts.clear();
+	nodesExpanded = nodesTouched = 0;
+	if (from.size() == 0)
+		return;
+	numStates = env->GetMaxHash();
+	if (numStates == 0)
+	{
+		printf("Error: the environment has no ranking (GetMaxHash() is 0)\n");
+		return;
+	}
+	numWords = (numStates+31)/32;
+	uint64_t numRegions = (numWords+kWordsPerRegion-1)/kWordsPerRegion;
+	// mmap zero fills, and pages that are never touched take no memory
+	bits = (uint64_t*)GetMMAP(fileName.empty()?0:fileName.c_str(), numWords*sizeof(uint64_t), bitsFD, true);
+	currRegions.assign(numRegions, 0);
+	nextRegions.assign(numRegions, 0);
+	printf("%llu states, %llu bytes of bitmap\n", (unsigned long long)numStates,
+		   (unsigned long long)(numWords*sizeof(uint64_t)));
+
+	// the start states are open with code 1
+	uint64_t count = 0;
+	for (unsigned int x = 0; x < from.size(); x++)
+		if (Mark(env->GetStateHash(from[x]), 1))
+			count++;
+	WorkerPool pool(numThreads);
+	numThreads = pool.NumThreads();
+	WorkStealingRange work(numThreads);
+	std::vector<uint64_t> counts(numThreads), touched(numThreads);
+	Timer t, total;
+	total.StartTimer();
+	for (int depth = 0; count != 0; depth++)
+	{
+		layerCounts.push_back(count);
+		t.StartTimer();
+		currRegions.swap(nextRegions);
+		const uint64_t open = (depth%2 == 0)?1:2, next = 3-open;
+		work.Reset(numRegions);
+		pool.Run([&](int threadNum) {
+			state s = from[0], child = from[0];
+			std::vector<action> acts;
+			uint64_t region;
+			counts[threadNum] = 0;
+			while (work.Next(threadNum, region))
+			{
+				if (currRegions[region] == 0)
+					continue;
+				currRegions[region] = 0;
+				counts[threadNum] += ExpandRegion(env, region, open, next, s, child, acts, touched[threadNum]);
+			}
+		});
+		count = 0;
+		for (uint64_t c : counts)
+			count += c;
+		printf("Depth %d complete; %1.2fs elapsed. %llu states; %llu new at depth %d\n", depth, t.EndTimer(),
+			   (unsigned long long)layerCounts.back(), (unsigned long long)count, depth+1);
+	}
+	for (uint64_t c : touched)
+		nodesTouched += c;
+	printf("%llu states reached in %d layers; %1.2fs elapsed\n", (unsigned long long)GetNumReached(),
+		   (int)layerCounts.size(), total.EndTimer());
+}
+
+template <class state, class action, class environment>
+uint64_t ParallelFrontierBFS<state, action, environment>::GetNumReached() const
+{
+	uint64_t total = 0;
+	for (uint64_t c : layerCounts)
+		total += c;
+	return total;
+}
+
+#endif /* ParallelFrontierBFS_h */
@@ -11,51 +11,85 @@
 
 #include <iostream>
 #include "SearchEnvironment.h"
-#include <ext/hash_map>
 #include "FPUtil.h"
-#include "vectorCache.h"
-#include "SharedQueue.h"
+#include "Timer.h"
+#include "WorkerPool.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <mutex>
 #include <thread>
 
-const int workDepth = 5;
-
-template <class action>
-struct workUnit {
-	action pre[workDepth];
-	std::vector<action> solution;
-	std::vector<int> gHistogram;
-	std::vector<int> fHistogram;
-	double nextBound;
-	uint64_t expanded, touched;
-	int unitNumber;
+/**
+ * Load balance statistics for one iteration of ParallelIDAStar.
+ */
+struct pidaIterationStats {
+	double bound;
+	double time;
+	uint64_t expanded;
+	uint64_t minThreadExpanded, maxThreadExpanded;
+	uint64_t workItems; // work items handed out (including the root)
+	double maxIdleTime; // longest time a thread waited for work
 };
 
+/**
+ * Parallel IDA* with dynamic work splitting.
+ *
+ * Every thread runs an explicit DFS stack. A thread that runs out of work
+ * registers as idle; busy threads notice this (a relaxed atomic read every
+ * 64 nodes) and donate the unexplored suffix of the shallowest frame of their
+ * stack that still has untried children. Each donated child becomes a work
+ * item (the action path from the root), so large subtrees are split as many
+ * times as needed instead of being fixed at a static depth.
+ */
 template <class environment, class state, class action>
 class ParallelIDAStar {
 public:
-	ParallelIDAStar() { storedHeuristic = false;}
+	ParallelIDAStar() { storedHeuristic = false; incremental = 0; numThreads = std::thread::hardware_concurrency(); verbose = true; }
 	virtual ~ParallelIDAStar() {}
 	//	void GetPath(environment *env, state from, state to,
 	//				 std::vector<state> &thePath);
 	void GetPath(environment *env, state from, state to,
 				 std::vector<action> &thePath);
-	
+
 	uint64_t GetNodesExpanded() { return nodesExpanded; }
 	uint64_t GetNodesTouched() { return nodesTouched; }
 	void ResetNodeCount() { nodesExpanded = nodesTouched = 0; }
 	void SetHeuristic(Heuristic<state> *heur) { heuristic = heur; if (heur != 0) storedHeuristic = true;}
+	// Used instead of the heuristic when set
+	void SetIncrementalHeuristic(IncrementalHeuristic<state, action> *heur) { incremental = heur; }
+	void SetNumThreads(int count) { numThreads = std::max(count, 1); }
+	void SetVerbose(bool v) { verbose = v; }
+	const std::vector<pidaIterationStats> &GetIterationStats() const { return iterationStats; }
 private:
+	struct searchFrame {
+		std::vector<action> actions;
+		size_t next;
+		double g;
+	};
+	struct threadData {
+		std::vector<action> path;
+		std::vector<searchFrame> stack;
+		std::vector<uint64_t> hCache; // incremental heuristic data for each frame
+		int depth;
+		size_t base; // length of the work item's path
+		double nextBound;
+		double idleTime;
+		uint64_t expanded, touched, steps;
+		std::vector<uint64_t> gHistogram;
+		std::vector<uint64_t> fHistogram;
+	};
 	unsigned long long nodesExpanded, nodesTouched;
-	
-	void StartThreadedIteration(environment env, state startState, double bound);
-	void DoIteration(environment *env,
-					 action forbiddenAction, state &currState,
-					 std::vector<action> &thePath, double bound, double g,
-					 workUnit<action> &w, vectorCache<action> &cache);
-	void GenerateWork(environment *env,
-					  action forbiddenAction, state &currState,
-					  std::vector<action> &thePath);
-	
+
+	void StartThreadedIteration(int threadNum, environment &env, state &startState, double bound);
+	bool GetWork(threadData &data, std::vector<action> &item);
+	void DoIteration(threadData &data, environment &env, state &currState, double bound);
+	bool Visit(threadData &data, environment &env, state &currState, double bound, double g,
+			   const action *forbiddenAction);
+	void DonateWork(threadData &data);
+
 	void PrintGHistogram()
 	{
 		return;
@@ -86,15 +120,28 @@ private:
 	void UpdateNextBound(double currBound, double fCost);
 	state goal;
 	double nextBound;
-	//vectorCache<action> actCache;
 	bool storedHeuristic;
+	bool verbose;
+	int numThreads;
 	Heuristic<state> *heuristic;
+	IncrementalHeuristic<state, action> *incremental;
 	std::vector<uint64_t> gCostHistogram;
 	std::vector<uint64_t> fCostHistogram;
-	std::vector<workUnit<action>> work;
-	std::vector<std::thread*> threads;
-	SharedQueue<int> q;
-	int foundSolution;
+	std::vector<pidaIterationStats> iterationStats;
+	std::vector<threadData> threads;
+
+	// shared work; protected by workLock
+	std::deque<std::vector<action>> work;
+	std::mutex workLock;
+	std::condition_variable workReady;
+	int idleThreads;
+	bool iterationDone;
+	uint64_t workItems;
+	std::vector<action> solution;
+	// read without the lock in the DFS loop
+	std::atomic<int> hungryThreads;
+	std::atomic<int> queuedWork;
+	std::atomic<bool> foundSolution;
 };
 
 //template <class state, class action>
@@ -110,237 +157,310 @@ void ParallelIDAStar<environment, state, action>::GetPath(environment *env,
 														  state from, state to,
 														  std::vector<action> &thePath)
 {
-	int numThreads = std::thread::hardware_concurrency();
 	if (!storedHeuristic)
 		heuristic = env;
 	nextBound = 0;
 	nodesExpanded = nodesTouched = 0;
 	thePath.resize(0);
-	work.resize(0);
+	iterationStats.resize(0);
 
 	// Set class member
 	goal = to;
-	
+
 	if (env->GoalTest(from, to))
 		return;
-	
-	std::vector<action> act;
-	env->GetActions(from, act);
-	
-	double rootH = heuristic->HCost(from, to);
+
+	std::vector<uint64_t> rootCache(incremental?incremental->GetCacheSize():0);
+	double rootH = incremental?incremental->InitialHCost(from, rootCache.data()):heuristic->HCost(from, to);
 	UpdateNextBound(0, rootH);
-	
-	// builds a list of all states at a fixed depth
-	// we will then search them in parallel
-	GenerateWork(env, act[0], from, thePath);
-	for (int x = 0; x < work.size(); x++)
-		work[x].unitNumber = x;
-	printf("%lu pieces of work generated\n", work.size());
-	foundSolution = work.size() + 1;
-	
-	while (foundSolution > work.size())
+
+	// each thread searches with its own copy of the environment and state
+	WorkerPool pool(numThreads);
+	std::vector<environment> envs(numThreads, *env);
+	std::vector<state> states(numThreads, from);
+	threads.resize(numThreads);
+	foundSolution = false;
+
+	while (true)
 	{
 		gCostHistogram.clear();
 		gCostHistogram.resize(nextBound+1);
 		fCostHistogram.clear();
 		fCostHistogram.resize(nextBound+1);
-		threads.resize(0);
-		
-		printf("Starting iteration with bound %f; %llu expanded, %llu generated\n", nextBound, nodesExpanded, nodesTouched);
-		fflush(stdout);
-		
-		for (int x = 0; x < work.size(); x++)
-		{
-			q.Add(x);
-		}
-		for (int x = 0; x < numThreads; x++)
+
+		if (verbose)
 		{
-			threads.push_back(new std::thread(&ParallelIDAStar<environment, state, action>::StartThreadedIteration, this,
-												 *env, from, nextBound));
+			printf("Starting iteration with bound %f; %llu expanded, %llu generated\n", nextBound, nodesExpanded, nodesTouched);
+			fflush(stdout);
 		}
-		for (int x = 0; x < threads.size(); x++)
+
+		// the whole tree starts as a single work item (the empty path)
+		work.clear();
+		work.push_back(std::vector<action>());
+		workItems = 1;
+		idleThreads = 0;
+		hungryThreads = 0;
+		queuedWork = 1;
+		iterationDone = false;
+		solution.resize(0);
+		for (auto &t : threads)
 		{
-			threads[x]->join();
-			delete threads[x];
-			threads[x] = 0;
+			t.nextBound = std::numeric_limits<double>::max();
+			t.idleTime = 0;
+			t.expanded = t.touched = t.steps = 0;
+			t.gHistogram.assign(gCostHistogram.size(), 0);
+			t.fHistogram.assign(fCostHistogram.size(), 0);
 		}
-		double bestBound = nextBound*10; // FIXME: Better ways to do bounds
-		for (int x = 0; x < work.size(); x++)
+
+		Timer timer;
+		timer.StartTimer();
+		double bound = nextBound;
+		pool.Run([&](int threadNum) {
+			StartThreadedIteration(threadNum, envs[threadNum], states[threadNum], bound);
+		});
+		timer.EndTimer();
+
+		pidaIterationStats stats;
+		stats.bound = bound;
+		stats.time = timer.GetElapsedTime();
+		stats.expanded = 0;
+		stats.minThreadExpanded = std::numeric_limits<uint64_t>::max();
+		stats.maxThreadExpanded = 0;
+		stats.workItems = workItems;
+		stats.maxIdleTime = 0;
+		double bestBound = std::numeric_limits<double>::max();
+		for (auto &t : threads)
 		{
-			for (int y = 0; y < work[x].gHistogram.size(); y++)
-			{
-				gCostHistogram[y] += work[x].gHistogram[y];
-				fCostHistogram[y] += work[x].fHistogram[y];
-			}
-			if (work[x].nextBound > nextBound && work[x].nextBound < bestBound)
-			{
-				//printf("Got bound of %1.0f from work %d\n", work[x].nextBound, x);
-				bestBound = work[x].nextBound;
-			}
-			nodesExpanded += work[x].expanded;
-			nodesTouched += work[x].touched;
-			if (work[x].solution.size() != 0)
+			for (int y = 0; y < t.gHistogram.size(); y++)
 			{
-//				printf(">>Solution histogram>>\n");
-//				PrintGHistogram();
-//				printf("<<Solution histogram<<\n");
-				thePath = work[x].solution;
+				gCostHistogram[y] += t.gHistogram[y];
+				fCostHistogram[y] += t.fHistogram[y];
 			}
+			if (t.nextBound > bound && t.nextBound < bestBound)
+				bestBound = t.nextBound;
+			nodesExpanded += t.expanded;
+			nodesTouched += t.touched;
+			stats.expanded += t.expanded;
+			stats.minThreadExpanded = std::min(stats.minThreadExpanded, t.expanded);
+			stats.maxThreadExpanded = std::max(stats.maxThreadExpanded, t.expanded);
+			stats.maxIdleTime = std::max(stats.maxIdleTime, t.idleTime);
+		}
+		iterationStats.push_back(stats);
+		if (verbose)
+		{
+			printf("%llu expanded in %1.3fs; per thread %llu to %llu (max/mean %1.2f); %llu work items; max idle %1.3fs\n",
+				   (unsigned long long)stats.expanded, stats.time, (unsigned long long)stats.minThreadExpanded,
+				   (unsigned long long)stats.maxThreadExpanded,
+				   stats.expanded?stats.maxThreadExpanded*(double)numThreads/stats.expanded:1.0,
+				   (unsigned long long)stats.workItems, stats.maxIdleTime);
 		}
 		nextBound = bestBound;
-//		printf(">>Full histogram>>\n");
-//		PrintGHistogram();
-//		printf("<<Full histogram<<\n");
-		if (thePath.size() != 0)
+		if (foundSolution)
+		{
+			thePath = solution;
+			return;
+		}
+		// nothing exceeded the bound, so there is no solution
+		if (bestBound == std::numeric_limits<double>::max())
 			return;
 	}
 }
 
+/**
+ * Take a work item from the shared queue, waiting for another thread to
+ * donate one if necessary. Returns false when the iteration is over.
+ */
 template <class environment, class state, class action>
-void ParallelIDAStar<environment, state, action>::GenerateWork(environment *env,
-															   action forbiddenAction, state &currState,
-															   std::vector<action> &thePath)
+bool ParallelIDAStar<environment, state, action>::GetWork(threadData &data, std::vector<action> &item)
 {
-	if (thePath.size() >= workDepth)
+	std::unique_lock<std::mutex> l(workLock);
+	if (work.empty() && !foundSolution)
 	{
-		workUnit<action> w;
-		for (int x = 0; x < workDepth; x++)
+		idleThreads++;
+		hungryThreads = idleThreads;
+		// everyone is out of work
+		if (idleThreads == numThreads)
 		{
-			w.pre[x] = thePath[x];
+			iterationDone = true;
+			workReady.notify_all();
+			return false;
 		}
-		work.push_back(w);
-		return;
-	}
-	
-	std::vector<action> actions;
-	env->GetActions(currState, actions);
-	nodesTouched += actions.size();
-	nodesExpanded++;
-	int depth = (int)thePath.size();
-	
-	for (unsigned int x = 0; x < actions.size(); x++)
-	{
-		if ((depth != 0) && (actions[x] == forbiddenAction))
-			continue;
-		
-		thePath.push_back(actions[x]);
-		
-		env->ApplyAction(currState, actions[x]);
-		action a = actions[x];
-		env->InvertAction(a);
-		GenerateWork(env, a, currState, thePath);
-		env->UndoAction(currState, actions[x]);
-		thePath.pop_back();
+		Timer t;
+		t.StartTimer();
+		workReady.wait(l, [this](){ return !work.empty() || iterationDone || foundSolution; });
+		data.idleTime += t.EndTimer();
+		if (work.empty())
+			return false;
+		idleThreads--;
+		hungryThreads = idleThreads;
 	}
-	
+	if (foundSolution)
+		return false;
+	item.swap(work.front());
+	work.pop_front();
+	queuedWork = (int)work.size();
+	return true;
 }
 
 template <class environment, class state, class action>
-void ParallelIDAStar<environment, state, action>::StartThreadedIteration(environment env, state startState, double bound)
+void ParallelIDAStar<environment, state, action>::StartThreadedIteration(int threadNum, environment &env, state &startState, double bound)
 {
-	vectorCache<action> actCache;
-	std::vector<action> thePath;
-	while (true)
+	threadData &data = threads[threadNum];
+	std::vector<action> item;
+	while (GetWork(data, item))
 	{
-		int nextValue;
-		// All values put in before threads start. Once the queue is empty we're done
-		if (q.Remove(nextValue) == false)
-			break;
-		
-		thePath.resize(0);
-		bool passedLimit = false;
+		data.path = item;
+		data.base = item.size();
+		data.depth = 0;
 		double g = 0;
-		workUnit<action> localWork = work[nextValue];
-		localWork.solution.resize(0);
-		localWork.gHistogram.clear();
-		localWork.gHistogram.resize(bound+1);
-		localWork.fHistogram.clear();
-		localWork.fHistogram.resize(bound+1);
-		localWork.nextBound = 10*bound;//FIXME: Better ways to do this
-		localWork.expanded = 0;
-		localWork.touched = 0;
-
-		for (int x = 0; x < workDepth; x++)
-		{
-			g += env.GCost(startState, localWork.pre[x]);
-			env.ApplyAction(startState, localWork.pre[x]);
-			thePath.push_back(localWork.pre[x]);
-			
-			if (!passedLimit && fgreater(g+heuristic->HCost(startState, goal), bound))
-			{
-				localWork.nextBound = g+heuristic->HCost(startState, goal);
-				passedLimit = true;
-			}
-		}
-
-		action last = localWork.pre[workDepth-1];
-		env.InvertAction(last);
-		
-		if (!passedLimit)
+		for (size_t x = 0; x < item.size(); x++)
 		{
-			DoIteration(&env, last, startState, thePath, bound, g, localWork, actCache);
+			g += env.GCost(startState, item[x]);
+			env.ApplyAction(startState, item[x]);
 		}
-		
-		for (int x = workDepth-1; x >= 0; x--)
+		action last;
+		if (item.size() > 0)
 		{
-			env.UndoAction(startState, localWork.pre[x]);
-			g -= env.GCost(startState, localWork.pre[x]);
+			last = item.back();
+			env.InvertAction(last);
 		}
-		work[nextValue] = localWork;
+		// the prefix was checked by the thread that donated it
+		if (Visit(data, env, startState, bound, g, item.size()?&last:0))
+			DoIteration(data, env, startState, bound);
+
+		for (size_t x = data.path.size(); x > 0; x--)
+			env.UndoAction(startState, data.path[x-1]);
 	}
 }
 
-
+/**
+ * Checks the f-cost and goal of currState. If it must be expanded, pushes a
+ * new frame with its actions and returns true.
+ */
 template <class environment, class state, class action>
-void ParallelIDAStar<environment, state, action>::DoIteration(environment *env,
-															  action forbiddenAction, state &currState,
-															  std::vector<action> &thePath, double bound, double g,
-															  workUnit<action> &w, vectorCache<action> &cache)
+bool ParallelIDAStar<environment, state, action>::Visit(threadData &data, environment &env, state &currState,
+														double bound, double g, const action *forbiddenAction)
 {
-	double h = heuristic->HCost(currState, goal);//, parentH); // TODO: restore code that uses parent h-cost
-	
+	double h;
+	if (incremental)
+	{
+		// frames above the work item's root continue from their parent's data
+		size_t cacheSize = incremental->GetCacheSize();
+		if (data.hCache.size() < (data.depth+1)*cacheSize)
+			data.hCache.resize((data.depth+1)*cacheSize);
+		if (data.depth == 0)
+			h = incremental->InitialHCost(currState, &data.hCache[0]);
+		else
+			h = incremental->IncrementalHCost(currState, data.path.back(), &data.hCache[(data.depth-1)*cacheSize],
+											  &data.hCache[data.depth*cacheSize]);
+	}
+	else
+		h = heuristic->HCost(currState, goal);
+
 	if (fgreater(g+h, bound))
 	{
-		if (g+h < w.nextBound)
-			w.nextBound = g+h;
-		return;
+		if (g+h < data.nextBound)
+			data.nextBound = g+h;
+		return false;
 	}
 
 	// must do this after we check the f-cost bound
-	if (env->GoalTest(currState, goal))
+	if (env.GoalTest(currState, goal))
 	{
-		w.solution = thePath;
-		foundSolution = std::min(foundSolution,w.unitNumber);
-		return;
+		std::lock_guard<std::mutex> l(workLock);
+		if (!foundSolution)
+		{
+			solution = data.path;
+			foundSolution = true;
+			workReady.notify_all();
+		}
+		return false;
 	}
-	
-	std::vector<action> &actions = *cache.getItem();
-	env->GetActions(currState, actions);
-	w.touched += actions.size();
-	w.expanded++;
-	w.gHistogram[g]++;
-	w.fHistogram[g+h]++;
 
-	for (unsigned int x = 0; x < actions.size(); x++)
+	if (data.depth == data.stack.size())
+		data.stack.resize(data.depth+1);
+	searchFrame &f = data.stack[data.depth];
+	env.GetActions(currState, f.actions);
+	data.touched += f.actions.size();
+	data.expanded++;
+	if (g < data.gHistogram.size())
+		data.gHistogram[(size_t)g]++;
+	if (g+h < data.fHistogram.size())
+		data.fHistogram[(size_t)(g+h)]++;
+	if (forbiddenAction)
+		f.actions.erase(std::remove(f.actions.begin(), f.actions.end(), *forbiddenAction), f.actions.end());
+	f.next = 0;
+	f.g = g;
+	data.depth++;
+	return true;
+}
+
+template <class environment, class state, class action>
+void ParallelIDAStar<environment, state, action>::DoIteration(threadData &data, environment &env, state &currState, double bound)
+{
+	while (data.depth > 0 && !foundSolution.load(std::memory_order_relaxed))
 	{
-		if (actions[x] == forbiddenAction)
+		// check for idle threads every 64 steps
+		if ((++data.steps&0x3F) == 0 &&
+			hungryThreads.load(std::memory_order_relaxed) > queuedWork.load(std::memory_order_relaxed))
+			DonateWork(data);
+
+		searchFrame &f = data.stack[data.depth-1];
+		if (f.next == f.actions.size())
+		{
+			data.depth--;
+			if (data.depth > 0)
+			{
+				env.UndoAction(currState, data.path.back());
+				data.path.pop_back();
+			}
 			continue;
-		
-		thePath.push_back(actions[x]);
-		
-		double edgeCost = env->GCost(currState, actions[x]);
-		env->ApplyAction(currState, actions[x]);
-		action a = actions[x];
-		env->InvertAction(a);
-		DoIteration(env, a, currState, thePath, bound, g+edgeCost, w, cache);
-		env->UndoAction(currState, actions[x]);
-		thePath.pop_back();
-		if (foundSolution <= w.unitNumber)
-			break;
+		}
+		action a = f.actions[f.next++];
+		double g = f.g+env.GCost(currState, a);
+		env.ApplyAction(currState, a);
+		data.path.push_back(a);
+		action inverse = a;
+		env.InvertAction(inverse);
+		if (!Visit(data, env, currState, bound, g, &inverse))
+		{
+			env.UndoAction(currState, a);
+			data.path.pop_back();
+		}
 	}
-	cache.returnItem(&actions);
 }
 
+/**
+ * Give half of the untried children of the shallowest frame with any left
+ * to the idle threads.
+ */
+template <class environment, class state, class action>
+void ParallelIDAStar<environment, state, action>::DonateWork(threadData &data)
+{
+	std::lock_guard<std::mutex> l(workLock);
+	if ((int)work.size() >= idleThreads)
+		return;
+	for (int x = 0; x < data.depth; x++)
+	{
+		searchFrame &f = data.stack[x];
+		size_t remaining = f.actions.size()-f.next;
+		if (remaining == 0)
+			continue;
+		size_t split = f.next+remaining/2;
+		// frame x is the node at the end of the first base+x actions of the path
+		std::vector<action> prefix(data.path.begin(), data.path.begin()+data.base+x);
+		for (size_t y = split; y < f.actions.size(); y++)
+		{
+			work.push_back(prefix);
+			work.back().push_back(f.actions[y]);
+		}
+		workItems += f.actions.size()-split;
+		queuedWork = (int)work.size();
+		f.actions.resize(split);
+		workReady.notify_all();
+		return;
+	}
+}
 
 template <class environment, class state, class action>
 void ParallelIDAStar<environment, state, action>::UpdateNextBound(double currBound, double fCost)
@@ -0,0 +1,223 @@
+//
+//  RetrogradeSolver.h
+//  hog2
+//
+//  Layered, parallel retrograde analysis of pursuit-evasion games (e.g. cops
+//  and robber) over joint positions with a 64-bit rank.
+//
+
+#ifndef RetrogradeSolver_h
+#define RetrogradeSolver_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include "MMapUtil.h"
+#include "WorkerPool.h"
+
+/**
+ * Retrograde analysis of a game where a min player (the pursuer) and a max
+ * player (the evader) alternate moves on unit cost moves. The value of a
+ * position is the number of moves until capture when the min player moves
+ * first (as min_cost in the coprobber Dijkstra solvers).
+ *
+ * The game has to provide:
+ *   uint64_t GetNumStates() const
+ *   bool IsTerminal(uint64_t rank) const      -- captured, value 0 for both players
+ *   int GetNumMaxMoves(uint64_t rank) const   -- distinct moves of the max player (at most 255)
+ *   void GetMinPredecessors(uint64_t rank, std::vector<uint64_t> &p) const
+ *       positions from which one min move reaches rank; repeats are allowed
+ *   void GetMaxPredecessors(uint64_t rank, std::vector<uint64_t> &p) const
+ *       positions from which one max move reaches rank; without repeats and
+ *       without terminal positions
+ *
+ * The layers are computed backward from the terminal positions. A min-to-move
+ * position gets its value from the first max-to-move successor that is solved;
+ * a max-to-move position is solved when the last of its successors is, so
+ * the solved successors are counted per position. Only the min-to-move values (16 bits) and
+ * the max-to-move counters (8 bits) are stored, 3 bytes per position, in
+ * memory or in memory-mapped files. The positions of a layer are split over
+ * the threads, which update the tables with atomic operations.
+ */
+template <class game>
+class RetrogradeSolver {
+public:
+	static const uint32_t kUnsolved = 0xFFFFFFFF;
+
+	RetrogradeSolver(const game &g) :g(g), values(0), counts(0), valuesFD(-1), countsFD(-1), layers(0) {}
+	~RetrogradeSolver() { Free(); }
+	RetrogradeSolver(const RetrogradeSolver &) = delete;
+	RetrogradeSolver &operator=(const RetrogradeSolver &) = delete;
+
+	/** Keep the tables in files with this prefix instead of in (anonymous) memory */
+	void SetFilePrefix(const char *prefix) { filePrefix = prefix?prefix:""; }
+	void Solve(int numThreads);
+	bool IsSolved() const { return values != 0; }
+	/** Moves until capture with the min player to move, or kUnsolved if the max player escapes */
+	uint32_t GetValue(uint64_t rank) const { return (values[rank] == 0)?kUnsolved:values[rank]-1u; }
+	/** The number of layers that were solved */
+	int GetNumLayers() const { return layers; }
+	uint64_t GetNodesExpanded() const { return nodesExpanded; }
+	uint64_t GetNodesTouched() const { return nodesTouched; }
+private:
+	static const uint16_t kMaxValue = 0xFFFE;
+	static const uint64_t kChunk = 1024;
+	void Free();
+	void Unmap(void *mem, uint64_t bytes, int &fd);
+	template <typename T>
+	T *Allocate(const char *suffix, uint64_t count, int &fd);
+
+	const game &g;
+	std::string filePrefix;
+	uint16_t *values; // min to move; value+1, 0 if unsolved
+	uint8_t *counts;  // max to move; successors solved so far
+	int valuesFD, countsFD;
+	int layers;
+	uint64_t nodesExpanded, nodesTouched;
+};
+
+template <class game>
+const uint32_t RetrogradeSolver<game>::kUnsolved;
+template <class game>
+const uint16_t RetrogradeSolver<game>::kMaxValue;
+template <class game>
+const uint64_t RetrogradeSolver<game>::kChunk;
+
+template <class game>
+template <typename T>
+T *RetrogradeSolver<game>::Allocate(const char *suffix, uint64_t count, int &fd)
+{
+	// mmap zero fills, and pages that are never touched take no memory
+	if (filePrefix.empty())
+		return (T*)GetMMAP(0, count*sizeof(T), fd, true);
+	std::string name = filePrefix+suffix;
+	return (T*)GetMMAP(name.c_str(), count*sizeof(T), fd, true);
+}
+
+template <class game>
+void RetrogradeSolver<game>::Free()
+{
+	uint64_t n = g.GetNumStates();
+	if (values)
+		Unmap(values, n*sizeof(uint16_t), valuesFD);
+	if (counts)
+		Unmap(counts, n*sizeof(uint8_t), countsFD);
+	values = 0;
+	counts = 0;
+}
+
+template <class game>
+void RetrogradeSolver<game>::Unmap(void *mem, uint64_t bytes, int &fd)
+{
+	// anonymous maps have no file to close
+	if (fd == -1)
+		munmap(mem, bytes);
+	else
+		CloseMMap((uint8_t*)mem, bytes, fd);
+	fd = -1;
+}
+
+template <class game>
+void RetrogradeSolver<game>::Solve(int numThreads)
+{
+	Free();
+	const uint64_t n = g.GetNumStates();
+	values = Allocate<uint16_t>(".values", n, valuesFD);
+	counts = Allocate<uint8_t>(".counts", n, countsFD);
+	nodesExpanded = nodesTouched = 0;
+
+	WorkerPool pool(numThreads);
+	numThreads = pool.NumThreads();
+	WorkStealingRange work(numThreads);
+	// the min-to-move and max-to-move positions of the current and next layer, per thread
+	std::vector<std::vector<uint64_t>> minNext(numThreads), maxNext(numThreads);
+	std::vector<uint64_t> expanded(numThreads), touched(numThreads);
+
+	// layer 0: the captures
+	work.Reset((n+kChunk-1)/kChunk);
+	pool.Run([&](int t) {
+		uint64_t chunk;
+		while (work.Next(t, chunk))
+		{
+			for (uint64_t x = chunk*kChunk; x < std::min(n, (chunk+1)*kChunk); x++)
+			{
+				if (!g.IsTerminal(x))
+					continue;
+				values[x] = 1;
+				minNext[t].push_back(x);
+				maxNext[t].push_back(x);
+			}
+		}
+	});
+
+	std::vector<uint64_t> minLayer, maxLayer;
+	for (layers = 0; true; layers++)
+	{
+		minLayer.clear();
+		maxLayer.clear();
+		for (int t = 0; t < numThreads; t++)
+		{
+			minLayer.insert(minLayer.end(), minNext[t].begin(), minNext[t].end());
+			maxLayer.insert(maxLayer.end(), maxNext[t].begin(), maxNext[t].end());
+			minNext[t].clear();
+			maxNext[t].clear();
+		}
+		if (minLayer.empty() && maxLayer.empty())
+			break;
+		if (layers+2 > kMaxValue)
+		{
+			printf("Error: more than %d layers; values are not complete\n", kMaxValue-1);
+			break;
+		}
+		const uint16_t nextValue = (uint16_t)(layers+2); // layers+1, stored +1
+		const uint64_t minChunks = (minLayer.size()+kChunk-1)/kChunk;
+		work.Reset(minChunks+(maxLayer.size()+kChunk-1)/kChunk);
+		pool.Run([&](int t) {
+			std::vector<uint64_t> pred;
+			uint64_t chunk;
+			while (work.Next(t, chunk))
+			{
+				bool min = chunk < minChunks;
+				const std::vector<uint64_t> &layer = min?minLayer:maxLayer;
+				uint64_t first = (min?chunk:chunk-minChunks)*kChunk;
+				for (uint64_t x = first; x < std::min((uint64_t)layer.size(), first+kChunk); x++)
+				{
+					expanded[t]++;
+					if (min)
+					{
+						// a max-to-move predecessor is solved with its last successor
+						g.GetMaxPredecessors(layer[x], pred);
+						touched[t] += pred.size();
+						for (uint64_t p : pred)
+						{
+							int solved = __atomic_add_fetch(&counts[p], 1, __ATOMIC_RELAXED);
+							if (solved == g.GetNumMaxMoves(p))
+								maxNext[t].push_back(p);
+						}
+					}
+					else {
+						// a min-to-move predecessor is solved with its first successor
+						g.GetMinPredecessors(layer[x], pred);
+						touched[t] += pred.size();
+						for (uint64_t p : pred)
+						{
+							uint16_t unsolved = 0;
+							if (__atomic_load_n(&values[p], __ATOMIC_RELAXED) == 0 &&
+								__atomic_compare_exchange_n(&values[p], &unsolved, nextValue, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+								minNext[t].push_back(p);
+						}
+					}
+				}
+			}
+		});
+	}
+	for (int t = 0; t < numThreads; t++)
+	{
+		nodesExpanded += expanded[t];
+		nodesTouched += touched[t];
+	}
+}
+
+#endif /* RetrogradeSolver_h */
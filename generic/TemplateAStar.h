@@ -166,7 +166,11 @@ private:
 //	void UpdateWeight(environment *env, state& currOpenNode, state& neighbor);
 //	void AddToOpenList(environment *env, state& currOpenNode, state& neighbor);
 	
+	bool LoadSuccessorBatch(const state &s);
+	
 	std::vector<state> neighbors;
+	std::vector<uint64_t> neighborHash;
+	std::vector<Successor<state, action>> successorBatch;
 	std::vector<uint64_t> neighborID;
 	std::vector<double> edgeCosts;
 	std::vector<double> hCosts;
@@ -400,6 +404,7 @@ bool TemplateAStar<state,action,environment,openList>::DoSingleSearchStep(std::v
   }
 
   neighbors.resize(0);
+  neighborHash.resize(0);
   edgeCosts.resize(0);
   hCosts.resize(0);
   neighborID.resize(0);
@@ -407,7 +412,15 @@ bool TemplateAStar<state,action,environment,openList>::DoSingleSearchStep(std::v
 
   if(verbose)std::cout << "Expanding: " << openClosedList.Lookup(nodeid).data << " with f:" << openClosedList.Lookup(nodeid).g+openClosedList.Lookup(nodeid).h << std::endl;
 
-  (env->*SuccessorFunc)(openClosedList.Lookup(nodeid).data, neighbors);
+  if (!LoadSuccessorBatch(openClosedList.Lookup(nodeid).data))
+  {
+    (env->*SuccessorFunc)(openClosedList.Lookup(nodeid).data, neighbors);
+    for (unsigned int x = 0; x < neighbors.size(); x++)
+    {
+      neighborHash.push_back(env->GetStateHash(neighbors[x]));
+      edgeCosts.push_back((env->*GCostFunc)(openClosedList.Lookup(nodeid).data, neighbors[x]));
+    }
+  }
   //std::cout << openClosedList.Lookup(nodeid).data << "("<<G<<"+"<<H<<")="<<(G+H)<<", "<<neighbors.size()<<" succ.\n";
   double bestH = 0;
   double lowHC = DBL_MAX;
@@ -415,11 +428,10 @@ bool TemplateAStar<state,action,environment,openList>::DoSingleSearchStep(std::v
   for (unsigned int x = 0; x < neighbors.size(); x++)
   {
     uint64_t theID;
-    neighborLoc.push_back(openClosedList.Lookup(env->GetStateHash(neighbors[x]), theID));
+    neighborLoc.push_back(openClosedList.Lookup(neighborHash[x], theID));
     neighborID.push_back(theID);
-    edgeCosts.push_back((env->*GCostFunc)(openClosedList.Lookup(nodeid).data, neighbors[x]));
 
-    double g(edgeCosts.back()+G);
+    double g(edgeCosts[x]+G);
     double h=DBL_MAX;
     if(neighborLoc.back() != kNotFound)
       h=openClosedList.Lookup(theID).h;
@@ -432,7 +444,7 @@ bool TemplateAStar<state,action,environment,openList>::DoSingleSearchStep(std::v
     // Find the lowest f-cost of the children
     if(doPartialExpansion && fgreater(g+h,G+H)) {
       // New H for current node
-      lowHC = std::min(lowHC, h+edgeCosts.back());
+      lowHC = std::min(lowHC, h+edgeCosts[x]);
       //std::cout << "New H: " << lowHC << "\n";
     }
 
@@ -441,13 +453,13 @@ bool TemplateAStar<state,action,environment,openList>::DoSingleSearchStep(std::v
       if (neighborLoc.back() != kNotFound)
       {
         if (!directed)
-          bestH = std::max(bestH, openClosedList.Lookup(theID).h-edgeCosts.back());
-        lowHC = std::min(lowHC, openClosedList.Lookup(theID).h+edgeCosts.back());
+          bestH = std::max(bestH, openClosedList.Lookup(theID).h-edgeCosts[x]);
+        lowHC = std::min(lowHC, openClosedList.Lookup(theID).h+edgeCosts[x]);
       }
       else {
         if (!directed)
-          bestH = std::max(bestH, h-edgeCosts.back());
-        lowHC = std::min(lowHC, h+edgeCosts.back());
+          bestH = std::max(bestH, h-edgeCosts[x]);
+        lowHC = std::min(lowHC, h+edgeCosts[x]);
       }
     }
   }
@@ -534,7 +546,7 @@ bool TemplateAStar<state,action,environment,openList>::DoSingleSearchStep(std::v
         {
           //double edgeCost = env->GCost(openClosedList.Lookup(nodeid).data, neighbors[x]);
           openClosedList.AddClosedNode(neighbors[x],
-                                       env->GetStateHash(neighbors[x]),
+                                       neighborHash[x],
                                        openClosedList.Lookup(nodeid).g+edgeCosts[x],
                                        std::max(hCosts[x], openClosedList.Lookup(nodeid).h-edgeCosts[x]),
                                        nodeid);
@@ -547,7 +559,7 @@ bool TemplateAStar<state,action,environment,openList>::DoSingleSearchStep(std::v
           if (useBPMX)
           {
             openClosedList.AddOpenNode(neighbors[x],
-                                       env->GetStateHash(neighbors[x]),
+                                       neighborHash[x],
                                        openClosedList.Lookup(nodeid).g+edgeCosts[x],
                                        std::max(weight*hCosts[x], openClosedList.Lookup(nodeid).h-edgeCosts[x]),
                                        nodeid);
@@ -559,7 +571,7 @@ bool TemplateAStar<state,action,environment,openList>::DoSingleSearchStep(std::v
             if(fequal(G+H,g+h)){
               //std::cout << "  OPEN-->"<<neighbors[x]<<"("<<g<<"+"<<h<<")="<<(g+h)<<"\n";
               openClosedList.AddOpenNode(neighbors[x],
-                                         env->GetStateHash(neighbors[x]),
+                                         neighborHash[x],
                                          g,
                                          weight*h,
                                          nodeid);
@@ -567,9 +579,9 @@ bool TemplateAStar<state,action,environment,openList>::DoSingleSearchStep(std::v
             //else
             //std::cout << "  ignore "<<neighbors[x]<<"("<<g<<"+"<<h<<")="<<(g+h)<<"\n";
           } else {
-            if(verbose)std::cout << "Add node ("<<std::hex<<env->GetStateHash(neighbors[x])<<std::dec<<") to open " << neighbors[x] << (G+edgeCosts[x]) << "+" << (weight*hCosts[x]) << "=" << (G+edgeCosts[x]+weight*hCosts[x]) << "\n";
+            if(verbose)std::cout << "Add node ("<<std::hex<<neighborHash[x]<<std::dec<<") to open " << neighbors[x] << (G+edgeCosts[x]) << "+" << (weight*hCosts[x]) << "=" << (G+edgeCosts[x]+weight*hCosts[x]) << "\n";
             openClosedList.AddOpenNode(neighbors[x],
-                                       env->GetStateHash(neighbors[x]),
+                                       neighborHash[x],
                                        G+edgeCosts[x],
                                        weight*hCosts[x],
                                        nodeid);
@@ -586,6 +598,34 @@ bool TemplateAStar<state,action,environment,openList>::DoSingleSearchStep(std::v
   return false;
 }
 
+/**
+ * Fills neighbors, neighborHash and edgeCosts from the successor batch of the
+ * environment, if it has one and the default successor and cost functions
+ * are used. Returns false otherwise.
+ */
+template <class state, class action, class environment, class openList>
+bool TemplateAStar<state, action,environment,openList>::LoadSuccessorBatch(const state &s)
+{
+  typedef SuccessorBatch<environment, state, action> batch;
+  unsigned maxSuccessors = batch::GetMaxSuccessors(env);
+  if (maxSuccessors == 0)
+    return false;
+  if (SuccessorFunc != static_cast<void (environment::*)(const state&, std::vector<state>&) const>(&environment::GetSuccessors) ||
+      GCostFunc != static_cast<double (environment::*)(const state&, const state&) const>(&environment::GCost))
+    return false;
+  if (successorBatch.size() < maxSuccessors)
+    successorBatch.resize(maxSuccessors);
+  unsigned count = batch::GetSuccessors(env, s, &successorBatch[0], true);
+  neighbors.resize(count);
+  for (unsigned int x = 0; x < count; x++)
+  {
+    neighbors[x] = successorBatch[x].s;
+    neighborHash.push_back(successorBatch[x].hash);
+    edgeCosts.push_back(successorBatch[x].cost);
+  }
+  return true;
+}
+
 /**
  * Returns the next state on the open list (but doesn't pop it off the queue). 
  * @author Nathan Sturtevant
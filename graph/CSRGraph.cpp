@@ -0,0 +1,268 @@
+//
+//  CSRGraph.cpp
+//  hog2
+//
+
+#include "CSRGraph.h"
+#include "Graph.h"
+#include <string.h>
+#include <algorithm>
+
+namespace {
+	const char csrFileMagic[8] = "HOG2CSR";
+	const uint32_t csrFileVersion = 1;
+
+	struct CSRFileHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t hasCoordinates;
+		uint64_t numNodes;
+		uint64_t numEdges;
+	};
+
+	template <typename T>
+	bool WriteArray(FILE *f, const std::vector<T> &v)
+	{
+		return fwrite(v.data(), sizeof(T), v.size(), f) == v.size();
+	}
+
+	template <typename T>
+	bool ReadArray(FILE *f, std::vector<T> &v, uint64_t count)
+	{
+		v.resize(count);
+		return fread(v.data(), sizeof(T), count, f) == count;
+	}
+}
+
+CSRGraph::CSRGraph()
+:offsets(1, 0)
+{
+}
+
+CSRGraph::CSRGraph(Graph *g, bool directed, int xLabel, int yLabel)
+{
+	uint32_t numNodes = g->GetNumNodes();
+	std::vector<uint32_t> from, to;
+	std::vector<float> weight;
+	edge_iterator ei = g->getEdgeIter();
+	for (edge *e = g->edgeIterNext(ei); e; e = g->edgeIterNext(ei))
+	{
+		from.push_back(e->getFrom());
+		to.push_back(e->getTo());
+		weight.push_back(e->GetWeight());
+		if (!directed)
+		{
+			from.push_back(e->getTo());
+			to.push_back(e->getFrom());
+			weight.push_back(e->GetWeight());
+		}
+	}
+	Build(numNodes, from, to, weight);
+	if (xLabel >= 0 && yLabel >= 0)
+	{
+		x.resize(numNodes);
+		y.resize(numNodes);
+		for (uint32_t n = 0; n < numNodes; n++)
+		{
+			x[n] = g->GetNode(n)->GetLabelF(xLabel);
+			y[n] = g->GetNode(n)->GetLabelF(yLabel);
+		}
+	}
+}
+
+/*
+ * Counting sort of the edges by source node. Edges with the same source
+ * keep their input order, so successors come out in the same order as the
+ * source graph.
+ *
+ * Parallel edges (eg both directions of an edge in an undirected build)
+ * are merged into the first of them with the smallest weight, so every
+ * neighbor is listed once and FindEdge finds the cheapest edge.
+ */
+void CSRGraph::Build(uint32_t numNodes, std::vector<uint32_t> &from, std::vector<uint32_t> &to, std::vector<float> &weight)
+{
+	offsets.assign(numNodes+1, 0);
+	for (uint32_t f : from)
+		offsets[f+1]++;
+	for (uint32_t n = 0; n < numNodes; n++)
+		offsets[n+1] += offsets[n];
+	targets.resize(to.size());
+	weights.resize(to.size());
+	std::vector<uint64_t> next(offsets.begin(), offsets.end()-1);
+	for (uint64_t e = 0; e < from.size(); e++)
+	{
+		uint64_t loc = next[from[e]]++;
+		targets[loc] = to[e];
+		weights[loc] = weight[e];
+	}
+
+	// where each target was last written; it is an edge of the current node
+	// if it is past the node's first edge
+	std::vector<uint64_t> written(numNodes, GetNumEdges());
+	uint64_t end = 0;
+	for (uint32_t n = 0; n < numNodes; n++)
+	{
+		uint64_t first = offsets[n], last = offsets[n+1];
+		offsets[n] = end;
+		for (uint64_t e = first; e < last; e++)
+		{
+			uint64_t &w = written[targets[e]];
+			if (w < GetNumEdges() && w >= offsets[n])
+			{
+				weights[w] = std::min(weights[w], weights[e]);
+				continue;
+			}
+			w = end;
+			targets[end] = targets[e];
+			weights[end] = weights[e];
+			end++;
+		}
+	}
+	offsets[numNodes] = end;
+	targets.resize(end);
+	weights.resize(end);
+}
+
+bool CSRGraph::LoadDIMACS(const char *grFile, const char *coFile)
+{
+	FILE *f = fopen(grFile, "r");
+	if (f == 0)
+	{
+		printf("Error opening '%s'\n", grFile);
+		return false;
+	}
+	char line[255];
+	uint32_t maxNode = 0;
+	std::vector<uint32_t> from, to;
+	std::vector<float> weight;
+	while (fgets(line, 255, f))
+	{
+		if (line[0] == 'p')
+		{
+			unsigned long nodes, edges;
+			if (2 == sscanf(line, "p sp %lu %lu", &nodes, &edges))
+			{
+				from.reserve(edges);
+				to.reserve(edges);
+				weight.reserve(edges);
+			}
+		}
+		else if (line[0] == 'a')
+		{
+			unsigned int x1, y1;
+			double w;
+			if (3 != sscanf(line, "a %u %u %lf", &x1, &y1, &w))
+				continue;
+			from.push_back(x1);
+			to.push_back(y1);
+			weight.push_back(w);
+			if (x1 > maxNode) maxNode = x1;
+			if (y1 > maxNode) maxNode = y1;
+		}
+	}
+	fclose(f);
+	x.resize(0);
+	y.resize(0);
+	Build(maxNode+1, from, to, weight);
+
+	if (coFile == 0)
+		return true;
+	f = fopen(coFile, "r");
+	if (f == 0)
+	{
+		printf("Error opening '%s'\n", coFile);
+		return false;
+	}
+	x.assign(GetNumNodes(), 0);
+	y.assign(GetNumNodes(), 0);
+	while (fgets(line, 255, f))
+	{
+		if (line[0] == 'v')
+		{
+			unsigned int id;
+			float x1, y1;
+			if (3 != sscanf(line, "v %u %f %f", &id, &x1, &y1) || id >= GetNumNodes())
+				continue;
+			x[id] = x1;
+			y[id] = y1;
+		}
+	}
+	fclose(f);
+	return true;
+}
+
+bool CSRGraph::Save(const char *file) const
+{
+	FILE *f = fopen(file, "w+b");
+	if (f == 0)
+	{
+		perror("Opening CSR graph");
+		return false;
+	}
+	CSRFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, csrFileMagic, sizeof(header.magic));
+	header.version = csrFileVersion;
+	header.hasCoordinates = HasCoordinates();
+	header.numNodes = GetNumNodes();
+	header.numEdges = GetNumEdges();
+	bool result = (fwrite(&header, sizeof(header), 1, f) == 1) &&
+		WriteArray(f, offsets) && WriteArray(f, targets) && WriteArray(f, weights);
+	if (result && HasCoordinates())
+		result = WriteArray(f, x) && WriteArray(f, y);
+	fclose(f);
+	return result;
+}
+
+bool CSRGraph::Load(const char *file)
+{
+	FILE *f = fopen(file, "rb");
+	if (f == 0)
+	{
+		perror("Opening CSR graph");
+		return false;
+	}
+	CSRFileHeader header;
+	if (fread(&header, sizeof(header), 1, f) != 1 ||
+		memcmp(header.magic, csrFileMagic, sizeof(header.magic)) != 0)
+	{
+		printf("Error: '%s' is not a CSR graph file\n", file);
+		fclose(f);
+		return false;
+	}
+	if (header.version != csrFileVersion)
+	{
+		printf("Error: CSR graph file version %u; expected %u\n", header.version, csrFileVersion);
+		fclose(f);
+		return false;
+	}
+	bool result = ReadArray(f, offsets, header.numNodes+1) &&
+		ReadArray(f, targets, header.numEdges) && ReadArray(f, weights, header.numEdges);
+	x.resize(0);
+	y.resize(0);
+	if (result && header.hasCoordinates)
+		result = ReadArray(f, x, header.numNodes) && ReadArray(f, y, header.numNodes);
+	fclose(f);
+	if (!result)
+	{
+		printf("Error: '%s' is truncated\n", file);
+		offsets.assign(1, 0);
+		targets.resize(0);
+		weights.resize(0);
+	}
+	return result;
+}
+
+uint64_t CSRGraph::FindEdge(uint32_t from, uint32_t to) const
+{
+	for (uint64_t e = offsets[from]; e < offsets[from+1]; e++)
+		if (targets[e] == to)
+			return e;
+	return GetNumEdges();
+}
+
+uint64_t CSRGraph::GetMemoryBytes() const
+{
+	return offsets.size()*sizeof(offsets[0])+targets.size()*sizeof(targets[0])+
+		weights.size()*sizeof(weights[0])+(x.size()+y.size())*sizeof(float);
+}
@@ -0,0 +1,60 @@
+//
+//  CSRGraph.h
+//  hog2
+//
+//  An immutable graph in compressed sparse row form.
+//
+
+#ifndef CSRGRAPH_H
+#define CSRGRAPH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+class Graph;
+
+/**
+ * Stores the outgoing edges of every node contiguously: the edges of node n
+ * are [EdgeBegin(n), EdgeEnd(n)) in the targets and weights arrays. Node ids
+ * are the same as the ids of the Graph or DIMACS file it was built from.
+ *
+ * Node coordinates are optional and are only used for heuristics and drawing.
+ */
+class CSRGraph {
+public:
+	CSRGraph();
+	// Builds from the edges of g. If directed is false every edge can be
+	// used in both directions. xLabel/yLabel are node labels holding
+	// coordinates (-1 to skip).
+	CSRGraph(Graph *g, bool directed = true, int xLabel = -1, int yLabel = -1);
+
+	// Reads a DIMACS shortest path graph (.gr, "a from to weight" lines) and
+	// optionally its coordinate file (.co, "v id x y" lines). Node 0 is
+	// unused as DIMACS ids start at 1.
+	bool LoadDIMACS(const char *grFile, const char *coFile = 0);
+	bool Save(const char *file) const;
+	bool Load(const char *file);
+
+	inline uint32_t GetNumNodes() const { return (uint32_t)(offsets.size()-1); }
+	inline uint64_t GetNumEdges() const { return targets.size(); }
+	inline uint64_t EdgeBegin(uint32_t n) const { return offsets[n]; }
+	inline uint64_t EdgeEnd(uint32_t n) const { return offsets[n+1]; }
+	inline uint32_t GetTarget(uint64_t e) const { return targets[e]; }
+	inline float GetWeight(uint64_t e) const { return weights[e]; }
+	// Returns the edge from -> to, or GetNumEdges() if there is none
+	uint64_t FindEdge(uint32_t from, uint32_t to) const;
+
+	bool HasCoordinates() const { return x.size() != 0; }
+	inline float GetX(uint32_t n) const { return x[n]; }
+	inline float GetY(uint32_t n) const { return y[n]; }
+	uint64_t GetMemoryBytes() const;
+private:
+	void Build(uint32_t numNodes, std::vector<uint32_t> &from, std::vector<uint32_t> &to, std::vector<float> &weight);
+	std::vector<uint64_t> offsets;
+	std::vector<uint32_t> targets;
+	std::vector<float> weights;
+	std::vector<float> x, y;
+};
+
+#endif
@@ -12,15 +12,21 @@
 #include "Graphics2D.h"
 
 JPS::JPS(Map *m)
+:passable(m, true, false)
 {
 	env = 0;
 	weight = 1.0;
 	jumpLimit = -1;
+	BuildJumpPoints(m);
+}
 
+void JPS::BuildJumpPoints(Map *m)
+{
+	map = m;
 	w = m->GetMapWidth();
 	h = m->GetMapHeight();
 	
-	jumpPoints.resize(m->GetMapWidth()*m->GetMapHeight());
+	jumpPoints.assign(m->GetMapWidth()*m->GetMapHeight(), false);
 	for (int y = 0; y < m->GetMapHeight(); y++)
 	{
 		for (int x = 0; x < m->GetMapWidth(); x++)
@@ -67,6 +73,12 @@ bool JPS::InitializeSearch(MapEnvironment *env, const xyLoc& from, const xyLoc&
 	this->env = env;
 	this->to = to;
 	Map *t = env->GetMap();
+	// the bitmap and jump points are only made again for a different map
+	if (t != map)
+	{
+		passable.Rebuild(t);
+		BuildJumpPoints(t);
+	}
 	//openClosedList.Reset();
 	openClosedList.Reset(t->GetMapWidth()*t->GetMapHeight());
 	xyLocParent f;
@@ -167,7 +179,7 @@ void JPS::GetJPSSuccessors(const xyLocParent &s, const xyLoc &goal)
 
 bool JPS::Passable(int x, int y)
 {
-	return env->GetMap()->GetTerrainType(x, y) == kGround;
+	return passable.Passable(x, y);
 }
 
 void JPS::SetJumpPoint(int x, int y)
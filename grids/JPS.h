@@ -16,6 +16,7 @@
 // For comparing items in open/closed
 #include "TemplateAStar.h"
 #include "IndexOpenClosed.h"
+#include "PassabilityBitmap.h"
 
 struct xyLocParent
 {
@@ -60,6 +61,7 @@ private:
 	bool Passable(int x, int y);
 	bool JumpPoint(int x, int y);
 	void SetJumpPoint(int x, int y);
+	void BuildJumpPoints(Map *m);
 	void ExtractPathToStartFromID(uint64_t node, std::vector<xyLoc> &thePath);
 	//AStarOpenClosed<xyLocParent, AStarCompare<xyLocParent> > openClosedList;
 	IndexOpenClosed<xyLocParent> openClosedList;
@@ -71,7 +73,10 @@ private:
 	uint32_t jumpLimit;
 	int w, h;
 	
+	// built from map; changes made to a map after it is searched aren't seen
+	Map *map;
 	std::vector<bool> jumpPoints;
+	PassabilityBitmap passable;
 };
 
 #endif /* JPS_h */
@@ -15,7 +15,7 @@
 #include "FPUtil.h"
 #include <deque>
 #include <vector>
-#include <ext/hash_map>
+#include "LearnedStateTable.h"
 #include "TemplateAStar.h"
 #include "Timer.h"
 #include "vectorCache.h"
@@ -462,8 +462,8 @@ namespace FLRTA {
 		void OpenGLDraw() const {}
 		void OpenGLDraw(const environment *env) const;
 	private:
-		typedef __gnu_cxx::hash_map<uint64_t, learnedStateData<state>, Hash64 > LearnedStateData;
-		typedef __gnu_cxx::hash_map<uint64_t, bool, Hash64 > ClosedList;
+		typedef LearnedStateTable<learnedStateData<state>> LearnedStateData;
+		typedef LearnedStateTable<bool> ClosedList;
 		void ExtractBestPath(environment *env, const state &from, const state &to, std::vector<state> &thePath);
 		void MakeTrappedMove(environment *env, const state &from, std::vector<state> &thePath);
 		
@@ -490,6 +490,7 @@ namespace FLRTA {
 	template <class state, class action, class environment>
 	void FLRTAStar<state, action, environment>::GetPath(environment *env, const state& from, const state& to, std::vector<state> &thePath)
 	{
+		stateData.UseDenseIndex(env->GetMaxHash());
 //		Timer t;
 //		t.StartTimer();
 //		VerifyParentChildren();
@@ -15,7 +15,7 @@
 #include "FPUtil.h"
 #include <deque>
 #include <vector>
-#include <ext/hash_map>
+#include "LearnedStateTable.h"
 
 namespace HLRTA{
 
@@ -104,7 +104,7 @@ public:
 	void OpenGLDraw() const {}
 	void OpenGLDraw(const environment *env) const;
 private:
-	typedef __gnu_cxx::hash_map<uint64_t, learnedData<state>, Hash64 > LearnedHeuristic;
+	typedef LearnedStateTable<learnedData<state>> LearnedHeuristic;
 
 	LearnedHeuristic heur;
 	state goal;
@@ -116,6 +116,7 @@ private:
 template <class state, class action, class environment>
 void HLRTAStar<state, action, environment>::GetPath(environment *env, const state& from, const state& to, std::vector<state> &thePath)
 {
+	heur.UseDenseIndex(env->GetMaxHash());
 	goal = to;
 	thePath.resize(0);
 	if (from==to)
@@ -12,6 +12,7 @@
 
 #include "SearchEnvironment.h"
 #include <ext/hash_map>
+#include "LearnedStateTable.h"
 #include "TemplateAStar.h"
 #include <iostream>
 #include <queue>
@@ -103,7 +104,7 @@ public:
 	}
 	
 private:
-	typedef __gnu_cxx::hash_map<uint64_t, stateData<state>, Hash64 > EnvironmentData;
+	typedef LearnedStateTable<stateData<state>> EnvironmentData;
 
 	double SumLearningRequired()
 	{
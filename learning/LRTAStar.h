@@ -14,7 +14,7 @@
 #include "FPUtil.h"
 #include <deque>
 #include <vector>
-#include <ext/hash_map>
+#include "LearnedStateTable.h"
 
 template <class state>
 struct learnedData {
@@ -62,7 +62,7 @@ public:
 	void OpenGLDraw() const {}
 	void OpenGLDraw(const environment *env) const;
 private:
-	typedef __gnu_cxx::hash_map<uint64_t, learnedData<state>, Hash64 > LearnedHeuristic;
+	typedef LearnedStateTable<learnedData<state>> LearnedHeuristic;
 
 	LearnedHeuristic heur;
 	state goal;
@@ -74,6 +74,7 @@ private:
 template <class state, class action, class environment>
 void LRTAStar<state, action, environment>::GetPath(environment *env, const state& from, const state& to, std::vector<state> &thePath)
 {
+	heur.UseDenseIndex(env->GetMaxHash());
 	goal = to;
 	thePath.resize(0);
 	if (from==to)
@@ -14,7 +14,7 @@
 #include "FPUtil.h"
 #include <deque>
 #include <vector>
-#include <ext/hash_map>
+#include "LearnedStateTable.h"
 #include "TemplateAStar.h"
 #include "Timer.h"
 #include <queue>
@@ -128,8 +128,8 @@ public:
 	void OpenGLDraw() const {}
 	void OpenGLDraw(const environment *env) const;
 private:
-	typedef __gnu_cxx::hash_map<uint64_t, lssLearnedData<state>, Hash64 > LearnedHeuristic;
-	typedef __gnu_cxx::hash_map<uint64_t, bool, Hash64 > ClosedList;
+	typedef LearnedStateTable<lssLearnedData<state>> LearnedHeuristic;
+	typedef LearnedStateTable<bool> ClosedList;
 	
 	environment *m_pEnv;
 	LearnedHeuristic heur;
@@ -150,6 +150,7 @@ private:
 template <class state, class action, class environment>
 void LSSLRTAStar<state, action, environment>::GetPath(environment *env, const state& from, const state& to, std::vector<state> &thePath)
 {
+	heur.UseDenseIndex(env->GetMaxHash());
 	// This code measures the size of the first heuristic minima that the agent passes over (not well)
 	if (initialHeuristic)
 	{
@@ -0,0 +1,290 @@
+//
+//  LearnedStateTable.h
+//  hog2
+//
+//  Table from state hash to the per-state data of the real-time learning
+//  algorithms (learned heuristics, dead states, local closed lists).
+//
+
+#ifndef LearnedStateTable_h
+#define LearnedStateTable_h
+
+#include <stdint.h>
+#include <new>
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <algorithm>
+
+/*
+ * LearnedStateTable
+ *
+ * Replaces the hash_maps that the LRTA* family used. It has the parts of
+ * the map interface that they use (find, operator[], iteration over
+ * pair<const uint64_t, data>, size, clear); entries can't be erased.
+ *
+ * Entries are stored in pages of 256 that are allocated as needed and never
+ * move, so references to them stay valid as the table grows (as with the
+ * node-based hash_map). By default each new entry takes the next free place
+ * and a chained index finds it: a bucket holds the address and place of its
+ * first entry, and the place of each entry the next one in its bucket. There
+ * are at least two buckets per entry, so a key is usually found (or found to
+ * be missing) with one bucket and at most one entry, as with the hash_map.
+ * Keys that differ only in their low 4 bits get buckets in the same run of
+ * 16, in an order that depends on the rest of the key; the runs come from the
+ * top bits of the rest of the key times 2^64/phi (Fibonacci hashing). Nearby
+ * keys (e.g. neighboring grid cells) then share cache lines of the index.
+ *
+ * UseDenseIndex(env->GetMaxHash()) instead puts the entry of hash value h at
+ * place h, so a lookup needs no index and states with nearby hash values
+ * (e.g. neighboring grid cells) share cache lines. Only the pages that hold
+ * entries are allocated. Keys at or above maxHash still use the index.
+ */
+template <typename data>
+class LearnedStateTable {
+public:
+	typedef std::pair<const uint64_t, data> value_type;
+
+	template <typename table, typename value>
+	class Iterator {
+	public:
+		Iterator(table *t, size_t i) :t(t), i(i), e((i == t->End())?0:&t->Entry(i)) {}
+		Iterator(table *t, size_t i, value *e) :t(t), i(i), e(e) {}
+		// iterator converts to const_iterator
+		template <typename t2, typename v2>
+		Iterator(const Iterator<t2, v2> &it) :t(it.t), i(it.i), e(it.e) {}
+		value &operator*() const { return *e; }
+		value *operator->() const { return e; }
+		Iterator &operator++() { *this = Iterator(t, t->Next(i+1)); return *this; }
+		Iterator operator++(int) { Iterator tmp(*this); ++*this; return tmp; }
+		bool operator==(const Iterator &it) const { return e == it.e; }
+		bool operator!=(const Iterator &it) const { return e != it.e; }
+	private:
+		template <typename t2, typename v2> friend class Iterator;
+		table *t;
+		size_t i;
+		value *e;
+	};
+	typedef Iterator<LearnedStateTable, value_type> iterator;
+	typedef Iterator<const LearnedStateTable, const value_type> const_iterator;
+
+	LearnedStateTable() :count(0), denseSize(0), nextPlace(0), bucketShift(64) {}
+	~LearnedStateTable() { clear(); }
+	LearnedStateTable(const LearnedStateTable &) = delete;
+	LearnedStateTable &operator=(const LearnedStateTable &) = delete;
+
+	/**
+	 * Place the entries of keys below maxHash by key. Only changes an empty
+	 * table (entries never move); does nothing if maxHash is 0 or too large.
+	 */
+	void UseDenseIndex(uint64_t maxHash);
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	/** Removes all entries; keeps the dense index */
+	void clear();
+
+	iterator begin() { return iterator(this, Next(0)); }
+	iterator end() { return iterator(this, End()); }
+	const_iterator begin() const { return const_iterator(this, Next(0)); }
+	const_iterator end() const { return const_iterator(this, End()); }
+
+	iterator find(uint64_t key)
+	{ uint32_t i; value_type *e = Lookup(key, i); return e?iterator(this, i, e):end(); }
+	const_iterator find(uint64_t key) const
+	{ uint32_t i; value_type *e = Lookup(key, i); return e?const_iterator(this, i, e):end(); }
+	/** Returns the data of key, adding a default constructed entry if needed */
+	data &operator[](uint64_t key);
+private:
+	static const uint32_t kEmpty = 0xFFFFFFFF;
+	static const int kPageBits = 8;
+	// keys that differ only in these bits share a run of buckets
+	static const int kRunBits = 4;
+	static const size_t kPageSize = 1<<kPageBits;
+	// largest dense index, in entries
+	static const uint64_t kMaxDense = 1ull<<26;
+	struct Page {
+		uint64_t used[kPageSize/64];
+		value_type *entries;
+	};
+	// the first entry of the bucket; the others are found through chain
+	struct Bucket {
+		value_type *entry;
+		uint32_t place;
+	};
+
+	value_type &Entry(size_t i) { return pages[i>>kPageBits].entries[i&(kPageSize-1)]; }
+	const value_type &Entry(size_t i) const { return pages[i>>kPageBits].entries[i&(kPageSize-1)]; }
+	bool Used(size_t i) const
+	{ return (pages[i>>kPageBits].used[(i&(kPageSize-1))>>6]>>(i&63))&1; }
+	size_t End() const { return pages.size()<<kPageBits; }
+	size_t Next(size_t i) const;
+	size_t BucketOf(uint64_t key) const
+	{ return (size_t)(((key>>kRunBits)*0x9E3779B97F4A7C15ull)>>bucketShift)^(key&((1<<kRunBits)-1)); }
+	value_type *Lookup(uint64_t key, uint32_t &place) const;
+	value_type *Add(uint64_t key, uint32_t place);
+	void AddToIndex(uint64_t key, uint32_t place);
+	void Link(uint64_t key, uint32_t place);
+
+	template <typename table, typename value> friend class Iterator;
+
+	std::vector<Page> pages; // entries is null for pages that aren't allocated
+	size_t count;
+	uint32_t denseSize; // a multiple of kPageSize
+	uint32_t nextPlace; // of the next key that isn't placed by key
+	std::vector<Bucket> buckets; // the size is a power of 2, at least 2^kRunBits
+	std::vector<uint32_t> chain; // the next place in the bucket of place denseSize+i
+	int bucketShift; // 64-log2(buckets.size())
+};
+
+template <typename data>
+const uint32_t LearnedStateTable<data>::kEmpty;
+template <typename data>
+const int LearnedStateTable<data>::kPageBits;
+template <typename data>
+const int LearnedStateTable<data>::kRunBits;
+template <typename data>
+const size_t LearnedStateTable<data>::kPageSize;
+template <typename data>
+const uint64_t LearnedStateTable<data>::kMaxDense;
+
+template <typename data>
+void LearnedStateTable<data>::UseDenseIndex(uint64_t maxHash)
+{
+	if (maxHash == 0 || maxHash > kMaxDense || count != 0)
+		return;
+	denseSize = (uint32_t)((maxHash+kPageSize-1)&~(uint64_t)(kPageSize-1));
+	nextPlace = denseSize;
+}
+
+template <typename data>
+void LearnedStateTable<data>::clear()
+{
+	for (auto &p : pages)
+	{
+		if (p.entries == 0)
+			continue;
+		for (size_t x = 0; x < kPageSize; x++)
+			if ((p.used[x>>6]>>(x&63))&1)
+				p.entries[x].~value_type();
+		::operator delete(p.entries);
+	}
+	pages.clear();
+	buckets.clear();
+	chain.clear();
+	count = 0;
+	nextPlace = denseSize;
+}
+
+// The first used place at or after i
+template <typename data>
+size_t LearnedStateTable<data>::Next(size_t i) const
+{
+	for (; i < End(); i++)
+	{
+		const Page &p = pages[i>>kPageBits];
+		if (p.entries == 0)
+			i |= kPageSize-1;
+		else if (p.used[(i&(kPageSize-1))>>6] == 0)
+			i |= 63;
+		else if (Used(i))
+			return i;
+	}
+	return End();
+}
+
+// Returns the entry of key (and sets place) or null. This is most of the
+// work of find and operator[], so it is inline.
+template <typename data>
+inline typename LearnedStateTable<data>::value_type *LearnedStateTable<data>::Lookup(uint64_t key, uint32_t &place) const
+{
+	if (key < denseSize)
+	{
+		if ((key>>kPageBits) >= pages.size())
+			return 0;
+		const Page &p = pages[key>>kPageBits];
+		if (p.entries == 0 || ((p.used[(key&(kPageSize-1))>>6]>>(key&63))&1) == 0)
+			return 0;
+		place = (uint32_t)key;
+		return &p.entries[key&(kPageSize-1)];
+	}
+	if (buckets.size() == 0)
+		return 0;
+	const Bucket &b = buckets[BucketOf(key)];
+	if (b.entry == 0)
+		return 0;
+	if (b.entry->first == key)
+	{
+		place = b.place;
+		return b.entry;
+	}
+	for (uint32_t i = chain[b.place-denseSize]; i != kEmpty; i = chain[i-denseSize])
+	{
+		value_type *e = &pages[i>>kPageBits].entries[i&(kPageSize-1)];
+		if (e->first == key)
+		{
+			place = i;
+			return e;
+		}
+	}
+	return 0;
+}
+
+// Constructs the entry of key at place
+template <typename data>
+typename LearnedStateTable<data>::value_type *LearnedStateTable<data>::Add(uint64_t key, uint32_t place)
+{
+	size_t page = place>>kPageBits;
+	if (page >= pages.size())
+		pages.resize(page+1, Page());
+	Page &p = pages[page];
+	if (p.entries == 0)
+		p.entries = static_cast<value_type *>(::operator new(sizeof(value_type)*kPageSize));
+	p.used[(place&(kPageSize-1))>>6] |= 1ull<<(place&63);
+	count++;
+	// construct in place; some of the data types can't be copied safely
+	return new (&p.entries[place&(kPageSize-1)]) value_type(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple());
+}
+
+template <typename data>
+void LearnedStateTable<data>::AddToIndex(uint64_t key, uint32_t place)
+{
+	chain.push_back(kEmpty);
+	// keep at least two buckets per entry
+	if (2*chain.size() > buckets.size())
+	{
+		buckets.assign(std::max(buckets.size()*2, (size_t)64), Bucket{0, kEmpty});
+		bucketShift = 64;
+		for (size_t n = buckets.size(); n > 1; n >>= 1)
+			bucketShift--;
+		for (uint32_t i = denseSize; i < place; i++)
+			Link(Entry(i).first, i);
+	}
+	Link(key, place);
+}
+
+// Adds place to the front of the chain of key's bucket
+template <typename data>
+void LearnedStateTable<data>::Link(uint64_t key, uint32_t place)
+{
+	Bucket &b = buckets[BucketOf(key)];
+	chain[place-denseSize] = b.place;
+	b.entry = &Entry(place);
+	b.place = place;
+}
+
+template <typename data>
+data &LearnedStateTable<data>::operator[](uint64_t key)
+{
+	uint32_t i;
+	value_type *e = Lookup(key, i);
+	if (e)
+		return e->second;
+	if (key < denseSize)
+		return Add(key, (uint32_t)key)->second;
+	i = nextPlace++;
+	e = Add(key, i);
+	AddToIndex(key, i);
+	return e->second;
+}
+
+#endif /* LearnedStateTable_h */
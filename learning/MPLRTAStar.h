@@ -14,7 +14,7 @@
 #include <deque>
 #include <vector>
 //#include <ext/hash_map>
-#include <unordered_map>
+#include "LearnedStateTable.h"
 #include "Map2DEnvironment.h"
 
 namespace MPLRTA {
@@ -74,7 +74,7 @@ namespace MPLRTA {
 		void OpenGLDraw() const {}
 		void OpenGLDraw(const MapEnvironment *env) const;
 	private:
-		typedef std::unordered_map<uint64_t, learnedData, Hash64 > LearnedHeuristic;
+		typedef LearnedStateTable<learnedData> LearnedHeuristic;
 		
 		LearnedHeuristic heur;
 		xyLoc goal, startState;
@@ -86,6 +86,7 @@ namespace MPLRTA {
 	/** The core routine of MPLRTAStar -- computes at most one-move path */
 	void MPLRTAStar::GetPath(MapEnvironment *env, const xyLoc& from, const xyLoc& to, std::vector<xyLoc> &thePath)
 	{
+		heur.UseDenseIndex(env->GetMaxHash());
 		if (setStart == false)
 		{
 			setStart = true;
@@ -13,7 +13,7 @@
 #include "FPUtil.h"
 #include <deque>
 #include <vector>
-#include <ext/hash_map>
+#include "LearnedStateTable.h"
 #include "TemplateAStar.h"
 #include "Timer.h"
 #include <queue>
@@ -160,8 +160,8 @@ public:
 	void OpenGLDraw() const {}
 	void OpenGLDraw(const environment *env) const;
 private:
-	typedef __gnu_cxx::hash_map<uint64_t, glssLearnedData<state>, Hash64 > LearnedHeuristic;
-	typedef __gnu_cxx::hash_map<uint64_t, bool, Hash64 > ClosedList;
+	typedef LearnedStateTable<glssLearnedData<state>> LearnedHeuristic;
+	typedef LearnedStateTable<bool> ClosedList;
 	
 	environment *m_pEnv;
 	LearnedHeuristic heur;
@@ -182,6 +182,7 @@ private:
 template <class state, class action, class environment>
 void gLSSLRTAStar<state, action, environment>::GetPath(environment *env, const state& from, const state& to, std::vector<state> &thePath)
 {
+	heur.UseDenseIndex(env->GetMaxHash());
 	m_pEnv = env;
 
 	// only run the first time
@@ -589,7 +589,7 @@ class ConstrainedEnvironment : public SearchEnvironment<State, Action> {
       //while((*s)->end_state.t>=from.t && s!=constraints.begin())--s; // Reverse to the constraint just before
       //auto e(constraints.upper_bound((Constraint<State> const*)&end));
       //while(e!=constraints.end() && (*e)->start_state.t<=to.t)++e;
-      static typename IntervalTree<Constraint<State>>::Intervals cs;
+      static thread_local typename IntervalTree<Constraint<State>>::Intervals cs;
       cs.resize(0);
       Identical<State> tmp(from,to);
       constraints.findOverlapping((Constraint<State>*)&tmp,cs);
@@ -615,7 +615,7 @@ class ConstrainedEnvironment : public SearchEnvironment<State, Action> {
       }
       //Check if the action violates any of the constraints that are in the constraints list
       if(constraints.empty())return 0;
-      static typename IntervalTree<Constraint<State>>::Intervals cs;
+      static thread_local typename IntervalTree<Constraint<State>>::Intervals cs;
       cs.resize(0);
       Identical<State> tmp(from,to);
       constraints.findOverlapping((Constraint<State>*)&tmp,cs);
@@ -630,7 +630,7 @@ class ConstrainedEnvironment : public SearchEnvironment<State, Action> {
     virtual inline void WaitTimes(const State& from, const State &to, std::set<float>& times) const {
       //Get wait times for this state
       if(constraints.empty() || from.sameLoc(to))return;
-      static typename IntervalTree<Constraint<State>>::Intervals cs;
+      static thread_local typename IntervalTree<Constraint<State>>::Intervals cs;
       cs.resize(0);
       Identical<State> tmp(to,to);
       constraints.findOverlapping((Constraint<State>*)&tmp,cs);
@@ -646,6 +646,7 @@ class ConstrainedEnvironment : public SearchEnvironment<State, Action> {
     virtual void GLDrawLine(const State &x, const State &y) const{}
     virtual void OpenGLDraw() const{}
     virtual void OpenGLDraw(const State &l1) const{}
+    virtual void OpenGLDraw(const State &l1, const State &l2, float pct) const{}
     virtual void OpenGLDraw(const State &l1, const State &l2, float pct, float r) const{}
     virtual void GLDrawPath(const std::vector<State> &p, const std::vector<State> &waypoints) const{
       if(p.size()<2) return;
@@ -10,6 +10,7 @@
 #define hog2_glut_Heuristic_h
 
 #include <vector>
+#include <stdint.h>
 
 enum HeuristicTreeNodeType {
 	kMaxNode,
@@ -41,6 +42,22 @@ public:
 	double HCost(const state &a, const state &b) const { return 0; }
 };
 
+/**
+ * A heuristic that can be updated along an edge instead of recomputed from
+ * scratch. The per-state data it needs (e.g. PDB ranks) is kept by the
+ * search in an array of GetCacheSize() values per depth. Both lookups are
+ * relative to the heuristic's own goal.
+ */
+template <class state, class action>
+class IncrementalHeuristic : public Heuristic<state> {
+public:
+	virtual int GetCacheSize() const = 0;
+	// Computes h(s) from scratch and fills cache
+	virtual double InitialHCost(const state &s, uint64_t *cache) const = 0;
+	// s is the state reached by applying a to the state whose data is in parentCache
+	virtual double IncrementalHCost(const state &s, const action &a, const uint64_t *parentCache, uint64_t *cache) const = 0;
+};
+
 template <class state>
 double Heuristic<state>::HCost(const state &s1, const state &s2) const
 {
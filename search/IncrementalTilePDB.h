@@ -0,0 +1,196 @@
+//
+//  IncrementalTilePDB.h
+//  hog2
+//
+//  Sliding-tile PDB lookups that update the PDB ranks after each move
+//  instead of recomputing them.
+//
+
+#ifndef INCREMENTALTILEPDB_H
+#define INCREMENTALTILEPDB_H
+
+#include <array>
+#include "Heuristic.h"
+#include "PermutationPDB.h"
+#include "FixedMNPuzzle.h"
+
+/**
+ * Combines (max or sum) a set of PermutationPDBs for FixedMNPuzzle states.
+ *
+ * A PermutationPDB rank is the lexicographic rank of the locations of the
+ * pattern tiles. A move swaps the blank with one tile, which only changes the
+ * terms of the rank for the moved items and for the pattern tiles located
+ * between the two squares (at most width-1 of them). So a child's rank is
+ * computed from its parent's in O(width) instead of O(k^2), and PDBs that
+ * contain neither the moved tile nor the blank keep the parent's rank. With
+ * disjoint additive patterns that don't include the blank, a move updates
+ * exactly one PDB.
+ *
+ * The PDBs can be built or loaded as usual with MNPuzzle states; the ranks
+ * are identical.
+ */
+template <int width, int height>
+class IncrementalTilePDB : public IncrementalHeuristic<FixedMNPuzzleState<width, height>, slideDir> {
+public:
+	typedef FixedMNPuzzleState<width, height> puzzleState;
+	typedef PermutationPDB<MNPuzzleState, slideDir, MNPuzzle> tilePDB;
+	IncrementalTilePDB() :additive(false) {}
+	// additive PDBs are summed; otherwise the max is used
+	void SetAdditive(bool sum) { additive = sum; }
+	void AddPDB(tilePDB *pdb);
+
+	int GetCacheSize() const { return (int)pdbs.size(); }
+	double InitialHCost(const puzzleState &s, uint64_t *cache) const;
+	double IncrementalHCost(const puzzleState &s, const slideDir &a, const uint64_t *parentCache, uint64_t *cache) const;
+	double HCost(const puzzleState &s, const puzzleState &) const;
+
+	uint64_t GetRank(const puzzleState &s, int which) const;
+	// ranks of s given the ranks of its parent (before applying a)
+	void UpdateRanks(const puzzleState &s, slideDir a, const uint64_t *parentRanks, uint64_t *ranks) const;
+private:
+	static const int numTiles = width*height;
+	struct patternInfo {
+		tilePDB *pdb;
+		std::array<int8_t, width*height> index; // index of each tile in the pattern, or -1
+		std::array<int64_t, width*height> weight; // weight of each pattern index in the rank
+		int size;
+	};
+	double Combine(const uint64_t *cache) const;
+	std::vector<patternInfo> pdbs;
+	bool additive;
+};
+
+template <int width, int height>
+void IncrementalTilePDB<width, height>::AddPDB(tilePDB *pdb)
+{
+	const std::vector<int> &pattern = pdb->GetPattern();
+	patternInfo info;
+	info.pdb = pdb;
+	info.size = (int)pattern.size();
+	info.index.fill(-1);
+	info.weight.fill(0);
+	for (int x = 0; x < info.size; x++)
+	{
+		info.index[pattern[x]] = x;
+		// (numTiles-1-x)!/(numTiles-size)!, as in PermutationPDB::GetPDBHash
+		int64_t w = 1;
+		for (int y = numTiles-1-x; y > numTiles-info.size; y--)
+			w *= y;
+		info.weight[x] = w;
+	}
+	pdbs.push_back(info);
+}
+
+template <int width, int height>
+uint64_t IncrementalTilePDB<width, height>::GetRank(const puzzleState &s, int which) const
+{
+	const patternInfo &p = pdbs[which];
+	std::array<int, width*height> locs;
+	for (int x = 0; x < numTiles; x++)
+	{
+		int i = p.index[s.puzzle[x]];
+		if (i >= 0)
+			locs[i] = x;
+	}
+	uint64_t rank = 0;
+	for (int x = 0; x < p.size; x++)
+	{
+		rank += locs[x]*p.weight[x];
+		for (int y = x+1; y < p.size; y++)
+		{
+			if (locs[y] > locs[x])
+				locs[y]--;
+		}
+	}
+	return rank;
+}
+
+template <int width, int height>
+double IncrementalTilePDB<width, height>::Combine(const uint64_t *cache) const
+{
+	double h = 0;
+	for (size_t x = 0; x < pdbs.size(); x++)
+	{
+		double val = pdbs[x].pdb->GetHCostFromHash(cache[x]);
+		h = additive?(h+val):std::max(h, val);
+	}
+	return h;
+}
+
+template <int width, int height>
+double IncrementalTilePDB<width, height>::InitialHCost(const puzzleState &s, uint64_t *cache) const
+{
+	for (size_t x = 0; x < pdbs.size(); x++)
+		cache[x] = GetRank(s, (int)x);
+	return Combine(cache);
+}
+
+template <int width, int height>
+double IncrementalTilePDB<width, height>::HCost(const puzzleState &s, const puzzleState &) const
+{
+	std::array<uint64_t, 64> cache;
+	assert(pdbs.size() <= cache.size());
+	return InitialHCost(s, &cache[0]);
+}
+
+/*
+ * The tile moved from `from` (the new blank location) to `to` (the old one),
+ * and the blank the other way. For pattern item i at location l, the rank term
+ * is weight[i]*(l - #{j<i : locs[j] < l}). Only the moved items and the
+ * items located strictly between from and to change.
+ */
+template <int width, int height>
+void IncrementalTilePDB<width, height>::UpdateRanks(const puzzleState &s, slideDir a,
+													const uint64_t *parentRanks, uint64_t *ranks) const
+{
+	int from = s.blank;
+	int to = from-FixedMNPuzzle<width, height>::GetBlankOffset(a);
+	int tile = s.puzzle[to];
+	int lo = std::min(from, to), hi = std::max(from, to);
+	int dir = (to > from)?1:-1;
+	for (size_t x = 0; x < pdbs.size(); x++)
+	{
+		const patternInfo &pi = pdbs[x];
+		int p = pi.index[tile];
+		int q = pi.index[0];
+		if (p < 0 && q < 0)
+		{
+			ranks[x] = parentRanks[x];
+			continue;
+		}
+		int64_t delta = 0;
+		int belowP = 0, belowQ = 0;
+		for (int l = lo+1; l < hi; l++)
+		{
+			int j = pi.index[s.puzzle[l]];
+			if (j < 0)
+				continue;
+			// j changes order with the tile and the blank in opposite ways
+			if (p >= 0)
+			{
+				if (j < p) belowP++;
+				else delta += dir*pi.weight[j];
+			}
+			if (q >= 0)
+			{
+				if (j < q) belowQ++;
+				else delta -= dir*pi.weight[j];
+			}
+		}
+		if (p >= 0)
+			delta += pi.weight[p]*((to-from)-dir*(belowP+((q >= 0 && q < p)?1:0)));
+		if (q >= 0)
+			delta += pi.weight[q]*((from-to)+dir*(belowQ+((p >= 0 && p < q)?1:0)));
+		ranks[x] = parentRanks[x]+delta;
+	}
+}
+
+template <int width, int height>
+double IncrementalTilePDB<width, height>::IncrementalHCost(const puzzleState &s, const slideDir &a,
+														   const uint64_t *parentCache, uint64_t *cache) const
+{
+	UpdateRanks(s, a, parentCache, cache);
+	return Combine(cache);
+}
+
+#endif
@@ -10,6 +10,7 @@
 #define MR1PermutationPDB_h
 
 #include "PDBHeuristic.h"
+#include "MR1Permutation.h"
 
 /**
  * This class uses the first of two Myrvold-Russkey ranking functions
@@ -33,29 +34,57 @@ public:
 	virtual void GetStateFromPDBHash(uint64_t hash, state &s, int threadID = 0) const;
 	virtual uint64_t GetAbstractHash(const state &s, int threadID = 0) const { return GetPDBHash(s); }
 	virtual state GetStateFromAbstractState(state &s) const { return s; }
+	// Batched versions for the build, using MR1KPermutation::RankBatch/UnrankBatch
+	virtual void GetPDBHashes(const state *s, uint64_t *hashes, int count, int threadID = 0) const;
+	virtual void GetStatesFromPDBHashes(const uint64_t *hashes, state *s, int count, int threadID = 0) const;
 
 	bool Load(FILE *f);
 	void Save(FILE *f);
 	bool Load(const char *prefix);
 	void Save(const char *prefix);
 	std::string GetFileName(const char *prefix);
+	const char *GetRankingScheme() const { return "MR1"; }
 private:
 	std::vector<int> distinct;
 	size_t puzzleSize;
 	uint64_t pdbSize;
 	
+	void SetNumBuildThreads(int numThreads)
+	{
+		if (numThreads > (int)dualCache.size())
+		{
+			dualCache.resize(numThreads);
+			locsCache.resize(numThreads);
+			valueStack.resize(numThreads);
+			batchItems.resize(numThreads);
+			batchDuals.resize(numThreads);
+		}
+	}
+
 	// cache for computing ranking/unranking
 	mutable std::vector<std::vector<int> > dualCache;
 	mutable std::vector<std::vector<int> > locsCache;
 	mutable std::vector<std::vector<int> > valueStack;
+	mutable std::vector<std::vector<int> > batchItems;
+	mutable std::vector<std::vector<int> > batchDuals;
 
+	// the index of each item in distinct, or -1
+	std::vector<int> distinctIndex;
+	MR1KPermutation mr1;
+	static const int batchStates = 64;
 	state example;
 };
 
+template <class state, class action, class environment>
+const int MR1PermutationPDB<state, action, environment>::batchStates;
+
 template <class state, class action, class environment>
 MR1PermutationPDB<state, action, environment>::MR1PermutationPDB(environment *e, const state &s, std::vector<int> distincts)
-:PDBHeuristic<state, action, environment>(e), distinct(distincts), puzzleSize(s.puzzle.size()), dualCache(maxThreads), locsCache(maxThreads), valueStack(maxThreads), example(s)
+:PDBHeuristic<state, action, environment>(e), distinct(distincts), puzzleSize(s.puzzle.size()), dualCache(maxThreads), locsCache(maxThreads), valueStack(maxThreads),
+batchItems(maxThreads), batchDuals(maxThreads), distinctIndex(s.puzzle.size(), -1), example(s)
 {
+	for (int x = 0; x < distinct.size(); x++)
+		distinctIndex[distinct[x]] = x;
 	pdbSize = 1;
 	for (int x = (int)example.puzzle.size(); x > example.puzzle.size()-distincts.size(); x--)
 	{
@@ -156,6 +185,75 @@ void MR1PermutationPDB<state, action, environment>::GetStateFromPDBHash(uint64_t
 	s.FinishUnranking(example);
 }
 
+/*
+ * MR1KPermutation ranks items 0..k-1 from the front of the permutation, and
+ * GetPDBHash ranks the distinct items from the back. Reversing both the
+ * locations and the item order maps one onto the other, with every digit of
+ * the mixed-radix rank complemented, so the rank is pdbSize-1 minus the
+ * MR1KPermutation rank.
+ */
+template <class state, class action, class environment>
+void MR1PermutationPDB<state, action, environment>::GetPDBHashes(const state *s, uint64_t *hashes, int count, int threadID) const
+{
+	int puzzleSize = (int)example.puzzle.size();
+	int k = (int)distinct.size();
+	std::vector<int> &items = batchItems[threadID];
+	std::vector<int> &duals = batchDuals[threadID];
+	items.resize(puzzleSize*batchStates);
+	duals.resize(puzzleSize*batchStates);
+	uint64_t ranks[batchStates];
+	for (int base = 0; base < count; base += batchStates)
+	{
+		int num = std::min(batchStates, count-base);
+		memset(&items[0], 0xFF, num*puzzleSize*sizeof(items[0]));
+		for (int b = 0; b < num; b++)
+		{
+			int *item = &items[b*puzzleSize];
+			int *dual = &duals[b*puzzleSize];
+			for (int x = 0; x < puzzleSize; x++)
+			{
+				int tile = s[base+b].puzzle[x];
+				if (tile != -1 && distinctIndex[tile] != -1)
+				{
+					item[puzzleSize-1-x] = k-1-distinctIndex[tile];
+					dual[k-1-distinctIndex[tile]] = puzzleSize-1-x;
+				}
+			}
+		}
+		mr1.RankBatch(&items[0], &duals[0], k, puzzleSize, num, ranks);
+		for (int b = 0; b < num; b++)
+			hashes[base+b] = pdbSize-1-ranks[b];
+	}
+}
+
+template <class state, class action, class environment>
+void MR1PermutationPDB<state, action, environment>::GetStatesFromPDBHashes(const uint64_t *hashes, state *s, int count, int threadID) const
+{
+	int puzzleSize = (int)example.puzzle.size();
+	int k = (int)distinct.size();
+	std::vector<int> &items = batchItems[threadID];
+	std::vector<int> &duals = batchDuals[threadID];
+	items.resize(puzzleSize*batchStates);
+	duals.resize(puzzleSize*batchStates);
+	uint64_t ranks[batchStates];
+	for (int base = 0; base < count; base += batchStates)
+	{
+		int num = std::min(batchStates, count-base);
+		for (int b = 0; b < num; b++)
+			ranks[b] = pdbSize-1-hashes[base+b];
+		mr1.UnrankBatch(ranks, &items[0], &duals[0], k, puzzleSize, num);
+		for (int b = 0; b < num; b++)
+		{
+			state &next = s[base+b];
+			const int *item = &items[b*puzzleSize];
+			next.puzzle.resize(puzzleSize);
+			for (int x = 0; x < puzzleSize; x++)
+				next.puzzle[puzzleSize-1-x] = (item[x] == -1)?-1:distinct[k-1-item[x]];
+			next.FinishUnranking(example);
+		}
+	}
+}
+
 template <class state, class action, class environment>
 std::string MR1PermutationPDB<state, action, environment>::GetFileName(const char *prefix)
 {
@@ -187,30 +285,53 @@ std::string MR1PermutationPDB<state, action, environment>::GetFileName(const cha
 template <class state, class action, class environment>
 bool MR1PermutationPDB<state, action, environment>::Load(const char *prefix)
 {
-	assert(false);
-	return false;
+	FILE *f = fopen(GetFileName(prefix).c_str(), "rb");
+	if (f == 0)
+	{
+		perror("Opening MR1PermutationPDB file");
+		return false;
+	}
+	bool result = Load(f);
+	fclose(f);
+	return result;
 }
 
 template <class state, class action, class environment>
 void MR1PermutationPDB<state, action, environment>::Save(const char *prefix)
 {
-	assert(false);
-	FILE *f = fopen(GetFileName(prefix).c_str(), "w+");
-	PDBHeuristic<state, action, environment>::PDB.Write(f);
+	FILE *f = fopen(GetFileName(prefix).c_str(), "w+b");
+	if (f == 0)
+	{
+		perror("Opening MR1PermutationPDB file");
+		return;
+	}
+	Save(f);
 	fclose(f);
 }
 
 template <class state, class action, class environment>
 bool MR1PermutationPDB<state, action, environment>::Load(FILE *f)
 {
-	assert(false);
-	return false;
+	if (!PDBHeuristic<state, action, environment>::Load(f))
+		return false;
+	// the pattern follows the PDB, and must be the one this PDB was made for
+	size_t numDistinct;
+	if (fread(&numDistinct, sizeof(numDistinct), 1, f) != 1 || numDistinct != distinct.size())
+		return false;
+	std::vector<int> pattern(numDistinct);
+	if (numDistinct > 0 && fread(pattern.data(), sizeof(pattern[0]), numDistinct, f) != numDistinct)
+		return false;
+	return pattern == distinct;
 }
 
 template <class state, class action, class environment>
 void MR1PermutationPDB<state, action, environment>::Save(FILE *f)
 {
-	assert(false);
+	PDBHeuristic<state, action, environment>::Save(f);
+	size_t numDistinct = distinct.size();
+	fwrite(&numDistinct, sizeof(numDistinct), 1, f);
+	if (numDistinct > 0)
+		fwrite(distinct.data(), sizeof(distinct[0]), numDistinct, f);
 }
 
 #endif /* MR1PermutationPDB_h */
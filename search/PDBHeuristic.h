@@ -10,13 +10,19 @@
 #define hog2_glut_PDBHeuristic_h
 
 #include <cassert>
-#include <thread>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+#include <atomic>
+#include <type_traits>
+#include <mutex>
 #include <string>
 #include "Heuristic.h"
-#include "SharedQueue.h"
+#include "WorkerPool.h"
 #include "NBitArray.h"
 #include "Timer.h"
 #include "RangeCompression.h"
+#include "DiskBitFile.h"
 
 enum PDBLookupType {
 	kPlain,
@@ -29,13 +35,63 @@ enum PDBLookupType {
 	kDefaultHeuristic
 };
 
+/**
+ * On-disk header written in front of every PDB. The entries follow at
+ * dataOffset (8-byte aligned), so they can be mapped directly into memory
+ * instead of being read. Files without the magic string are in the older
+ * format (lookup type, raw goal, NBitArray) and are still readable.
+ */
+struct PDBFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t lookupType;
+	uint32_t entryBits;
+	uint32_t goalBytes; // raw goal state follows the header (0 if not stored)
+	char rankingScheme[16];
+	uint64_t compressionValue;
+	uint64_t goalRank;
+	uint64_t entries;
+	uint64_t dataOffset;
+	uint64_t dataBytes;
+	uint64_t checksum;
+};
+const char pdbFileMagic[8] = "HOG2PDB";
+const uint32_t pdbFileVersion = 1;
+
 const int coarseSize = 1024;
-const int maxThreads = 32; // TODO: This isn't enforced in a static assert
+// per-thread ranking caches made when a PDB is constructed; builds with more
+// threads add caches through SetNumBuildThreads
+const int maxThreads = 32;
+
+/**
+ * One bit per coarse region of the PDB, which can be set concurrently by all
+ * build threads without locking.
+ */
+class AtomicCoarseBitmap {
+public:
+	AtomicCoarseBitmap(uint64_t numRegions) :bits((numRegions+63)/64)
+	{ for (auto &w : bits) w.store(0, std::memory_order_relaxed); }
+	void Set(uint64_t region)
+	{
+		uint64_t mask = 1ull<<(region&0x3F);
+		// avoid the (contended) write if the bit is already set
+		if ((bits[region>>6].load(std::memory_order_relaxed)&mask) == 0)
+			bits[region>>6].fetch_or(mask, std::memory_order_relaxed);
+	}
+	bool Get(uint64_t region) const
+	{ return (bits[region>>6].load(std::memory_order_relaxed)>>(region&0x3F))&1; }
+	uint64_t NumWords() const { return bits.size(); }
+	uint64_t GetWord(uint64_t word) const { return bits[word].load(std::memory_order_relaxed); }
+	uint64_t ExchangeWord(uint64_t word, uint64_t value) { return bits[word].exchange(value, std::memory_order_relaxed); }
+	void Swap(AtomicCoarseBitmap &other) { bits.swap(other.bits); }
+private:
+	std::vector<std::atomic<uint64_t>> bits;
+};
 
 template <class abstractState, class abstractAction, class abstractEnvironment, class state = abstractState, uint64_t pdbBits = 8>
 class PDBHeuristic : public Heuristic<state> {
 public:
-	PDBHeuristic(abstractEnvironment *e) :type(kPlain), env(e)
+	PDBHeuristic(abstractEnvironment *e) :type(kPlain), compressionValue(1), env(e), mapOnLoad(true), verifyOnLoad(false)
 	{ goalSet = false; }
 	virtual ~PDBHeuristic() {}
 
@@ -43,6 +99,8 @@ public:
 	{	GetStateFromPDBHash(this->GetAbstractHash(goal), goalState); goalSet = true; }
 
 	virtual double HCost(const state &a, const state &b) const;
+	// Looks up the (compressed) entry for the given abstract hash
+	inline double GetHCostFromHash(uint64_t hash) const;
 
 	virtual uint64_t GetPDBSize() const = 0;
 
@@ -50,18 +108,40 @@ public:
 	virtual uint64_t GetAbstractHash(const state &s, int threadID = 0) const = 0;
 	virtual void GetStateFromPDBHash(uint64_t hash, abstractState &s, int threadID = 0) const = 0;
 	virtual state GetStateFromAbstractState(abstractState &s) const = 0;
+	// Batched ranking and unranking used by the build; override when a
+	// ranking function can process several states faster than one at a time
+	virtual void GetPDBHashes(const abstractState *s, uint64_t *hashes, int count, int threadID = 0) const
+	{ for (int x = 0; x < count; x++) hashes[x] = GetPDBHash(s[x], threadID); }
+	virtual void GetStatesFromPDBHashes(const uint64_t *hashes, abstractState *s, int count, int threadID = 0) const
+	{ for (int x = 0; x < count; x++) GetStateFromPDBHash(hashes[x], s[x], threadID); }
 
 	virtual bool Load(const char *prefix) = 0;
 	virtual void Save(const char *prefix) = 0;
 	virtual bool Load(FILE *f);
 	virtual void Save(FILE *f);
 	virtual std::string GetFileName(const char *prefix) = 0;
+	// Identifies the ranking function; a PDB is only loaded by the scheme that built it
+	virtual const char *GetRankingScheme() const { return "default"; }
+	// By default Load() maps the entries from the file (fast start, shared
+	// between processes); otherwise they are read into memory. The checksum
+	// is always checked when reading, but only on request when mapping,
+	// since that touches every page.
+	void SetLoadOptions(bool mapFile, bool verifyChecksum)
+	{ mapOnLoad = mapFile; verifyOnLoad = verifyChecksum; }
 	
 	void BuildPDB(const state &goal, int numThreads)
 	{ BuildPDBForwardBackward(goal, numThreads); }
 	void BuildPDBForward(const state &goal, int numThreads);
 	void BuildPDBBackward(const state &goal, int numThreads);
 	void BuildPDBForwardBackward(const state &goal, int numThreads);
+	// Builds a unit-cost PDB with the depths on disk instead of in memory.
+	// The buckets are striped across the prefixes (e.g. one per disk). At most
+	// maxOpenBuckets files of children are written at once; with more buckets
+	// each layer is expanded in several passes.
+	bool BuildPDBExternal(const state &goal, const std::vector<std::string> &prefixes,
+						  uint64_t bucketEntries, int numThreads, uint64_t maxOpenBuckets = 256);
+	// Reads the result of BuildPDBExternal, div compressing it by factor
+	bool LoadExternalPDB(const std::vector<std::string> &prefixes, uint64_t bucketEntries, uint64_t factor = 1);
 
 	void BuildAdditivePDB(state &goal, const char *pdb_filename, int numThreads);
 
@@ -87,45 +167,68 @@ protected:
 
 	abstractEnvironment *env;
 	abstractState goalState;
+	// Called before the build threads start; classes that keep per-thread
+	// caches indexed by threadID must have at least numThreads of them
+	virtual void SetNumBuildThreads(int numThreads) {}
 private:
 	bool goalSet;
-	void ForwardThreadWorker(int threadNum, int depth,
-							 NBitArray<pdbBits> &DB,
-							 std::vector<bool> &coarse,
-							 SharedQueue<std::pair<uint64_t, uint64_t> > *work,
-							 SharedQueue<uint64_t> *results,
-							 std::mutex *lock);
-	void BackwardThreadWorker(int threadNum, int depth,
-							  NBitArray<pdbBits> &DB,
-							  std::vector<bool> &coarse,
-							  SharedQueue<std::pair<uint64_t, uint64_t> > *work,
-							  SharedQueue<uint64_t> *results,
-							  std::mutex *lock);
-	void ForwardBackwardThreadWorker(int threadNum, int depth, bool forward,
-									 NBitArray<pdbBits> &DB,
-									 std::vector<bool> &coarseOpen,
-									 std::vector<bool> &coarseClosed,
-									 SharedQueue<std::pair<uint64_t, uint64_t> > *work,
-									 SharedQueue<uint64_t> *results,
-									 std::mutex *lock);
+	bool mapOnLoad, verifyOnLoad;
+	bool LoadLegacy(FILE *f);
+	bool WriteIfLess(uint64_t rank, int newGCost, std::mutex *lock);
+	struct buildBatch {
+		std::vector<uint64_t> parentRanks;
+		std::vector<abstractState> parents;
+		std::vector<abstractState> children;
+		std::vector<uint64_t> childRanks;
+		std::vector<int> childCosts;
+		std::vector<size_t> firstChild; // children of parent p are [firstChild[p], firstChild[p+1])
+		std::vector<abstractAction> acts;
+	};
+	static const int buildBatchSize = 64;
+	void ExpandBatch(buildBatch &batch, int depth, int threadNum);
+	static const uint64_t externalChunkEntries = 1ull<<24;
+	static const uint32_t externalBufferEntries = 1024;
+	static int GetExternalDepth(const std::vector<uint8_t> &data, uint64_t offset)
+	{ return (data[offset>>1]>>(4*(offset&1)))&0xF; }
+	static void SetExternalDepth(std::vector<uint8_t> &data, uint64_t offset, int value)
+	{ data[offset>>1] = (data[offset>>1]&~(0xF<<(4*(offset&1))))|(value<<(4*(offset&1))); }
+	void ReadExternalBucket(std::vector<DiskBitFile *> &files, uint64_t bucket, uint64_t entries, std::vector<uint8_t> &data);
+	void WriteExternalBucket(std::vector<DiskBitFile *> &files, uint64_t bucket, uint64_t entries, const std::vector<uint8_t> &data);
+	std::string GetExternalRankFile(const std::vector<std::string> &prefixes, uint64_t bucket) const;
+	uint64_t ForwardLayer(int threadNum, int depth,
+						  WorkStealingRange &work,
+						  AtomicCoarseBitmap &open,
+						  AtomicCoarseBitmap &nextOpen,
+						  AtomicCoarseBitmap *closed,
+						  std::mutex *lock);
+	uint64_t BackwardLayer(int threadNum, int depth,
+						   WorkStealingRange &work,
+						   AtomicCoarseBitmap &closed,
+						   std::mutex *lock);
 };
 
 template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
 double PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::HCost(const state &a, const state &b) const
+{
+	return GetHCostFromHash(GetAbstractHash(a));
+}
+
+template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
+double PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::GetHCostFromHash(uint64_t hash) const
 {
 	switch (type)
 	{
 		case kPlain:
 		{
-			return PDB.Get(GetAbstractHash(a)); //PDB[GetPDBHash(a)];
+			return PDB.Get(hash); //PDB[GetPDBHash(a)];
 		}
 		case kDivCompress:
 		{
-			return PDB.Get(GetAbstractHash(a)/compressionValue);
+			return PDB.Get(hash/compressionValue);
 		}
 		case kModCompress:
 		{
-			return PDB.Get(GetAbstractHash(a)%compressionValue);
+			return PDB.Get(hash%compressionValue);
 		}
 
 		default:
@@ -137,8 +240,6 @@ template <class abstractState, class abstractAction, class abstractEnvironment,
 void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::BuildPDBForward(const state &goal, int numThreads)
 {
 	assert(goalSet);
-	SharedQueue<std::pair<uint64_t, uint64_t> > workQueue(numThreads*20);
-	SharedQueue<uint64_t> resultQueue;
 	std::mutex lock;
 	
 	uint64_t COUNT = GetPDBSize();
@@ -147,8 +248,8 @@ void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdb
 	
 	// with weights we have to store the lowest weight stored to make sure
 	// we don't skip regions
-	std::vector<bool> coarseOpenCurr((COUNT+coarseSize-1)/coarseSize);
-	std::vector<bool> coarseOpenNext((COUNT+coarseSize-1)/coarseSize);
+	AtomicCoarseBitmap coarseOpenCurr((COUNT+coarseSize-1)/coarseSize);
+	AtomicCoarseBitmap coarseOpenNext((COUNT+coarseSize-1)/coarseSize);
 	
 	uint64_t entries = 1;
 	std::cout << "Num Entries: " << COUNT << std::endl;
@@ -156,63 +257,35 @@ void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdb
 	//std::cout << "State Hash of Goal: " << GetStateHash(goal) << std::endl;
 	std::cout << "PDB Hash of Goal: " << GetPDBHash(goalState) << std::endl;
 	
-	std::deque<state> q_curr, q_next;
-	std::vector<state> children;
-	
 	Timer t;
 	t.StartTimer();
 	PDB.Set(GetPDBHash(goalState), 0);
 
-	coarseOpenCurr[GetPDBHash(goalState)/coarseSize] = true;
+	coarseOpenCurr.Set(GetPDBHash(goalState)/coarseSize);
 	int depth = 0;
-	uint64_t newEntries;
-	std::vector<std::thread*> threads(numThreads);
 	printf("Creating %d threads\n", numThreads);
+	WorkerPool pool(numThreads);
+	numThreads = pool.NumThreads();
+	SetNumBuildThreads(numThreads);
+	WorkStealingRange work(numThreads);
+	std::vector<uint64_t> counts(numThreads);
 	do {
-		newEntries = 0;
 		Timer s;
 		s.StartTimer();
-		for (int x = 0; x < numThreads; x++)
-		{
-			threads[x] = new std::thread(&PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::ForwardThreadWorker,
-										 this,
-										 x, depth, std::ref(PDB), std::ref(coarseOpenNext),
-										 &workQueue, &resultQueue, &lock);
-		}
-		
-		for (uint64_t x = 0; x < COUNT; x+=coarseSize)
-		{
-			if (coarseOpenCurr[x/coarseSize])
-			{
-				workQueue.WaitAdd({x, std::min(COUNT, x+coarseSize)});
-			}
-			coarseOpenCurr[x/coarseSize] = false;
-		}
-		for (int x = 0; x < numThreads; x++)
-		{
-			workQueue.WaitAdd({0,0});
-		}
-		for (int x = 0; x < numThreads; x++)
-		{
-			threads[x]->join();
-			delete threads[x];
-			threads[x] = 0;
-		}
+		work.Reset(coarseOpenCurr.NumWords());
+		pool.Run([&](int threadNum) {
+			counts[threadNum] = ForwardLayer(threadNum, depth, work, coarseOpenCurr, coarseOpenNext, 0, &lock);
+		});
 		// read out node counts
 		uint64_t total = 0;
-		{
-			uint64_t val;
-			while (resultQueue.Remove(val))
-			{
-				total+=val;
-			}
-		}
+		for (uint64_t val : counts)
+			total += val;
 		
-		entries += total;//newEntries;
+		entries += total;
 		printf("Depth %d complete; %1.2fs elapsed. %llu new states written; %llu of %llu total\n",
 			   depth, s.EndTimer(), total, entries, COUNT);
 		depth++;
-		coarseOpenCurr.swap(coarseOpenNext);
+		coarseOpenCurr.Swap(coarseOpenNext);
 	} while (entries != COUNT);
 	
 	printf("%1.2fs elapsed\n", t.EndTimer());
@@ -228,8 +301,6 @@ template <class abstractState, class abstractAction, class abstractEnvironment,
 void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::BuildPDBBackward(const state &goal, int numThreads)
 {
 	assert(goalSet);
-	SharedQueue<std::pair<uint64_t, uint64_t> > workQueue(numThreads*20);
-	SharedQueue<uint64_t> resultQueue;
 	std::mutex lock;
 	
 	uint64_t COUNT = GetPDBSize();
@@ -238,7 +309,7 @@ void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdb
 	
 	// with weights we have to store the lowest weight stored to make sure
 	// we don't skip regions
-	std::vector<bool> coarseClosed((COUNT+coarseSize-1)/coarseSize);
+	AtomicCoarseBitmap coarseClosed((COUNT+coarseSize-1)/coarseSize);
 	
 	uint64_t entries = 1;
 	std::cout << "Num Entries: " << COUNT << std::endl;
@@ -246,56 +317,30 @@ void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdb
 	//std::cout << "State Hash of Goal: " << GetStateHash(goal) << std::endl;
 	std::cout << "PDB Hash of Goal: " << GetPDBHash(goalState) << std::endl;
 	
-	std::deque<state> q_curr, q_next;
-	std::vector<state> children;
-	
 	Timer t;
 	t.StartTimer();
 	PDB.Set(GetPDBHash(goalState), 0);
 	
 	int depth = 0;
-	uint64_t newEntries;
-	std::vector<std::thread*> threads(numThreads);
 	printf("Creating %d threads\n", numThreads);
+	WorkerPool pool(numThreads);
+	numThreads = pool.NumThreads();
+	SetNumBuildThreads(numThreads);
+	WorkStealingRange work(numThreads);
+	std::vector<uint64_t> counts(numThreads);
 	do {
-		newEntries = 0;
 		Timer s;
 		s.StartTimer();
-		for (int x = 0; x < numThreads; x++)
-		{
-			threads[x] = new std::thread(&PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::BackwardThreadWorker,
-										 this,
-										 x, depth, std::ref(PDB), std::ref(coarseClosed),
-										 &workQueue, &resultQueue, &lock);
-		}
-		for (uint64_t x = 0; x < COUNT; x+=coarseSize)
-		{
-			if (coarseClosed[x/coarseSize] == false)
-			{
-				workQueue.WaitAdd({x, std::min(COUNT, x+coarseSize)});
-			}
-		}
-		for (int x = 0; x < numThreads; x++)
-		{
-			workQueue.WaitAdd({0,0});
-		}
-		for (int x = 0; x < numThreads; x++)
-		{
-			threads[x]->join();
-			delete threads[x];
-			threads[x] = 0;
-		}
+		work.Reset(coarseClosed.NumWords());
+		pool.Run([&](int threadNum) {
+			counts[threadNum] = BackwardLayer(threadNum, depth, work, coarseClosed, &lock);
+		});
 		// read out node counts
 		uint64_t total = 0;
-		{
-			uint64_t val;
-			while (resultQueue.Remove(val))
-			{
-				total+=val;
-			}
-		}
+		for (uint64_t val : counts)
+			total += val;
 		
-		entries += total;//newEntries;
+		entries += total;
 		printf("Depth %d complete; %1.2fs elapsed. %llu new states written; %llu of %llu total\n",
 			   depth, s.EndTimer(), total, entries, COUNT);
 		depth++;
@@ -314,8 +359,6 @@ template <class abstractState, class abstractAction, class abstractEnvironment,
 void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::BuildPDBForwardBackward(const state &goal, int numThreads)
 {
 	assert(goalSet);
-	SharedQueue<std::pair<uint64_t, uint64_t> > workQueue(numThreads*20);
-	SharedQueue<uint64_t> resultQueue;
 	std::mutex lock;
 	
 	uint64_t COUNT = GetPDBSize();
@@ -324,9 +367,9 @@ void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdb
 	
 	// with weights we have to store the lowest weight stored to make sure
 	// we don't skip regions
-	std::vector<bool> coarseClosed((COUNT+coarseSize-1)/coarseSize);
-	std::vector<bool> coarseOpenCurr((COUNT+coarseSize-1)/coarseSize);
-	std::vector<bool> coarseOpenNext((COUNT+coarseSize-1)/coarseSize);
+	AtomicCoarseBitmap coarseClosed((COUNT+coarseSize-1)/coarseSize);
+	AtomicCoarseBitmap coarseOpenCurr((COUNT+coarseSize-1)/coarseSize);
+	AtomicCoarseBitmap coarseOpenNext((COUNT+coarseSize-1)/coarseSize);
 	
 	uint64_t entries = 1;
 	std::cout << "Num Entries: " << COUNT << std::endl;
@@ -334,81 +377,45 @@ void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdb
 	//std::cout << "State Hash of Goal: " << GetStateHash(goal) << std::endl;
 	std::cout << "PDB Hash of Goal: " << GetPDBHash(goalState) << std::endl;
 	
-	std::deque<state> q_curr, q_next;
-	std::vector<state> children;
 	std::vector<uint64_t> distribution;
 
 	Timer t;
 	t.StartTimer();
 	PDB.Set(GetPDBHash(goalState), 0);
-	coarseOpenCurr[GetPDBHash(goalState)/coarseSize] = true;
+	coarseOpenCurr.Set(GetPDBHash(goalState)/coarseSize);
 	distribution.push_back(1);
 	
 	int depth = 0;
-	uint64_t newEntries;
 	bool searchForward = true;
-	std::vector<std::thread*> threads(numThreads);
 	printf("Creating %d threads\n", numThreads);
+	WorkerPool pool(numThreads);
+	numThreads = pool.NumThreads();
+	SetNumBuildThreads(numThreads);
+	WorkStealingRange work(numThreads);
+	std::vector<uint64_t> counts(numThreads);
 	do {
-		newEntries = 0;
 		Timer s;
 		s.StartTimer();
-		for (int x = 0; x < numThreads; x++)
-		{
-			threads[x] = new std::thread(&PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::ForwardBackwardThreadWorker,
-										 this,
-										 x, depth, searchForward,
-										 std::ref(PDB), std::ref(coarseOpenNext), std::ref(coarseClosed),
-										 &workQueue, &resultQueue, &lock);
-		}
-		if (searchForward)
-		{
-			for (uint64_t x = 0; x < COUNT; x+=coarseSize)
-			{
-				if (coarseOpenCurr[x/coarseSize])
-				{
-					workQueue.WaitAdd({x, std::min(COUNT, x+coarseSize)});
-				}
-				coarseOpenCurr[x/coarseSize] = false;
-			}
-		}
-		else {
-			for (uint64_t x = 0; x < COUNT; x+=coarseSize)
-			{
-				if (coarseClosed[x/coarseSize] == false)
-				{
-					workQueue.WaitAdd({x, std::min(COUNT, x+coarseSize)});
-				}
-			}
-		}
-
-		for (int x = 0; x < numThreads; x++)
-		{
-			workQueue.WaitAdd({0,0});
-		}
-		for (int x = 0; x < numThreads; x++)
-		{
-			threads[x]->join();
-			delete threads[x];
-			threads[x] = 0;
-		}
+		work.Reset(coarseClosed.NumWords());
+		pool.Run([&](int threadNum) {
+			if (searchForward)
+				counts[threadNum] = ForwardLayer(threadNum, depth, work, coarseOpenCurr, coarseOpenNext, &coarseClosed, &lock);
+			else
+				counts[threadNum] = BackwardLayer(threadNum, depth, work, coarseClosed, &lock);
+		});
 		// read out node counts
 		uint64_t total = 0;
-		{
-			uint64_t val;
-			while (resultQueue.Remove(val))
-			{
-				total+=val;
-			}
-		}
-		entries += total;//newEntries;
+		for (uint64_t val : counts)
+			total += val;
+
+		entries += total;
 		distribution.push_back(total);
 		printf("Depth %d complete; %1.2fs elapsed. %llu new states written; %llu of %llu total [%s]\n",
 			   depth, s.EndTimer(), total, entries, COUNT, searchForward?"forward":"backward");
 		if (double(total)*double(total)*0.4 > double(COUNT-entries)*double(distribution[distribution.size()-2]))// || depth == 8)
 			searchForward = false;
 		depth++;
-		coarseOpenCurr.swap(coarseOpenNext);
+		coarseOpenCurr.Swap(coarseOpenNext);
 	} while (entries != COUNT);
 	
 	printf("%1.2fs elapsed\n", t.EndTimer());
@@ -420,290 +427,479 @@ void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdb
 	PrintHistogram();
 }
 
-
+/*
+ * External-memory breadth-first build. The rank space is split into buckets
+ * of bucketEntries, and the 4-bit depths of bucket b are kept in a DiskBitFile
+ * under prefixes[b%prefixes.size()], where 0xF means not yet reached. Only one
+ * bucket of depths (bucketEntries/2 bytes) is in memory at a time.
+ *
+ * Each layer is built in two passes. The expand pass loads every bucket with
+ * states at the current depth and appends the (in-bucket) ranks of their
+ * children to an unsorted file for the child's bucket; children that are
+ * already known in the loaded bucket are dropped immediately. The merge pass
+ * then does delayed duplicate detection: it loads each bucket, sorts its
+ * child ranks a chunk at a time and sets the depth of those not yet reached.
+ *
+ * Depths must fit in 4 bits (at most 14), and bucketEntries is limited to
+ * the 2^31 entries that fit in a single DiskBitFile sub-bucket.
+ */
 template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
-void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::ForwardThreadWorker(int threadNum, int depth,
-																	 NBitArray<pdbBits> &DB,
-																	 std::vector<bool> &coarse,
-																	 SharedQueue<std::pair<uint64_t, uint64_t> > *work,
-																	 SharedQueue<uint64_t> *results,
-																	 std::mutex *lock)
+bool PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::BuildPDBExternal(const state &goal, const std::vector<std::string> &prefixes,
+																										 uint64_t bucketEntries, int numThreads, uint64_t maxOpenBuckets)
 {
-//	lock->lock();
-//	printf("Thread %d online\n", threadNum);
-//	lock->unlock();
-
-	std::pair<uint64_t, uint64_t> p;
-	uint64_t start, end;
-	std::vector<abstractAction> acts;
-	abstractState s(goalState), t(goalState);
-	uint64_t count = 0;
-	
-	struct writeInfo {
-		uint64_t rank;
-		int newGCost;
-	};
-	std::vector<writeInfo> cache;
-	while (true)
+	assert(goalSet);
+	if (prefixes.size() == 0 || bucketEntries < 2 || bucketEntries > (1ull<<31) || maxOpenBuckets == 0)
+	{
+		printf("Invalid external PDB configuration: %d prefixes, %llu entries per bucket\n", (int)prefixes.size(), bucketEntries);
+		return false;
+	}
+	bucketEntries &= ~1ull; // keeps chunks byte aligned
+	const uint64_t COUNT = GetPDBSize();
+	const uint64_t numBuckets = (COUNT+bucketEntries-1)/bucketEntries;
+	auto bucketSize = [&](uint64_t b) { return std::min(bucketEntries, COUNT-b*bucketEntries); };
+
+	std::vector<DiskBitFile *> files;
+	for (size_t p = 0; p < prefixes.size(); p++)
 	{
-		work->WaitRemove(p);
-		if (p.first == p.second)
+		files.push_back(new DiskBitFile(prefixes[p].c_str()));
+		std::vector<bucketData> sizes;
+		for (uint64_t b = p; b < numBuckets; b += prefixes.size())
 		{
-			break;
+			sizes.resize(sizes.size()+1);
+			sizes.back().theSize = bucketSize(b);
+		}
+		files.back()->Init(sizes);
+	}
+	std::cout << "Num Entries: " << COUNT << " in " << numBuckets << " buckets" << std::endl;
+	std::cout << "Goal State: " << goalState << std::endl;
+
+	// the goal is the only child of layer -1
+	uint64_t goalRank = GetPDBHash(goalState);
+	{
+		FILE *f = fopen(GetExternalRankFile(prefixes, goalRank/bucketEntries).c_str(), "w");
+		if (f == 0)
+		{
+			perror("Could not create rank file");
+			for (DiskBitFile *d : files)
+				delete d;
+			return false;
 		}
-		start = p.first;
-		end = p.second;
-		//int nextDepth = 255;
-		for (uint64_t x = start; x < end; x++)
+		uint32_t offset = (uint32_t)(goalRank%bucketEntries);
+		fwrite(&offset, sizeof(offset), 1, f);
+		fclose(f);
+	}
+	std::vector<bool> hasChildren(numBuckets, false), hasLayer(numBuckets, false);
+	hasChildren[goalRank/bucketEntries] = true;
+
+	Timer t;
+	t.StartTimer();
+	printf("Creating %d threads\n", numThreads);
+	WorkerPool pool(numThreads);
+	numThreads = pool.NumThreads();
+	SetNumBuildThreads(numThreads);
+	WorkStealingRange work(numThreads);
+	std::mutex lock;
+	std::vector<uint8_t> data;
+	std::vector<uint32_t> ranks;
+	const uint64_t groupSize = std::min(numBuckets, maxOpenBuckets);
+	std::vector<FILE *> rankFiles(groupSize, (FILE*)0);
+	std::vector<std::vector<std::vector<uint32_t>>> buffers(numThreads, std::vector<std::vector<uint32_t>>(groupSize));
+	std::vector<uint64_t> distribution;
+	uint64_t entries = 0;
+	bool success = true;
+	for (int depth = 0; ; depth++)
+	{
+		Timer s;
+		s.StartTimer();
+		// merge: states first reached at this depth
+		uint64_t total = 0;
+		for (uint64_t b = 0; b < numBuckets; b++)
 		{
-			int stateDepth = DB.Get(x);
-			if (stateDepth == depth)
+			hasLayer[b] = false;
+			if (!hasChildren[b])
+				continue;
+			hasChildren[b] = false;
+			std::string rankFile = GetExternalRankFile(prefixes, b);
+			FILE *f = fopen(rankFile.c_str(), "r");
+			if (f == 0)
+			{
+				perror("Could not read rank file");
+				success = false;
+				break;
+			}
+			ReadExternalBucket(files, b, bucketSize(b), data);
+			ranks.resize(externalChunkEntries);
+			size_t numRead;
+			while (success && (numRead = fread(&ranks[0], sizeof(ranks[0]), ranks.size(), f)) > 0)
 			{
-				GetStateFromPDBHash(x, s, threadNum);
-				//std::cout << "Expanding[r][" << stateDepth << "]: " << s << std::endl;
-				env->GetActions(s, acts);
-				for (int y = 0; y < acts.size(); y++)
+				std::sort(ranks.begin(), ranks.begin()+numRead);
+				for (size_t x = 0; x < numRead; x++)
 				{
-					env->GetNextState(s, acts[y], t);
-					assert(env->InvertAction(acts[y]) == true);
-					//virtual bool InvertAction(action &a) const = 0;
-					
-					uint64_t nextRank = GetPDBHash(t, threadNum);
-					int newCost = stateDepth+(env->GCost(t, acts[y]));
-					cache.push_back({nextRank, newCost});
+					if (GetExternalDepth(data, ranks[x]) == 0xF)
+					{
+						if (depth == 0xF)
+						{
+							printf("External PDB depths must be less than %d\n", 0xF);
+							success = false;
+							break;
+						}
+						SetExternalDepth(data, ranks[x], depth);
+						hasLayer[b] = true;
+						total++;
+					}
 				}
 			}
+			fclose(f);
+			remove(rankFile.c_str());
+			if (!success)
+				break;
+			if (hasLayer[b])
+				WriteExternalBucket(files, b, bucketSize(b), data);
 		}
-		// write out everything
-		lock->lock();
-		for (auto d : cache)
+		if (!success || total == 0)
+			break;
+		entries += total;
+		distribution.push_back(total);
+
+		// expand: write the children of this layer to their buckets. At most
+		// maxOpenBuckets rank files (and buffers per thread) are open, so with
+		// more buckets than that the layer is expanded once per group of them.
+		for (uint64_t firstTarget = 0; firstTarget < numBuckets && entries < COUNT; firstTarget += groupSize)
 		{
-			if (d.newGCost < DB.Get(d.rank)) // shorter path
+			const uint64_t lastTarget = std::min(numBuckets, firstTarget+groupSize);
+			for (uint64_t b = 0; b < numBuckets; b++)
 			{
-				count++;
-				coarse[d.rank/coarseSize] = true;
-				DB.Set(d.rank, d.newGCost);
+				if (!hasLayer[b])
+					continue;
+				ReadExternalBucket(files, b, bucketSize(b), data);
+				const uint64_t size = bucketSize(b);
+				const uint64_t regionSize = coarseSize*64;
+				work.Reset((size+regionSize-1)/regionSize);
+				pool.Run([&](int threadNum) {
+					buildBatch batch;
+					std::vector<std::vector<uint32_t>> &out = buffers[threadNum];
+					auto flush = [&](uint64_t target) {
+						std::lock_guard<std::mutex> l(lock);
+						std::vector<uint32_t> &buffer = out[target-firstTarget];
+						FILE *&f = rankFiles[target-firstTarget];
+						if (f == 0)
+							f = fopen(GetExternalRankFile(prefixes, target).c_str(), "a");
+						if (f == 0 || fwrite(&buffer[0], sizeof(uint32_t), buffer.size(), f) != buffer.size())
+						{
+							perror("Could not write rank file");
+							success = false;
+						}
+						hasChildren[target] = true;
+						buffer.resize(0);
+					};
+					uint64_t region;
+					while (work.Next(threadNum, region))
+					{
+						uint64_t start = region*regionSize;
+						uint64_t end = std::min(size, start+regionSize);
+						batch.parentRanks.resize(0);
+						for (uint64_t x = start; x < end; x++)
+						{
+							if (GetExternalDepth(data, x) == depth)
+								batch.parentRanks.push_back(b*bucketEntries+x);
+							if (batch.parentRanks.size() == buildBatchSize || (x+1 == end && batch.parentRanks.size() > 0))
+							{
+								ExpandBatch(batch, depth, threadNum);
+								for (uint64_t rank : batch.childRanks)
+								{
+									uint64_t target = rank/bucketEntries;
+									uint32_t offset = (uint32_t)(rank%bucketEntries);
+									if (target < firstTarget || target >= lastTarget)
+										continue;
+									if (target == b && GetExternalDepth(data, offset) != 0xF)
+										continue;
+									out[target-firstTarget].push_back(offset);
+									if (out[target-firstTarget].size() == externalBufferEntries)
+										flush(target);
+								}
+								batch.parentRanks.resize(0);
+							}
+						}
+					}
+					for (uint64_t target = firstTarget; target < lastTarget; target++)
+						if (out[target-firstTarget].size() > 0)
+							flush(target);
+				});
+			}
+			for (uint64_t x = 0; x < groupSize; x++)
+			{
+				if (rankFiles[x] != 0)
+					fclose(rankFiles[x]);
+				rankFiles[x] = 0;
 			}
 		}
-		lock->unlock();
-		cache.resize(0);
+		printf("Depth %d complete; %1.2fs elapsed. %llu new states written; %llu of %llu total\n",
+			   depth, s.EndTimer(), total, entries, COUNT);
+		if (!success)
+			break;
+	}
+	uint64_t bytesRead = 0, bytesWritten = 0;
+	for (DiskBitFile *d : files)
+	{
+		bytesRead += d->GetBytesRead();
+		bytesWritten += d->GetBytesWritten();
+		delete d;
 	}
-	results->Add(count);
-//	lock->lock();
-//	printf("Thread %d offline\n", threadNum);
-//	lock->unlock();
+	for (uint64_t b = 0; b < numBuckets; b++)
+		remove(GetExternalRankFile(prefixes, b).c_str());
+	printf("%1.2fs elapsed; %llu MB of depths read, %llu MB written\n", t.EndTimer(), bytesRead>>20, bytesWritten>>20);
+	if (success && entries != COUNT)
+		printf("Warning: %llu of %llu entries reached\n", entries, COUNT);
+	for (size_t x = 0; x < distribution.size(); x++)
+		printf("%d: %llu\n", (int)x, distribution[x]);
+	return success;
 }
 
 template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
-void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::BackwardThreadWorker(int threadNum, int depth,
-																											NBitArray<pdbBits> &DB,
-																											std::vector<bool> &coarse,
-																											SharedQueue<std::pair<uint64_t, uint64_t> > *work,
-																											SharedQueue<uint64_t> *results,
-																											std::mutex *lock)
+bool PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::LoadExternalPDB(const std::vector<std::string> &prefixes,
+																										uint64_t bucketEntries, uint64_t factor)
 {
-	std::pair<uint64_t, uint64_t> p;
-	uint64_t start, end;
-	std::vector<abstractAction> acts;
-	abstractState s(goalState), t(goalState);
-	uint64_t count = 0;
-	int blankEntries = 0;
-	struct writeInfo {
-		uint64_t rank;
-		int newGCost;
-	};
-	std::vector<writeInfo> cache;
-	while (true)
+	bucketEntries &= ~1ull;
+	const uint64_t COUNT = GetPDBSize();
+	const uint64_t numBuckets = (COUNT+bucketEntries-1)/bucketEntries;
+	std::vector<DiskBitFile *> files;
+	for (size_t p = 0; p < prefixes.size(); p++)
+		files.push_back(new DiskBitFile(prefixes[p].c_str()));
+	// DiskBitFile exits on missing files, so check first
+	bool found = true;
+	for (uint64_t b = 0; b < numBuckets && found; b++)
+	{
+		FILE *f = fopen(files[b%files.size()]->getBucketFileName((int)(b/files.size()), 0), "r");
+		if (f == 0)
+			found = false;
+		else
+			fclose(f);
+	}
+	if (!found)
+	{
+		printf("External PDB is missing buckets\n");
+		for (DiskBitFile *d : files)
+			delete d;
+		return false;
+	}
+
+	type = (factor > 1)?kDivCompress:kPlain;
+	compressionValue = (factor > 1)?factor:1;
+	PDB.Resize((COUNT+compressionValue-1)/compressionValue);
+	PDB.FillMax();
+	std::vector<uint8_t> data;
+	for (uint64_t b = 0; b < numBuckets; b++)
 	{
-		work->WaitRemove(p);
-		if (p.first == p.second)
+		uint64_t size = std::min(bucketEntries, COUNT-b*bucketEntries);
+		ReadExternalBucket(files, b, size, data);
+		for (uint64_t x = 0; x < size; x++)
 		{
-			break;
+			int depth = GetExternalDepth(data, x);
+			if (depth == 0xF) // unreachable
+				continue;
+			uint64_t newIndex = (b*bucketEntries+x)/compressionValue;
+			if (depth < PDB.Get(newIndex))
+				PDB.Set(newIndex, depth);
 		}
-		start = p.first;
-		end = p.second;
-		//int nextDepth = 255;
-		blankEntries = 0;
-		for (uint64_t x = start; x < end; x++)
-		{
-			int stateDepth = DB.Get(x);
-			if (stateDepth == ((1<<pdbBits)-1))//depth) // pdbBits
-			{
-				blankEntries++;
-				GetStateFromPDBHash(x, s, threadNum);
-				//std::cout << "Expanding[r][" << stateDepth << "]: " << s << std::endl;
-				env->GetActions(s, acts);
-				for (int y = 0; y < acts.size(); y++)
-				{
-					env->GetNextState(s, acts[y], t);
-					//assert(env->InvertAction(acts[y]) == true);
-					//virtual bool InvertAction(action &a) const = 0;
+	}
+	for (DiskBitFile *d : files)
+		delete d;
+	return true;
+}
 
-					uint64_t nextRank = GetPDBHash(t, threadNum);
-					if (DB.Get(nextRank) == depth)
-					{
-						int newCost = depth+(env->GCost(t, acts[y]));
-						cache.push_back({x, newCost});
-						blankEntries--;
-						break;
-					}
-				}
-			}
-		}
-		// write out everything
-		if (cache.size() > 0)
+template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
+void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::ReadExternalBucket(std::vector<DiskBitFile *> &files, uint64_t bucket,
+																										  uint64_t entries, std::vector<uint8_t> &data)
+{
+	DiskBitFile *f = files[bucket%files.size()];
+	data.resize((entries+1)/2);
+	for (uint64_t x = 0; x < entries; x += externalChunkEntries)
+		f->ReadChunk((int)(bucket/files.size()), x, (int)std::min(externalChunkEntries, entries-x), &data[x/2]);
+	f->CloseReadFile();
+}
+
+template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
+void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::WriteExternalBucket(std::vector<DiskBitFile *> &files, uint64_t bucket,
+																										   uint64_t entries, const std::vector<uint8_t> &data)
+{
+	DiskBitFile *f = files[bucket%files.size()];
+	for (uint64_t x = 0; x < entries; x += externalChunkEntries)
+		f->WriteChunk((int)(bucket/files.size()), x, (int)std::min(externalChunkEntries, entries-x), &data[x/2]);
+}
+
+template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
+std::string PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::GetExternalRankFile(const std::vector<std::string> &prefixes,
+																												   uint64_t bucket) const
+{
+	return prefixes[bucket%prefixes.size()]+"-next-b"+std::to_string(bucket/prefixes.size());
+}
+
+template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
+bool PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::WriteIfLess(uint64_t rank, int newGCost, std::mutex *lock)
+{
+	if (NBitArray<pdbBits>::SupportsAtomicWrites())
+		return PDB.AtomicSetIfLess(rank, newGCost);
+	// entries can span two words; fall back to locking
+	std::lock_guard<std::mutex> l(*lock);
+	return PDB.AtomicSetIfLess(rank, newGCost);
+}
+
+/*
+ * Unranks the parents in the batch, generates all their children and ranks
+ * them, so that the ranking functions can work on many states at once.
+ */
+template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
+void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::ExpandBatch(buildBatch &batch, int depth, int threadNum)
+{
+	size_t numParents = batch.parentRanks.size();
+	if (batch.parents.size() < numParents)
+		batch.parents.resize(numParents, goalState);
+	GetStatesFromPDBHashes(&batch.parentRanks[0], &batch.parents[0], (int)numParents, threadNum);
+	size_t numChildren = 0;
+	batch.firstChild.resize(0);
+	batch.childCosts.resize(0);
+	for (size_t p = 0; p < numParents; p++)
+	{
+		batch.firstChild.push_back(numChildren);
+		//std::cout << "Expanding[r][" << depth << "]: " << batch.parents[p] << std::endl;
+		env->GetActions(batch.parents[p], batch.acts);
+		for (int y = 0; y < batch.acts.size(); y++)
 		{
-			//printf("%d items to write\n", cache.size());
-			lock->lock();
-			if (blankEntries == 0)
-				coarse[start/coarseSize] = true; // closed
-			for (auto d : cache)
-			{
-				if (d.newGCost < DB.Get(d.rank)) // shorter path
-				{
-					count++;
-					DB.Set(d.rank, d.newGCost);
-				}
-			}
-			lock->unlock();
+			if (numChildren == batch.children.size())
+				batch.children.push_back(goalState);
+			env->GetNextState(batch.parents[p], batch.acts[y], batch.children[numChildren]);
+			batch.childCosts.push_back(depth+env->GCost(batch.parents[p], batch.acts[y]));
+			numChildren++;
 		}
-		cache.resize(0);
 	}
-	results->Add(count);
+	batch.firstChild.push_back(numChildren);
+	batch.childRanks.resize(numChildren);
+	if (numChildren > 0)
+		GetPDBHashes(&batch.children[0], &batch.childRanks[0], (int)numChildren, threadNum);
 }
 
+/*
+ * Expands all states at the current depth in the open coarse regions. Regions
+ * are claimed one bitmap word (64 regions) at a time from the scheduler, and
+ * cleared in the open list as they are claimed. New entries are written with
+ * lock-free compare-and-swap and their regions marked in nextOpen. If closed
+ * is provided, regions with no entries left above the current depth are
+ * marked closed for a later backward search.
+ */
 template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
-void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::ForwardBackwardThreadWorker(int threadNum, int depth, bool forward,
-																												   NBitArray<pdbBits> &DB,
-																												   std::vector<bool> &coarseOpen,
-																												   std::vector<bool> &coarseClosed,
-																												   SharedQueue<std::pair<uint64_t, uint64_t> > *work,
-																												   SharedQueue<uint64_t> *results,
-																												   std::mutex *lock)
+uint64_t PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::ForwardLayer(int threadNum, int depth,
+																										 WorkStealingRange &work,
+																										 AtomicCoarseBitmap &open,
+																										 AtomicCoarseBitmap &nextOpen,
+																										 AtomicCoarseBitmap *closed,
+																										 std::mutex *lock)
 {
-	std::pair<uint64_t, uint64_t> p;
-	uint64_t start, end;
-	std::vector<abstractAction> acts;
-	abstractState s(goalState), t(goalState);
+	const uint64_t COUNT = PDB.Size();
+	buildBatch batch;
 	uint64_t count = 0;
-	int blankEntries = 0;
-	struct writeInfo {
-		uint64_t rank;
-		int newGCost;
-	};
-	std::vector<writeInfo> cache;
-	if (forward)
+	uint64_t word;
+	
+	while (work.Next(threadNum, word))
 	{
-		bool allEntriesWritten;
-		while (true)
+		uint64_t regions = open.ExchangeWord(word, 0);
+		while (regions != 0)
 		{
-			work->WaitRemove(p);
-			if (p.first == p.second)
-			{
-				break;
-			}
-			start = p.first;
-			end = p.second;
-
-			allEntriesWritten = true;
+			uint64_t start = (word*64+__builtin_ctzll(regions))*coarseSize;
+			uint64_t end = std::min(COUNT, start+coarseSize);
+			regions &= regions-1;
+			
+			bool allEntriesWritten = true;
+			batch.parentRanks.resize(0);
 			for (uint64_t x = start; x < end; x++)
 			{
-				int stateDepth = DB.Get(x);
+				int stateDepth = PDB.Get(x);
 				if (stateDepth > depth)
 					allEntriesWritten = false;
 				if (stateDepth == depth)
+					batch.parentRanks.push_back(x);
+				if (batch.parentRanks.size() == buildBatchSize || (x+1 == end && batch.parentRanks.size() > 0))
 				{
-					GetStateFromPDBHash(x, s, threadNum);
-					//std::cout << "Expanding[r][" << stateDepth << "]: " << s << std::endl;
-					env->GetActions(s, acts);
-					for (int y = 0; y < acts.size(); y++)
+					ExpandBatch(batch, depth, threadNum);
+					for (size_t c = 0; c < batch.childRanks.size(); c++)
 					{
-						env->GetNextState(s, acts[y], t);
-						assert(env->InvertAction(acts[y]) == true);
-						//virtual bool InvertAction(action &a) const = 0;
-						
-						uint64_t nextRank = GetPDBHash(t, threadNum);
-						int newCost = stateDepth+(env->GCost(t, acts[y]));
-						cache.push_back({nextRank, newCost});
+						if (WriteIfLess(batch.childRanks[c], batch.childCosts[c], lock)) // shorter path
+						{
+							count++;
+							nextOpen.Set(batch.childRanks[c]/coarseSize);
+						}
 					}
+					batch.parentRanks.resize(0);
 				}
 			}
-			// write out everything
-			lock->lock();
-			if (allEntriesWritten)
-				coarseClosed[start/coarseSize] = true;
-			for (auto d : cache)
-			{
-				if (d.newGCost < DB.Get(d.rank)) // shorter path
-				{
-					count++;
-					coarseOpen[d.rank/coarseSize] = true;
-					DB.Set(d.rank, d.newGCost);
-				}
-			}
-			lock->unlock();
-			cache.resize(0);
+			if (closed && allEntriesWritten)
+				closed->Set(start/coarseSize);
 		}
 	}
-	else {
-		while (true)
+	return count;
+}
+
+/*
+ * Fills in unwritten entries in regions that are not yet closed by looking
+ * for a neighbor at the current depth. Each region is only written by the
+ * thread that claimed it.
+ */
+template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
+uint64_t PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::BackwardLayer(int threadNum, int depth,
+																										  WorkStealingRange &work,
+																										  AtomicCoarseBitmap &closed,
+																										  std::mutex *lock)
+{
+	const uint64_t COUNT = PDB.Size();
+	const uint64_t numRegions = (COUNT+coarseSize-1)/coarseSize;
+	buildBatch batch;
+	uint64_t count = 0;
+	uint64_t word;
+	
+	while (work.Next(threadNum, word))
+	{
+		uint64_t regions = ~closed.GetWord(word);
+		if (numRegions-word*64 < 64)
+			regions &= (1ull<<(numRegions-word*64))-1;
+		while (regions != 0)
 		{
-			work->WaitRemove(p);
-			if (p.first == p.second)
-			{
-				break;
-			}
-			start = p.first;
-			end = p.second;
-			//int nextDepth = 255;
-			blankEntries = 0;
+			uint64_t start = (word*64+__builtin_ctzll(regions))*coarseSize;
+			uint64_t end = std::min(COUNT, start+coarseSize);
+			regions &= regions-1;
+			
+			int blankEntries = 0;
+			batch.parentRanks.resize(0);
 			for (uint64_t x = start; x < end; x++)
 			{
-				int stateDepth = DB.Get(x);
+				int stateDepth = PDB.Get(x);
 				if (stateDepth == ((1<<pdbBits)-1))//depth) // pdbBits
 				{
 					blankEntries++;
-					GetStateFromPDBHash(x, s, threadNum);
-					//std::cout << "Expanding[r][" << stateDepth << "]: " << s << std::endl;
-					env->GetActions(s, acts);
-					for (int y = 0; y < acts.size(); y++)
-					{
-						env->GetNextState(s, acts[y], t);
-						//assert(env->InvertAction(acts[y]) == true);
-						//virtual bool InvertAction(action &a) const = 0;
-						
-						uint64_t nextRank = GetPDBHash(t, threadNum);
-						if (DB.Get(nextRank) == depth)
-						{
-							int newCost = depth+(env->GCost(t, acts[y]));
-							cache.push_back({x, newCost});
-							blankEntries--;
-							break;
-						}
-					}
+					batch.parentRanks.push_back(x);
 				}
-			}
-			// write out everything
-			if (cache.size() > 0)
-			{
-				//printf("%d items to write\n", cache.size());
-				lock->lock();
-				if (blankEntries == 0)
-					coarseClosed[start/coarseSize] = true; // closed
-				for (auto d : cache)
+				if (batch.parentRanks.size() == buildBatchSize || (x+1 == end && batch.parentRanks.size() > 0))
 				{
-					if (d.newGCost < DB.Get(d.rank)) // shorter path
+					ExpandBatch(batch, depth, threadNum);
+					for (size_t p = 0; p < batch.parentRanks.size(); p++)
 					{
-						count++;
-						DB.Set(d.rank, d.newGCost);
+						for (size_t c = batch.firstChild[p]; c < batch.firstChild[p+1]; c++)
+						{
+							if (PDB.Get(batch.childRanks[c]) == depth)
+							{
+								if (WriteIfLess(batch.parentRanks[p], batch.childCosts[c], lock)) // shorter path
+									count++;
+								blankEntries--;
+								break;
+							}
+						}
 					}
+					batch.parentRanks.resize(0);
 				}
-				lock->unlock();
 			}
-			cache.resize(0);
+			if (blankEntries == 0)
+				closed.Set(start/coarseSize); // closed
 		}
 	}
-	results->Add(count);
+	return count;
 }
 
 template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
@@ -816,6 +1012,62 @@ void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdb
 
 template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
 bool PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::Load(FILE *f)
+{
+	off_t start = ftello(f);
+	PDBFileHeader header;
+	if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, pdbFileMagic, sizeof(pdbFileMagic)) != 0)
+	{
+		fseeko(f, start, SEEK_SET);
+		return LoadLegacy(f);
+	}
+	if (header.version != pdbFileVersion)
+	{
+		printf("PDB file version %u not supported (expected %u)\n", header.version, pdbFileVersion);
+		return false;
+	}
+	if (header.entryBits != pdbBits)
+	{
+		printf("PDB file has %u-bit entries; expected %llu\n", header.entryBits, pdbBits);
+		return false;
+	}
+	if (strncmp(header.rankingScheme, GetRankingScheme(), sizeof(header.rankingScheme)) != 0)
+	{
+		printf("PDB file ranking '%.16s' doesn't match '%s'\n", header.rankingScheme, GetRankingScheme());
+		return false;
+	}
+	if (header.goalBytes == sizeof(goalState))
+	{
+		if (fread(&goalState, sizeof(goalState), 1, f) != 1)
+			return false;
+	}
+	else if (header.goalBytes == 0) {
+		GetStateFromPDBHash(header.goalRank, goalState);
+	}
+	else {
+		return false;
+	}
+	if (fseeko(f, header.dataOffset, SEEK_SET) != 0)
+		return false;
+	bool success;
+	if (mapOnLoad)
+		success = PDB.MapData(f, header.entries);
+	else
+		success = PDB.ReadData(f, header.entries);
+	if (!success || PDB.DataBytes() != header.dataBytes)
+		return false;
+	if ((!mapOnLoad || verifyOnLoad) && PDB.Checksum() != header.checksum)
+	{
+		printf("PDB checksum mismatch; file is corrupt\n");
+		return false;
+	}
+	type = (PDBLookupType)header.lookupType;
+	compressionValue = header.compressionValue;
+	goalSet = true;
+	return true;
+}
+
+template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
+bool PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::LoadLegacy(FILE *f)
 {
 	if (fread(&type, sizeof(type), 1, f) != 1)
 		return false;
@@ -827,9 +1079,28 @@ bool PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdb
 template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
 void PDBHeuristic<abstractState, abstractAction, abstractEnvironment, state, pdbBits>::Save(FILE *f)
 {
-	fwrite(&type, sizeof(type), 1, f);
-	fwrite(&goalState, sizeof(goalState), 1, f);
-	PDB.Write(f);
+	PDBFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, pdbFileMagic, sizeof(pdbFileMagic));
+	header.version = pdbFileVersion;
+	header.lookupType = type;
+	header.entryBits = pdbBits;
+	// states holding pointers (eg std::vector) are recovered from their rank instead
+	header.goalBytes = std::is_trivially_copyable<abstractState>::value?sizeof(goalState):0;
+	strncpy(header.rankingScheme, GetRankingScheme(), sizeof(header.rankingScheme)-1);
+	header.compressionValue = compressionValue;
+	header.goalRank = GetPDBHash(goalState);
+	header.entries = PDB.Size();
+	header.dataOffset = (ftello(f)+sizeof(header)+header.goalBytes+7)&~7ull;
+	header.dataBytes = PDB.DataBytes();
+	header.checksum = PDB.Checksum();
+	fwrite(&header, sizeof(header), 1, f);
+	if (header.goalBytes != 0)
+		fwrite(&goalState, sizeof(goalState), 1, f);
+	while (ftello(f) < header.dataOffset)
+		fputc(0, f);
+	if (!PDB.WriteData(f))
+		perror("Writing PDB");
 }
 
 template <class abstractState, class abstractAction, class abstractEnvironment, class state, uint64_t pdbBits>
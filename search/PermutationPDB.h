@@ -10,6 +10,7 @@
 #define hog2_glut_PermutationPDB_h
 
 #include "PDBHeuristic.h"
+#include "PermutationBatch.h"
 
 /**
  * This class does the basic permutation calculation with a regular N^2 permutation
@@ -24,6 +25,8 @@ public:
 
 	virtual uint64_t GetPDBHash(const state &s, int threadID = 0) const;
 	virtual void GetStateFromPDBHash(uint64_t hash, state &s, int threadID = 0) const;
+	virtual void GetPDBHashes(const state *s, uint64_t *hashes, int count, int threadID = 0) const;
+	virtual void GetStatesFromPDBHashes(const uint64_t *hashes, state *s, int count, int threadID = 0) const;
 	virtual uint64_t GetAbstractHash(const state &s, int threadID = 0) const { return GetPDBHash(s); }
 	virtual state GetStateFromAbstractState(state &s) const { return s; }
 
@@ -32,6 +35,8 @@ public:
 	bool Load(const char *prefix);
 	void Save(const char *prefix);
 	std::string GetFileName(const char *prefix);
+	const char *GetRankingScheme() const { return "lex"; }
+	const std::vector<int> &GetPattern() const { return distinct; }
 private:
 	uint64_t Factorial(int val) const;
 	uint64_t FactorialUpperK(int n, int k) const;
@@ -39,16 +44,31 @@ private:
 	size_t puzzleSize;
 	uint64_t pdbSize;
 	state example;
+	// weight of the (corrected) location of each distinct item in the rank
+	std::vector<uint64_t> rankWeights;
+	void SetNumBuildThreads(int numThreads)
+	{
+		if (numThreads > (int)dualCache.size())
+		{
+			dualCache.resize(numThreads);
+			locsCache.resize(numThreads);
+			batchCache.resize(numThreads);
+		}
+	}
+
 	// cache for computing ranking/unranking
 	mutable std::vector<std::vector<int> > dualCache;
 	mutable std::vector<std::vector<int> > locsCache;
+	mutable std::vector<std::vector<int32_t> > batchCache;
 };
 
 template <class state, class action, class environment>
 PermutationPDB<state, action, environment>::PermutationPDB(environment *e, const state &s, std::vector<int> distincts)
 :PDBHeuristic<state, action, environment, state>(e), distinct(distincts), puzzleSize(s.puzzle.size()),
-dualCache(maxThreads), locsCache(maxThreads), example(s)
+dualCache(maxThreads), locsCache(maxThreads), batchCache(maxThreads), example(s)
 {
+	for (int x = 0; x < distinct.size(); x++)
+		rankWeights.push_back(FactorialUpperK(puzzleSize-1-x, puzzleSize-distinct.size()));
 	this->SetGoal(s);
 	pdbSize = 1;
 	for (int x = (int)s.puzzle.size(); x > s.puzzle.size()-distincts.size(); x--)
@@ -84,12 +104,10 @@ uint64_t PermutationPDB<state, action, environment>::GetPDBHash(const state &s,
 	}
 	
 	uint64_t hashVal = 0;
-	int numEntriesLeft = (int)s.puzzle.size();
 	
 	for (unsigned int x = 0; x < locs.size(); x++)
 	{
-		hashVal += locs[x]*FactorialUpperK(numEntriesLeft-1, s.puzzle.size()-distinct.size());
-		numEntriesLeft--;
+		hashVal += locs[x]*rankWeights[x];
 		
 		// decrement locations of remaining items
 		for (unsigned y = x; y < locs.size(); y++)
@@ -128,7 +146,65 @@ void PermutationPDB<state, action, environment>::GetStateFromPDBHash(uint64_t ha
 	s.FinishUnranking(example);
 }
 
-void GetStateFromHash(uint64_t hash, int *pieces, int count)
+/**
+ * Ranks count states, permutationBatchSize at a time. The last batch is
+ * padded with copies of the last state.
+ */
+template <class state, class action, class environment>
+void PermutationPDB<state, action, environment>::GetPDBHashes(const state *s, uint64_t *hashes, int count, int threadID) const
+{
+	std::vector<int> &dual = dualCache[threadID];
+	std::vector<int32_t> &locs = batchCache[threadID];
+	int k = (int)distinct.size();
+	dual.resize(puzzleSize);
+	locs.resize(k*permutationBatchSize);
+	uint64_t ranks[permutationBatchSize];
+	for (int base = 0; base < count; base += permutationBatchSize)
+	{
+		int num = std::min(permutationBatchSize, count-base);
+		for (int b = 0; b < permutationBatchSize; b++)
+		{
+			const state &next = s[base+std::min(b, num-1)];
+			for (unsigned int x = 0; x < puzzleSize; x++)
+			{
+				if (next.puzzle[x] != -1)
+					dual[next.puzzle[x]] = x;
+			}
+			for (int x = 0; x < k; x++)
+				locs[x*permutationBatchSize+b] = dual[distinct[x]];
+		}
+		LexRankBatch(&locs[0], &rankWeights[0], k, ranks);
+		for (int b = 0; b < num; b++)
+			hashes[base+b] = ranks[b];
+	}
+}
+
+template <class state, class action, class environment>
+void PermutationPDB<state, action, environment>::GetStatesFromPDBHashes(const uint64_t *hashes, state *s, int count, int threadID) const
+{
+	std::vector<int32_t> &locs = batchCache[threadID];
+	int k = (int)distinct.size();
+	locs.resize(k*permutationBatchSize);
+	uint64_t ranks[permutationBatchSize];
+	for (int base = 0; base < count; base += permutationBatchSize)
+	{
+		int num = std::min(permutationBatchSize, count-base);
+		for (int b = 0; b < permutationBatchSize; b++)
+			ranks[b] = hashes[base+std::min(b, num-1)];
+		LexUnrankBatch(ranks, k, (int)puzzleSize, &locs[0]);
+		for (int b = 0; b < num; b++)
+		{
+			state &next = s[base+b];
+			next.puzzle.resize(puzzleSize);
+			std::fill(next.puzzle.begin(), next.puzzle.end(), -1);
+			for (int x = 0; x < k; x++)
+				next.puzzle[locs[x*permutationBatchSize+b]] = distinct[x];
+			next.FinishUnranking(example);
+		}
+	}
+}
+
+inline void GetStateFromHash(uint64_t hash, int *pieces, int count)
 {
 	int numEntriesLeft = 1;
 	for (int x = count-1; x >= 0; x--)
@@ -188,30 +264,53 @@ std::string PermutationPDB<state, action, environment>::GetFileName(const char *
 template <class state, class action, class environment>
 bool PermutationPDB<state, action, environment>::Load(const char *prefix)
 {
-	assert(false);
-	return false;
+	FILE *f = fopen(GetFileName(prefix).c_str(), "rb");
+	if (f == 0)
+	{
+		perror("Opening PermutationPDB file");
+		return false;
+	}
+	bool result = Load(f);
+	fclose(f);
+	return result;
 }
 
 template <class state, class action, class environment>
 void PermutationPDB<state, action, environment>::Save(const char *prefix)
 {
-	assert(false);
-	FILE *f = fopen(GetFileName(prefix).c_str(), "w+");
-	PDBHeuristic<state, action, environment>::PDB.Write(f);
+	FILE *f = fopen(GetFileName(prefix).c_str(), "w+b");
+	if (f == 0)
+	{
+		perror("Opening PermutationPDB file");
+		return;
+	}
+	Save(f);
 	fclose(f);
 }
 
 template <class state, class action, class environment>
 bool PermutationPDB<state, action, environment>::Load(FILE *f)
 {
-	assert(false);
-	return false;
+	if (!PDBHeuristic<state, action, environment, state>::Load(f))
+		return false;
+	// the pattern follows the PDB, and must be the one this PDB was made for
+	size_t numDistinct;
+	if (fread(&numDistinct, sizeof(numDistinct), 1, f) != 1 || numDistinct != distinct.size())
+		return false;
+	std::vector<int> pattern(numDistinct);
+	if (numDistinct > 0 && fread(pattern.data(), sizeof(pattern[0]), numDistinct, f) != numDistinct)
+		return false;
+	return pattern == distinct;
 }
 
 template <class state, class action, class environment>
 void PermutationPDB<state, action, environment>::Save(FILE *f)
 {
-	assert(false);
+	PDBHeuristic<state, action, environment, state>::Save(f);
+	size_t numDistinct = distinct.size();
+	fwrite(&numDistinct, sizeof(numDistinct), 1, f);
+	if (numDistinct > 0)
+		fwrite(distinct.data(), sizeof(distinct[0]), numDistinct, f);
 }
 
 template <class state, class action, class environment>
@@ -15,6 +15,8 @@
 
 #include <stdint.h>
 #include <vector>
+#include <utility>
+#include <type_traits>
 //#include "ReservationProvider.h"
 #include <assert.h>
 #include "ObjectiveEnvironment.h"
@@ -28,6 +30,15 @@ struct Hash64 {
 		{ return (size_t)(x); }
 };
 
+/** One successor of a state, as written by GetSuccessorBatch */
+template <class state, class action>
+struct Successor {
+	state s;
+	action a; // the action that generates s
+	double cost; // GCost of the action
+	uint64_t hash; // GetStateHash(s)
+};
+
 
 template <class state, class action>
 class SearchEnvironment : public ObjectiveEnvironment<state> {
@@ -35,6 +46,15 @@ public:
 	virtual ~SearchEnvironment() {}
 	virtual void GetSuccessors(const state &nodeID, std::vector<state> &neighbors) const = 0;
 	virtual unsigned GetSuccessors(const state &nodeID, state* neighbors) const{return 0UL;}
+	/** Largest number of successors GetSuccessorBatch writes; 0 if the
+	 environment doesn't have a batch. **/
+	virtual unsigned GetMaxSuccessors() const { return 0; }
+	/** Writes the successors of nodeID, in GetSuccessors order, with their
+	 actions and costs (and hashes if withHash) into succ, which has room for
+	 GetMaxSuccessors() entries. Returns the number written. Writing into the
+	 same buffer again doesn't allocate. Subclasses that change the
+	 successors, costs or hashes must override this or GetMaxSuccessors. **/
+	virtual unsigned GetSuccessorBatch(const state &nodeID, Successor<state, action> *succ, bool withHash) const { return 0; }
 	virtual void GetActions(const state &nodeID, std::vector<action> &actions) const = 0;
 	virtual int GetNumSuccessors(const state &stateID) const
 	{ std::vector<state> neighbors; GetSuccessors(stateID, neighbors); return (int)neighbors.size(); }
@@ -168,4 +188,33 @@ void SearchEnvironment<state,action>::GLDrawPath(const std::vector<state> &path)
 	}
 }
 
+/**
+ * Calls the successor batch of environments that have one. Many environments
+ * used by the templated searches don't derive from SearchEnvironment; for
+ * them GetMaxSuccessors is 0.
+ */
+template <class environment, class state, class action>
+class SuccessorBatch {
+	template <class e>
+	static char Test(decltype(std::declval<const e&>().GetSuccessorBatch(std::declval<const state&>(), (Successor<state, action>*)0, true)) *);
+	template <class e>
+	static long Test(...);
+	static const bool hasBatch = (sizeof(Test<environment>(0)) == 1);
+
+	template <class e>
+	static unsigned GetMax(const e *env, std::true_type) { return env->GetMaxSuccessors(); }
+	template <class e>
+	static unsigned GetMax(const e *, std::false_type) { return 0; }
+	template <class e>
+	static unsigned Get(const e *env, const state &s, Successor<state, action> *succ, bool withHash, std::true_type)
+	{ return env->GetSuccessorBatch(s, succ, withHash); }
+	template <class e>
+	static unsigned Get(const e *, const state &, Successor<state, action> *, bool, std::false_type) { return 0; }
+public:
+	static unsigned GetMaxSuccessors(const environment *env)
+	{ return GetMax(env, std::integral_constant<bool, hasBatch>()); }
+	static unsigned GetSuccessors(const environment *env, const state &s, Successor<state, action> *succ, bool withHash)
+	{ return Get(env, s, succ, withHash, std::integral_constant<bool, hasBatch>()); }
+};
+
 #endif
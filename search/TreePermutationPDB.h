@@ -34,6 +34,7 @@ public:
 	bool Load(const char *prefix);
 	void Save(const char *prefix);
 	std::string GetFileName(const char *prefix);
+	const char *GetRankingScheme() const { return "tree"; }
 private:
 	uint64_t Factorial(int val) const;
 	uint64_t FactorialUpperK(int n, int k) const;
@@ -43,6 +44,16 @@ private:
 	
 	const int maxThreads = 32;
 
+	void SetNumBuildThreads(int numThreads)
+	{
+		if (numThreads > (int)dualCache.size())
+		{
+			dualCache.resize(numThreads);
+			locsCache.resize(numThreads);
+			tempCache.resize(numThreads);
+		}
+	}
+
 	// cache for computing ranking/unranking
 	mutable std::vector<std::vector<int> > dualCache;
 	mutable std::vector<std::vector<int> > locsCache;
@@ -246,30 +257,53 @@ std::string TreePermutationPDB<state, action, environment>::GetFileName(const ch
 template <class state, class action, class environment>
 bool TreePermutationPDB<state, action, environment>::Load(const char *prefix)
 {
-	assert(false);
-	return false;
+	FILE *f = fopen(GetFileName(prefix).c_str(), "rb");
+	if (f == 0)
+	{
+		perror("Opening TreePermutationPDB file");
+		return false;
+	}
+	bool result = Load(f);
+	fclose(f);
+	return result;
 }
 
 template <class state, class action, class environment>
 void TreePermutationPDB<state, action, environment>::Save(const char *prefix)
 {
-	assert(false);
-	FILE *f = fopen(GetFileName(prefix).c_str(), "w+");
-	PDBHeuristic<state, action, environment>::PDB.Write(f);
+	FILE *f = fopen(GetFileName(prefix).c_str(), "w+b");
+	if (f == 0)
+	{
+		perror("Opening TreePermutationPDB file");
+		return;
+	}
+	Save(f);
 	fclose(f);
 }
 
 template <class state, class action, class environment>
 bool TreePermutationPDB<state, action, environment>::Load(FILE *f)
 {
-	assert(false);
-	return false;
+	if (!PDBHeuristic<state, action, environment>::Load(f))
+		return false;
+	// the pattern follows the PDB, and must be the one this PDB was made for
+	size_t numDistinct;
+	if (fread(&numDistinct, sizeof(numDistinct), 1, f) != 1 || numDistinct != distinct.size())
+		return false;
+	std::vector<int> pattern(numDistinct);
+	if (numDistinct > 0 && fread(pattern.data(), sizeof(pattern[0]), numDistinct, f) != numDistinct)
+		return false;
+	return pattern == distinct;
 }
 
 template <class state, class action, class environment>
 void TreePermutationPDB<state, action, environment>::Save(FILE *f)
 {
-	assert(false);
+	PDBHeuristic<state, action, environment>::Save(f);
+	size_t numDistinct = distinct.size();
+	fwrite(&numDistinct, sizeof(numDistinct), 1, f);
+	if (numDistinct > 0)
+		fwrite(distinct.data(), sizeof(distinct[0]), numDistinct, f);
 }
 
 template <class state, class action, class environment>
@@ -23,6 +23,8 @@
 #define env_UnitTests_h_
 
 #include <gtest/gtest.h>
+#include <dirent.h>
+#include <unistd.h>
 #include "dtedreader.h"
 #include "BucketHash.h"
 //#include "TemporalAStar.h"
@@ -31,6 +33,42 @@
 #include "CollisionDetection.h"
 #include "Hungarian.h"
 #include "Map3d.h"
+#include "NBitArray.h"
+#include "WorkerPool.h"
+#include "PassabilityBitmap.h"
+#include "FlatOpenClosed.h"
+#include "CSRGraph.h"
+#include "CSRGraphEnvironment.h"
+#include "IncrementalTilePDB.h"
+#include "MR1PermutationPDB.h"
+#include "GridStates.h"
+#include "ConflictIndex.h"
+#include "Map2DConstrainedEnvironment.h"
+#include "CBSUnits.h"
+#include "NonUnitTimeCAT.h"
+#include "PackedKeyTable.h"
+#include "ParetoFront.h"
+#include "NAMOAStar.h"
+#include "AnyAngleSipp.h"
+#include "IDAStar.h"
+#include "ParallelIDAStar.h"
+#include "MR1Permutation.h"
+#include "RubiksCubeEdges.h"
+#include "LearnedStateTable.h"
+#include "ClusterAbstraction.h"
+#include "Map2DEnvironment.h"
+#include "MNPuzzle.h"
+#include "PancakePuzzle.h"
+#include "RubiksCube.h"
+#include "RubikFaceTurn.h"
+#include "ExternalSort.h"
+#include "RetrogradeSolver.h"
+#include "GraphEnvironment.h"
+#include "VoxelOctree.h"
+#include "ParallelFrontierBFS.h"
+#include "TOH.h"
+#include "TopSpin.h"
+#include "PackedTOH.h"
 
 /*TEST(util, dtedreader){
   float** array;
@@ -1371,4 +1409,1413 @@ TEST(biclique, assertCore){
   }
   ASSERT_TRUE(found);
 }
+TEST(WorkerPool, EachItemClaimedOnce){
+  WorkerPool pool(4);
+  WorkStealingRange work(4);
+  std::vector<std::atomic<int>> claimed(1000);
+  for(int layer(0); layer<3; ++layer){
+    for(auto &c : claimed) c.store(0);
+    work.Reset(claimed.size());
+    pool.Run([&](int threadNum){
+      uint64_t item;
+      while(work.Next(threadNum,item))
+        claimed[item]++;
+    });
+    for(auto &c : claimed) ASSERT_EQ(1,c.load());
+  }
+}
+
+TEST(NBitArray, AtomicSetIfLess){
+  NBitArray<4> array(4096);
+  array.FillMax();
+  WorkerPool pool(4);
+  pool.Run([&](int threadNum){
+    for(uint64_t x(0); x<array.Size(); ++x)
+      array.AtomicSetIfLess(x,(x+threadNum)%4+1);
+  });
+  for(uint64_t x(0); x<array.Size(); ++x)
+    ASSERT_EQ(1,array.Get(x));
+  ASSERT_FALSE(array.AtomicSetIfLess(0,1));
+  ASSERT_TRUE(array.AtomicSetIfLess(0,0));
+}
+
+TEST(NBitArray, MapData){
+  NBitArray<5> array(1000);
+  for(uint64_t x(0); x<array.Size(); ++x)
+    array.Set(x,x%31);
+  FILE *f(tmpfile());
+  fputc(0,f); // data need not be page aligned
+  ASSERT_TRUE(array.WriteData(f));
+  fseek(f,1,SEEK_SET);
+  NBitArray<5> mapped;
+  ASSERT_TRUE(mapped.MapData(f,array.Size()));
+  ASSERT_TRUE(mapped.IsMapped());
+  ASSERT_EQ(array.Checksum(),mapped.Checksum());
+  for(uint64_t x(0); x<array.Size(); ++x)
+    ASSERT_EQ(array.Get(x),mapped.Get(x));
+  mapped.Set(0,7); // copy-on-write; file is unchanged
+  NBitArray<5> read;
+  fseek(f,1,SEEK_SET);
+  ASSERT_TRUE(read.ReadData(f,array.Size()));
+  ASSERT_EQ(0,read.Get(0));
+  fclose(f);
+}
+
+TEST(PassabilityBitmap, MatchesMap){
+  std::string text("type octile\nheight 20\nwidth 70\nmap\n");
+  srandom(7);
+  for(int y(0); y<20; ++y){
+    for(int x(0); x<70; ++x)
+      text+=(random()%4)?'.':((random()%2)?'T':'@');
+    text+='\n';
+  }
+  FILE *f(tmpfile());
+  fputs(text.c_str(),f);
+  rewind(f);
+  Map m(f);
+  fclose(f);
+  PassabilityBitmap b(&m);
+  int dx[]={0,1,1,1,0,-1,-1,-1};
+  int dy[]={-1,-1,0,1,1,1,0,-1};
+  for(int y(-3); y<23; ++y)
+    for(int x(-3); x<73; ++x)
+      ASSERT_EQ(m.IsTraversable(x,y),b.Passable(x,y));
+  for(int y(0); y<20; ++y)
+    for(int x(0); x<70; ++x){
+      uint8_t mask(b.GetNeighborMask(x,y));
+      for(int d(0); d<8; ++d){
+        bool legal(m.CanStep(x,y,x+dx[d],y+dy[d]));
+        if(dx[d]&&dy[d]) // no corner cutting
+          legal=legal&&m.CanStep(x,y,x+dx[d],y)&&m.CanStep(x,y,x,y+dy[d]);
+        ASSERT_EQ(legal,(mask>>d)&1);
+      }
+    }
+  b.SetPassable(5,5,false);
+  ASSERT_FALSE(b.Passable(5,5));
+  ASSERT_EQ(0,b.GetNeighborMask(5,5));
+  ASSERT_EQ(0,b.GetNeighborMask(4,4)&PassabilityBitmap::kSouthEast);
+}
+
+struct FlatTestCompare {
+  bool operator()(const AStarOpenClosedData<int> &i1, const AStarOpenClosedData<int> &i2) const
+  { return i1.g+i1.h>i2.g+i2.h; }
+};
+
+TEST(FlatOpenClosed, OrderAndLookup){
+  FlatOpenClosed<int,FlatTestCompare> q;
+  for(int maxHash : {0,1000,100}){ // hash table, direct index, direct index that overflows
+    q.Reset(maxHash);
+    srandom(3);
+    std::vector<uint64_t> ids;
+    for(int x(0); x<500; ++x)
+      ids.push_back(q.AddOpenNode(x,x*2,random()%100,0));
+    ASSERT_EQ(maxHash==1000,q.UsingDirectIndex());
+    for(int x(0); x<500; x+=7){
+      q.Lookup(ids[x]).g=random()%100;
+      q.KeyChanged(ids[x]);
+    }
+    for(int x(0); x<500; ++x){
+      uint64_t id;
+      ASSERT_EQ(kOpenList,q.Lookup(x*2,id));
+      ASSERT_EQ(ids[x],id);
+      ASSERT_EQ(kNotFound,q.Lookup(x*2+1,id));
+    }
+    double last(0);
+    while(q.OpenSize()){
+      uint64_t id(q.Close());
+      ASSERT_LE(last,q.Lookat(id).g);
+      last=q.Lookat(id).g;
+    }
+    ASSERT_EQ(500,q.ClosedSize());
+  }
+}
+
+TEST(CSRGraph, MatchesGraph){
+  Graph g;
+  for(int x(0); x<20; ++x)
+    g.AddNode(new node(""));
+  srandom(5);
+  for(int x(0); x<60; ++x){
+    int from(random()%20), to(random()%20);
+    if(from!=to&&!g.findDirectedEdge(from,to))
+      g.AddEdge(new edge(from,to,1+random()%10));
+  }
+  CSRGraph c(&g);
+  ASSERT_TRUE(c.Save("csr-unit-test.graph"));
+  CSRGraph loaded;
+  ASSERT_TRUE(loaded.Load("csr-unit-test.graph"));
+  remove("csr-unit-test.graph");
+  ASSERT_EQ(g.GetNumEdges(),loaded.GetNumEdges());
+  for(int from(0); from<20; ++from)
+    for(int to(0); to<20; ++to){
+      edge *e(g.findDirectedEdge(from,to));
+      uint64_t ce(loaded.FindEdge(from,to));
+      ASSERT_EQ(e==0,ce==loaded.GetNumEdges());
+      if(e)
+        ASSERT_EQ(e->GetWeight(),loaded.GetWeight(ce));
+    }
+
+  GraphEnvironment ge(&g);
+  ge.SetDirected(true);
+  CSRGraphEnvironment ce(&loaded);
+  std::vector<graphState> n1, n2;
+  for(int x(0); x<20; ++x){
+    ge.GetSuccessors(x,n1);
+    ce.GetSuccessors(x,n2);
+    std::sort(n1.begin(),n1.end());
+    std::sort(n2.begin(),n2.end());
+    ASSERT_EQ(n1,n2);
+  }
+}
+
+TEST(CSRGraph, ParallelEdgesMerged){
+  Graph g;
+  for(int x(0); x<3; ++x)
+    g.AddNode(new node(""));
+  g.AddEdge(new edge(0,1,5));
+  g.AddEdge(new edge(1,0,3));
+  g.AddEdge(new edge(0,2,4));
+  // undirected, 0->1 is there twice
+  CSRGraph c(&g,false);
+  ASSERT_EQ(4u,c.GetNumEdges());
+  CSRGraphEnvironment ce(&c);
+  std::vector<graphState> n;
+  ce.GetSuccessors(0,n);
+  ASSERT_EQ((std::vector<graphState>{1,2}),n);
+  ce.GetSuccessors(1,n);
+  ASSERT_EQ((std::vector<graphState>{0}),n);
+  ASSERT_EQ(3,ce.GCost(0,1));
+  ASSERT_EQ(3,ce.GCost(1,0));
+  ASSERT_EQ(4,ce.GCost(2,0));
+}
+
+TEST(IncrementalTilePDB, MatchesPermutationPDB){
+  MNPuzzle mnp(4,4);
+  MNPuzzleState goal(4,4);
+  std::vector<std::vector<int>> patterns={{0,1,2,3,4},{5,6,7,8},{0,15,9,12},{2,14,11,10,13}};
+  std::vector<PermutationPDB<MNPuzzleState,slideDir,MNPuzzle>*> pdbs;
+  IncrementalTilePDB<4,4> h;
+  for(auto const& p:patterns){
+    pdbs.push_back(new PermutationPDB<MNPuzzleState,slideDir,MNPuzzle>(&mnp,goal,p));
+    h.AddPDB(pdbs.back());
+  }
+  FixedMNPuzzle<4,4> env;
+  FixedMNPuzzleState<4,4> s;
+  std::vector<uint64_t> ranks(patterns.size()), next(patterns.size());
+  for(int x(0); x<patterns.size(); ++x)
+    ranks[x]=h.GetRank(s,x);
+  srandom(7);
+  std::vector<slideDir> acts;
+  for(int step(0); step<2000; ++step){
+    env.GetActions(s,acts);
+    slideDir a(acts[random()%acts.size()]);
+    env.ApplyAction(s,a);
+    h.UpdateRanks(s,a,ranks.data(),next.data());
+    ranks.swap(next);
+    MNPuzzleState ms(s.GetMNPuzzleState());
+    for(int x(0); x<patterns.size(); ++x)
+      ASSERT_EQ(pdbs[x]->GetPDBHash(ms),ranks[x]);
+  }
+  for(auto p:pdbs)
+    delete p;
+
+  // solve with a built PDB
+  MNPuzzle mnp3(3,3);
+  MNPuzzleState goal3(3,3);
+  PermutationPDB<MNPuzzleState,slideDir,MNPuzzle> pdb(&mnp3,goal3,{0,1,2,3,4,5});
+  pdb.BuildPDB(goal3,1);
+  IncrementalTilePDB<3,3> h3;
+  h3.AddPDB(&pdb);
+  FixedMNPuzzle<3,3> env3;
+  FixedMNPuzzleState<3,3> goalFixed;
+  ParallelIDAStar<FixedMNPuzzle<3,3>,FixedMNPuzzleState<3,3>,slideDir> ida;
+  ParallelIDAStar<MNPuzzle,MNPuzzleState,slideDir> ida2;
+  ida.SetIncrementalHeuristic(&h3);
+  ida.SetVerbose(false);
+  ida2.SetVerbose(false);
+  ida.SetNumThreads(2);
+  for(int x(0); x<5; ++x){
+    FixedMNPuzzleState<3,3> s3;
+    for(int y(0); y<40; ++y){
+      env3.GetActions(s3,acts);
+      env3.ApplyAction(s3,acts[random()%acts.size()]);
+    }
+    std::vector<slideDir> p1, p2;
+    ida.GetPath(&env3,s3,goalFixed,p1);
+    ida2.GetPath(&mnp3,s3.GetMNPuzzleState(),goal3,p2);
+    ASSERT_EQ(p2.size(),p1.size());
+    for(auto a:p1)
+      env3.ApplyAction(s3,a);
+    ASSERT_TRUE(s3==goalFixed);
+  }
+}
+
+// ParallelIDAStar returns a path to the goal of the same cost as IDAStar
+template <int width, int height>
+static void ParallelIDAMatchesIDA(int instances, int walkLength){
+  MNPuzzle mnp(width,height);
+  MNPuzzleState goal(width,height);
+  IDAStar<MNPuzzleState,slideDir,MNPuzzle> ida;
+  ParallelIDAStar<MNPuzzle,MNPuzzleState,slideDir> pida;
+  pida.SetVerbose(false);
+  std::vector<slideDir> acts;
+  for(int x(0); x<instances; ++x){
+    MNPuzzleState start(width,height);
+    for(int y(0); y<walkLength; ++y){
+      mnp.GetActions(start,acts);
+      mnp.ApplyAction(start,acts[random()%acts.size()]);
+    }
+    std::vector<slideDir> expected;
+    ida.GetPath(&mnp,start,goal,expected);
+    for(int threads:{1,2,4}){
+      std::vector<slideDir> path;
+      pida.SetNumThreads(threads);
+      pida.GetPath(&mnp,start,goal,path);
+      ASSERT_EQ(expected.size(),path.size());
+      MNPuzzleState s(start);
+      for(auto a:path){
+        mnp.GetActions(s,acts);
+        ASSERT_TRUE(std::find(acts.begin(),acts.end(),a)!=acts.end());
+        mnp.ApplyAction(s,a);
+      }
+      ASSERT_TRUE(s==goal);
+    }
+  }
+}
+
+TEST(ParallelIDAStar, MatchesIDAStar){
+  srandom(11);
+  ParallelIDAMatchesIDA<3,3>(6,300);
+  ParallelIDAMatchesIDA<4,4>(6,100);
+}
+
+TEST(PermutationBatch, MatchesScalar){
+  MNPuzzle mnp(4,4);
+  MNPuzzleState goal(4,4);
+  PermutationPDB<MNPuzzleState,slideDir,MNPuzzle> pdb(&mnp,goal,{0,1,2,3,4,5,6});
+  const int count(37); // not a multiple of the batch size
+  srandom(11);
+  std::vector<uint64_t> ranks(count), batched(count);
+  for(int x(0); x<count; ++x)
+    ranks[x]=random()%pdb.GetPDBSize();
+  std::vector<MNPuzzleState> states(count,goal);
+  pdb.GetStatesFromPDBHashes(ranks.data(),states.data(),count);
+  for(int x(0); x<count; ++x){
+    MNPuzzleState s(4,4);
+    pdb.GetStateFromPDBHash(ranks[x],s);
+    ASSERT_TRUE(s==states[x]);
+  }
+  pdb.GetPDBHashes(states.data(),batched.data(),count);
+  for(int x(0); x<count; ++x)
+    ASSERT_EQ(ranks[x],batched[x]);
+
+  MR1KPermutation mr1;
+  const int k(7), N(12);
+  std::vector<int> items(count*N), dual(count*N), item(N), d(N);
+  for(int x(0); x<count; ++x)
+    ranks[x]=random()%3991680; // 12!/5!
+  mr1.UnrankBatch(ranks.data(),items.data(),dual.data(),k,N,count);
+  for(int x(0); x<count; ++x){
+    mr1.Unrank(ranks[x],item.data(),d.data(),k,N);
+    for(int y(0); y<N; ++y)
+      ASSERT_EQ(item[y],items[x*N+y]);
+  }
+  mr1.RankBatch(items.data(),dual.data(),k,N,count,batched.data());
+  for(int x(0); x<count; ++x)
+    ASSERT_EQ(ranks[x],batched[x]);
+}
+
+// Ranks and unranks one state at a time, as PDBHeuristic does by default
+template <class pdbType, class abstractState>
+class ScalarRankingPDB : public pdbType {
+public:
+  using pdbType::pdbType;
+  void GetPDBHashes(const abstractState *s, uint64_t *hashes, int count, int threadID = 0) const
+  { for(int x(0); x<count; ++x) hashes[x]=this->GetPDBHash(s[x],threadID); }
+  void GetStatesFromPDBHashes(const uint64_t *hashes, abstractState *s, int count, int threadID = 0) const
+  { for(int x(0); x<count; ++x) this->GetStateFromPDBHash(hashes[x],s[x],threadID); }
+};
+
+template <class pdbType, class scalarType, class abstractState>
+static void BatchBuildMatchesScalar(pdbType &batched, scalarType &scalar, abstractState goal){
+  const int count(37);
+  std::vector<uint64_t> ranks(count), hashes(count);
+  std::vector<abstractState> states(count,goal);
+  for(int x(0); x<count; ++x)
+    ranks[x]=random()%batched.GetPDBSize();
+  batched.GetStatesFromPDBHashes(ranks.data(),states.data(),count);
+  for(int x(0); x<count; ++x){
+    abstractState s(goal);
+    batched.GetStateFromPDBHash(ranks[x],s);
+    ASSERT_TRUE(s==states[x]);
+  }
+  batched.GetPDBHashes(states.data(),hashes.data(),count);
+  for(int x(0); x<count; ++x)
+    ASSERT_EQ(ranks[x],hashes[x]);
+  batched.BuildPDBForward(goal,2);
+  scalar.BuildPDBForward(goal,2);
+  for(uint64_t x(0); x<batched.GetPDBSize(); ++x)
+    ASSERT_EQ(scalar.GetHCostFromHash(x),batched.GetHCostFromHash(x));
+}
+
+TEST(PermutationBatch, BuildMatchesScalar){
+  srandom(13);
+  MNPuzzle mnp(3,3);
+  MNPuzzleState goal(3,3);
+  MR1PermutationPDB<MNPuzzleState,slideDir,MNPuzzle> mr1(&mnp,goal,{0,2,3,5,6,8});
+  ScalarRankingPDB<MR1PermutationPDB<MNPuzzleState,slideDir,MNPuzzle>,MNPuzzleState> mr1Scalar(&mnp,goal,{0,2,3,5,6,8});
+  mr1.SetGoal(goal);
+  mr1Scalar.SetGoal(goal);
+  BatchBuildMatchesScalar(mr1,mr1Scalar,goal);
+
+  RubikEdge env;
+  RubikEdgeState edgeGoal;
+  std::vector<int> edges={1,4,7,10};
+  RubikEdgePDB edge(&env,edgeGoal,edges);
+  ScalarRankingPDB<RubikEdgePDB,RubikEdgeState> edgeScalar(&env,edgeGoal,edges);
+  BatchBuildMatchesScalar(edge,edgeScalar,edgeGoal);
+}
+
+// Builds with more threads than the default number of ranking caches
+template <class pdbType>
+static void BuildWithManyThreads(){
+  MNPuzzle mnp(3,3);
+  MNPuzzleState goal(3,3);
+  pdbType one(&mnp,goal,{0,1,2,3,4});
+  pdbType many(&mnp,goal,{0,1,2,3,4});
+  one.SetGoal(goal);
+  many.SetGoal(goal);
+  one.BuildPDBForward(goal,1);
+  many.BuildPDBForward(goal,2*maxThreads+1);
+  for(uint64_t x(0); x<one.GetPDBSize(); ++x)
+    ASSERT_EQ(one.GetHCostFromHash(x),many.GetHCostFromHash(x));
+  many.BuildPDBForwardBackward(goal,2*maxThreads+1);
+  for(uint64_t x(0); x<one.GetPDBSize(); ++x)
+    ASSERT_EQ(one.GetHCostFromHash(x),many.GetHCostFromHash(x));
+}
+
+TEST(PDBHeuristic, MoreThreadsThanCaches){
+  BuildWithManyThreads<PermutationPDB<MNPuzzleState,slideDir,MNPuzzle>>();
+  BuildWithManyThreads<MR1PermutationPDB<MNPuzzleState,slideDir,MNPuzzle>>();
+}
+
+TEST(PermutationPDB, SaveChecksPattern){
+  MNPuzzle mnp(3,3);
+  MNPuzzleState goal(3,3);
+  PermutationPDB<MNPuzzleState,slideDir,MNPuzzle> pdb(&mnp,goal,{0,1,2,3});
+  pdb.BuildPDB(goal,1);
+  FILE *f(tmpfile());
+  pdb.Save(f);
+  long end(ftell(f));
+  // the versioned header comes first
+  char magic[8];
+  rewind(f);
+  ASSERT_EQ(1u,fread(magic,sizeof(magic),1,f));
+  ASSERT_EQ(0,memcmp(magic,pdbFileMagic,sizeof(magic)));
+  rewind(f);
+  PermutationPDB<MNPuzzleState,slideDir,MNPuzzle> loaded(&mnp,goal,{0,1,2,3});
+  ASSERT_TRUE(loaded.Load(f));
+  ASSERT_EQ(end,ftell(f));
+  for(uint64_t x(0); x<pdb.GetPDBSize(); ++x)
+    ASSERT_EQ(pdb.GetHCostFromHash(x),loaded.GetHCostFromHash(x));
+  rewind(f);
+  PermutationPDB<MNPuzzleState,slideDir,MNPuzzle> other(&mnp,goal,{0,1,2,4});
+  ASSERT_FALSE(other.Load(f));
+  // a corrupt pattern length is rejected before anything is allocated
+  size_t numDistinct(size_t(1)<<60);
+  fseek(f,end-4*sizeof(int)-sizeof(numDistinct),SEEK_SET);
+  fwrite(&numDistinct,sizeof(numDistinct),1,f);
+  rewind(f);
+  ASSERT_FALSE(loaded.Load(f));
+  fclose(f);
+}
+
+TEST(PDBHeuristic, BuildExternalMatchesInMemory){
+  RubikEdge env;
+  RubikEdgeState goal;
+  std::vector<int> edges={0,1,2,3};
+  RubikEdgePDB pdb(&env,goal,edges);
+  RubikEdgePDB ext(&env,goal,edges);
+  int numThreads(std::thread::hardware_concurrency());
+  pdb.BuildPDBForward(goal,numThreads);
+  char dir[]="/tmp/hog2extXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir)!=0);
+  // two stripes and a bucket size that doesn't divide the PDB size
+  std::vector<std::string> prefixes={std::string(dir)+"/a",std::string(dir)+"/b"};
+  const uint64_t bucketEntries(30001);
+  ASSERT_TRUE(ext.BuildPDBExternal(goal,prefixes,bucketEntries,numThreads));
+  ASSERT_TRUE(ext.LoadExternalPDB(prefixes,bucketEntries));
+  for(uint64_t x(0); x<pdb.GetPDBSize(); ++x)
+    ASSERT_EQ(pdb.GetHCostFromHash(x),ext.GetHCostFromHash(x));
+  // 7 buckets written 2 at a time
+  ASSERT_TRUE(ext.BuildPDBExternal(goal,prefixes,bucketEntries,numThreads,2));
+  ASSERT_TRUE(ext.LoadExternalPDB(prefixes,bucketEntries));
+  for(uint64_t x(0); x<pdb.GetPDBSize(); ++x)
+    ASSERT_EQ(pdb.GetHCostFromHash(x),ext.GetHCostFromHash(x));
+  ASSERT_TRUE(ext.LoadExternalPDB(prefixes,bucketEntries,4));
+  pdb.DivCompress(4,false);
+  for(uint64_t x(0); x<pdb.GetPDBSize(); ++x)
+    ASSERT_EQ(pdb.GetHCostFromHash(x),ext.GetHCostFromHash(x));
+  for(auto const& p:prefixes){
+    DiskBitFile *f(new DiskBitFile(p.c_str()));
+    for(int b(0); b<4; ++b)
+      remove(f->getBucketFileName(b,0));
+    delete f;
+  }
+  // nothing else was left in the directory
+  ASSERT_EQ(0,rmdir(dir));
+}
+
+static void RandomTimedPath(int size, int steps, std::vector<xytLoc>& path){
+  path.resize(0);
+  path.emplace_back(random()%size,random()%size,0.0f);
+  for(int i(0); i<steps; ++i){
+    xytLoc s(path.back());
+    int d(random()%9);
+    int x(s.x+d%3-1), y(s.y+d/3-1);
+    if(x>=0 && x<size) s.x=x;
+    if(y>=0 && y<size) s.y=y;
+    s.t+=(d%3!=1 && d/3!=1)?1.5f:1.0f;
+    path.push_back(s);
+  }
+}
+
+// Interpolated positions of the two paths come within 2r of each other
+static bool PathsCollide(std::vector<xytLoc> const& a, std::vector<xytLoc> const& b, double r){
+  double end(std::min(a.back().t,b.back().t));
+  unsigned i(0), j(0);
+  for(double t(0); t<=end; t+=0.01){
+    while(a[i+1].t<t) ++i;
+    while(b[j+1].t<t) ++j;
+    double fa((t-a[i].t)/(a[i+1].t-a[i].t)), fb((t-b[j].t)/(b[j+1].t-b[j].t));
+    double dx((a[i].x+fa*(a[i+1].x-a[i].x))-(b[j].x+fb*(b[j+1].x-b[j].x)));
+    double dy((a[i].y+fa*(a[i+1].y-a[i].y))-(b[j].y+fb*(b[j+1].y-b[j].y)));
+    if(dx*dx+dy*dy<4*r*r) return true;
+  }
+  return false;
+}
+
+TEST(ConflictIndex, CandidatesIncludeCollisions){
+  srandom(31337);
+  for(double r:{0.25,0.4,0.75}){
+    const unsigned n(40);
+    std::vector<std::vector<xytLoc>> paths(n);
+    for(auto& p:paths)
+      RandomTimedPath(12,20,p);
+    ConflictIndex<xytLoc> index(1.0,ConflictIndex<xytLoc>::MarginForRadius(r));
+    ASSERT_EQ(n,index.Sync(paths));
+    ASSERT_EQ(0u,index.Sync(paths));
+    std::vector<std::pair<unsigned,unsigned>> candidates;
+    index.GetCandidatePairs(candidates);
+    unsigned collisions(0);
+    for(unsigned x(0); x<n; ++x){
+      for(unsigned y(x+1); y<n; ++y){
+        if(PathsCollide(paths[x],paths[y],r)){
+          ++collisions;
+          ASSERT_TRUE(std::binary_search(candidates.begin(),candidates.end(),std::make_pair(x,y)));
+        }
+      }
+    }
+    ASSERT_GT(collisions,0u);
+    ASSERT_LT(candidates.size(),n*(n-1)/2);
+
+    // Replanning a few agents gives the same buckets as a fresh index
+    for(unsigned x(0); x<n; x+=7)
+      RandomTimedPath(12,25,paths[x]);
+    ASSERT_EQ(6u,index.Sync(paths));
+    ConflictIndex<xytLoc> fresh(1.0,ConflictIndex<xytLoc>::MarginForRadius(r));
+    fresh.Sync(paths);
+    std::vector<std::pair<unsigned,unsigned>> expected;
+    fresh.GetCandidatePairs(expected);
+    index.GetCandidatePairs(candidates);
+    ASSERT_EQ(expected,candidates);
+    ASSERT_EQ(fresh.NumBuckets(),index.NumBuckets());
+    std::vector<unsigned> c1, c2;
+    for(unsigned x(0); x<n; ++x){
+      index.GetCandidates(x,c1);
+      fresh.GetCandidates(x,c2);
+      ASSERT_EQ(c2,c1);
+    }
+  }
+}
+
+template<>
+double NonUnitTimeCAT<xytLoc,tDirection>::bucketWidth=1.0;
+
+// Solves agents crossing an 8x8 grid with CBS; returns the number of CT nodes
+static unsigned SolveCBS(unsigned numAgents, unsigned threads, unsigned batch, std::vector<std::vector<xytLoc>>& paths, double& cost){
+  typedef TieBreaking<xytLoc,tDirection> comparison;
+  typedef NonUnitTimeCAT<xytLoc,tDirection> conflicttable;
+  std::string text("type octile\nheight 8\nwidth 8\nmap\n");
+  for(int y(0); y<8; ++y){
+    for(int x(0); x<8; ++x)
+      text+=((x==2||x==5)&&(y==2||y==5))?'@':'.';
+    text+='\n';
+  }
+  FILE *f(tmpfile());
+  fputs(text.c_str(),f);
+  rewind(f);
+  Map m(f);
+  fclose(f);
+  std::vector<std::vector<xytLoc>> wpts={{{0,3},{7,3}},{{7,3},{0,3}},{{3,0},{3,7}},{{3,7},{3,0}},{{0,0},{7,7}}};
+  wpts.resize(numAgents);
+  // every agent gets its own environments
+  std::vector<std::unique_ptr<MapEnvironment>> mapEnvs;
+  std::vector<std::vector<EnvironmentContainer<xytLoc,tDirection>>> environs;
+  for(auto const& w:wpts){
+    mapEnvs.emplace_back(new MapEnvironment(&m));
+    mapEnvs.back()->SetEightConnected();
+    mapEnvs.back()->setGoal(xyLoc(w.back().x,w.back().y));
+    environs.push_back({EnvironmentContainer<xytLoc,tDirection>("8",new Map2DConstrainedEnvironment(mapEnvs.back().get()),nullptr,0,1.0f)});
+  }
+  Timer t;
+  CBSGroup<xytLoc,tDirection,comparison,conflicttable> group(environs);
+  group.timer=&t;
+  group.keeprunning=true;
+  group.nobypass=true;
+  group.numThreads=threads;
+  group.ctBatch=batch;
+  t.StartTimer();
+  std::vector<std::unique_ptr<CBSUnit<xytLoc,tDirection,comparison,conflicttable>>> units;
+  for(auto const& w:wpts){
+    units.emplace_back(new CBSUnit<xytLoc,tDirection,comparison,conflicttable>(w));
+    group.AddUnit(units.back().get());
+  }
+  while(group.ExpandOneCBSNode()){}
+  paths.resize(0);
+  cost=0;
+  for(unsigned a(0); a<units.size(); ++a){
+    paths.push_back(units[a]->GetPath());
+    std::reverse(paths.back().begin(),paths.back().end());
+    cost+=environs[a][0].environment->GetPathLength(paths.back());
+  }
+  // the solution is collision free
+  for(unsigned a(0); a<paths.size(); ++a)
+    for(unsigned b(a+1); b<paths.size(); ++b)
+      for(unsigned i(1); i<paths[a].size(); ++i)
+        for(unsigned j(1); j<paths[b].size(); ++j)
+          EXPECT_FALSE(environs[a][0].environment->collisionCheck(paths[a][i-1],paths[a][i],agentRadius,paths[b][j-1],paths[b][j],agentRadius));
+  return group.tree.size();
+}
+
+TEST(CBSGroup, ConflictIndexFindsAllConflicts){
+  // the agents cross in the middle, so the root has conflicts to resolve
+  for(unsigned numAgents:{2u,4u,5u}){
+    std::vector<std::vector<xytLoc>> paths;
+    double cost;
+    ASSERT_LT(1,SolveCBS(numAgents,1,1,paths,cost));
+    ASSERT_EQ(numAgents,paths.size());
+    for(auto const& p:paths)
+      ASSERT_LT(1,p.size());
+  }
+}
+
+TEST(CBSGroup, ThreadsDontChangeTree){
+  bool useCAT(TieBreaking<xytLoc,tDirection>::useCAT);
+  for(unsigned numAgents:{4u,5u}){
+    // the conflict avoidance table is only used with four agents, to keep the test short
+    TieBreaking<xytLoc,tDirection>::useCAT=(numAgents==4);
+    for(unsigned batch:{1u,4u}){
+      std::vector<std::vector<xytLoc>> p1, p2;
+      double c1, c2;
+      unsigned n1(SolveCBS(numAgents,1,batch,p1,c1));
+      unsigned n2(SolveCBS(numAgents,2,batch,p2,c2));
+      ASSERT_EQ(n1,n2);
+      ASSERT_EQ(c1,c2);
+      ASSERT_EQ(p1.size(),p2.size());
+      for(unsigned a(0); a<p1.size(); ++a){
+        ASSERT_EQ(p1[a].size(),p2[a].size());
+        for(unsigned i(0); i<p1[a].size(); ++i){
+          ASSERT_EQ(p1[a][i],p2[a][i]);
+        }
+      }
+    }
+  }
+  TieBreaking<xytLoc,tDirection>::useCAT=useCAT;
+}
+
+TEST(CBSGroup, BatchKeepsOptimalCost){
+  // ctBatch 1 is plain best-first CBS; larger batches may find another
+  // solution, but one of the same cost. (With five agents and no CAT plain
+  // CBS itself misses the cheapest solution, so that case isn't used.)
+  bool useCAT(TieBreaking<xytLoc,tDirection>::useCAT);
+  for(bool cat:{false,true}){
+    TieBreaking<xytLoc,tDirection>::useCAT=cat;
+    for(unsigned numAgents:{3u,4u}){
+      std::vector<std::vector<xytLoc>> paths;
+      double optimal;
+      SolveCBS(numAgents,1,1,paths,optimal);
+      for(unsigned batch:{2u,4u,8u}){
+        double cost;
+        SolveCBS(numAgents,1,batch,paths,cost);
+        ASSERT_EQ(numAgents,paths.size());
+        ASSERT_TRUE(fequal(optimal,cost));
+      }
+    }
+  }
+  TieBreaking<xytLoc,tDirection>::useCAT=useCAT;
+}
+
+TEST(PackedKeyTable, MatchesMap){
+  PackedKeyTable<int> table(3);
+  std::map<std::vector<uint64_t>,int> expected;
+  std::vector<std::vector<uint64_t>> order;
+  srandom(7);
+  for(int x(0); x<5000; ++x){
+    // small values so that keys repeat and contain zero bytes
+    std::vector<uint64_t> key{uint64_t(random()%8),uint64_t(random()%8)<<32,uint64_t(random()%16)};
+    if(expected.find(key)==expected.end())
+      order.push_back(key);
+    ASSERT_EQ(expected.find(key)==expected.end(),table.find(&key[0])==0);
+    table[&key[0]]+=x;
+    expected[key]+=x;
+  }
+  ASSERT_EQ(expected.size(),table.size());
+  for(unsigned x(0); x<order.size(); ++x){
+    ASSERT_EQ(0,memcmp(&order[x][0],table.GetKey(x),3*sizeof(uint64_t)));
+    ASSERT_EQ(expected[order[x]],table.GetValue(x));
+    ASSERT_EQ(expected[order[x]],*table.find(&order[x][0]));
+  }
+  table.SetWidth(1);
+  ASSERT_EQ(0u,table.size());
+  ASSERT_TRUE(table.find(&order[0][0])==0);
+}
+
+template <unsigned dim>
+static void CheckParetoFront(){
+  ParetoFront<dim> front;
+  std::vector<cost<dim>> all;
+  srandom(11);
+  for(int x(0); x<3000; ++x){
+    cost<dim> c;
+    for(unsigned i(0); i<dim; ++i)
+      c.value[i]=random()%40;
+    all.push_back(c);
+    bool dominated(false);
+    for(auto const& e:front)
+      dominated|=ParetoFront<dim>::Dominates(e.c,c);
+    ASSERT_EQ(dominated,front.Dominates(c));
+    ASSERT_EQ(!dominated,front.Insert(c,x%5));
+  }
+  // The front is exactly the non-dominated vectors seen, sorted on the first objective
+  unsigned expected(0);
+  for(unsigned x(0); x<all.size(); ++x){
+    bool dominated(false), duplicate(false);
+    for(unsigned y(0); y<all.size(); ++y){
+      dominated|=ParetoFront<dim>::Dominates(all[y],all[x]);
+      duplicate|=(y<x && ParetoFront<dim>::Equal(all[y],all[x]));
+    }
+    ASSERT_EQ(!dominated,front.Find(all[x])!=0);
+    if(!dominated && !duplicate) ++expected;
+  }
+  ASSERT_EQ(expected,front.size());
+  for(auto e(front.begin()); e+1<front.end(); ++e)
+    ASSERT_LE(e->c.value[0],(e+1)->c.value[0]);
+  cost<dim> c(front.begin()->c);
+  ASSERT_TRUE(front.Erase(c));
+  ASSERT_EQ(expected-1,front.size());
+  ASSERT_TRUE(front.Find(c)==0);
+}
+
+TEST(ParetoFront, MatchesBruteForce){
+  CheckParetoFront<2>();
+  CheckParetoFront<3>();
+}
+
+// Two objectives on a small graph: 0-1-3 costs (11,6), 0-2-3 costs (12,2)
+// and 0-4-3 costs (13,8), which both of the others dominate.
+class ParetoDiamond{
+public:
+  void GetSuccessors(int const& s, std::vector<int>& succ)const{
+    if(s==0){succ.push_back(1);succ.push_back(2);succ.push_back(4);}
+    else if(s!=3) succ.push_back(3);
+  }
+  char GetAction(int const&, int const&)const{return 0;}
+  std::vector<float> GCostVector(int const& a, int const& b)const{
+    switch(b==3?a:b){
+      case 1: return b==3?std::vector<float>{10,3}:std::vector<float>{1,3};
+      case 2: return b==3?std::vector<float>{10,1}:std::vector<float>{2,1};
+      default: return b==3?std::vector<float>{10,4}:std::vector<float>{3,4};
+    }
+  }
+  std::vector<float> HCostVector(int const&, int const&)const{return std::vector<float>(2);}
+  uint64_t GetStateHash(int const& s)const{return s;}
+  bool GoalTest(int const& a, int const& b)const{return a==b;}
+  void SetColor(double, double, double, double)const{}
+  void OpenGLDraw(int const&)const{}
+};
+
+TEST(NAMOAStar, GetPathsReturnsFront){
+  ParetoDiamond env;
+  NAMOAStar<int,char,ParetoDiamond,2> search;
+  std::vector<std::vector<int>> paths;
+  search.GetPaths(&env,0,3,paths);
+  ASSERT_EQ(2u,paths.size());
+  ASSERT_EQ(std::vector<int>({0,1,3}),paths[0]);
+  ASSERT_EQ(std::vector<int>({0,2,3}),paths[1]);
+}
+
+TEST(SafeIntervalStore, IncrementalMatchesRebuilt){
+  const unsigned n(20), cells(6);
+  std::vector<std::vector<std::pair<unsigned,TimeInterval>>> trajectories(n);
+  auto randomize=[&](unsigned o){
+    trajectories[o].resize(0);
+    for(int k(0); k<4; ++k){
+      double t(random()%40);
+      trajectories[o].push_back({unsigned(random()%(cells*cells)),TimeInterval(t,t+1+random()%8)});
+    }
+  };
+  srandom(17);
+  SafeIntervalStore store(100);
+  for(unsigned o(0); o<n; ++o){
+    randomize(o);
+    for(auto const& u:trajectories[o])
+      store.AddUnsafeInterval(u.first%cells,u.first/cells,o,u.second);
+  }
+  Intervals base{{0,10},{20,100}};
+  store.SetSafeIntervals(2,3,base);
+  for(int r(0); r<100; ++r){
+    unsigned o(random()%n);
+    store.RemoveOwner(o);
+    randomize(o);
+    for(auto const& u:trajectories[o])
+      store.AddUnsafeInterval(u.first%cells,u.first/cells,o,u.second);
+    // the endpoints are integers, so check the times between them
+    for(unsigned c(0); c<cells*cells; ++c){
+      Intervals const& safe(store.GetSafeIntervals(c%cells,c/cells));
+      for(double t(0.5); t<100; t+=1){
+        bool expected(c!=3*cells+2 || t<10 || t>20);
+        for(auto const& traj:trajectories)
+          for(auto const& u:traj)
+            if(u.first==c && u.second.first<t && t<u.second.second)
+              expected=false;
+        bool found(false);
+        for(auto const& i:safe)
+          found|=(i.first<t && t<i.second);
+        ASSERT_EQ(expected,found);
+      }
+    }
+  }
+  store.Clear();
+  ASSERT_EQ(1u,store.GetSafeIntervals(2,3).size());
+}
+
+TEST(AnyAngleSipp, TrajectoriesPersistUntilRemoved){
+  std::string text("type octile\nheight 8\nwidth 8\nmap\n");
+  for(int y(0); y<8; ++y)
+    text+="........\n";
+  FILE *f(tmpfile());
+  fputs(text.c_str(),f);
+  rewind(f);
+  Map m(f);
+  fclose(f);
+  AnyAngleSipp<Map,AANode> sipp(1,false);
+  std::vector<AANode> a, b, alone;
+  sipp.GetPath(a,AANode(1,1),AANode(7,3),m);
+  sipp.GetPath(alone,AANode(7,1),AANode(1,3),m);
+  ASSERT_GT(a.size(),0u);
+  ASSERT_GT(alone.size(),0u);
+  // The paths cross; the second agent has to avoid the first
+  sipp.AddTrajectory(0,a);
+  sipp.GetPath(b,AANode(7,1),AANode(1,3),m);
+  ASSERT_GT(b.size(),0u);
+  ASSERT_GT(b.back().g,alone.back().g+0.1);
+  sipp.GetPath(b,AANode(7,1),AANode(1,3),m);
+  ASSERT_GT(b.back().g,alone.back().g+0.1);
+  sipp.RemoveTrajectory(0);
+  sipp.GetPath(b,AANode(7,1),AANode(1,3),m);
+  ASSERT_EQ(alone.size(),b.size());
+  ASSERT_FLOAT_EQ(alone.back().g,b.back().g);
+}
+
+TEST(LearnedStateTable, MatchesMap){
+  struct entry{
+    entry():value(0){}
+    int value;
+  };
+  for(int dense(0); dense<2; ++dense){
+    LearnedStateTable<entry> table;
+    if(dense) table.UseDenseIndex(1000);
+    std::map<uint64_t,int> expected;
+    std::map<uint64_t,entry*> where;
+    srandom(13);
+    for(int x(0); x<20000; ++x){
+      // keys below and above the dense range
+      uint64_t key((random()%2)?random()%1200:random());
+      ASSERT_EQ(expected.find(key)==expected.end(),table.find(key)==table.end());
+      entry& e(table[key]);
+      if(where.find(key)!=where.end())
+        ASSERT_EQ(where[key],&e); // entries never move
+      where[key]=&e;
+      e.value+=x;
+      expected[key]+=x;
+    }
+    ASSERT_EQ(expected.size(),table.size());
+    std::map<uint64_t,int> seen;
+    for(LearnedStateTable<entry>::const_iterator it(table.begin()); it!=table.end(); it++)
+      seen[it->first]=it->second.value;
+    ASSERT_EQ(expected,seen);
+    // only changes an empty table
+    table.UseDenseIndex(500);
+    ASSERT_EQ(expected[where.begin()->first],table.find(where.begin()->first)->second.value);
+    table.clear();
+    ASSERT_EQ(0u,table.size());
+    ASSERT_TRUE(table.begin()==table.end());
+    ASSERT_TRUE(table.find(where.begin()->first)==table.end());
+    table[5].value=1;
+    ASSERT_EQ(1u,table.size());
+    ASSERT_EQ(5u,table.begin()->first);
+  }
+}
+
+TEST(ClusterAbstraction, ParallelAndCachedMatchSerial){
+  // rooms with doors, so that clusters have several entrances and some cells
+  // can only reach some of them
+  std::string text("type octile\nheight 32\nwidth 32\nmap\n");
+  for(int y(0); y<32; ++y){
+    for(int x(0); x<32; ++x)
+      text+=((x%7==3 && y%5!=1) || (y%9==4 && x%6!=2))?'@':'.';
+    text+='\n';
+  }
+  auto loadMap=[&text](){
+    FILE *f(tmpfile());
+    fputs(text.c_str(),f);
+    rewind(f);
+    Map *m(new Map(f));
+    fclose(f);
+    return m;
+  };
+  char dir[]="/tmp/hpacacheXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir)!=0);
+  ClusterAbstraction serial(loadMap(),8,0,1);
+  ClusterAbstraction parallel(loadMap(),8,0,3);
+  ClusterAbstraction saved(loadMap(),8,dir,3);
+  ClusterAbstraction cached(loadMap(),8,dir,3);
+  ASSERT_FALSE(saved.loadedFromCache());
+  ASSERT_TRUE(cached.loadedFromCache());
+  for(ClusterAbstraction *a : {&parallel,&cached}){
+    ASSERT_EQ(serial.getNumAbstractGraphs(),a->getNumAbstractGraphs());
+    for(unsigned level(0); level<serial.getNumAbstractGraphs(); ++level){
+      Graph *g1(serial.GetAbstractGraph(level)), *g2(a->GetAbstractGraph(level));
+      ASSERT_EQ(g1->GetNumNodes(),g2->GetNumNodes());
+      ASSERT_EQ(g1->GetNumEdges(),g2->GetNumEdges());
+      for(int x(0); x<g1->GetNumNodes(); ++x)
+        ASSERT_EQ(g1->GetNode(x)->GetLabelL(GraphAbstractionConstants::kParent),g2->GetNode(x)->GetLabelL(GraphAbstractionConstants::kParent));
+      for(int x(0); x<g1->GetNumEdges(); ++x){
+        edge *e1(g1->GetEdge(x)), *e2(g2->GetEdge(x));
+        ASSERT_EQ(e1->getFrom(),e2->getFrom());
+        ASSERT_EQ(e1->getTo(),e2->getTo());
+        ASSERT_EQ(e1->GetWeight(),e2->GetWeight());
+      }
+    }
+  }
+  ASSERT_GT(serial.GetAbstractGraph(1)->GetNumEdges(),0);
+  // the cache is the only file in the directory
+  std::string cacheFile;
+  DIR *d(opendir(dir));
+  for(dirent *e(readdir(d)); e; e=readdir(d))
+    if(e->d_name[0]!='.') cacheFile=std::string(dir)+"/"+e->d_name;
+  closedir(d);
+  ASSERT_EQ(0,remove(cacheFile.c_str()));
+  rmdir(dir);
+}
+
+// The batch has the successors of GetSuccessors, in the same order, with the
+// actions that generate them, their GCosts and their hashes
+template <class state, class action, class environment>
+static void CheckSuccessorBatch(environment const& env, state const& s){
+  std::vector<state> succ;
+  env.GetSuccessors(s,succ);
+  std::vector<Successor<state,action>> batch(env.GetMaxSuccessors());
+  ASSERT_FALSE(batch.empty());
+  unsigned count(env.GetSuccessorBatch(s,&batch[0],true));
+  ASSERT_EQ(succ.size(),count);
+  for(unsigned i(0); i<count; ++i){
+    ASSERT_TRUE(succ[i]==batch[i].s);
+    ASSERT_EQ(env.GCost(s,succ[i]),batch[i].cost);
+    ASSERT_EQ(env.GetStateHash(succ[i]),batch[i].hash);
+    state next(s);
+    env.ApplyAction(next,batch[i].a);
+    ASSERT_TRUE(next==batch[i].s);
+  }
+}
+
+TEST(SuccessorBatch, MatchesGetSuccessors){
+  std::string text("type octile\nheight 20\nwidth 30\nmap\n");
+  srandom(11);
+  for(int y(0); y<20; ++y){
+    for(int x(0); x<30; ++x)
+      text+=(random()%4)?'.':((random()%2)?'T':'@');
+    text+='\n';
+  }
+  FILE *f(tmpfile());
+  fputs(text.c_str(),f);
+  rewind(f);
+  Map m(f);
+  fclose(f);
+  MapEnvironment me(&m);
+  me.setGoal(xyLoc(3,3));
+  for(int c : {4,5,8,9}){
+    me.SetConnectedness(c);
+    for(bool bitmap : {false,true}){
+      me.UsePassabilityBitmap(bitmap);
+      for(int y(0); y<20; ++y)
+        for(int x(0); x<30; ++x)
+          if(m.IsTraversable(x,y))
+            CheckSuccessorBatch<xyLoc,tDirection>(me,xyLoc(x,y));
+    }
+  }
+  me.SetConnectedness(24);
+  ASSERT_EQ(0,me.GetMaxSuccessors());
+
+  MNPuzzle mnp(4,4);
+  PancakePuzzle pancake(12);
+  RubiksCube cube;
+  MNPuzzleState s1(4,4);
+  PancakePuzzleState s2(12);
+  RubiksState s3;
+  std::vector<MNPuzzleState> n1;
+  std::vector<PancakePuzzleState> n2;
+  std::vector<RubiksState> n3;
+  for(int i(0); i<50; ++i){
+    CheckSuccessorBatch<MNPuzzleState,slideDir>(mnp,s1);
+    CheckSuccessorBatch<PancakePuzzleState,PancakePuzzleAction>(pancake,s2);
+    CheckSuccessorBatch<RubiksState,RubiksAction>(cube,s3);
+    mnp.GetSuccessors(s1,n1);
+    s1=n1[random()%n1.size()];
+    pancake.GetSuccessors(s2,n2);
+    s2=n2[random()%n2.size()];
+    cube.GetSuccessors(s3,n3);
+    s3=n3[random()%n3.size()];
+  }
+  cube.SetPruneSuccessors(true);
+  ASSERT_EQ(0,cube.GetMaxSuccessors());
+}
+
+TEST(RubiksCube, FaceTurnTables){
+  RubiksCube cube;
+  RubiksState s;
+  std::vector<int> edges={0,1,2,3,4,5,6,7}, corners={0,1,2,3,4,5};
+  RubikEdgePDB ep(&cube.e,s.edge,edges);
+  RubikCornerPDB cp(&cube.c,s.corner,corners);
+  srandom(3);
+  uint64_t check(0);
+  for(int i(0); i<10000; ++i){
+    int a(random()%18);
+    RubiksState before(s);
+    cube.ApplyAction(s,a);
+    check=check*1000003+cube.GetEdgeHash(s)+cube.GetCornerHash(s)+ep.GetPDBHash(s.edge)+cp.GetPDBHash(s.corner);
+
+    RubiksState t(s);
+    cube.UndoAction(t,a);
+    ASSERT_TRUE(t==before);
+    cube.GetStateFromHash(cube.GetCornerHash(s),cube.GetEdgeHash(s),t);
+    ASSERT_TRUE(t==s);
+    // pdb states have no cube (0xF) in the other locations
+    RubikEdgeState e;
+    RubiksCornerState c;
+    ep.GetStateFromPDBHash(ep.GetPDBHash(before.edge),e);
+    cp.GetStateFromPDBHash(cp.GetPDBHash(before.corner),c);
+    cube.e.ApplyAction(e,a);
+    cube.c.ApplyAction(c,a);
+    ASSERT_EQ(ep.GetPDBHash(s.edge),ep.GetPDBHash(e));
+    ASSERT_EQ(cp.GetPDBHash(s.corner),cp.GetPDBHash(c));
+  }
+  // the hashes along the same moves with the switch-based face turns
+  ASSERT_EQ(0xacaa977f536fbcf0ull,check);
+}
+
+TEST(RubiksCube, FaceTurnShuffleMatchesScalar){
+#ifdef RUBIK_FACE_TURN_SHUFFLE
+  if(!__builtin_cpu_supports("ssse3"))
+    return;
+  srandom(5);
+  for(int i(0); i<1000; ++i){
+    // any word, including the 0xF (no cube) fields of pdb states
+    uint64_t state(((uint64_t)random()<<42)^((uint64_t)random()<<21)^random());
+    for(int a(0); a<18; ++a){
+      ASSERT_EQ(RubiksCorner::FaceTurn(a).PermuteScalar(state),RubiksCorner::FaceTurn(a).PermuteShuffle(state));
+      ASSERT_EQ(RubikEdge::FaceTurn(a).PermuteScalar(state),RubikEdge::FaceTurn(a).PermuteShuffle(state));
+    }
+  }
+#endif
+}
+
+TEST(ExternalSort, SortMergeAndPrefetch){
+  WorkerPool pool(3);
+  srandom(11);
+  std::vector<uint64_t> a, b;
+  // the high bits of b are the same, so the sort skips those digits
+  for(int i(0); i<100000; ++i){
+    a.push_back(((uint64_t)random()<<33)^random());
+    b.push_back((0xABCDull<<40)|(random()%50000));
+  }
+  for(auto* v:{&a,&b}){
+    std::vector<uint64_t> expected(*v), scratch(v->size());
+    std::sort(expected.begin(),expected.end());
+    RadixSort(v->data(),v->size(),scratch.data(),&pool);
+    ASSERT_TRUE(expected==*v);
+  }
+  std::vector<uint64_t> unique(b);
+  unique.erase(std::unique(unique.begin(),unique.end()),unique.end());
+  std::random_shuffle(b.begin(),b.end());
+  size_t duplicates(b.size()-unique.size());
+  ASSERT_EQ(duplicates,SortAndUnique(b));
+  ASSERT_TRUE(unique==b);
+
+  // closed runs of every 3rd and every 5th value; the runs overlap
+  std::vector<uint64_t> run1, run2, states;
+  for(uint64_t x(0); x<200000; ++x){
+    if(x%3==0) run1.push_back(x);
+    if(x%5==0) run2.push_back(x);
+    states.push_back(x);
+  }
+  SortedRunFile closed;
+  ASSERT_TRUE(closed.Open("/tmp/hog2-sorted-runs"));
+  closed.AddRun(run1);
+  closed.AddRun(run2);
+  ASSERT_EQ(2,closed.NumRuns());
+  ASSERT_EQ(run1.size()+run2.size(),closed.size());
+  size_t removed(closed.Subtract(states));
+  ASSERT_EQ(200000,removed+states.size());
+  for(uint64_t x:states)
+    ASSERT_TRUE(x%3!=0 && x%5!=0);
+  closed.Close();
+  remove("/tmp/hog2-sorted-runs");
+
+  SortedIndex index(states);
+  for(uint64_t x(0); x<200010; ++x)
+    ASSERT_EQ(x<200000 && x%3!=0 && x%5!=0,index.Contains(x));
+  ASSERT_EQ(states.size(),index.Count(run1.data(),0)+index.Count(states.data(),states.size()));
+
+  // blocks that don't divide the count and a count that stops early
+  FILE *f(tmpfile());
+  fwrite(a.data(),sizeof(uint64_t),a.size(),f);
+  for(uint64_t count:{(uint64_t)a.size(),(uint64_t)77777,(uint64_t)~0ull}){
+    rewind(f);
+    PrefetchReader reader(f,count,1000);
+    std::vector<uint64_t> read;
+    size_t n;
+    for(uint64_t* block(reader.Next(n)); block; block=reader.Next(n))
+      read.insert(read.end(),block,block+n);
+    ASSERT_EQ(std::min<uint64_t>(count,a.size()),read.size());
+    ASSERT_TRUE(std::equal(read.begin(),read.end(),a.begin()));
+  }
+  fclose(f);
+}
+
+TEST(ExternalSort, SpillAndMerge){
+  srandom(13);
+  std::vector<uint64_t> values, run1, run2;
+  for(int i(0); i<50000; ++i)
+    values.push_back(random()%30000);
+  for(uint64_t x(0); x<30000; x+=7) run1.push_back(x);
+  for(uint64_t x(5); x<30000; x+=11) run2.push_back(x);
+  SortedRunFile closed;
+  ASSERT_TRUE(closed.Open("/tmp/hog2-spill-closed"));
+  closed.AddRun(run1);
+  closed.AddRun(run2);
+  std::vector<uint64_t> expected(values);
+  SortAndUnique(expected);
+  closed.Subtract(expected);
+
+  // the bucket is sorted in parts of 4000 values that are merged against closed
+  FILE *f(tmpfile());
+  fwrite(values.data(),sizeof(uint64_t),values.size(),f);
+  rewind(f);
+  SortedRunFile runs, merged;
+  ASSERT_TRUE(runs.Open("/tmp/hog2-spill-runs"));
+  ASSERT_TRUE(merged.Open("/tmp/hog2-spill-merged"));
+  std::vector<uint64_t> buffer;
+  runs.AddRuns(f,buffer,4000);
+  fclose(f);
+  ASSERT_EQ(13,runs.NumRuns());
+  ASSERT_TRUE(buffer.empty());
+  ASSERT_EQ(expected.size(),runs.Merge({&closed},merged));
+  ASSERT_EQ(1,merged.NumRuns());
+  ASSERT_EQ(expected.size(),merged.RunSize(0));
+  std::vector<uint64_t> read;
+  for(uint64_t from(0); merged.ReadRun(0,from,buffer,3000)!=0; from+=buffer.size())
+    read.insert(read.end(),buffer.begin(),buffer.end());
+  ASSERT_TRUE(expected==read);
+  // without anything to subtract the runs are just combined
+  SortAndUnique(values);
+  ASSERT_EQ(values.size(),runs.Merge({},merged));
+  ASSERT_EQ(values.size(),merged.ReadRun(1,0,buffer,~0ull));
+  ASSERT_TRUE(values==buffer);
+  runs.Close();
+  closed.Close();
+  merged.Close();
+  remove("/tmp/hog2-spill-runs");
+  remove("/tmp/hog2-spill-closed");
+  remove("/tmp/hog2-spill-merged");
+}
+
+// One cop (min) and one robber (max) on an undirected graph; both can pass
+struct OneCopGame{
+  std::vector<std::vector<uint64_t>> adj;
+  uint64_t n() const {return adj.size();}
+  uint64_t GetNumStates() const {return n()*n();}
+  bool IsTerminal(uint64_t rank) const {return rank/n()==rank%n();}
+  int GetNumMaxMoves(uint64_t rank) const {return adj[rank/n()].size()+1;}
+  // rank is robber*n+cop
+  void GetMinPredecessors(uint64_t rank, std::vector<uint64_t> &p) const {
+    p.assign(1,rank);
+    for(uint64_t c:adj[rank%n()]) p.push_back(rank-rank%n()+c);
+  }
+  void GetMaxPredecessors(uint64_t rank, std::vector<uint64_t> &p) const {
+    p.clear();
+    uint64_t r(rank/n()), c(rank%n());
+    if(r!=c) p.push_back(rank);
+    for(uint64_t x:adj[r]) if(x!=c) p.push_back(x*n()+c);
+  }
+};
+
+TEST(RetrogradeSolver, OneCopValues){
+  const uint32_t inf(RetrogradeSolver<OneCopGame>::kUnsolved);
+  OneCopGame tree, cycle;
+  // a tree is cop-win, a cycle of 5 is not
+  tree.adj={{1,2},{0,3,4},{0,5},{1},{1,6},{2},{4}};
+  cycle.adj={{1,4},{0,2},{1,3},{2,4},{3,0}};
+  for(OneCopGame* g:{&tree,&cycle}){
+    // value iteration: cop to move (min) and robber to move (max)
+    uint64_t n(g->n());
+    std::vector<uint32_t> copValue(n*n,inf), robberValue(n*n,inf);
+    for(uint64_t x(0); x<n*n; ++x)
+      if(g->IsTerminal(x)) copValue[x]=robberValue[x]=0;
+    for(bool changed(true); changed;){
+      changed=false;
+      for(uint64_t x(0); x<n*n; ++x){
+        if(g->IsTerminal(x)) continue;
+        uint64_t r(x/n), c(x%n);
+        uint32_t best(robberValue[x]);
+        for(uint64_t to:g->adj[c]) best=std::min(best,robberValue[r*n+to]);
+        if(best!=inf && best+1<copValue[x]){copValue[x]=best+1; changed=true;}
+        uint32_t worst(copValue[x]);
+        for(uint64_t to:g->adj[r]) worst=std::max(worst,copValue[to*n+c]);
+        if(worst!=inf && worst+1<robberValue[x]){robberValue[x]=worst+1; changed=true;}
+      }
+    }
+    for(int threads:{1,3}){
+      RetrogradeSolver<OneCopGame> solver(*g);
+      solver.Solve(threads);
+      ASSERT_TRUE(solver.IsSolved());
+      for(uint64_t x(0); x<n*n; ++x)
+        ASSERT_EQ(copValue[x],solver.GetValue(x));
+    }
+    ASSERT_EQ(g==&tree,std::count(copValue.begin(),copValue.end(),inf)==0);
+  }
+}
+
+// The max over the pivots one at a time, to compare with the vector max
+class PivotMajorDistanceHeuristic : public GraphDistanceHeuristic {
+public:
+  PivotMajorDistanceHeuristic(Graph* g):GraphDistanceHeuristic(g){}
+  double HCost(const graphState &a, const graphState &b) const {
+    double val(0);
+    for(int i(0); i<GetNumHeuristics(); ++i)
+      val=std::max(val,fabs(Distance(i,a)-Distance(i,b)));
+    return val;
+  }
+};
+
+TEST(GraphDistanceHeuristic, NodeMajorLookups){
+  // a random graph with irrational weights and two nodes no pivot reaches
+  srandom(42);
+  Graph g;
+  for(int i(0); i<300; ++i) g.AddNode(new node(""));
+  for(int i(1); i<298; ++i){
+    g.AddEdge(new edge(i-1,i,1+sqrt(random()%100)));
+    g.AddEdge(new edge(random()%298,i,1+sqrt(random()%100)));
+  }
+  g.AddEdge(new edge(298,299,1.5));
+  std::vector<graphState> pivots{0,17,150,296,3,250,77,200,11};
+  GraphDistanceHeuristic serial(&g), parallel(&g);
+  for(graphState p:pivots) serial.AddHeuristic(g.GetNode(p));
+  parallel.AddHeuristics(pivots,3);
+  ASSERT_EQ(pivots.size(),parallel.GetNumHeuristics());
+  ASSERT_TRUE(parallel.Save("/tmp/hog2-dh"));
+  PivotMajorDistanceHeuristic exact(&g);
+  ASSERT_TRUE(exact.Load("/tmp/hog2-dh"));
+  remove("/tmp/hog2-dh");
+  ASSERT_EQ(pivots.size(),exact.GetNumHeuristics());
+  for(graphState a(0); a<300; ++a)
+    for(graphState b(0); b<300; ++b){
+      ASSERT_EQ(exact.HCost(a,b),serial.HCost(a,b));
+      ASSERT_EQ(exact.HCost(a,b),parallel.HCost(a,b));
+    }
+}
+
+TEST(VoxelOctree, MatchesDenseGrid){
+  // a world that isn't a multiple of 4 voxels, with a full corner block
+  const int sx(37), sy(22), sz(70);
+  srandom(7);
+  std::vector<bool> dense(sx*sy*sz,false);
+  auto at=[&](int x,int y,int z){return (x*sy+y)*sz+z;};
+  for(int i(0); i<sx*sy*sz/6; ++i) dense[random()%dense.size()]=true;
+  for(int x(0); x<16; ++x) for(int y(0); y<16; ++y) for(int z(0); z<16; ++z) dense[at(x,y,z)]=true;
+  std::vector<uint64_t> morton, blocked;
+  for(int bx(0); bx<(sx+3)/4; ++bx)
+    for(int by(0); by<(sy+3)/4; ++by)
+      for(int bz(0); bz<(sz+3)/4; ++bz){
+        uint64_t mask(0);
+        for(int i(0); i<64; ++i){
+          int x(4*bx+i/16), y(4*by+i/4%4), z(4*bz+i%4);
+          // voxels past the end are set too, as in the files
+          if(x>=sx || y>=sy || z>=sz || dense[at(x,y,z)]) mask|=1ull<<VoxelOctree::BrickBit(i/16,i/4%4,i%4);
+        }
+        // add some bricks twice, in pieces, and out of order
+        morton.insert(morton.begin(),VoxelOctree::EncodeMorton(bx,by,bz));
+        blocked.insert(blocked.begin(),mask&0xFFFFFFFF);
+        morton.push_back(VoxelOctree::EncodeMorton(bx,by,bz));
+        blocked.push_back(mask);
+      }
+  VoxelOctree tree;
+  tree.Build(&morton[0],&blocked[0],morton.size(),sx,sy,sz);
+  ASSERT_EQ(4,tree.GetNumLevels());
+  auto isBlocked=[&](int x,int y,int z){return x<0 || y<0 || z<0 || x>=sx || y>=sy || z>=sz || dense[at(x,y,z)];};
+  for(int x(-1); x<=sx; ++x)
+    for(int y(-1); y<=sy; ++y)
+      for(int z(-1); z<=sz; ++z){
+        ASSERT_EQ(isBlocked(x,y,z),tree.IsBlocked(x,y,z));
+        uint32_t free(0);
+        for(int i(0); i<27; ++i)
+          if(!isBlocked(x+i/9-1,y+i/3%3-1,z+i%3-1)) free|=1u<<i;
+        ASSERT_EQ(free,tree.GetFreeNeighborhood(x,y,z));
+        for(int level(0); level<tree.GetNumLevels(); ++level){
+          // the aligned region of 4^level voxels, clipped to the world
+          int side(1<<(2*level)), blockedCount(0), count(0);
+          for(int i(x/side*side); i<std::min(sx,(x/side+1)*side); ++i)
+            for(int j(y/side*side); j<std::min(sy,(y/side+1)*side); ++j)
+              for(int k(z/side*side); k<std::min(sz,(z/side+1)*side); ++k){
+                ++count;
+                blockedCount+=dense[at(i,j,k)];
+              }
+          bool inside((x/side+1)*side<=sx && (y/side+1)*side<=sy && (z/side+1)*side<=sz);
+          VoxelOctree::tRegion r(tree.GetRegion(level,x,y,z));
+          if(x<0 || y<0 || z<0 || x>=sx || y>=sy || z>=sz || (inside && blockedCount==count)) ASSERT_EQ(VoxelOctree::kBlockedRegion,r);
+          else if(blockedCount==0) ASSERT_EQ(VoxelOctree::kFreeRegion,r);
+          else ASSERT_EQ(VoxelOctree::kMixedRegion,r);
+        }
+      }
+}
+
+// Layer sizes from a plain BFS over all ranks
+template <class state, class environment>
+std::vector<uint64_t> GetBFSLayers(environment &env, const state &start){
+  std::vector<int> depth(env.GetMaxHash(),-1);
+  std::vector<uint64_t> layers;
+  std::deque<state> q{start};
+  std::vector<state> succ;
+  depth[env.GetStateHash(start)]=0;
+  while(!q.empty()){
+    state s(q.front());
+    q.pop_front();
+    int d(depth[env.GetStateHash(s)]);
+    if(layers.size()<=d) layers.push_back(0);
+    ++layers[d];
+    env.GetSuccessors(s,succ);
+    for(auto const& c:succ)
+      if(depth[env.GetStateHash(c)]==-1){
+        depth[env.GetStateHash(c)]=d+1;
+        q.push_back(c);
+      }
+  }
+  return layers;
+}
+
+TEST(ParallelFrontierBFS, MatchesSerialLayers){
+  TOH<7> toh;
+  TOHState<7> tohStart;
+  PancakePuzzle pancake(8);
+  PancakePuzzleState pancakeStart(8);
+  TopSpin topspin(9,4);
+  TopSpinState topspinStart(9,4);
+  for(int threads:{1,3}){
+    ParallelFrontierBFS<TOHState<7>,TOHMove,TOH<7>> bfs1;
+    bfs1.DoBFS(&toh,tohStart,threads);
+    ASSERT_EQ(GetBFSLayers(toh,tohStart),bfs1.GetLayerCounts());
+    ASSERT_EQ(toh.GetMaxHash(),bfs1.GetNumReached());
+    ParallelFrontierBFS<PancakePuzzleState,PancakePuzzleAction,PancakePuzzle> bfs2;
+    bfs2.DoBFS(&pancake,pancakeStart,threads);
+    ASSERT_EQ(GetBFSLayers(pancake,pancakeStart),bfs2.GetLayerCounts());
+    ParallelFrontierBFS<TopSpinState,TopSpinAction,TopSpin> bfs3;
+    bfs3.DoBFS(&topspin,topspinStart,threads);
+    ASSERT_EQ(GetBFSLayers(topspin,topspinStart),bfs3.GetLayerCounts());
+    // the 4-tile turns are even permutations
+    ASSERT_EQ(topspin.GetMaxHash()/2,bfs3.GetNumReached());
+    ASSERT_TRUE(bfs3.Reached(topspin.GetStateHash(topspinStart)));
+  }
+}
+
+TEST(PackedTOH, MatchesTOH){
+  TOH<6> toh;
+  PackedTOH<6> packed;
+  TOHState<6> s;
+  PackedTOHState<6> p;
+  std::vector<TOHMove> a1, a2;
+  std::vector<TOHState<6>> s1;
+  std::vector<PackedTOHState<6>> s2;
+  Successor<PackedTOHState<6>,TOHMove> batch[6];
+  ASSERT_EQ(toh.GetStateHash(s),p.pegs);
+  for(uint64_t r(0); r<toh.GetMaxHash(); ++r){
+    toh.GetStateFromHash(r,s);
+    p.pegs=r;
+    toh.GetActions(s,a1);
+    packed.GetActions(p,a2);
+    ASSERT_EQ(a1,a2);
+    toh.GetSuccessors(s,s1);
+    packed.GetSuccessors(p,s2);
+    ASSERT_EQ(s1.size(),packed.GetSuccessorBatch(p,batch,true));
+    ASSERT_EQ(s1.size(),s2.size());
+    for(unsigned i(0); i<s1.size(); ++i){
+      ASSERT_EQ(toh.GetStateHash(s1[i]),s2[i].pegs);
+      ASSERT_EQ(s2[i].pegs,batch[i].hash);
+      ASSERT_EQ(a2[i],batch[i].a);
+      TOHMove m(a2[i]);
+      packed.InvertAction(m);
+      packed.ApplyAction(s2[i],m);
+      ASSERT_EQ(p,s2[i]);
+    }
+  }
+}
+
+TEST(PackedTOH, AdditivePDBs){
+  PackedTOH<7> env;
+  std::vector<PackedTOHState<7>> succ;
+  for(uint64_t goalRank:{(uint64_t)0x3FFF,(uint64_t)1234}){
+    PackedTOHState<7> goal;
+    goal.pegs=goalRank;
+    // distances to the goal
+    std::vector<int> dist(env.GetMaxHash(),-1);
+    std::deque<PackedTOHState<7>> q{goal};
+    dist[goal.pegs]=0;
+    while(!q.empty()){
+      env.GetSuccessors(q.front(),succ);
+      for(auto const& c:succ)
+        if(dist[c.pegs]==-1){
+          dist[c.pegs]=dist[q.front().pegs]+1;
+          q.push_back(c);
+        }
+      q.pop_front();
+    }
+    for(int threads:{1,3}){
+      PackedTOHPDB<7> exact({7}), additive({2,2,3});
+      exact.BuildPDBs(goal,threads);
+      additive.BuildPDBs(goal,threads);
+      // the two 2-disk groups share a table when their goals are the same
+      ASSERT_EQ(goalRank==0x3FFF?16+64:16+16+64,additive.GetMemoryBytes());
+      PackedTOHState<7> s;
+      for(uint64_t r(0); r<env.GetMaxHash(); ++r){
+        s.pegs=r;
+        ASSERT_EQ(dist[r],exact.HCost(s,goal));
+        ASSERT_LE(additive.HCost(s,goal),dist[r]);
+        env.GetSuccessors(s,succ);
+        for(auto const& c:succ)
+          ASSERT_LE(fabs(additive.HCost(s,goal)-additive.HCost(c,goal)),1);
+      }
+    }
+  }
+}
+
 #endif
@@ -257,6 +257,29 @@ uint8_t *DiskBitFile::ReadChunk(int bucket, int64_t offset, int numEntries, uint
 	return data;
 }
 
+void DiskBitFile::WriteChunk(int bucket, int64_t offset, int numEntries, const uint8_t *data)
+{
+	int64_t subBucket = (offset*BITS/8)>>subBucketBits;
+	offset -= subBucket*(1<<subBucketBits)*8/BITS;
+	assert(0 == offset%2);
+
+	// don't leave stale data in the other handles
+	CloseReadFile();
+	FlushCache();
+	CloseReadWriteFile();
+	FILE *f = fopen(getBucketFileName(bucket, subBucket), "r+");
+	if (f == 0)
+	{
+		printf("Unable to open file %s\n", getBucketFileName(bucket, subBucket));
+		exit(0);
+	}
+	fseek(f, offset*BITS/8, SEEK_SET);
+	int alignedSize = (numEntries*BITS+7)/8;
+	fwrite(data, sizeof(uint8_t), alignedSize, f);
+	bytesWritten += alignedSize;
+	fclose(f);
+}
+
 void DiskBitFile::FlushCache()
 {
 	if (cacheChanged)
@@ -274,9 +297,9 @@ void DiskBitFile::FlushCache()
 
 void DiskBitFile::Init(const std::vector<bucketData> &buckets)
 {
-	int subBucket = 0;
 	for (unsigned int x = 0; x < buckets.size(); x++)
 	{
+		int subBucket = 0;
 		printf("Bucket %d has %llu entries\n", x, buckets[x].theSize);
 		
 		FILE *f = fopen(getBucketFileName(x, subBucket), "w");
@@ -295,7 +318,7 @@ void DiskBitFile::Init(const std::vector<bucketData> &buckets)
 			{
 				fclose(f);
 				subBucket = currSubBucket;
-				FILE *f = fopen(getBucketFileName(x, subBucket), "w");
+				f = fopen(getBucketFileName(x, subBucket), "w");
 				if (f == 0)
 				{ printf("Error opening file '%s'\n", getBucketFileName(x, subBucket)); exit(0); }
 			}
@@ -34,12 +34,14 @@ public:
 	
 	uint8_t *ReadChunk(int bucket, int64_t offset, int numEntries, uint8_t *data);
 	void CloseReadFile();
+	// writes a chunk in the ReadChunk format; offset must be even
+	void WriteChunk(int bucket, int64_t offset, int numEntries, const uint8_t *data);
+	const char *getBucketFileName(int bucket, int subBucket);
 
 	uint64_t GetBytesRead() const { return bytesRead; }
 	uint64_t GetBytesWritten() const { return bytesWritten; }
 private:
 	void FlushCache();
-	const char *getBucketFileName(int bucket, int subBucket);
 
 	// data for reading and writing depths
 	FILE *outputFile;
@@ -0,0 +1,467 @@
+//
+//  ExternalSort.h
+//  hog2
+//
+//  Sort- and merge-based duplicate detection for external-memory searches
+//  that store states as 64-bit ranks in bucket files.
+//
+
+#ifndef ExternalSort_h
+#define ExternalSort_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <future>
+#include <algorithm>
+#include <functional>
+#include "WorkerPool.h"
+
+/*
+ * An external search keeps the states of each (direction, depth, bucket) in a
+ * file and removes duplicates when a bucket is read back. Rather than putting
+ * the bucket into a hash set and probing it with every state of the closed
+ * list, the bucket is sorted and made unique, then merged with the closed
+ * list, which is kept in sorted runs. The closed list is read sequentially in
+ * large blocks, the next block being read while the current one is merged.
+ * A sorted bucket takes 8 bytes per state in memory.
+ */
+
+/**
+ * Sorts data (stable LSD radix sort on 8-bit digits); scratch must have room
+ * for count values. Digits that are the same in all values are skipped. The
+ * passes are split over the threads of pool if it is given; only one sort can
+ * use a pool at a time.
+ */
+inline void RadixSort(uint64_t *data, size_t count, uint64_t *scratch, WorkerPool *pool = 0)
+{
+	if (count < 1024)
+	{
+		std::sort(data, data+count);
+		return;
+	}
+	uint64_t differ = 0;
+	for (size_t x = 1; x < count; x++)
+		differ |= data[x]^data[0];
+
+	const int numThreads = pool?pool->NumThreads():1;
+	auto run = [pool](const std::function<void(int)> &job) { if (pool) pool->Run(job); else job(0); };
+	std::vector<size_t> offsets(256*numThreads);
+	uint64_t *from = data, *to = scratch;
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		if (((differ>>shift)&0xFF) == 0)
+			continue;
+		run([&](int t) {
+			size_t *c = &offsets[256*t];
+			std::fill(c, c+256, 0);
+			for (size_t x = count*t/numThreads; x < count*(t+1)/numThreads; x++)
+				c[(from[x]>>shift)&0xFF]++;
+		});
+		// digits in order, and within a digit the threads in order, keep the sort stable
+		size_t sum = 0;
+		for (int d = 0; d < 256; d++)
+		{
+			for (int t = 0; t < numThreads; t++)
+			{
+				size_t c = offsets[256*t+d];
+				offsets[256*t+d] = sum;
+				sum += c;
+			}
+		}
+		run([&](int t) {
+			size_t *c = &offsets[256*t];
+			for (size_t x = count*t/numThreads; x < count*(t+1)/numThreads; x++)
+				to[c[(from[x]>>shift)&0xFF]++] = from[x];
+		});
+		std::swap(from, to);
+	}
+	if (from != data)
+		memcpy(data, from, count*sizeof(uint64_t));
+}
+
+/** Sorts values and removes duplicates; returns the number removed */
+inline size_t SortAndUnique(std::vector<uint64_t> &values, WorkerPool *pool = 0)
+{
+	std::vector<uint64_t> scratch(values.size());
+	RadixSort(values.data(), values.size(), scratch.data(), pool);
+	size_t before = values.size();
+	values.erase(std::unique(values.begin(), values.end()), values.end());
+	return before-values.size();
+}
+
+/**
+ * Reads up to max values from the current position of f, appending to values;
+ * returns the number read
+ */
+inline size_t ReadValues(FILE *f, std::vector<uint64_t> &values, uint64_t max = ~0ull)
+{
+	off_t start = ftello(f);
+	fseeko(f, 0, SEEK_END);
+	size_t count = (size_t)std::min<uint64_t>(max, (ftello(f)-start)/sizeof(uint64_t));
+	fseeko(f, start, SEEK_SET);
+	size_t before = values.size();
+	values.resize(before+count);
+	values.resize(before+fread(values.data()+before, sizeof(uint64_t), count, f));
+	return values.size()-before;
+}
+
+/*
+ * Membership tests on a sorted and unique vector (e.g. to check the states of
+ * the opposite open list against a bucket). The top bits of value-min index a
+ * table of positions with about one value per entry, so a lookup usually
+ * touches one or two cache lines. The vector must not change while in use.
+ */
+class SortedIndex {
+public:
+	SortedIndex(const std::vector<uint64_t> &sorted)
+	:sorted(sorted), shift(0)
+	{
+		if (sorted.empty())
+			return;
+		uint64_t range = sorted.back()-sorted.front();
+		while ((range>>shift) >= sorted.size())
+			shift++;
+		starts.resize((size_t)(range>>shift)+2);
+		size_t next = 0;
+		for (size_t x = 0; x < sorted.size(); x++)
+		{
+			size_t slot = (size_t)((sorted[x]-sorted.front())>>shift);
+			while (next <= slot)
+				starts[next++] = x;
+		}
+		while (next < starts.size())
+			starts[next++] = sorted.size();
+	}
+	bool Contains(uint64_t value) const
+	{
+		if (sorted.empty() || value < sorted.front() || value > sorted.back())
+			return false;
+		size_t slot = (size_t)((value-sorted.front())>>shift);
+		auto i = std::lower_bound(sorted.begin()+starts[slot], sorted.begin()+starts[slot+1], value);
+		return i != sorted.begin()+starts[slot+1] && *i == value;
+	}
+	/** The number of values that are in the vector */
+	size_t Count(const uint64_t *values, size_t count) const
+	{
+		size_t found = 0;
+		for (size_t x = 0; x < count; x++)
+			found += Contains(values[x]);
+		return found;
+	}
+private:
+	const std::vector<uint64_t> &sorted;
+	int shift;
+	std::vector<size_t> starts;
+};
+
+/*
+ * Reads up to count values from the current position of f, one block at a
+ * time. After the first block, the next block is read on another thread while
+ * the caller works on the current one. Nothing else may use f until the reader
+ * is destroyed.
+ */
+class PrefetchReader {
+public:
+	PrefetchReader(FILE *f, uint64_t count = ~0ull, size_t blockSize = 1<<16)
+	:f(f), remaining(count), requested(0), next(0)
+	{
+		off_t start = ftello(f);
+		fseeko(f, 0, SEEK_END);
+		remaining = std::min(remaining, (uint64_t)(ftello(f)-start)/sizeof(uint64_t));
+		fseeko(f, start, SEEK_SET);
+		// small files don't need full blocks
+		blockSize = (size_t)std::min<uint64_t>(blockSize, remaining);
+		buffers[0].resize(blockSize);
+		buffers[1].resize(blockSize);
+		// the caller waits for the first block anyway
+		Prefetch(std::launch::deferred);
+	}
+	~PrefetchReader() { if (pending.valid()) pending.wait(); }
+	PrefetchReader(const PrefetchReader &) = delete;
+	PrefetchReader &operator=(const PrefetchReader &) = delete;
+
+	/** The next block, the caller's until the following call; null at the end */
+	uint64_t *Next(size_t &count)
+	{
+		count = 0;
+		if (!pending.valid())
+			return 0;
+		count = pending.get();
+		remaining = (count < requested)?0:remaining-count;
+		uint64_t *block = buffers[next].data();
+		next = 1-next;
+		Prefetch(std::launch::async);
+		return (count == 0)?0:block;
+	}
+private:
+	void Prefetch(std::launch policy)
+	{
+		requested = (size_t)std::min<uint64_t>(remaining, buffers[next].size());
+		if (requested == 0)
+			return;
+		FILE *file = f;
+		uint64_t *into = buffers[next].data();
+		size_t n = requested;
+		pending = std::async(policy, [file, into, n]() { return fread(into, sizeof(uint64_t), n, file); });
+	}
+
+	FILE *f;
+	uint64_t remaining;
+	size_t requested;
+	int next;
+	std::vector<uint64_t> buffers[2];
+	std::future<size_t> pending;
+};
+
+/*
+ * A closed list file: a sequence of runs, each sorted and without duplicates.
+ * A bucket can be closed more than once (e.g. MM expands the same g-cost and
+ * bucket at several priorities), so each closing adds a run rather than
+ * rewriting the file. The run lengths are kept in memory.
+ *
+ * A bucket that is too large to sort in memory is sorted in parts, each added
+ * as a run to a file of its own, and Merge then combines those runs while
+ * removing the closed states, reading every run a block at a time. Only the
+ * blocks are in memory, so the size of a bucket is limited by the disk.
+ */
+class SortedRunFile {
+public:
+	SortedRunFile() :f(0), total(0) {}
+	~SortedRunFile() { Close(); }
+	SortedRunFile(const SortedRunFile &) = delete;
+	SortedRunFile &operator=(const SortedRunFile &) = delete;
+
+	/** Creates (or truncates) the file */
+	bool Open(const std::string &name)
+	{
+		Close();
+		f = fopen(name.c_str(), "w+b");
+		return f != 0;
+	}
+	bool IsOpen() const { return f != 0; }
+	void Close()
+	{
+		if (f)
+			fclose(f);
+		f = 0;
+		runs.clear();
+		total = 0;
+	}
+	uint64_t size() const { return total; }
+	size_t NumRuns() const { return runs.size(); }
+
+	/** Appends a run; data must be sorted and unique */
+	void AddRun(const uint64_t *data, size_t count)
+	{
+		if (count == 0)
+			return;
+		fseeko(f, 0, SEEK_END);
+		count = fwrite(data, sizeof(uint64_t), count, f);
+		runs.push_back(count);
+		total += count;
+	}
+	void AddRun(const std::vector<uint64_t> &data) { AddRun(data.data(), data.size()); }
+
+	/**
+	 * Reads in from its current position to the end in parts of at most
+	 * maxValues values, adding each part as a run once it is sorted and unique.
+	 * values is used as the buffer and is left empty.
+	 */
+	void AddRuns(FILE *in, std::vector<uint64_t> &values, size_t maxValues, WorkerPool *pool = 0)
+	{
+		values.clear();
+		while (ReadValues(in, values, maxValues) != 0)
+		{
+			SortAndUnique(values, pool);
+			AddRun(values);
+			values.clear();
+		}
+	}
+
+	uint64_t RunSize(size_t run) const { return runs[run]; }
+
+	/**
+	 * Replaces values with up to maxValues values of a run, starting with its
+	 * from'th value; returns the number read
+	 */
+	size_t ReadRun(size_t run, uint64_t from, std::vector<uint64_t> &values, size_t maxValues)
+	{
+		values.clear();
+		if (run >= runs.size() || from >= runs[run])
+			return 0;
+		fseeko(f, (off_t)((RunStart(run)+from)*sizeof(uint64_t)), SEEK_SET);
+		return ReadValues(f, values, std::min<uint64_t>(maxValues, runs[run]-from));
+	}
+
+	/**
+	 * Merges the runs and writes the result, sorted, to the end of out. A
+	 * value that is in more than one run is written once; a value that is in
+	 * any of the files in subtract is not written at all. Returns the number
+	 * of values written. out must not be one of the files being read.
+	 */
+	uint64_t Merge(const std::vector<SortedRunFile *> &subtract, FILE *out, size_t blockSize = 1<<16)
+	{
+		std::vector<RunCursor> in, closed;
+		AddCursors(in, blockSize);
+		for (SortedRunFile *s : subtract)
+			s->AddCursors(closed, blockSize);
+		// a heap of the runs ordered by their next value
+		std::vector<RunCursor *> heap;
+		for (RunCursor &c : in)
+			if (!c.Done())
+				heap.push_back(&c);
+		auto later = [](const RunCursor *a, const RunCursor *b) { return a->Value() > b->Value(); };
+		std::make_heap(heap.begin(), heap.end(), later);
+
+		std::vector<uint64_t> buffer;
+		buffer.reserve(blockSize);
+		uint64_t written = 0;
+		bool first = true;
+		uint64_t last = 0;
+		while (!heap.empty())
+		{
+			std::pop_heap(heap.begin(), heap.end(), later);
+			RunCursor *c = heap.back();
+			uint64_t value = c->Value();
+			if (c->Advance())
+				std::push_heap(heap.begin(), heap.end(), later);
+			else
+				heap.pop_back();
+			if (!first && value == last)
+				continue;
+			first = false;
+			last = value;
+			bool found = false;
+			for (size_t x = 0; x < closed.size() && !found; x++)
+				found = closed[x].Skip(value);
+			if (found)
+				continue;
+			buffer.push_back(value);
+			if (buffer.size() == blockSize)
+				written += Write(buffer, out);
+		}
+		written += Write(buffer, out);
+		return written;
+	}
+	/** Merges as above, adding the result to to as one run */
+	uint64_t Merge(const std::vector<SortedRunFile *> &subtract, SortedRunFile &to)
+	{
+		uint64_t count = Merge(subtract, to.f);
+		if (count != 0)
+		{
+			to.runs.push_back(count);
+			to.total += count;
+		}
+		return count;
+	}
+
+	/** Removes the values in the file from sorted (sorted and unique); returns the number removed */
+	size_t Subtract(std::vector<uint64_t> &sorted)
+	{
+		size_t removed = 0;
+		uint64_t start = 0;
+		for (uint64_t run : runs)
+		{
+			fseeko(f, (off_t)(start*sizeof(uint64_t)), SEEK_SET);
+			start += run;
+			PrefetchReader reader(f, run);
+			size_t in = 0, out = 0, n = sorted.size();
+			const uint64_t *block;
+			size_t count;
+			while (in < n && (block = reader.Next(count)) != 0)
+			{
+				for (size_t x = 0; x < count && in < n; x++)
+				{
+					while (in < n && sorted[in] < block[x])
+						sorted[out++] = sorted[in++];
+					if (in < n && sorted[in] == block[x])
+						in++;
+				}
+			}
+			while (in < n)
+				sorted[out++] = sorted[in++];
+			sorted.resize(out);
+			removed += n-out;
+		}
+		return removed;
+	}
+private:
+	/*
+	 * Reads one run a block at a time. Several cursors can read the same file,
+	 * so each seeks before it reads.
+	 */
+	class RunCursor {
+	public:
+		RunCursor(FILE *f, uint64_t start, uint64_t count, size_t blockSize)
+		:f(f), next(start), end(start+count), at(0), valid(0), block((size_t)std::min<uint64_t>(blockSize, count))
+		{ Fill(); }
+		bool Done() const { return at == valid; }
+		uint64_t Value() const { return block[at]; }
+		/** Moves to the next value; returns false at the end of the run */
+		bool Advance()
+		{
+			if (++at == valid)
+				Fill();
+			return at != valid;
+		}
+		/** Moves past the values less than value; returns whether the next one is value */
+		bool Skip(uint64_t value)
+		{
+			while (at != valid && block[valid-1] < value)
+				Fill();
+			if (at == valid)
+				return false;
+			at = std::lower_bound(block.begin()+at, block.begin()+valid, value)-block.begin();
+			return block[at] == value;
+		}
+	private:
+		void Fill()
+		{
+			at = valid = 0;
+			size_t count = (size_t)std::min<uint64_t>(block.size(), end-next);
+			if (count == 0)
+				return;
+			fseeko(f, (off_t)(next*sizeof(uint64_t)), SEEK_SET);
+			valid = fread(block.data(), sizeof(uint64_t), count, f);
+			next = (valid == count)?next+count:end;
+		}
+
+		FILE *f;
+		uint64_t next, end;
+		size_t at, valid;
+		std::vector<uint64_t> block;
+	};
+
+	uint64_t RunStart(size_t run) const
+	{
+		uint64_t start = 0;
+		for (size_t x = 0; x < run; x++)
+			start += runs[x];
+		return start;
+	}
+	void AddCursors(std::vector<RunCursor> &cursors, size_t blockSize)
+	{
+		uint64_t start = 0;
+		for (uint64_t run : runs)
+		{
+			cursors.emplace_back(f, start, run, blockSize);
+			start += run;
+		}
+	}
+	static uint64_t Write(std::vector<uint64_t> &values, FILE *out)
+	{
+		fseeko(out, 0, SEEK_END);
+		size_t count = fwrite(values.data(), sizeof(uint64_t), values.size(), out);
+		values.clear();
+		return count;
+	}
+
+	FILE *f;
+	std::vector<uint64_t> runs;
+	uint64_t total;
+};
+
+#endif /* ExternalSort_h */
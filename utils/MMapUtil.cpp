@@ -92,3 +92,24 @@ void CloseMMap(uint8_t *mem, uint64_t mapSizeBytes, int fd)
 		handle_error("close");
 	}
 }
+
+uint8_t *GetPrivateMMAP(int fd, uint64_t offset, uint64_t mapSizeBytes)
+{
+	uint64_t pageOffset = offset%sysconf(_SC_PAGESIZE);
+	uint8_t *memblock = (uint8_t *)mmap(NULL, mapSizeBytes+pageOffset, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, offset-pageOffset);
+	if (memblock == MAP_FAILED)
+	{
+		perror("mmap");
+		return 0;
+	}
+	return memblock+pageOffset;
+}
+
+void ClosePrivateMMap(uint8_t *mem, uint64_t offset, uint64_t mapSizeBytes)
+{
+	uint64_t pageOffset = offset%sysconf(_SC_PAGESIZE);
+	if (munmap(mem-pageOffset, mapSizeBytes+pageOffset) != 0)
+	{
+		handle_error("unmap");
+	}
+}
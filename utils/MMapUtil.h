@@ -12,4 +12,10 @@
 uint8_t *GetMMAP(const char *filename, uint64_t mapSizeBytes, int &fd, bool zero = false);
 void CloseMMap(uint8_t *mem, uint64_t mapSizeBytes, int fd);
 
+// Maps part of an already open file copy-on-write. The offset does not need to
+// be page aligned; the returned pointer is to the byte at offset, or 0 on failure.
+// Pages that are never written stay shared with other processes mapping the file.
+uint8_t *GetPrivateMMAP(int fd, uint64_t offset, uint64_t mapSizeBytes);
+void ClosePrivateMMap(uint8_t *mem, uint64_t offset, uint64_t mapSizeBytes);
+
 #endif
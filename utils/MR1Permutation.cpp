@@ -61,6 +61,80 @@ void MR1KPermutation::Unrank(uint64_t hash, int *puzzle, int *dual, int distinct
 	}
 }
 
+const int mr1BatchSize = 8;
+
+void MR1KPermutation::RankBatch(int *items, int *dual, int distinctSize, int puzzleSize, int count, uint64_t *hashes) const
+{
+	for (int base = 0; base < count; base += mr1BatchSize)
+	{
+		int num = (count-base < mr1BatchSize)?(count-base):mr1BatchSize;
+		int *locs = items+base*puzzleSize;
+		int *duals = dual+base*puzzleSize;
+		for (int b = 0; b < num; b++)
+			hashes[base+b] = 0;
+		uint64_t multiplier = 1;
+		for (int i = 0; i < distinctSize; i++)
+		{
+			for (int b = 0; b < num; b++)
+			{
+				int *l = locs+b*puzzleSize;
+				int *d = duals+b*puzzleSize;
+				int tmp = d[i];
+				unsigned int tmp2 = l[i];
+				hashes[base+b] += (tmp-i)*multiplier;
+				if (tmp2 < puzzleSize)
+				{
+					swap(l[i], l[d[i]]);
+					swap(d[tmp2], d[i]);
+				}
+			}
+			multiplier *= (puzzleSize-i);
+		}
+	}
+}
+
+// 32-bit division is much faster, so it is used when all the ranks fit
+template <typename rankType>
+static void UnrankGroup(const uint64_t *hashes, int *puzzle, int *d, int distinctSize, int puzzleSize, int num)
+{
+	rankType hash[mr1BatchSize];
+	for (int b = 0; b < num; b++)
+		hash[b] = (rankType)hashes[b];
+	for (int i = 0; i < distinctSize; i++)
+	{
+		rankType divisor = puzzleSize-i;
+		for (int b = 0; b < num; b++)
+		{
+			int *db = d+b*puzzleSize;
+			swap(db[i+hash[b]%divisor], db[i]);
+			hash[b] = hash[b]/divisor;
+			puzzle[b*puzzleSize+db[i]] = i;
+		}
+	}
+}
+
+void MR1KPermutation::UnrankBatch(const uint64_t *hashes, int *items, int *dual, int distinctSize, int puzzleSize, int count) const
+{
+	for (int base = 0; base < count; base += mr1BatchSize)
+	{
+		int num = (count-base < mr1BatchSize)?(count-base):mr1BatchSize;
+		int *puzzle = items+base*puzzleSize;
+		int *d = dual+base*puzzleSize;
+		bool fits32 = true;
+		for (int b = 0; b < num; b++)
+		{
+			fits32 = fits32 && (hashes[base+b] <= 0xFFFFFFFFull);
+			for (int x = 0; x < puzzleSize; x++)
+				d[b*puzzleSize+x] = x;
+		}
+		memset(puzzle, 0xFF, num*puzzleSize*sizeof(puzzle[0]));
+		if (fits32)
+			UnrankGroup<uint32_t>(hashes+base, puzzle, d, distinctSize, puzzleSize, num);
+		else
+			UnrankGroup<uint64_t>(hashes+base, puzzle, d, distinctSize, puzzleSize, num);
+	}
+}
+
 //MR1Permutation::MR1Permutation(std::vector<int> distincts, int permSize, int maxNumThreads)
 //:distinct(distincts), puzzleSize(permSize), distinctSize(distincts.size()),
 // dualCache(maxNumThreads), locsCache(maxNumThreads), valueStack(maxNumThreads)
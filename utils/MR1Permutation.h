@@ -17,6 +17,11 @@ class MR1KPermutation {
 public:
 	uint64_t Rank(int *items, int *dual, int k, int N) const;
 	void Unrank(uint64_t hash, int *items, int *dual, int k, int N) const;
+	// Rank/unrank count permutations stored one after another (N entries
+	// each). Groups of permutations are processed in lockstep so that their
+	// independent swap chains overlap.
+	void RankBatch(int *items, int *dual, int k, int N, int count, uint64_t *hashes) const;
+	void UnrankBatch(const uint64_t *hashes, int *items, int *dual, int k, int N, int count) const;
 };
 
 
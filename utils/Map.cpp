@@ -93,7 +93,7 @@ Tile::Tile()
 * A map is an array of tiles according to the height and width of the map.
 */
 Map::Map(long _width, long _height)
-:width(_height), height(_height), noobs(true)
+:width(_width), height(_height), noobs(true)
 {
   InitTextures();
 
@@ -101,10 +101,10 @@ Map::Map(long _width, long _height)
   tileSet = kFall;
   map_name[0] = 0;
   sizeMultiplier = 1;
-  land = new Tile *[2];
+  land = new Tile *[width];
   //	for (int x = 0; x < 8; x++)
   //		g[x] = 0;
-  for (int x = 0; x < 2; x++) land[x] = new Tile [2];
+  for (int x = 0; x < width; x++) land[x] = new Tile [height];
   drawLand = true;
   dList = 0;
   updated = true;
@@ -180,6 +180,8 @@ public:
 	inline long GetMapWidth() const { return width; }
 	/** return the height of the map */
 	inline long GetMapHeight() const { return height; }
+	/** return how the tiles are interpreted when moving between them */
+	inline tMapType GetMapType() const { return mapType; }
 	
 	void SetTileSet(tTileset ts);
 	tTileset GetTileSet();
@@ -10,13 +10,19 @@
 #define hog2_glut_NBitArray_h
 
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 #include <algorithm>
+#include "MMapUtil.h"
 
 /**
  * This class supports compact n-bit arrays. For (1 <= n <= 64). 
  * It is efficient for powers of two, but less so
  * for non-powers of two. (Currently about 3x slower.)
+ *
+ * The entries can either live on the heap or be mapped copy-on-write from
+ * a file (see MapData), in which case unmodified pages are shared with
+ * every other process that maps the same file.
  */
 template <uint64_t numBits>
 class NBitArray
@@ -33,20 +39,37 @@ public:
 	uint64_t Size() const;
 	uint64_t Get(uint64_t index) const;
 	void Set(uint64_t index, uint64_t val);
+	// Lock-free write of val if it is smaller than the stored value; returns
+	// true if written. Only thread safe when numBits divides 64, so that no
+	// entry spans two words.
+	bool AtomicSetIfLess(uint64_t index, uint64_t val);
+	static bool SupportsAtomicWrites() { return (64%numBits) == 0; }
 
 	bool Write(FILE *);
 	bool Read(FILE *);
 	bool Write(const char *);
 	bool Read(const char *);
+
+	// Raw entry data only; the caller is responsible for recording the size
+	uint64_t DataBytes() const { return memorySize*sizeof(uint64_t); }
+	bool WriteData(FILE *);
+	bool ReadData(FILE *, uint64_t numEntries);
+	bool MapData(FILE *, uint64_t numEntries);
+	bool IsMapped() const { return mapped; }
+	uint64_t Checksum() const;
 private:
+	void Allocate();
+	void Release();
 	uint64_t *mem;
 	uint64_t entries;
 	uint64_t memorySize;
+	bool mapped;
+	uint64_t mapOffset;
 };
 
 template <uint64_t numBits>
 NBitArray<numBits>::NBitArray(uint64_t numEntries)
-:entries(numEntries), memorySize(((entries*numBits+63)/64))
+:entries(numEntries), memorySize(((entries*numBits+63)/64)), mapped(false), mapOffset(0)
 {
 	static_assert(numBits >= 1 && numBits <= 64, "numBits out of bounds!");
 
@@ -55,7 +78,7 @@ NBitArray<numBits>::NBitArray(uint64_t numEntries)
 
 template <uint64_t numBits>
 NBitArray<numBits>::NBitArray(const char *file)
-:mem(0)
+:mem(0), entries(0), memorySize(0), mapped(false), mapOffset(0)
 {
 	static_assert(numBits >= 1 && numBits <= 64, "numBits out of bounds!");
 	Read(file);
@@ -63,6 +86,7 @@ NBitArray<numBits>::NBitArray(const char *file)
 
 template <uint64_t numBits>
 NBitArray<numBits>::NBitArray(const NBitArray &copyMe)
+:mapped(false), mapOffset(0)
 {
 	entries = copyMe.entries;
 	memorySize = copyMe.memorySize;
@@ -74,7 +98,25 @@ NBitArray<numBits>::NBitArray(const NBitArray &copyMe)
 template <uint64_t numBits>
 NBitArray<numBits>::~NBitArray()
 {
-	delete [] mem;
+	Release();
+}
+
+template <uint64_t numBits>
+void NBitArray<numBits>::Allocate()
+{
+	Release();
+	mem = new uint64_t[memorySize];
+}
+
+template <uint64_t numBits>
+void NBitArray<numBits>::Release()
+{
+	if (mapped)
+		ClosePrivateMMap((uint8_t*)mem, mapOffset, memorySize*sizeof(uint64_t));
+	else
+		delete [] mem;
+	mem = 0;
+	mapped = false;
 }
 
 template <uint64_t numBits>
@@ -82,10 +124,9 @@ NBitArray<numBits> &NBitArray<numBits>::operator=(const NBitArray &copyMe)
 {
 	if (this == &copyMe)
 		return *this;
-	delete mem;
 	entries = copyMe.entries;
 	memorySize = copyMe.memorySize;
-	mem = new uint64_t[memorySize];
+	Allocate();
 	memcpy(mem, copyMe.mem, memorySize*sizeof(mem[0]));
 	return *this;
 }
@@ -107,8 +148,7 @@ void NBitArray<numBits>::Resize(uint64_t newMaxEntries)
 {
 	entries = newMaxEntries;
 	memorySize = ((entries*numBits+63)/64);
-	delete [] mem;
-	mem = new uint64_t[memorySize];
+	Allocate();
 }
 
 template <uint64_t numBits>
@@ -141,8 +181,7 @@ bool NBitArray<numBits>::Read(FILE *f)
 	{
 		entries = e1;
 		memorySize = m1;
-		delete [] mem;
-		mem = new uint64_t[memorySize];
+		Allocate();
 		success = success&&(fread(mem, sizeof(uint64_t), memorySize, f) == memorySize);
 	}
 	return success;
@@ -176,6 +215,60 @@ bool NBitArray<numBits>::Read(const char *file)
 	return result;
 }
 
+template <uint64_t numBits>
+bool NBitArray<numBits>::WriteData(FILE *f)
+{
+	return fwrite(mem, sizeof(uint64_t), memorySize, f) == memorySize;
+}
+
+template <uint64_t numBits>
+bool NBitArray<numBits>::ReadData(FILE *f, uint64_t numEntries)
+{
+	entries = numEntries;
+	memorySize = ((entries*numBits+63)/64);
+	Allocate();
+	return fread(mem, sizeof(uint64_t), memorySize, f) == memorySize;
+}
+
+/*
+ * Maps the entries at the current file position instead of reading them, and
+ * moves the file position past them. Writes (Set) only modify the private
+ * copy of the touched pages, never the file.
+ */
+template <uint64_t numBits>
+bool NBitArray<numBits>::MapData(FILE *f, uint64_t numEntries)
+{
+	off_t offset = ftello(f);
+	if (offset < 0)
+		return false;
+	Release();
+	entries = numEntries;
+	memorySize = ((entries*numBits+63)/64);
+	uint8_t *data = GetPrivateMMAP(fileno(f), offset, memorySize*sizeof(uint64_t));
+	if (data == 0)
+	{
+		entries = memorySize = 0;
+		return false;
+	}
+	mem = (uint64_t*)data;
+	mapped = true;
+	mapOffset = offset;
+	return fseeko(f, offset+memorySize*sizeof(uint64_t), SEEK_SET) == 0;
+}
+
+/* 64-bit FNV-1a style hash over the data words, for detecting corrupt files. */
+template <uint64_t numBits>
+uint64_t NBitArray<numBits>::Checksum() const
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (uint64_t x = 0; x < memorySize; x++)
+	{
+		hash ^= mem[x];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
 template <uint64_t numBits>
 uint64_t NBitArray<numBits>::Get(uint64_t index) const
 {
@@ -187,7 +280,9 @@ uint64_t NBitArray<numBits>::Get(uint64_t index) const
 	uint64_t bitMask1 = (1ull<<bitCount1)-1;
 	uint64_t bitMask2 = (1ull<<bitCount2)-1;
 	uint64_t result = (mem[offset1]>>bitOffset1)&bitMask1;
-	result = ((mem[offset1+1]&bitMask2)<<bitCount1) | result;
+	// don't touch the next word unless the entry spans it (it may not be mapped)
+	if (bitCount2 > 0)
+		result = ((mem[offset1+1]&bitMask2)<<bitCount1) | result;
 	return result;
 }
 
@@ -202,11 +297,38 @@ void NBitArray<numBits>::Set(uint64_t index, uint64_t val)
 	uint64_t bitMask1 = (1ull<<bitCount1)-1;
 	uint64_t bitMask2 = (1ull<<bitCount2)-1;
 	mem[offset1] = (mem[offset1]&(~(bitMask1<<bitOffset1))) | ((val&bitMask1)<<bitOffset1);
-	mem[offset1+1] = (mem[offset1+1]&(~(bitMask2))) | ((val>>bitCount1)&bitMask2);
+	if (bitCount2 > 0)
+		mem[offset1+1] = (mem[offset1+1]&(~(bitMask2))) | ((val>>bitCount1)&bitMask2);
 	//	uint64_t result = (mem[offset1]>>bitOffset1)&bitMask1;
 	//	result = ((mem[offset1+1]&bitMask2)<<bitCount2) | result;
 }
 
+template <uint64_t numBits>
+bool NBitArray<numBits>::AtomicSetIfLess(uint64_t index, uint64_t val)
+{
+	if (!SupportsAtomicWrites())
+	{
+		if (val >= Get(index))
+			return false;
+		Set(index, val);
+		return true;
+	}
+	const uint64_t entryMask = (numBits == 64)?(~0ull):((1ull<<(numBits&0x3F))-1);
+	uint64_t startingBit = index*numBits;
+	uint64_t *word = &mem[startingBit/64];
+	uint64_t bitOffset = startingBit&0x3F; // same as mod 64
+	uint64_t oldWord = __atomic_load_n(word, __ATOMIC_RELAXED);
+	while (true)
+	{
+		if (val >= ((oldWord>>bitOffset)&entryMask))
+			return false;
+		uint64_t newWord = (oldWord&(~(entryMask<<bitOffset))) | ((val&entryMask)<<bitOffset);
+		// on failure oldWord is reloaded with the current contents
+		if (__atomic_compare_exchange_n(word, &oldWord, newWord, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return true;
+	}
+}
+
 template <>
 uint64_t NBitArray<64>::Get(uint64_t index) const;
 template <>
@@ -0,0 +1,147 @@
+//
+//  PackedKeyTable.h
+//  hog2
+//
+//  Hash table keyed by fixed-width arrays of 64-bit words.
+//
+
+#ifndef PackedKeyTable_h
+#define PackedKeyTable_h
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+/*
+ * PackedKeyTable
+ *
+ * Replaces maps keyed by strings that were built from a list of integers
+ * (e.g. one state hash per agent). Every key has the same number of words,
+ * so the keys are stored back to back in one array (in insertion order) and
+ * the values in another. The hash slots are open addressed (linear probing)
+ * and hold the index of the entry, so a lookup doesn't allocate and an insert
+ * only grows the arrays.
+ *
+ * Entries can't be removed one at a time; clear() keeps the memory for the
+ * next use. The values are kept in a std::vector, so use uint8_t instead of
+ * bool.
+ */
+template <typename value>
+class PackedKeyTable {
+public:
+	PackedKeyTable(int width = 1) :keyWidth(width), entries(0) { slots.resize(16, empty); }
+	/** Changes the number of words per key. Clears the table. */
+	void SetWidth(int width) { keyWidth = width; clear(); }
+	int GetWidth() const { return keyWidth; }
+	size_t size() const { return entries; }
+	void clear();
+
+	/** Returns the value stored for key, or null */
+	value *find(const uint64_t *key);
+	const value *find(const uint64_t *key) const;
+	/** Returns the value stored for key, inserting a default value if needed */
+	value &operator[](const uint64_t *key);
+
+	/** Entries in insertion order */
+	const uint64_t *GetKey(size_t which) const { return &keys[which*keyWidth]; }
+	value &GetValue(size_t which) { return values[which]; }
+	const value &GetValue(size_t which) const { return values[which]; }
+private:
+	static const uint32_t empty = 0xFFFFFFFF;
+	uint64_t Hash(const uint64_t *key) const;
+	size_t Slot(const uint64_t *key) const;
+	void Grow();
+
+	int keyWidth;
+	size_t entries;
+	std::vector<uint64_t> keys;
+	std::vector<value> values;
+	std::vector<uint32_t> slots; // entry index or empty; the size is a power of 2
+};
+
+template <typename value>
+const uint32_t PackedKeyTable<value>::empty;
+
+template <typename value>
+void PackedKeyTable<value>::clear()
+{
+	if (entries == 0)
+		return;
+	entries = 0;
+	keys.resize(0);
+	values.resize(0);
+	std::fill(slots.begin(), slots.end(), empty);
+}
+
+template <typename value>
+uint64_t PackedKeyTable<value>::Hash(const uint64_t *key) const
+{
+	uint64_t h = 0x9E3779B97F4A7C15ull;
+	for (int x = 0; x < keyWidth; x++)
+	{
+		h ^= key[x];
+		h *= 0xBF58476D1CE4E5B9ull;
+		h ^= h>>31;
+	}
+	return h;
+}
+
+// Slot containing key or the empty slot where it would go
+template <typename value>
+size_t PackedKeyTable<value>::Slot(const uint64_t *key) const
+{
+	size_t mask = slots.size()-1;
+	size_t s = Hash(key)&mask;
+	while (slots[s] != empty && memcmp(&keys[slots[s]*keyWidth], key, keyWidth*sizeof(uint64_t)) != 0)
+		s = (s+1)&mask;
+	return s;
+}
+
+template <typename value>
+void PackedKeyTable<value>::Grow()
+{
+	slots.assign(slots.size()*2, empty);
+	size_t mask = slots.size()-1;
+	for (size_t x = 0; x < entries; x++)
+	{
+		size_t s = Hash(&keys[x*keyWidth])&mask;
+		while (slots[s] != empty)
+			s = (s+1)&mask;
+		slots[s] = (uint32_t)x;
+	}
+}
+
+template <typename value>
+value *PackedKeyTable<value>::find(const uint64_t *key)
+{
+	size_t s = Slot(key);
+	return (slots[s] == empty)?0:&values[slots[s]];
+}
+
+template <typename value>
+const value *PackedKeyTable<value>::find(const uint64_t *key) const
+{
+	size_t s = Slot(key);
+	return (slots[s] == empty)?0:&values[slots[s]];
+}
+
+template <typename value>
+value &PackedKeyTable<value>::operator[](const uint64_t *key)
+{
+	size_t s = Slot(key);
+	if (slots[s] != empty)
+		return values[slots[s]];
+	// keep the load at most 1/2
+	if (2*(entries+1) > slots.size())
+	{
+		Grow();
+		s = Slot(key);
+	}
+	slots[s] = (uint32_t)entries;
+	keys.insert(keys.end(), key, key+keyWidth);
+	values.push_back(value());
+	return values[entries++];
+}
+
+#endif /* PackedKeyTable_h */
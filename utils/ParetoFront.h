@@ -0,0 +1,157 @@
+//
+//  ParetoFront.h
+//  hog2
+//
+//  Set of mutually non-dominated cost vectors, kept sorted so that dominance
+//  checks don't have to look at every vector.
+//
+
+#ifndef ParetoFront_h
+#define ParetoFront_h
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <strings.h>
+#include <cmath>
+#include "FPUtil.h"
+#include "MultiObjective.h"
+
+// Each vector in the front carries a list of ids (for NAMOA*, the parents
+// that reach a node with that cost). Dominance is Pareto dominance with the
+// tolerance of FPUtil: a dominates b if a<=b in every objective and a<b in at
+// least one.
+//
+// The vectors are sorted on the first objective. Only those with a smaller
+// (or equal) first objective can dominate c and only those with a larger (or
+// equal) one can be dominated by it, so a check scans one side of c. For two
+// objectives the second objective then decreases along the front, so the
+// scan stops at the first vector that can't be compared with c; for more
+// objectives the whole side is scanned, so a check is linear in the size of
+// the front. That's cheap for the per-node fronts NAMOAStar keeps (at most 5
+// vectors on a 64x64 grid with three objectives); a large front with three
+// or more objectives would want a k-d tree or a proper skyline structure.
+template <unsigned dim>
+class ParetoFront{
+public:
+  struct Entry{
+    Entry(cost<dim> const& cc):c(cc){}
+    cost<dim> c;
+    std::vector<uint64_t> ids;
+  };
+  typedef typename std::vector<Entry>::const_iterator const_iterator;
+
+  size_t size()const{return front.size();}
+  bool empty()const{return front.empty();}
+  void clear(){front.clear();}
+  const_iterator begin()const{return front.begin();}
+  const_iterator end()const{return front.end();}
+
+  // a<=b in every objective
+  static bool WeaklyDominates(cost<dim> const& a, cost<dim> const& b){
+    for(unsigned i(0); i<dim; ++i)
+      if(!fleq(a.value[i],b.value[i]))
+        return false;
+    return true;
+  }
+  static bool Equal(cost<dim> const& a, cost<dim> const& b){
+    for(unsigned i(0); i<dim; ++i)
+      if(!fequal(a.value[i],b.value[i]))
+        return false;
+    return true;
+  }
+  static bool Dominates(cost<dim> const& a, cost<dim> const& b){
+    return WeaklyDominates(a,b) && !Equal(a,b);
+  }
+
+  // Is some vector in the front strictly better than c?
+  bool Dominates(cost<dim> const& c)const{
+    bool found(false);
+    ScanBelow(c,[&](Entry const& e){
+      if(Dominates(e.c,c)){found=true;}
+      return found;
+    });
+    return found;
+  }
+
+  Entry const* Find(cost<dim> const& c)const{
+    Entry const* found(nullptr);
+    ScanBelow(c,[&](Entry const& e){
+      if(Equal(e.c,c)){found=&e;}
+      return found!=nullptr;
+    });
+    return found;
+  }
+
+  // Removes the vectors that c dominates; returns how many were removed
+  unsigned RemoveDominated(cost<dim> const& c){
+    auto first(std::lower_bound(front.begin(),front.end(),c.value[0]-TOLERANCE,
+      [](Entry const& e, double v){return e.c.value[0]<v;}));
+    if(dim==2){
+      // the dominated vectors are contiguous
+      auto last(first);
+      while(last!=front.end() && !fless(last->c.value[1],c.value[1]))
+        ++last;
+      auto d(std::remove_if(first,last,[&](Entry const& e){return Dominates(c,e.c);}));
+      unsigned removed(last-d);
+      front.erase(d,last);
+      return removed;
+    }
+    auto d(std::remove_if(first,front.end(),[&](Entry const& e){return Dominates(c,e.c);}));
+    unsigned removed(front.end()-d);
+    front.erase(d,front.end());
+    return removed;
+  }
+
+  // Adds id to the list of c unless c is dominated. Vectors dominated by c
+  // are removed. Returns false if c was dominated.
+  bool Insert(cost<dim> const& c, uint64_t id){
+    bool dominated(false);
+    Entry const* same(nullptr);
+    ScanBelow(c,[&](Entry const& e){
+      if(Equal(e.c,c)){same=&e;}
+      else if(WeaklyDominates(e.c,c)){dominated=true;}
+      return dominated || same;
+    });
+    if(dominated) return false;
+    if(same){
+      std::vector<uint64_t>& ids(front[same-&front[0]].ids);
+      if(std::find(ids.begin(),ids.end(),id)==ids.end())
+        ids.push_back(id);
+      return true;
+    }
+    RemoveDominated(c);
+    auto loc(std::upper_bound(front.begin(),front.end(),c.value[0],
+      [](double v, Entry const& e){return v<e.c.value[0];}));
+    loc=front.insert(loc,Entry(c));
+    loc->ids.push_back(id);
+    return true;
+  }
+
+  // Removes c (and its ids) from the front. Returns false if it isn't there.
+  bool Erase(cost<dim> const& c){
+    Entry const* e(Find(c));
+    if(!e) return false;
+    front.erase(front.begin()+(e-&front[0]));
+    return true;
+  }
+
+private:
+  // Calls f on the vectors that could dominate (or equal) c, starting with
+  // the one with the largest first objective, until f returns true.
+  template <typename F>
+  void ScanBelow(cost<dim> const& c, F f)const{
+    auto last(std::upper_bound(front.begin(),front.end(),c.value[0]+TOLERANCE,
+      [](double v, Entry const& e){return v<e.c.value[0];}));
+    while(last!=front.begin()){
+      --last;
+      if(f(*last)) return;
+      // for two objectives the second one only increases from here
+      if(dim==2 && fgreater(last->c.value[1],c.value[1])) return;
+    }
+  }
+
+  std::vector<Entry> front; // sorted on the first objective
+};
+
+#endif
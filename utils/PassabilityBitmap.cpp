@@ -0,0 +1,87 @@
+//
+//  PassabilityBitmap.cpp
+//  hog2
+//
+
+#include "PassabilityBitmap.h"
+
+PassabilityBitmap::PassabilityBitmap(const Map *m, bool groundOnly, bool neighborMasks)
+:groundOnly(groundOnly), useMasks(neighborMasks)
+{
+	Rebuild(m);
+}
+
+bool PassabilityBitmap::CellPassable(const Map *m, long x, long y) const
+{
+	if (groundOnly)
+		return m->GetTerrainType(x, y) == kGround;
+	return m->IsTraversable(x, y);
+}
+
+void PassabilityBitmap::Rebuild(const Map *m)
+{
+	width = m->GetMapWidth();
+	height = m->GetMapHeight();
+	rowBits = ((width+2*kBorder+63)/64)*64;
+	bits.assign(rowBits*(height+2*kBorder)/64, 0);
+	for (long y = 0; y < height; y++)
+		for (long x = 0; x < width; x++)
+			SetBit(x, y, CellPassable(m, x, y));
+
+	masks.resize(0);
+	if (!useMasks)
+		return;
+	masks.resize(width*height);
+	for (long y = 0; y < height; y++)
+		for (long x = 0; x < width; x++)
+			masks[y*width+x] = ComputeNeighborMask(x, y);
+}
+
+void PassabilityBitmap::SetBit(long x, long y, bool passable)
+{
+	uint64_t bit = (uint64_t)(y+kBorder)*rowBits+(uint64_t)(x+kBorder);
+	if (passable)
+		bits[bit>>6] |= (1ull<<(bit&0x3F));
+	else
+		bits[bit>>6] &= ~(1ull<<(bit&0x3F));
+}
+
+void PassabilityBitmap::SetPassable(long x, long y, bool passable)
+{
+	SetBit(x, y, passable);
+	if (masks.size() == 0)
+		return;
+	// the moves of this cell and of its 8 neighbors can change
+	for (long dy = -1; dy <= 1; dy++)
+	{
+		for (long dx = -1; dx <= 1; dx++)
+		{
+			if (x+dx >= 0 && x+dx < width && y+dy >= 0 && y+dy < height)
+				masks[(y+dy)*width+x+dx] = ComputeNeighborMask(x+dx, y+dy);
+		}
+	}
+}
+
+uint8_t PassabilityBitmap::ComputeNeighborMask(long x, long y) const
+{
+	if (!Passable(x, y))
+		return 0;
+	bool n = Passable(x, y-1), s = Passable(x, y+1);
+	bool e = Passable(x+1, y), w = Passable(x-1, y);
+	uint8_t mask = 0;
+	if (n) mask |= kNorth;
+	if (s) mask |= kSouth;
+	if (e) mask |= kEast;
+	if (w) mask |= kWest;
+	// diagonal moves may not cut corners
+	if (n && e && Passable(x+1, y-1)) mask |= kNorthEast;
+	if (n && w && Passable(x-1, y-1)) mask |= kNorthWest;
+	if (s && e && Passable(x+1, y+1)) mask |= kSouthEast;
+	if (s && w && Passable(x-1, y+1)) mask |= kSouthWest;
+	return mask;
+}
+
+uint64_t PassabilityBitmap::GetMemoryBytes() const
+{
+	return bits.size()*sizeof(bits[0])+masks.size()*sizeof(masks[0]);
+}
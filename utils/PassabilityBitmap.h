@@ -0,0 +1,67 @@
+//
+//  PassabilityBitmap.h
+//  hog2
+//
+//  A compact, read-mostly copy of the passable cells of an octile Map.
+//
+
+#ifndef PassabilityBitmap_h
+#define PassabilityBitmap_h
+
+#include <stdint.h>
+#include <vector>
+#include "Map.h"
+
+/**
+ * Stores one bit per cell of an octile map, with each row padded to a whole
+ * number of 64-bit words. A border of kBorder impassable cells surrounds the
+ * map, so lookups up to kBorder cells outside the map need no bounds checks.
+ *
+ * Optionally an 8-bit mask of the legal octile moves (no corner cutting) is
+ * precomputed for every cell, so all neighbors of a cell can be generated
+ * from a single byte.
+ *
+ * The bitmap is a snapshot; call Rebuild() or SetPassable() if the map changes.
+ */
+class PassabilityBitmap {
+public:
+	enum tNeighbor {
+		kNorth = 0x01, kNorthEast = 0x02, kEast = 0x04, kSouthEast = 0x08,
+		kSouth = 0x10, kSouthWest = 0x20, kWest = 0x40, kNorthWest = 0x80
+	};
+	static const int kBorder = 3;
+
+	// groundOnly treats only kGround as passable (as JPS and CanonicalGrid do);
+	// otherwise the rule of Map::IsTraversable is used
+	PassabilityBitmap(const Map *m, bool groundOnly = false, bool neighborMasks = true);
+	void Rebuild(const Map *m);
+
+	inline bool Passable(long x, long y) const
+	{
+		uint64_t bit = (uint64_t)(y+kBorder)*rowBits+(uint64_t)(x+kBorder);
+		return (bits[bit>>6]>>(bit&0x3F))&1;
+	}
+	void SetPassable(long x, long y, bool passable);
+
+	inline uint8_t GetNeighborMask(long x, long y) const
+	{
+		if (masks.size() == 0)
+			return ComputeNeighborMask(x, y);
+		return masks[y*width+x];
+	}
+	uint8_t ComputeNeighborMask(long x, long y) const;
+
+	long GetWidth() const { return width; }
+	long GetHeight() const { return height; }
+	uint64_t GetMemoryBytes() const;
+private:
+	bool CellPassable(const Map *m, long x, long y) const;
+	void SetBit(long x, long y, bool passable);
+	long width, height;
+	uint64_t rowBits;
+	bool groundOnly, useMasks;
+	std::vector<uint64_t> bits;
+	std::vector<uint8_t> masks;
+};
+
+#endif /* PassabilityBitmap_h */
@@ -0,0 +1,113 @@
+//
+//  PermutationBatch.h
+//  hog2
+//
+//  Lexicographic ranking and unranking of k-permutations for a batch of
+//  states at once.
+//
+
+#ifndef PermutationBatch_h
+#define PermutationBatch_h
+
+#include <stdint.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+ * Batches are stored item-major: the location of item i in state b is
+ * locs[i*permutationBatchSize+b], so each step of the O(k^2) rank correction
+ * works on one vector of locations. With AVX2 (build with CPU=AVX2) a batch is
+ * one 256-bit register; otherwise the same loops are compiled as scalar code.
+ *
+ * The ranks are the same as PermutationPDB::GetPDBHash; weights[i] is
+ * (n-1-i)!/(n-k)!. The divisions in unranking and the weighted sum in ranking
+ * stay scalar.
+ */
+const int permutationBatchSize = 8;
+
+/** Ranks a full batch. locs is modified. */
+inline void LexRankBatch(int32_t *locs, const uint64_t *weights, int k, uint64_t *ranks)
+{
+	for (int x = 0; x < k; x++)
+	{
+		int32_t *lx = &locs[x*permutationBatchSize];
+#ifdef __AVX2__
+		__m256i vx = _mm256_loadu_si256((const __m256i*)lx);
+		for (int y = x+1; y < k; y++)
+		{
+			__m256i *ly = (__m256i*)&locs[y*permutationBatchSize];
+			__m256i vy = _mm256_loadu_si256(ly);
+			// the compare mask is -1 where the location is decremented
+			_mm256_storeu_si256(ly, _mm256_add_epi32(vy, _mm256_cmpgt_epi32(vy, vx)));
+		}
+#else
+		for (int y = x+1; y < k; y++)
+		{
+			int32_t *ly = &locs[y*permutationBatchSize];
+			for (int b = 0; b < permutationBatchSize; b++)
+				ly[b] -= (ly[b] > lx[b]);
+		}
+#endif
+	}
+	for (int b = 0; b < permutationBatchSize; b++)
+		ranks[b] = 0;
+	for (int x = 0; x < k; x++)
+		for (int b = 0; b < permutationBatchSize; b++)
+			ranks[b] += locs[x*permutationBatchSize+b]*weights[x];
+}
+
+template <typename rankType>
+inline void LexUnrankDigits(const uint64_t *ranks, int k, int n, int32_t *locs)
+{
+	for (int b = 0; b < permutationBatchSize; b++)
+	{
+		rankType hash = (rankType)ranks[b];
+		rankType numEntriesLeft = n-k+1;
+		for (int x = k-1; x >= 0; x--)
+		{
+			locs[x*permutationBatchSize+b] = (int32_t)(hash%numEntriesLeft);
+			hash /= numEntriesLeft;
+			numEntriesLeft++;
+		}
+	}
+}
+
+/** Unranks a full batch of ranks of k items out of n into item locations. */
+inline void LexUnrankBatch(const uint64_t *ranks, int k, int n, int32_t *locs)
+{
+	// The digits are independent of the corrections below, so they are all
+	// extracted first (with 32-bit division when possible). Correcting in
+	// decreasing order of x then matches the interleaved order of
+	// PermutationPDB::GetStateFromPDBHash.
+	bool fits32 = true;
+	for (int b = 0; b < permutationBatchSize; b++)
+		fits32 = fits32 && (ranks[b] <= 0xFFFFFFFFull);
+	if (fits32)
+		LexUnrankDigits<uint32_t>(ranks, k, n, locs);
+	else
+		LexUnrankDigits<uint64_t>(ranks, k, n, locs);
+	for (int x = k-1; x >= 0; x--)
+	{
+		int32_t *lx = &locs[x*permutationBatchSize];
+#ifdef __AVX2__
+		// y >= x is y > x-1
+		__m256i vx = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)lx), _mm256_set1_epi32(1));
+		for (int y = x+1; y < k; y++)
+		{
+			__m256i *ly = (__m256i*)&locs[y*permutationBatchSize];
+			__m256i vy = _mm256_loadu_si256(ly);
+			_mm256_storeu_si256(ly, _mm256_sub_epi32(vy, _mm256_cmpgt_epi32(vy, vx)));
+		}
+#else
+		for (int y = x+1; y < k; y++)
+		{
+			int32_t *ly = &locs[y*permutationBatchSize];
+			for (int b = 0; b < permutationBatchSize; b++)
+				ly[b] += (ly[b] >= lx[b]);
+		}
+#endif
+	}
+}
+
+#endif /* PermutationBatch_h */
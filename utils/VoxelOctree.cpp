@@ -0,0 +1,222 @@
+//
+//  VoxelOctree.cpp
+//  hog2
+//
+
+#include "VoxelOctree.h"
+#include <algorithm>
+
+namespace {
+	// Spreads the low 21 bits of x to every third bit
+	uint64_t Part1By2(uint64_t x)
+	{
+		x &= 0x1FFFFF;
+		x = (x | (x << 32)) & 0x1F00000000FFFFull;
+		x = (x | (x << 16)) & 0x1F0000FF0000FFull;
+		x = (x | (x << 8)) & 0x100F00F00F00F00Full;
+		x = (x | (x << 4)) & 0x10C30C30C30C30C3ull;
+		x = (x | (x << 2)) & 0x1249249249249249ull;
+		return x;
+	}
+
+	uint32_t Compact1By2(uint64_t x)
+	{
+		x &= 0x1249249249249249ull;
+		x = (x | (x >> 2)) & 0x10C30C30C30C30C3ull;
+		x = (x | (x >> 4)) & 0x100F00F00F00F00Full;
+		x = (x | (x >> 8)) & 0x1F0000FF0000FFull;
+		x = (x | (x >> 16)) & 0x1F00000000FFFFull;
+		x = (x | (x >> 32)) & 0x1FFFFF;
+		return (uint32_t)x;
+	}
+
+	// The position of child c among the stored children of a node
+	inline uint32_t ChildIndex(uint64_t children, int c)
+	{
+		return __builtin_popcountll(children & ((1ull<<c)-1));
+	}
+}
+
+uint64_t VoxelOctree::EncodeMorton(uint32_t x, uint32_t y, uint32_t z)
+{
+	// as Voxels::EncodeMorton3
+	return (Part1By2(z) << 2) | (Part1By2(y) << 1) | Part1By2(x);
+}
+
+void VoxelOctree::DecodeMorton(uint64_t code, uint32_t &x, uint32_t &y, uint32_t &z)
+{
+	x = Compact1By2(code);
+	y = Compact1By2(code >> 1);
+	z = Compact1By2(code >> 2);
+}
+
+VoxelOctree::VoxelOctree()
+:sizeX(0), sizeY(0), sizeZ(0), depth(0)
+{
+}
+
+void VoxelOctree::Build(const uint64_t *morton, const uint64_t *blocked, size_t count,
+						uint32_t sx, uint32_t sy, uint32_t sz)
+{
+	sizeX = sx;
+	sizeY = sy;
+	sizeZ = sz;
+	// one level per factor of 4 in bricks, at least one above the bricks
+	uint32_t largest = (std::max(sizeX, std::max(sizeY, sizeZ))+3)/4;
+	for (depth = 1; depth < 10 && (1u<<(2*depth)) < largest; depth++)
+	{ }
+
+	std::vector<std::pair<uint64_t, uint64_t> > sorted;
+	sorted.reserve(count);
+	for (size_t x = 0; x < count; x++)
+	{
+		uint32_t bx, by, bz;
+		DecodeMorton(morton[x], bx, by, bz);
+		if (bx*4 >= sizeX || by*4 >= sizeY || bz*4 >= sizeZ)
+			continue;
+		// voxels outside the world are blocked anyway, so only inside ones are stored
+		uint64_t mask = blocked[x];
+		for (int i = 0; i < 64; i++)
+			if (bx*4+(i>>4) >= sizeX || by*4+((i>>2)&3) >= sizeY || bz*4+(i&3) >= sizeZ)
+				mask &= ~(1ull<<i);
+		if (mask != 0)
+			sorted.push_back(std::make_pair(morton[x], mask));
+	}
+	std::sort(sorted.begin(), sorted.end());
+	std::vector<uint64_t> keys;
+	std::vector<bool> full;
+	bricks.clear();
+	for (size_t x = 0; x < sorted.size(); x++)
+	{
+		if (keys.size() > 0 && keys.back() == sorted[x].first)
+		{
+			bricks.back() |= sorted[x].second;
+			full.back() = (bricks.back() == ~0ull);
+			continue;
+		}
+		keys.push_back(sorted[x].first);
+		bricks.push_back(sorted[x].second);
+		full.push_back(sorted[x].second == ~0ull);
+	}
+
+	// the parents of each level group 64 consecutive Morton codes
+	levels.assign(depth, std::vector<treeNode>());
+	for (int d = depth-1; d >= 0; d--)
+	{
+		std::vector<uint64_t> parentKeys;
+		std::vector<bool> parentFull;
+		std::vector<treeNode> &nodes = levels[d];
+		for (size_t x = 0; x < keys.size(); x++)
+		{
+			uint64_t parent = keys[x]>>6;
+			if (parentKeys.size() == 0 || parentKeys.back() != parent)
+			{
+				treeNode n = {0, 0, (uint32_t)x};
+				nodes.push_back(n);
+				parentKeys.push_back(parent);
+			}
+			nodes.back().children |= 1ull<<(keys[x]&63);
+			if (full[x])
+				nodes.back().full |= 1ull<<(keys[x]&63);
+		}
+		for (size_t x = 0; x < nodes.size(); x++)
+			parentFull.push_back(nodes[x].full == ~0ull);
+		keys.swap(parentKeys);
+		full.swap(parentFull);
+	}
+}
+
+uint64_t VoxelOctree::GetBrick(int bx, int by, int bz) const
+{
+	if (bx < 0 || by < 0 || bz < 0 || (uint32_t)bx*4 >= sizeX || (uint32_t)by*4 >= sizeY || (uint32_t)bz*4 >= sizeZ)
+		return ~0ull;
+	if (levels[0].size() == 0)
+		return 0;
+	uint64_t code = EncodeMorton(bx, by, bz);
+	uint32_t index = 0;
+	for (int d = 0; d < depth; d++)
+	{
+		const treeNode &n = levels[d][index];
+		int c = (code>>(6*(depth-1-d)))&63;
+		if (((n.children>>c)&1) == 0)
+			return 0;
+		if ((n.full>>c)&1)
+			return ~0ull;
+		index = n.firstChild+ChildIndex(n.children, c);
+	}
+	return bricks[index];
+}
+
+bool VoxelOctree::IsBlocked(int x, int y, int z) const
+{
+	if (!Inside(x, y, z))
+		return true;
+	return (GetBrick(x>>2, y>>2, z>>2)>>BrickBit(x&3, y&3, z&3))&1;
+}
+
+uint32_t VoxelOctree::GetFreeNeighborhood(int x, int y, int z) const
+{
+	// the neighborhood spans one or two bricks on each axis
+	uint64_t masks[2][2][2];
+	int bx = (x-1)>>2, by = (y-1)>>2, bz = (z-1)>>2;
+	int nx = ((x+1)>>2)-bx, ny = ((y+1)>>2)-by, nz = ((z+1)>>2)-bz;
+	for (int i = 0; i <= nx; i++)
+		for (int j = 0; j <= ny; j++)
+			for (int k = 0; k <= nz; k++)
+				masks[i][j][k] = GetBrick(bx+i, by+j, bz+k);
+
+	uint32_t result = 0;
+	for (int dx = -1; dx <= 1; dx++)
+	{
+		int vx = x+dx;
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			int vy = y+dy;
+			for (int dz = -1; dz <= 1; dz++)
+			{
+				int vz = z+dz;
+				if (!Inside(vx, vy, vz))
+					continue;
+				uint64_t brick = masks[(vx>>2)-bx][(vy>>2)-by][(vz>>2)-bz];
+				if (((brick>>BrickBit(vx&3, vy&3, vz&3))&1) == 0)
+					result |= 1u<<((dx+1)*9+(dy+1)*3+(dz+1));
+			}
+		}
+	}
+	return result;
+}
+
+VoxelOctree::tRegion VoxelOctree::GetRegion(int level, int x, int y, int z) const
+{
+	if (!Inside(x, y, z))
+		return kBlockedRegion;
+	if (level == 0)
+		return IsBlocked(x, y, z)?kBlockedRegion:kFreeRegion;
+	if (levels[0].size() == 0)
+		return kFreeRegion;
+	// the region of level L is a node at depth depth+1-L (bricks are at depth)
+	int target = std::max(0, depth+1-level);
+	uint64_t code = EncodeMorton(x>>2, y>>2, z>>2);
+	uint32_t index = 0;
+	for (int d = 0; d < target; d++)
+	{
+		const treeNode &n = levels[d][index];
+		int c = (code>>(6*(depth-1-d)))&63;
+		if (((n.children>>c)&1) == 0)
+			return kFreeRegion;
+		if ((n.full>>c)&1)
+			return kBlockedRegion;
+		index = n.firstChild+ChildIndex(n.children, c);
+	}
+	if (target == depth)
+		return (bricks[index] == ~0ull)?kBlockedRegion:kMixedRegion;
+	return (levels[target][index].full == ~0ull)?kBlockedRegion:kMixedRegion;
+}
+
+uint64_t VoxelOctree::GetMemoryBytes() const
+{
+	uint64_t total = bricks.size()*sizeof(uint64_t);
+	for (size_t d = 0; d < levels.size(); d++)
+		total += levels[d].size()*sizeof(treeNode);
+	return total;
+}
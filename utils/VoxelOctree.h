@@ -0,0 +1,83 @@
+//
+//  VoxelOctree.h
+//  hog2
+//
+//  Sparse occupancy of a voxel world in Morton order: a tree with 4x4x4
+//  children per node over bricks of 4x4x4 voxels.
+//
+
+#ifndef VoxelOctree_h
+#define VoxelOctree_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/*
+ * Each brick keeps one bit per voxel (set if blocked), the same 64-bit
+ * masks as the .3dnav files. Bricks without blocked voxels are not stored.
+ * Every node of the tree has a 64-bit mask of the children (in Morton
+ * order) that have blocked voxels and a mask of those that are entirely
+ * blocked, and its stored children are adjacent in the next level. A lookup
+ * descends one level per 4x of the world's extent and stops early in empty
+ * or full regions.
+ *
+ * Voxels outside the world are blocked.
+ */
+class VoxelOctree {
+public:
+	enum tRegion {
+		kFreeRegion,
+		kMixedRegion,
+		kBlockedRegion
+	};
+
+	VoxelOctree();
+	/**
+	 * Builds from count bricks: morton[i] is the Morton code of the brick
+	 * coordinates (voxel/4) and blocked[i] its voxels (see BrickBit). The
+	 * bricks can be in any order; repeated bricks are merged.
+	 */
+	void Build(const uint64_t *morton, const uint64_t *blocked, size_t count,
+			   uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ);
+
+	bool IsBlocked(int x, int y, int z) const;
+	/** Bit (dx+1)*9+(dy+1)*3+(dz+1) is set if voxel (x+dx, y+dy, z+dz) is free */
+	uint32_t GetFreeNeighborhood(int x, int y, int z) const;
+	/**
+	 * Whether the aligned region of 4^level voxels per side around a voxel
+	 * is free, blocked or mixed; level 0 is the voxel and 1 its brick.
+	 * Regions that cross the edge of the world are never blocked.
+	 */
+	tRegion GetRegion(int level, int x, int y, int z) const;
+	/** The smallest level whose region covers the world */
+	int GetNumLevels() const { return depth+1; }
+
+	uint32_t GetSizeX() const { return sizeX; }
+	uint32_t GetSizeY() const { return sizeY; }
+	uint32_t GetSizeZ() const { return sizeZ; }
+	size_t GetNumBricks() const { return bricks.size(); }
+	uint64_t GetMemoryBytes() const;
+
+	/** Bit of voxel (x, y, z) of a brick, 0 <= x, y, z < 4 */
+	static int BrickBit(int x, int y, int z) { return x*16+y*4+z; }
+	static uint64_t EncodeMorton(uint32_t x, uint32_t y, uint32_t z);
+	static void DecodeMorton(uint64_t code, uint32_t &x, uint32_t &y, uint32_t &z);
+private:
+	struct treeNode {
+		uint64_t children; // children with blocked voxels
+		uint64_t full; // children that are blocked entirely
+		uint32_t firstChild;
+	};
+	uint64_t GetBrick(int bx, int by, int bz) const;
+	bool Inside(int x, int y, int z) const
+	{ return x >= 0 && y >= 0 && z >= 0 && (uint32_t)x < sizeX && (uint32_t)y < sizeY && (uint32_t)z < sizeZ; }
+
+	// levels[0] holds the root; the children of levels[depth-1] are bricks
+	std::vector<std::vector<treeNode> > levels;
+	std::vector<uint64_t> bricks;
+	uint32_t sizeX, sizeY, sizeZ;
+	int depth;
+};
+
+#endif /* VoxelOctree_h */
@@ -0,0 +1,157 @@
+//
+//  WorkerPool.h
+//  hog2
+//
+//  Persistent worker threads and a work-stealing range scheduler for
+//  layered (BFS-style) parallel builds.
+//
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+/* WorkerPool
+ *
+ * A fixed set of threads that stay alive between jobs. Run() hands the same
+ * function to every worker (with the worker's thread number) and blocks until
+ * all workers have returned from it. This avoids creating and joining new
+ * threads for every layer of a layered search.
+ */
+class WorkerPool {
+public:
+	WorkerPool(int numThreads);
+	~WorkerPool();
+	int NumThreads() const { return (int)threads.size(); }
+	void Run(const std::function<void(int)> &job);
+private:
+	void Worker(int threadNum);
+	std::vector<std::thread> threads;
+	std::function<void(int)> currentJob;
+	std::mutex lock;
+	std::condition_variable jobReady;
+	std::condition_variable jobDone;
+	uint64_t generation;
+	int running;
+	bool quit;
+};
+
+inline WorkerPool::WorkerPool(int numThreads)
+:generation(0), running(0), quit(false)
+{
+	if (numThreads < 1)
+		numThreads = 1;
+	for (int x = 0; x < numThreads; x++)
+		threads.push_back(std::thread(&WorkerPool::Worker, this, x));
+}
+
+inline WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> l(lock);
+		quit = true;
+	}
+	jobReady.notify_all();
+	for (auto &t : threads)
+		t.join();
+}
+
+/* Runs job(threadNum) on every worker, waiting until all have finished. */
+inline void WorkerPool::Run(const std::function<void(int)> &job)
+{
+	std::unique_lock<std::mutex> l(lock);
+	currentJob = job;
+	running = (int)threads.size();
+	generation++;
+	jobReady.notify_all();
+	jobDone.wait(l, [this](){ return running == 0; });
+	currentJob = nullptr;
+}
+
+inline void WorkerPool::Worker(int threadNum)
+{
+	uint64_t lastGeneration = 0;
+	while (true)
+	{
+		std::function<void(int)> job;
+		{
+			std::unique_lock<std::mutex> l(lock);
+			jobReady.wait(l, [&](){ return quit || generation != lastGeneration; });
+			if (quit)
+				return;
+			lastGeneration = generation;
+			job = currentJob;
+		}
+		job(threadNum);
+		{
+			std::lock_guard<std::mutex> l(lock);
+			running--;
+			if (running == 0)
+				jobDone.notify_one();
+		}
+	}
+}
+
+/* WorkStealingRange
+ *
+ * Splits the items [0, count) into one contiguous slice per thread. Each
+ * thread consumes its own slice front to back (keeping memory access local),
+ * and once it is empty steals single items from the other slices. Claiming an
+ * item is a single uncontended atomic increment in the common case.
+ */
+class WorkStealingRange {
+public:
+	WorkStealingRange(int numThreads);
+	void Reset(uint64_t count);
+	bool Next(int threadNum, uint64_t &item);
+private:
+	struct slice {
+		std::atomic<uint64_t> next;
+		uint64_t end;
+		char padding[64-sizeof(std::atomic<uint64_t>)-sizeof(uint64_t)];
+	};
+	std::vector<slice> slices;
+};
+
+inline WorkStealingRange::WorkStealingRange(int numThreads)
+:slices(numThreads < 1 ? 1 : numThreads)
+{
+	Reset(0);
+}
+
+/* Not thread safe; call between jobs only. */
+inline void WorkStealingRange::Reset(uint64_t count)
+{
+	uint64_t numSlices = slices.size();
+	for (uint64_t x = 0; x < numSlices; x++)
+	{
+		slices[x].next.store(count*x/numSlices);
+		slices[x].end = count*(x+1)/numSlices;
+	}
+}
+
+inline bool WorkStealingRange::Next(int threadNum, uint64_t &item)
+{
+	int numSlices = (int)slices.size();
+	for (int x = 0; x < numSlices; x++)
+	{
+		slice &s = slices[(threadNum+x)%numSlices];
+		if (s.next.load(std::memory_order_relaxed) >= s.end)
+			continue;
+		uint64_t val = s.next.fetch_add(1, std::memory_order_relaxed);
+		if (val < s.end)
+		{
+			item = val;
+			return true;
+		}
+	}
+	return false;
+}
+
+#endif